@@ -0,0 +1,174 @@
+/*
+ * bench_ctparse.c - /proc/net/nf_conntrack parser throughput
+ *
+ * Writes a 30k-entry conntrack fixture to a temp file and parses it
+ * repeatedly with (a) the original fgets + strstr + sscanf + inet_pton
+ * loop and (b) the streaming myco_ctparse tokenizer. Both feed the same
+ * checksum sink so the comparison is parse cost only.
+ *
+ *   ./bench_ctparse [entries] [iterations]
+ */
+#define _POSIX_C_SOURCE 200809L
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "../myco_ctparse.h"
+
+static double now_s(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+typedef struct {
+    uint64_t sum;
+    int      records;
+} sink_t;
+
+static void sink_add(sink_t *s, const flow_key_t *k, uint64_t txp, uint64_t rxp,
+                     uint64_t txb, uint64_t rxb) {
+    s->sum += k->src_ip ^ k->dst_ip ^ k->src_port ^ ((uint64_t)k->dst_port << 16) ^ k->protocol;
+    s->sum += txp + rxp + txb + rxb;
+    s->records++;
+}
+
+static int stream_cb(const ct_record_t *rec, void *user) {
+    sink_add((sink_t *)user, &rec->key, rec->tx_packets, rec->rx_packets,
+             rec->tx_bytes, rec->rx_bytes);
+    return 0;
+}
+
+/* The pre-tokenizer populate_from_proc() loop, minus the table update. */
+static void legacy_parse(const char *path, sink_t *s) {
+    FILE *fp = fopen(path, "r");
+    if (!fp) return;
+    char line[1024];
+    while (fgets(line, sizeof(line), fp)) {
+        int proto_num = 0;
+        char src_str[64] = {0}, dst_str[64] = {0};
+        int sport = 0, dport = 0;
+        uint64_t pkts = 0, rx_pkts = 0, tx_byts = 0, rx_byts = 0;
+
+        char *p = strstr(line, "tcp");
+        if (p) {
+            proto_num = 6;
+        } else {
+            p = strstr(line, "udp");
+            if (p) proto_num = 17;
+            else   continue;
+        }
+        p = strstr(line, "src=");
+        if (p) sscanf(p, "src=%63s", src_str);
+        p = strstr(line, "dst=");
+        if (p) sscanf(p, "dst=%63s", dst_str);
+        p = strstr(line, "sport=");
+        if (p) sscanf(p, "sport=%d", &sport);
+        p = strstr(line, "dport=");
+        if (p) sscanf(p, "dport=%d", &dport);
+        p = strstr(line, "packets=");
+        if (p) {
+            sscanf(p, "packets=%llu", (unsigned long long *)&pkts);
+            p = strstr(p + 8, "packets=");
+            if (p) sscanf(p, "packets=%llu", (unsigned long long *)&rx_pkts);
+        }
+        p = strstr(line, "bytes=");
+        if (p) {
+            sscanf(p, "bytes=%llu", (unsigned long long *)&tx_byts);
+            p = strstr(p + 6, "bytes=");
+            if (p) sscanf(p, "bytes=%llu", (unsigned long long *)&rx_byts);
+        }
+        if (!src_str[0] || !dst_str[0]) continue;
+
+        flow_key_t key;
+        memset(&key, 0, sizeof(key));
+        inet_pton(AF_INET, src_str, &key.src_ip);
+        inet_pton(AF_INET, dst_str, &key.dst_ip);
+        key.src_port = (uint16_t)sport;
+        key.dst_port = (uint16_t)dport;
+        key.protocol = (uint8_t)proto_num;
+        sink_add(s, &key, pkts, rx_pkts, tx_byts, rx_byts);
+    }
+    fclose(fp);
+}
+
+static void stream_parse(const char *path, sink_t *s) {
+    static char buf[CT_PARSE_BLOCK];
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) return;
+    ct_parse_fd(fd, buf, sizeof(buf), stream_cb, s);
+    close(fd);
+}
+
+static int write_fixture(const char *path, int entries) {
+    FILE *fp = fopen(path, "w");
+    if (!fp) return -1;
+    unsigned seed = 12345;
+    for (int i = 0; i < entries; i++) {
+        seed = seed * 1103515245u + 12345u;
+        int udp = (seed >> 16) % 4 == 0;
+        unsigned lan = 10 + i % 200, wan = (seed >> 8) & 0xFFFFFF;
+        unsigned sport = 1024 + (seed % 60000), dport = udp ? 53 + (i % 3) * 390 : 443;
+        unsigned long long tp = seed % 5000, rp = (seed >> 3) % 9000;
+        fprintf(fp,
+                "ipv4     2 %s      %d %u %s src=192.168.1.%u dst=%u.%u.%u.%u "
+                "sport=%u dport=%u packets=%llu bytes=%llu src=%u.%u.%u.%u "
+                "dst=192.168.1.%u sport=%u dport=%u packets=%llu bytes=%llu "
+                "[ASSURED] mark=0 zone=0 use=2\n",
+                udp ? "udp" : "tcp", udp ? 17 : 6, 30 + i % 400000,
+                udp ? "" : "ESTABLISHED",
+                lan, 1 + (wan >> 16) % 223, (wan >> 8) & 0xFF, wan & 0xFF, 1 + i % 254,
+                sport, dport, tp, tp * 120,
+                1 + (wan >> 16) % 223, (wan >> 8) & 0xFF, wan & 0xFF, 1 + i % 254,
+                lan, dport, sport, rp, rp * 900);
+    }
+    fclose(fp);
+    return 0;
+}
+
+int main(int argc, char **argv) {
+    int entries = argc > 1 ? atoi(argv[1]) : 30000;
+    int iters   = argc > 2 ? atoi(argv[2]) : 20;
+    if (entries <= 0) entries = 30000;
+    if (iters <= 0) iters = 20;
+
+    char path[] = "/tmp/bench_ctparse_XXXXXX";
+    int tmp = mkstemp(path);
+    if (tmp < 0) { perror("mkstemp"); return 1; }
+    close(tmp);
+    if (write_fixture(path, entries) != 0) { perror("fixture"); return 1; }
+
+    sink_t a = {0}, b = {0};
+    legacy_parse(path, &a);     /* warm page cache */
+    stream_parse(path, &b);
+    if (a.sum != b.sum || a.records != b.records) {
+        fprintf(stderr, "MISMATCH: legacy %d/%llu stream %d/%llu\n",
+                a.records, (unsigned long long)a.sum,
+                b.records, (unsigned long long)b.sum);
+        unlink(path);
+        return 1;
+    }
+
+    double t0 = now_s();
+    for (int i = 0; i < iters; i++) { sink_t s = {0}; legacy_parse(path, &s); }
+    double t_legacy = now_s() - t0;
+
+    t0 = now_s();
+    for (int i = 0; i < iters; i++) { sink_t s = {0}; stream_parse(path, &s); }
+    double t_stream = now_s() - t0;
+
+    unlink(path);
+
+    double lines = (double)entries * iters;
+    printf("entries=%d iterations=%d\n", entries, iters);
+    printf("legacy  fgets+sscanf : %10.0f lines/s  (%.2f ms/pass)\n",
+           lines / t_legacy, t_legacy * 1e3 / iters);
+    printf("stream  myco_ctparse : %10.0f lines/s  (%.2f ms/pass)\n",
+           lines / t_stream, t_stream * 1e3 / iters);
+    printf("speedup              : %.1fx\n", t_legacy / t_stream);
+    return 0;
+}
@@ -0,0 +1,165 @@
+/*
+ * bench_domains.c - domain → service / persona match throughput
+ *
+ * Replays a home-router query mix (CDN hostnames with deep labels,
+ * first-party API hosts, and ~40% names that match nothing) through
+ * (a) the original first-match linear scan over the suffix tables and
+ * (b) the generated suffix trie behind dns_domain_to_service() /
+ * dns_domain_to_hint(). Both read the same myco_domains.def, so the
+ * comparison is lookup cost only. Queries where the two disagree are
+ * listed: those are table-order shadowing the trie now resolves.
+ *
+ *   ./bench_domains [iterations]
+ */
+#define _POSIX_C_SOURCE 200809L
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <time.h>
+
+#include "../myco_dns.h"
+
+/* Referenced by dns_sniff_thread(); never started here. */
+volatile sig_atomic_t g_stop = 0;
+
+/* ── Legacy tables, rebuilt from the same source ──────────────── */
+
+typedef struct { const char *suffix; persona_t persona; } legacy_hint_t;
+typedef struct { const char *suffix; service_t service; } legacy_service_t;
+
+#define DOMAIN_HINT(s, v)
+#define DOMAIN_SERVICE(s, v) { s, v },
+static const legacy_service_t legacy_services[] = {
+#include "../myco_domains.def"
+    { NULL, SVC_UNKNOWN }
+};
+#undef DOMAIN_HINT
+#undef DOMAIN_SERVICE
+
+#define DOMAIN_HINT(s, v) { s, v },
+#define DOMAIN_SERVICE(s, v)
+static const legacy_hint_t legacy_hints[] = {
+#include "../myco_domains.def"
+    { NULL, PERSONA_UNKNOWN }
+};
+#undef DOMAIN_HINT
+#undef DOMAIN_SERVICE
+
+static int suffix_match(const char *domain, size_t dlen, const char *suffix) {
+    size_t slen = strlen(suffix);
+    if (slen > dlen) return 0;
+    const char *tail = domain + (dlen - slen);
+    return strcasecmp(tail, suffix) == 0 && (slen == dlen || tail[-1] == '.');
+}
+
+static service_t legacy_to_service(const char *domain) {
+    size_t dlen = strlen(domain);
+    for (const legacy_service_t *e = legacy_services; e->suffix; e++) {
+        if (suffix_match(domain, dlen, e->suffix)) return e->service;
+    }
+    return SVC_UNKNOWN;
+}
+
+static persona_t legacy_to_hint(const char *domain) {
+    size_t dlen = strlen(domain);
+    for (const legacy_hint_t *e = legacy_hints; e->suffix; e++) {
+        if (suffix_match(domain, dlen, e->suffix)) return e->persona;
+    }
+    return PERSONA_UNKNOWN;
+}
+
+/* ── Query mix ─────────────────────────────────────────────────── */
+
+static const char *const queries[] = {
+    "rr3---sn-4g5lznez.googlevideo.com",
+    "rr1---sn-ab5l6nrz.googlevideo.com",
+    "i.ytimg.com",
+    "yt3.ggpht.com",
+    "www.youtube.com",
+    "ipv4-c012-ist001-ix.1.oca.nflxvideo.net",
+    "occ-0-2773-185.1.nflxso.net",
+    "video-ist1-1.xx.fbcdn.net",
+    "scontent-ist1-1.cdninstagram.com",
+    "graph.facebook.com",
+    "audio-ak-spotify-com.akamaized.net",
+    "spclient.wg.spotify.com",
+    "us-east1.discord.media",
+    "gateway.discord.gg",
+    "zoom.us",
+    "us04web.zoom.us",
+    "teams.microsoft.com",
+    "meet.google.com",
+    "drive.google.com",
+    "docs.google.com",
+    "euw1.api.riotgames.com",
+    "cdn.steamstatic.com",
+    "steamcdn-a.akamaihd.net",
+    "download.microsoft.com",
+    "swcdn.apple.com",
+    "connectivity-check.ubuntu.com",
+    "www.dropbox.com",
+    "api.github.com",
+    /* No match */
+    "www.google.com",
+    "ads.doubleclick.net",
+    "www.example-shop.com.tr",
+    "cdn.jsdelivr.net",
+    "fonts.gstatic.com",
+    "ocsp.digicert.com",
+    "time.cloudflare.com",
+    "d2x1f5c3v5a6b7.cloudfront.net",
+    "s3.eu-central-1.amazonaws.com",
+    "mobile.events.data.microsoft.com",
+    "api.weather.example.org",
+    "router.lan",
+};
+#define N_QUERIES (sizeof(queries) / sizeof(queries[0]))
+
+static double now_s(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+int main(int argc, char **argv) {
+    int iters = argc > 1 ? atoi(argv[1]) : 20000;
+    if (iters <= 0) iters = 20000;
+
+    for (size_t i = 0; i < N_QUERIES; i++) {
+        service_t a = legacy_to_service(queries[i]);
+        service_t b = dns_domain_to_service(queries[i]);
+        persona_t c = legacy_to_hint(queries[i]);
+        persona_t d = dns_domain_to_hint(queries[i]);
+        if (a != b || c != d) {
+            printf("differs: %-40s service %s → %s, persona %d → %d\n", queries[i],
+                   service_name(a), service_name(b), (int)c, (int)d);
+        }
+    }
+
+    unsigned sink = 0;
+    double t0 = now_s();
+    for (int it = 0; it < iters; it++) {
+        for (size_t i = 0; i < N_QUERIES; i++) {
+            sink += (unsigned)legacy_to_service(queries[i]);
+            sink += (unsigned)legacy_to_hint(queries[i]);
+        }
+    }
+    double legacy = now_s() - t0;
+
+    t0 = now_s();
+    for (int it = 0; it < iters; it++) {
+        for (size_t i = 0; i < N_QUERIES; i++) {
+            sink += (unsigned)dns_domain_to_service(queries[i]);
+            sink += (unsigned)dns_domain_to_hint(queries[i]);
+        }
+    }
+    double trie = now_s() - t0;
+
+    double n = (double)iters * (double)N_QUERIES * 2.0;
+    printf("linear scan: %10.0f matches/s\n", n / legacy);
+    printf("suffix trie: %10.0f matches/s  (%.1fx)\n", n / trie, legacy / trie);
+    printf("(checksum %u)\n", sink);
+    return 0;
+}
@@ -0,0 +1,210 @@
+/*
+ * bench_ports.c - port → service / persona lookup cost
+ *
+ * Compares the original if-chains of range comparisons (kept verbatim
+ * below) with the generated table behind service_from_port() /
+ * hint_from_port(). First checks that both agree on every TCP and UDP
+ * port, then replays a home-router destination mix: mostly 443/80,
+ * some ephemeral and P2P ports, and a slice of game / call traffic.
+ *
+ *   ./bench_ports [iterations]
+ */
+#define _POSIX_C_SOURCE 200809L
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "../myco_hint.h"
+
+/* ── Legacy branch chains ─────────────────────────────────────── */
+
+static persona_t legacy_hint(uint8_t protocol, uint16_t dst_port) {
+    /* ── UDP ports ─────────────────────────────────────────────── */
+    if (protocol == 17) {
+        /* VOIP / WebRTC */
+        if (dst_port >= 3478 && dst_port <= 3479)  return PERSONA_VOIP;    /* STUN/TURN */
+        if (dst_port >= 19302 && dst_port <= 19309) return PERSONA_VOIP;   /* Google Meet/WebRTC */
+        if (dst_port >= 5060 && dst_port <= 5061)   return PERSONA_VOIP;   /* SIP */
+        if (dst_port >= 8801 && dst_port <= 8810)   return PERSONA_VIDEO;  /* Zoom media */
+
+        /* GAMING — Valve */
+        if (dst_port >= 27015 && dst_port <= 27050) return PERSONA_GAMING; /* CS2, Dota 2 */
+
+        /* GAMING — Riot (Valorant), PUBG/Krafton */
+        if (dst_port >= 7000 && dst_port <= 8000)   return PERSONA_GAMING;
+
+        /* GAMING — Epic (Fortnite) */
+        if (dst_port == 5222)                        return PERSONA_GAMING;
+        if (dst_port >= 5795 && dst_port <= 5847)    return PERSONA_GAMING;
+
+        /* GAMING — Minecraft Bedrock */
+        if (dst_port == 19132)                       return PERSONA_GAMING;
+
+        /* STREAMING — RTMP */
+        if (dst_port == 1935)                        return PERSONA_STREAMING;
+
+        /* TORRENT — DHT */
+        if (dst_port >= 6881 && dst_port <= 6889)    return PERSONA_TORRENT;
+
+        return PERSONA_UNKNOWN;
+    }
+
+    /* ── TCP ports ─────────────────────────────────────────────── */
+    if (protocol == 6) {
+        /* VOIP — SIP over TCP */
+        if (dst_port >= 5060 && dst_port <= 5061)    return PERSONA_VOIP;
+
+        /* GAMING — Riot (LoL, Valorant) */
+        if (dst_port >= 5000 && dst_port <= 5500)    return PERSONA_GAMING;
+        if (dst_port == 2099)                         return PERSONA_GAMING; /* Riot auth */
+
+        /* GAMING — Minecraft Java */
+        if (dst_port == 25565)                        return PERSONA_GAMING;
+
+        /* GAMING — Supercell (Brawl Stars, Clash Royale) */
+        if (dst_port == 9339)                         return PERSONA_GAMING;
+
+        /* STREAMING — RTMP */
+        if (dst_port == 1935)                         return PERSONA_STREAMING;
+
+        /* TORRENT — BitTorrent */
+        if (dst_port >= 6881 && dst_port <= 6889)     return PERSONA_TORRENT;
+        if (dst_port == 6969)                          return PERSONA_TORRENT; /* tracker */
+
+        return PERSONA_UNKNOWN;
+    }
+
+    return PERSONA_UNKNOWN;
+}
+
+static service_t legacy_service(uint8_t protocol, uint16_t dst_port) {
+    /* ── UDP ports ─────────────────────────────────────────────── */
+    if (protocol == 17) {
+        /* SYSTEM */
+        if (dst_port == 53)                         return SVC_SYSTEM;   /* DNS */
+        if (dst_port == 123)                        return SVC_SYSTEM;   /* NTP */
+        if (dst_port == 67 || dst_port == 68)       return SVC_SYSTEM;   /* DHCP */
+        if (dst_port == 5353)                       return SVC_SYSTEM;   /* mDNS */
+
+        /* VOIP_CALL — signalling + real-time voice */
+        if (dst_port >= 3478 && dst_port <= 3479)   return SVC_VOIP_CALL; /* STUN/TURN */
+        if (dst_port >= 5060 && dst_port <= 5061)   return SVC_VOIP_CALL; /* SIP */
+
+        /* VIDEO_CONF — interactive video calls */
+        if (dst_port >= 19302 && dst_port <= 19309) return SVC_VIDEO_CONF; /* Google Meet */
+        if (dst_port >= 8801 && dst_port <= 8810)   return SVC_VIDEO_CONF; /* Zoom */
+
+        /* GAME_RT — real-time game traffic */
+        if (dst_port >= 27015 && dst_port <= 27050) return SVC_GAME_RT;   /* Valve */
+        if (dst_port >= 7000 && dst_port <= 8000)   return SVC_GAME_RT;   /* Riot/PUBG */
+        if (dst_port == 5222)                       return SVC_GAME_RT;   /* Epic */
+        if (dst_port >= 5795 && dst_port <= 5847)   return SVC_GAME_RT;   /* Epic */
+        if (dst_port == 19132)                      return SVC_GAME_RT;   /* MC Bedrock */
+
+        /* VIDEO_LIVE — RTMP push streaming */
+        if (dst_port == 1935)                       return SVC_VIDEO_LIVE;
+
+        /* TORRENT — DHT */
+        if (dst_port >= 6881 && dst_port <= 6889)   return SVC_TORRENT;
+
+        return SVC_UNKNOWN;
+    }
+
+    /* ── TCP ports ─────────────────────────────────────────────── */
+    if (protocol == 6) {
+        /* WEB_INTERACTIVE — remote shell / control channels */
+        if (dst_port == 22)                         return SVC_WEB_INTERACTIVE; /* SSH */
+
+        /* VOIP_CALL — SIP over TCP */
+        if (dst_port >= 5060 && dst_port <= 5061)   return SVC_VOIP_CALL;
+
+        /* GAME_RT */
+        if (dst_port >= 5000 && dst_port <= 5500)   return SVC_GAME_RT;   /* Riot */
+        if (dst_port == 2099)                       return SVC_GAME_RT;   /* Riot auth */
+        if (dst_port == 25565)                      return SVC_GAME_RT;   /* MC Java */
+        if (dst_port == 9339)                       return SVC_GAME_RT;   /* Supercell */
+
+        /* VIDEO_LIVE — RTMP */
+        if (dst_port == 1935)                       return SVC_VIDEO_LIVE;
+
+        /* TORRENT */
+        if (dst_port >= 6881 && dst_port <= 6889)   return SVC_TORRENT;
+        if (dst_port == 6969)                       return SVC_TORRENT;   /* tracker */
+
+        return SVC_UNKNOWN;
+    }
+
+    return SVC_UNKNOWN;
+}
+
+/* ── Destination mix ───────────────────────────────────────────── */
+
+#define N_FLOWS 4096
+
+static uint8_t  mix_proto[N_FLOWS];
+static uint16_t mix_port[N_FLOWS];
+
+static void build_mix(void) {
+    uint32_t x = 2463534242u;   /* xorshift32, fixed seed */
+    for (int i = 0; i < N_FLOWS; i++) {
+        x ^= x << 13; x ^= x >> 17; x ^= x << 5;
+        uint32_t r = x % 100;
+        if (r < 55)      { mix_proto[i] = 6;  mix_port[i] = 443; }
+        else if (r < 65) { mix_proto[i] = 17; mix_port[i] = 443; }     /* QUIC */
+        else if (r < 72) { mix_proto[i] = 6;  mix_port[i] = 80; }
+        else if (r < 77) { mix_proto[i] = 17; mix_port[i] = 53; }
+        else if (r < 85) { mix_proto[i] = 17; mix_port[i] = (uint16_t)(27015 + x % 36); }
+        else if (r < 88) { mix_proto[i] = 17; mix_port[i] = (uint16_t)(3478 + (x & 1)); }
+        else             { mix_proto[i] = (x & 2) ? 6 : 17;
+                           mix_port[i] = (uint16_t)(1024 + x % 64511); }
+    }
+}
+
+static double now_s(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+int main(int argc, char **argv) {
+    int iters = argc > 1 ? atoi(argv[1]) : 2000;
+    if (iters <= 0) iters = 2000;
+
+    static const uint8_t protos[] = { 6, 17, 1, 132 };
+    int diffs = 0;
+    for (size_t p = 0; p < sizeof(protos); p++) {
+        for (uint32_t port = 0; port <= 0xFFFF; port++) {
+            if (legacy_service(protos[p], (uint16_t)port) != service_from_port(protos[p], (uint16_t)port) ||
+                legacy_hint(protos[p], (uint16_t)port) != hint_from_port(protos[p], (uint16_t)port)) {
+                if (diffs++ < 10) printf("differs: proto %u port %u\n", protos[p], port);
+            }
+        }
+    }
+    printf("%d of %zu (proto, port) pairs differ\n", diffs, sizeof(protos) * 65536);
+
+    build_mix();
+    unsigned sink = 0;
+    double t0 = now_s();
+    for (int it = 0; it < iters; it++) {
+        for (int i = 0; i < N_FLOWS; i++) {
+            sink += (unsigned)legacy_service(mix_proto[i], mix_port[i]);
+            sink += (unsigned)legacy_hint(mix_proto[i], mix_port[i]);
+        }
+    }
+    double chain = now_s() - t0;
+
+    t0 = now_s();
+    for (int it = 0; it < iters; it++) {
+        for (int i = 0; i < N_FLOWS; i++) {
+            sink += (unsigned)service_from_port(mix_proto[i], mix_port[i]);
+            sink += (unsigned)hint_from_port(mix_proto[i], mix_port[i]);
+        }
+    }
+    double table = now_s() - t0;
+
+    double n = (double)iters * N_FLOWS * 2.0;
+    printf("branch chain: %6.2f ns/lookup\n", chain / n * 1e9);
+    printf("port table:   %6.2f ns/lookup  (%.1fx)\n", table / n * 1e9, chain / table);
+    printf("(checksum %u)\n", sink);
+    return diffs != 0;
+}
@@ -0,0 +1,402 @@
+/*
+ * mycoflow_replay.c - feed a recorded trace through the flow pipeline
+ *
+ * Reads a trace written by the daemon (trace_file option) and pushes it
+ * through dns_parse_response_at(), the flow table, device aggregation
+ * and classifier_tick() on the trace's own clock, as fast as possible.
+ * The mark and RTT engines are NULL, so nothing touches the kernel.
+ *
+ * Reports ticks/s and ns/tick per stage. Every verdict change (flow
+ * classified, reclassified, stabilised or dropped) is logged per tick;
+ * with --runs N the log of every run is compared against the first, and
+ * --save / --diff keep a log to compare a later build against.
+ *
+ *   ./mycoflow-replay TRACE [--runs N] [--save FILE] [--diff FILE]
+ */
+#define _POSIX_C_SOURCE 200809L
+#include <arpa/inet.h>
+#include <signal.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "../myco_classifier.h"
+#include "../myco_device.h"
+#include "../myco_log.h"
+#include "../myco_trace.h"
+
+/* Referenced by dns_sniff_thread(); never started here. */
+volatile sig_atomic_t g_stop = 0;
+
+enum { ST_DNS, ST_INGEST, ST_DEVICE, ST_CLASSIFY, ST_COUNT };
+static const char *const stage_names[ST_COUNT] = { "dns", "ingest", "device", "classify" };
+
+typedef struct {
+    uint32_t src_ip, dst_ip;
+    uint16_t src_port, dst_port;
+    uint8_t  proto;
+    uint8_t  service;
+    uint8_t  mark;
+    uint8_t  stable;
+} verdict_t;
+
+typedef struct {
+    verdict_t *v;
+    size_t     n, cap;
+} verdict_set_t;
+
+/* Growable text buffer holding one run's verdict log. */
+typedef struct {
+    char  *s;
+    size_t len, cap;
+} text_t;
+
+static double now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec * 1e9 + (double)ts.tv_nsec;
+}
+
+__attribute__((format(printf, 2, 3)))
+static void text_printf(text_t *t, const char *fmt, ...) {
+    for (;;) {
+        va_list ap;
+        va_start(ap, fmt);
+        int n = vsnprintf(t->s ? t->s + t->len : NULL, t->cap - t->len, fmt, ap);
+        va_end(ap);
+        if (n < 0) return;
+        if (t->len + (size_t)n < t->cap) {
+            t->len += (size_t)n;
+            return;
+        }
+        size_t cap = t->cap ? t->cap * 2 : 65536;
+        while (cap <= t->len + (size_t)n) cap *= 2;
+        char *s = realloc(t->s, cap);
+        if (!s) return;
+        t->s = s;
+        t->cap = cap;
+    }
+}
+
+/* ── Verdict snapshots ──────────────────────────────────────── */
+
+static int collect_cb(const flow_service_t *fs, void *user) {
+    verdict_set_t *set = user;
+    if (set->n == set->cap) {
+        size_t cap = set->cap ? set->cap * 2 : 256;
+        verdict_t *v = realloc(set->v, cap * sizeof(*v));
+        if (!v) return 1;
+        set->v = v;
+        set->cap = cap;
+    }
+    verdict_t *v = &set->v[set->n++];
+    v->src_ip   = fs->src_ip;
+    v->dst_ip   = fs->dst_ip;
+    v->src_port = fs->src_port;
+    v->dst_port = fs->dst_port;
+    v->proto    = fs->proto;
+    v->service  = (uint8_t)fs->service;
+    v->mark     = fs->ct_mark;
+    v->stable   = fs->stable;
+    return 0;
+}
+
+static int verdict_key_cmp(const verdict_t *a, const verdict_t *b) {
+    if (a->src_ip != b->src_ip)     return a->src_ip < b->src_ip ? -1 : 1;
+    if (a->dst_ip != b->dst_ip)     return a->dst_ip < b->dst_ip ? -1 : 1;
+    if (a->src_port != b->src_port) return a->src_port < b->src_port ? -1 : 1;
+    if (a->dst_port != b->dst_port) return a->dst_port < b->dst_port ? -1 : 1;
+    if (a->proto != b->proto)       return a->proto < b->proto ? -1 : 1;
+    return 0;
+}
+
+static int verdict_qsort_cmp(const void *a, const void *b) {
+    return verdict_key_cmp(a, b);
+}
+
+static void log_verdict(text_t *log, unsigned tick, const verdict_t *v, int gone) {
+    char src[INET_ADDRSTRLEN], dst[INET_ADDRSTRLEN];
+    struct in_addr a;
+    a.s_addr = v->src_ip;
+    inet_ntop(AF_INET, &a, src, sizeof(src));
+    a.s_addr = v->dst_ip;
+    inet_ntop(AF_INET, &a, dst, sizeof(dst));
+    if (gone) {
+        text_printf(log, "%08u %s:%u>%s:%u/%u gone\n", tick, src, v->src_port,
+                    dst, v->dst_port, v->proto);
+    } else {
+        text_printf(log, "%08u %s:%u>%s:%u/%u %s mark=%u%s\n", tick, src,
+                    v->src_port, dst, v->dst_port, v->proto,
+                    service_name((service_t)v->service), v->mark,
+                    v->stable ? " stable" : "");
+    }
+}
+
+/* Merge the sorted previous and current snapshots, logging differences. */
+static void log_changes(text_t *log, unsigned tick, const verdict_set_t *prev,
+                        const verdict_set_t *cur) {
+    size_t i = 0, j = 0;
+    while (i < prev->n || j < cur->n) {
+        int c = i == prev->n ? 1 : j == cur->n ? -1
+              : verdict_key_cmp(&prev->v[i], &cur->v[j]);
+        if (c < 0) {
+            log_verdict(log, tick, &prev->v[i++], 1);
+        } else if (c > 0) {
+            log_verdict(log, tick, &cur->v[j++], 0);
+        } else {
+            const verdict_t *p = &prev->v[i++], *q = &cur->v[j++];
+            if (p->service != q->service || p->mark != q->mark || p->stable != q->stable) {
+                log_verdict(log, tick, q, 0);
+            }
+        }
+    }
+}
+
+/* ── One pass over the trace ────────────────────────────────── */
+
+typedef struct {
+    unsigned ticks;
+    unsigned dns_msgs;
+    double   span_s;          /* trace time covered */
+    double   stage_ns[ST_COUNT];
+    double   total_ns;
+} run_stats_t;
+
+static int replay(trace_reader_t *r, text_t *log, run_stats_t *st) {
+    static flow_table_t ft;
+    static device_table_t dt;
+    static dns_cache_t dns;
+    memset(st, 0, sizeof(*st));
+    if (flow_table_init_sized(&ft, FLOW_TABLE_MAX_CAPACITY) != 0) return -1;
+    dns_cache_init(&dns);
+    device_table_init(&dt);
+    flow_service_table_t *tab = classifier_create_sized(FLOW_TABLE_MAX_CAPACITY);
+    if (!tab) {
+        dns_cache_destroy(&dns);
+        flow_table_free(&ft);
+        return -1;
+    }
+
+    verdict_set_t sets[2] = {{0}};
+    int cur = 0;
+    double first_ts = -1.0, last_ts = 0.0;
+    int rc = 0;
+
+    trace_reader_rewind(r);
+    double t_start = now_ns();
+    trace_rec_t rec;
+    int got;
+    while ((got = trace_reader_next(r, &rec)) == 1) {
+        if (first_ts < 0.0) first_ts = rec.ts;
+        last_ts = rec.ts;
+        double t0 = now_ns();
+
+        if (rec.type == TRACE_REC_DNS) {
+            dns_parse_response_at(&dns, rec.data, rec.len, rec.ts);
+            st->dns_msgs++;
+            st->stage_ns[ST_DNS] += now_ns() - t0;
+        } else if (rec.type == TRACE_REC_FLOWS) {
+            size_t off = 0;
+            while (off < rec.len) {
+                trace_flow_t f;
+                int used = trace_flow_decode(rec.data + off, rec.len - off, &f);
+                if (used < 0) {
+                    rc = -1;
+                    break;
+                }
+                off += (size_t)used;
+                if (f.kind == TRACE_FLOW_GONE) {
+                    flow_table_remove(&ft, &f.key);
+                    continue;
+                }
+                if (f.kind == TRACE_FLOW_SAME) {
+                    const flow_entry_t *e = flow_table_lookup(&ft, &f.key);
+                    if (e) {
+                        f.tx_packets = e->packets;
+                        f.rx_packets = e->rx_packets;
+                        f.tx_bytes   = e->bytes;
+                        f.rx_bytes   = e->rx_bytes;
+                    }
+                }
+                flow_table_update(&ft, &f.key, f.tx_packets, f.rx_packets,
+                                  f.tx_bytes, f.rx_bytes, rec.ts);
+                if (f.has_mark) flow_table_set_mark(&ft, &f.key, f.mark, rec.ts);
+            }
+            st->stage_ns[ST_INGEST] += now_ns() - t0;
+        } else if (rec.type == TRACE_REC_TICK) {
+            double window_s = 0.5;
+            if (rec.len >= sizeof(window_s)) memcpy(&window_s, rec.data, sizeof(window_s));
+
+            flow_table_evict_stale(&ft, rec.ts, 60.0);
+            double t1 = now_ns();
+            st->stage_ns[ST_INGEST] += t1 - t0;
+
+            device_table_aggregate(&dt, &ft, rec.ts, &dns);
+            device_table_evict_stale(&dt, rec.ts, 120.0);
+            device_table_update_personas(&dt, NULL);
+            double t2 = now_ns();
+            st->stage_ns[ST_DEVICE] += t2 - t1;
+
+            classifier_tick(tab, &ft, &dns, NULL, NULL, rec.ts, window_s);
+            st->stage_ns[ST_CLASSIFY] += now_ns() - t2;
+            st->ticks++;
+
+            /* Verdict bookkeeping is outside the timed stages. */
+            verdict_set_t *next = &sets[cur ^ 1];
+            next->n = 0;
+            classifier_for_each(tab, collect_cb, next);
+            qsort(next->v, next->n, sizeof(*next->v), verdict_qsort_cmp);
+            log_changes(log, st->ticks, &sets[cur], next);
+            cur ^= 1;
+        }
+        if (rc != 0) break;
+    }
+    if (got < 0) rc = -1;
+    st->total_ns = now_ns() - t_start;
+    st->span_s = first_ts < 0.0 ? 0.0 : last_ts - first_ts;
+
+    free(sets[0].v);
+    free(sets[1].v);
+    classifier_destroy(tab);
+    dns_cache_destroy(&dns);
+    flow_table_free(&ft);
+    return rc;
+}
+
+static void print_stats(int run, const run_stats_t *st) {
+    double ticks = st->ticks ? (double)st->ticks : 1.0;
+    double stage_sum = 0.0;
+    for (int s = 0; s < ST_COUNT; s++) stage_sum += st->stage_ns[s];
+    printf("run %d: %u ticks, %u DNS msgs, %.1f s of trace in %.3f s "
+           "(%.0f ticks/s, %.0fx real time)\n",
+           run, st->ticks, st->dns_msgs, st->span_s, st->total_ns / 1e9,
+           stage_sum > 0.0 ? ticks / (stage_sum / 1e9) : 0.0,
+           stage_sum > 0.0 ? st->span_s / (stage_sum / 1e9) : 0.0);
+    for (int s = 0; s < ST_COUNT; s++) {
+        printf("  %-9s %10.0f ns/tick\n", stage_names[s], st->stage_ns[s] / ticks);
+    }
+}
+
+/* ── Verdict log comparison ─────────────────────────────────── */
+
+static const char *next_line(const char *p, const char *end, size_t *len) {
+    const char *nl = memchr(p, '\n', (size_t)(end - p));
+    *len = nl ? (size_t)(nl - p) : (size_t)(end - p);
+    return nl ? nl + 1 : end;
+}
+
+/* Line-by-line comparison; prints the first few mismatches. Returns the
+ * number of differing lines. */
+static unsigned diff_logs(const char *name_a, const text_t *a,
+                          const char *name_b, const text_t *b) {
+    const char *pa = a->s ? a->s : "", *ea = pa + a->len;
+    const char *pb = b->s ? b->s : "", *eb = pb + b->len;
+    unsigned diffs = 0;
+    while (pa < ea || pb < eb) {
+        size_t la = 0, lb = 0;
+        const char *la_s = pa, *lb_s = pb;
+        if (pa < ea) pa = next_line(pa, ea, &la);
+        if (pb < eb) pb = next_line(pb, eb, &lb);
+        if (la == lb && memcmp(la_s, lb_s, la) == 0) continue;
+        if (++diffs <= 10) {
+            printf("  - %s: %.*s\n", name_a, (int)la, la ? la_s : "(end)");
+            printf("  + %s: %.*s\n", name_b, (int)lb, lb ? lb_s : "(end)");
+        }
+    }
+    return diffs;
+}
+
+static int read_file(const char *path, text_t *out) {
+    FILE *f = fopen(path, "rb");
+    if (!f) return -1;
+    char buf[65536];
+    size_t n;
+    while ((n = fread(buf, 1, sizeof(buf), f)) > 0) {
+        text_printf(out, "%.*s", (int)n, buf);
+    }
+    fclose(f);
+    return 0;
+}
+
+int main(int argc, char **argv) {
+    const char *trace = NULL, *save = NULL, *against = NULL;
+    int runs = 1;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--runs") == 0 && i + 1 < argc) {
+            runs = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--save") == 0 && i + 1 < argc) {
+            save = argv[++i];
+        } else if (strcmp(argv[i], "--diff") == 0 && i + 1 < argc) {
+            against = argv[++i];
+        } else if (!trace && argv[i][0] != '-') {
+            trace = argv[i];
+        } else {
+            trace = NULL;
+            break;
+        }
+    }
+    if (!trace || runs < 1) {
+        fprintf(stderr, "usage: %s TRACE [--runs N] [--save FILE] [--diff FILE]\n", argv[0]);
+        return 2;
+    }
+
+    log_init(LOG_WARN);   /* persona-change chatter would swamp the report */
+
+    trace_reader_t r;
+    if (trace_reader_open(&r, trace) != 0) {
+        fprintf(stderr, "%s: not a mycoflow trace\n", trace);
+        return 1;
+    }
+
+    int rc = 0, failed = 0;
+    text_t first = {0};
+    for (int run = 1; run <= runs; run++) {
+        text_t log = {0};
+        run_stats_t st;
+        if (replay(&r, run == 1 ? &first : &log, &st) != 0) {
+            fprintf(stderr, "%s: truncated or corrupt trace (or out of memory), "
+                    "run %d abandoned\n", trace, run);
+            free(log.s);
+            rc = failed = 1;
+            break;
+        }
+        print_stats(run, &st);
+        if (run > 1) {
+            char name[16];
+            snprintf(name, sizeof(name), "run %d", run);
+            unsigned d = diff_logs("run 1", &first, name, &log);
+            printf("  verdicts vs run 1: %s (%u differing lines)\n",
+                   d ? "DIFFER" : "identical", d);
+            if (d) rc = 1;
+        }
+        free(log.s);
+    }
+
+    if (save && !failed) {
+        FILE *f = fopen(save, "wb");
+        if (!f || (first.len && fwrite(first.s, first.len, 1, f) != 1)) {
+            fprintf(stderr, "%s: write failed\n", save);
+            rc = 1;
+        }
+        if (f) fclose(f);
+    }
+    if (against && !failed) {
+        text_t old = {0};
+        if (read_file(against, &old) != 0) {
+            fprintf(stderr, "%s: cannot read\n", against);
+            rc = 1;
+        } else {
+            unsigned d = diff_logs(against, &old, "this run", &first);
+            printf("verdicts vs %s: %s (%u differing lines)\n", against,
+                   d ? "DIFFER" : "identical", d);
+            if (d) rc = 1;
+        }
+        free(old.s);
+    }
+
+    free(first.s);
+    trace_reader_close(&r);
+    return rc;
+}
@@ -24,7 +24,7 @@ int tc_ingress(struct __sk_buff *skb) {
         __sync_fetch_and_add(&val->packets, 1);
         __sync_fetch_and_add(&val->bytes, skb->len);
     }
-    return TC_ACT_OK;
+    return TC_ACT_UNSPEC;   /* observe only: later filters still run */
 }
 
 char _license[] SEC("license") = "GPL";
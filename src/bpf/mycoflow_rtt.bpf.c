@@ -1,28 +1,73 @@
 /*
- * MycoFlow — Passive TCP RTT measurement
+ * MycoFlow — Passive TCP and QUIC RTT measurement
  * mycoflow_rtt.bpf.c — measures forwarding-path RTT without active probing
  *
  * Approach
  * --------
  * Two TC hooks on the WAN interface (egress = client→server, ingress
- * = server→client). For each TCP flow we:
+ * = server→client). For each TCP flow we keep a small ring of
+ * outstanding samples, pping-style:
  *
- *   1. On egress: stamp tx_ts_ns and tx_seq_end = seq + payload_len
- *      + (SYN|FIN ? 1 : 0)  — the ACK we expect to see for this pkt.
- *   2. On ingress ACK: if ack_seq >= tx_seq_end, RTT = now - tx_ts_ns.
- *      Clear tx_ts_ns so the next outgoing pkt sets a fresh sample.
- *   3. EWMA-smooth (RFC 6298: srtt = (7*srtt + rtt) / 8).
+ *   1. On egress: if the ring has room, append (seq_end, now) with
+ *      seq_end = seq + payload_len + (SYN|FIN ? 1 : 0) — the ACK we
+ *      expect to see for this pkt. A segment that does not advance past
+ *      the highest seq_end the flow has ever sent (kept across ring
+ *      drains) is a retransmission: it is not stamped and the ring is
+ *      cleared, since any ACK that follows is ambiguous (Karn).
+ *   2. On ingress ACK: the oldest slot the ACK covers gives
+ *      RTT = now - ts; every covered slot is retired.
+ *   3. EWMA-smooth (RFC 6298: srtt = (7*srtt + rtt) / 8) and count
+ *      the sample in the flow's cumulative RTT histogram, which
+ *      userspace diffs per tick into p50/p95/p99.
+ *   4. If userspace set a threshold for the flow (myco_rtt_thresh) and
+ *      srtt just crossed it, push a breach event on myco_rtt_events.
+ *
+ * QUIC flows (UDP to server port 443) have no cleartext seq/ack, but
+ * short-header packets carry the spin bit (RFC 9000 §17.4): the server
+ * echoes the last value it received, the client inverts the last value
+ * it received, so the bit flips once per round trip in each direction.
+ *
+ *   a. On egress: a short-header packet whose spin differs from the
+ *      last one seen is the client's edge; stamp it and arm the flow.
+ *   b. On ingress: the first short-header packet carrying that value is
+ *      the server's echo of the edge; RTT = now - stamp, disarm, then
+ *      steps 3-4 exactly as for TCP (same map, key protocol 17).
+ *
+ * While armed, further egress edges are ignored — the next genuine one
+ * can only follow the echo — so a reordered packet carrying the old
+ * value cannot restart the timer. An edge that is never echoed is given
+ * up after the 10 s plausibility bound.
  *
  * The map is keyed by 5-tuple canonicalized so the LAN side is "client"
  * and the WAN side is "server" regardless of direction. Userspace reads
- * srtt_ms per flow through bpf_map_lookup_elem.
+ * the whole map once per classifier tick (bpf_map_lookup_batch, falling
+ * back to a get_next_key walk on older kernels) into a snapshot that
+ * answers every per-flow srtt_ms lookup; successive snapshots are
+ * diffed for the histogram percentiles.
+ *
+ * The same hooks also keep per-flow packet features (myco_feat) for
+ * TCP and UDP: per direction, packet/byte counters plus log2 histograms
+ * of packet size and inter-arrival time. Counters are cumulative;
+ * userspace batch-reads the map once per classifier tick and diffs
+ * successive reads into windowed features.
+ *
+ * Both hooks only observe: every path returns TC_ACT_UNSPEC, so
+ * filters behind ours on the same clsact (e.g. an SQM ingress redirect)
+ * still see the packet.
  *
  * Limitations (accepted for v1)
- *   - TCP only. UDP has no seq/ack so no passive RTT is derivable.
- *   - One outstanding sample per flow: high-bandwidth flows overwrite
- *     their own tx_ts_ns before the ACK lands. srtt stays representative
- *     because the next round still gets a fresh sample; we just lose
- *     some sample density. Acceptable for QoS decisions at ~1Hz.
+ *   - Other UDP (WebRTC, games) has neither seq/ack nor a spin bit, so
+ *     no passive RTT is derivable; QUIC on ports other than 443 is not
+ *     recognised.
+ *   - QUIC endpoints may disable the spin bit. A constant value yields
+ *     no edges and so no samples; one randomised per packet yields
+ *     short bogus samples, which are not filtered out.
+ *   - The server's ACK delay is part of a QUIC sample, since it echoes
+ *     the edge only in its next packet.
+ *   - At most RTT_RING samples per round trip: once the ring is full,
+ *     egress segments pass unstamped until an ACK frees slots. Every
+ *     flow, bulk included, still gets several samples per RTT, at a
+ *     fixed per-packet cost (RTT_RING compares on ingress).
  *   - IPv4 only. IPv6 support is a straightforward addition but kept
  *     out of v1 to keep the verifier happy.
  */
@@ -31,26 +76,64 @@
 #include <linux/if_ether.h>
 #include <linux/ip.h>
 #include <linux/tcp.h>
+#include <linux/udp.h>
 #include <linux/in.h>
 #include <bpf/bpf_helpers.h>
 #include <bpf/bpf_endian.h>
 
 #define FLOW_RTT_MAX 4096
+#define RTT_RING     4      /* outstanding samples per flow, power of two */
+#define RTT_MAX_MS   10000  /* longer samples are implausible, ignored */
+#define QUIC_PORT    443
+
+/* myco_rtt_value.spin bits (QUIC flows only) */
+#define SPIN_VAL     0x01   /* spin bit of the last egress edge */
+#define SPIN_SEEN    0x02   /* SPIN_VAL is valid */
+#define SPIN_ARMED   0x04   /* edge stamped in spin_ts_ns, echo pending */
+
+/* RTT histogram layout, mirrored in myco_rtt.h (RTT_HIST_BUCKETS,
+ * rtt_hist_bucket()). Buckets 0..3 hold 0..3 ms exactly; above that
+ * each power of two [2^e, 2^(e+1)) is split into 4 linear sub-buckets
+ * (≤ 25 % wide), b = 4*(e-1) + ((v >> (e-2)) & 3). 47 holds ≥ 7168 ms. */
+#define RTT_HIST_BUCKETS 48
+#define FLOW_FEAT_MAX 4096
+
+/* Histogram layout, mirrored in myco_rtt.h (RTT_FEAT_*).
+ *   size bucket b : IP length in [2^(b+5), 2^(b+6)); 0 also holds < 64 B,
+ *                   7 holds everything from 4096 B (GSO super-packets)
+ *   iat  bucket b : gap in [2^(b+2), 2^(b+3)) µs; 0 also holds < 4 µs,
+ *                   15 holds everything from ~131 ms */
+#define FEAT_SIZE_BUCKETS 8
+#define FEAT_IAT_BUCKETS  16
+#define FEAT_DIR_UP       0   /* egress, LAN → WAN */
+#define FEAT_DIR_DOWN     1   /* ingress, WAN → LAN */
 
 struct myco_rtt_key {
     __u32 client_ip;    /* LAN side (NBO) */
     __u32 server_ip;    /* WAN side (NBO) */
     __u16 client_port;  /* NBO */
     __u16 server_port;  /* NBO */
-    __u8  protocol;     /* always 6 for this map */
+    __u8  protocol;     /* 6 (TCP) or 17 (QUIC) for this map */
     __u8  pad[3];
 };
 
+struct myco_rtt_slot {
+    __u64 ts_ns;        /* egress time of the stamped segment */
+    __u32 seq_end;      /* ack we expect for it */
+    __u32 pad;
+};
+
 struct myco_rtt_value {
-    __u64 tx_ts_ns;     /* 0 when current outgoing sample has been consumed */
-    __u32 tx_seq_end;   /* ack we expect for the outgoing pkt */
+    struct myco_rtt_slot ring[RTT_RING];   /* outstanding, oldest at head */
     __u32 srtt_ms;      /* EWMA-smoothed RTT (0 until first sample) */
     __u32 samples;      /* running count of successful RTT samples */
+    __u8  head;         /* ring index of the oldest outstanding slot */
+    __u8  count;        /* outstanding slots, 0..RTT_RING */
+    __u8  spin;         /* QUIC: SPIN_* state; the ring stays empty */
+    __u8  sent_any;     /* TCP: seq_max is valid */
+    __u32 seq_max;      /* TCP: highest seq_end sent so far */
+    __u64 spin_ts_ns;   /* QUIC: egress time of the armed spin edge */
+    __u32 rtt_hist[RTT_HIST_BUCKETS];      /* cumulative samples per bucket */
 };
 
 struct {
@@ -60,6 +143,130 @@ struct {
     __type(value, struct myco_rtt_value);
 } myco_rtt SEC(".maps");
 
+struct myco_feat_dir {
+    __u64 bytes;
+    __u64 last_ns;      /* arrival of the previous packet, 0 = none yet */
+    __u32 packets;
+    __u32 size_hist[FEAT_SIZE_BUCKETS];
+    __u32 iat_hist[FEAT_IAT_BUCKETS];
+    __u32 pad;
+};
+
+struct myco_feat_value {
+    struct myco_feat_dir dir[2];
+};
+
+/* Same key as myco_rtt (protocol 6 or 17). */
+struct {
+    __uint(type, BPF_MAP_TYPE_LRU_HASH);
+    __uint(max_entries, FLOW_FEAT_MAX);
+    __type(key, struct myco_rtt_key);
+    __type(value, struct myco_feat_value);
+} myco_feat SEC(".maps");
+
+/* Breach events (optional). Userspace writes a threshold for each flow
+ * it wants watched; ingress emits one event on the ring buffer when the
+ * flow's srtt rises above it and re-arms once srtt is back at or below.
+ * Flows without a threshold cost one failed lookup per RTT sample. */
+struct myco_rtt_thresh {
+    __u32 thresh_ms;
+    __u32 over;         /* 1 = event sent, srtt still above threshold */
+};
+
+struct {
+    __uint(type, BPF_MAP_TYPE_LRU_HASH);
+    __uint(max_entries, FLOW_RTT_MAX);
+    __type(key, struct myco_rtt_key);
+    __type(value, struct myco_rtt_thresh);
+} myco_rtt_thresh SEC(".maps");
+
+struct myco_rtt_event {
+    struct myco_rtt_key key;
+    __u32 srtt_ms;
+    __u32 rtt_ms;       /* the sample that pushed srtt over */
+    __u32 thresh_ms;
+    __u32 pad;
+};
+
+struct {
+    __uint(type, BPF_MAP_TYPE_RINGBUF);
+    __uint(max_entries, 64 * 1024);
+} myco_rtt_events SEC(".maps");
+
+/* floor(log2(v)), 0 for v == 0. Branchy but loop-free for the verifier. */
+static __always_inline __u32 log2_u32(__u32 v) {
+    __u32 r = 0;
+    if (v >= 1u << 16) { v >>= 16; r += 16; }
+    if (v >= 1u << 8)  { v >>= 8;  r += 8; }
+    if (v >= 1u << 4)  { v >>= 4;  r += 4; }
+    if (v >= 1u << 2)  { v >>= 2;  r += 2; }
+    if (v >= 1u << 1)  { r += 1; }
+    return r;
+}
+
+/* Account one TCP/UDP packet to its flow's `dir` half. Runs before the
+ * RTT logic in both hooks; never drops or alters the packet. */
+static __always_inline void feat_account(struct __sk_buff *skb, int dir) {
+    void *data     = (void *)(long)skb->data;
+    void *data_end = (void *)(long)skb->data_end;
+
+    struct ethhdr *eth = data;
+    if ((void *)(eth + 1) > data_end) return;
+    if (eth->h_proto != bpf_htons(ETH_P_IP)) return;
+
+    struct iphdr *iph = (struct iphdr *)(eth + 1);
+    if ((void *)(iph + 1) > data_end) return;
+    if (iph->protocol != IPPROTO_TCP && iph->protocol != IPPROTO_UDP) return;
+    if (iph->ihl < 5) return;
+
+    /* TCP and UDP both open with source/dest ports. */
+    struct udphdr *l4 = (struct udphdr *)((void *)iph + (__u32)iph->ihl * 4);
+    if ((void *)(l4 + 1) > data_end) return;
+
+    struct myco_rtt_key key = {};
+    key.protocol = iph->protocol;
+    if (dir == FEAT_DIR_UP) {
+        key.client_ip   = iph->saddr;
+        key.server_ip   = iph->daddr;
+        key.client_port = l4->source;
+        key.server_port = l4->dest;
+    } else {
+        key.client_ip   = iph->daddr;
+        key.server_ip   = iph->saddr;
+        key.client_port = l4->dest;
+        key.server_port = l4->source;
+    }
+
+    struct myco_feat_value *v = bpf_map_lookup_elem(&myco_feat, &key);
+    if (!v) {
+        struct myco_feat_value zero = {};
+        bpf_map_update_elem(&myco_feat, &key, &zero, BPF_NOEXIST);
+        v = bpf_map_lookup_elem(&myco_feat, &key);
+        if (!v) return;
+    }
+    struct myco_feat_dir *d = &v->dir[dir & 1];
+
+    __u32 len = bpf_ntohs(iph->tot_len);
+    __u32 sb  = log2_u32(len);
+    sb = sb < 6 ? 0 : sb - 5;
+    if (sb > FEAT_SIZE_BUCKETS - 1) sb = FEAT_SIZE_BUCKETS - 1;
+
+    __sync_fetch_and_add(&d->packets, 1);
+    __sync_fetch_and_add(&d->bytes, len);
+    __sync_fetch_and_add(&d->size_hist[sb], 1);
+
+    __u64 now  = bpf_ktime_get_ns();
+    __u64 prev = d->last_ns;
+    d->last_ns = now;
+    if (prev == 0 || now <= prev) return;
+
+    __u64 gap_us = (now - prev) / 1000;
+    __u32 ib = log2_u32(gap_us > 0xFFFFFFFFull ? 0xFFFFFFFFu : (__u32)gap_us);
+    ib = ib < 2 ? 0 : ib - 2;
+    if (ib > FEAT_IAT_BUCKETS - 1) ib = FEAT_IAT_BUCKETS - 1;
+    __sync_fetch_and_add(&d->iat_hist[ib], 1);
+}
+
 /* Parse Ethernet + IPv4 + TCP. Fills iph_cp/tcph_cp with bounded copies.
  * Returns 0 on success, -1 if not an IPv4 TCP packet or header truncated. */
 static __always_inline int parse_ipv4_tcp(struct __sk_buff *skb,
@@ -86,22 +293,151 @@ static __always_inline int parse_ipv4_tcp(struct __sk_buff *skb,
     return 0;
 }
 
-/* Egress: client → server. Record tx_ts_ns + tx_seq_end. */
+static __always_inline __u32 rtt_hist_bucket(__u32 rtt_ms) {
+    if (rtt_ms < 4) return rtt_ms;
+    __u32 e = log2_u32(rtt_ms);
+    __u32 b = 4 * (e - 1) + ((rtt_ms >> (e - 2)) & 3);
+    return b < RTT_HIST_BUCKETS ? b : RTT_HIST_BUCKETS - 1;
+}
+
+/* Wrap-safe TCP sequence compare: a is at or after b. */
+static __always_inline int seq_geq(__u32 a, __u32 b) {
+    return (__s32)(a - b) >= 0;
+}
+
+/* Steps 3-4 for one RTT sample, shared by TCP and QUIC. */
+static __always_inline void rtt_account(struct myco_rtt_value *v,
+                                        struct myco_rtt_key *key,
+                                        __u64 rtt_ns) {
+    __u32 rtt_ms = (__u32)(rtt_ns / 1000000);
+    if (rtt_ms == 0)  rtt_ms = 1;       /* clamp sub-ms to 1 */
+    if (rtt_ms > RTT_MAX_MS) return;    /* implausible — ignore */
+
+    /* RFC 6298 EWMA: srtt = 7/8*srtt + 1/8*rtt */
+    __u32 new_srtt;
+    if (v->srtt_ms == 0) {
+        new_srtt = rtt_ms;
+    } else {
+        new_srtt = (v->srtt_ms * 7 + rtt_ms) / 8;
+    }
+    v->srtt_ms  = new_srtt;
+    v->samples += 1;
+    __u32 hb = rtt_hist_bucket(rtt_ms);
+    if (hb < RTT_HIST_BUCKETS) v->rtt_hist[hb] += 1;   /* bound for the verifier */
+
+    struct myco_rtt_thresh *th = bpf_map_lookup_elem(&myco_rtt_thresh, key);
+    if (!th) return;
+    if (new_srtt <= th->thresh_ms) {
+        th->over = 0;
+    } else if (!th->over) {
+        th->over = 1;
+        struct myco_rtt_event *ev = bpf_ringbuf_reserve(&myco_rtt_events, sizeof(*ev), 0);
+        if (ev) {
+            ev->key       = *key;
+            ev->srtt_ms   = new_srtt;
+            ev->rtt_ms    = rtt_ms;
+            ev->thresh_ms = th->thresh_ms;
+            ev->pad       = 0;
+            bpf_ringbuf_submit(ev, 0);
+        }
+    }
+}
+
+/* Parse Ethernet + IPv4 + UDP with server port 443 and a QUIC short
+ * header (form bit clear, fixed bit set). Fills the client-perspective
+ * key for `dir`. Returns the spin bit, or -1 for any other packet. */
+static __always_inline int parse_ipv4_quic(struct __sk_buff *skb, int dir,
+                                           struct myco_rtt_key *key) {
+    void *data     = (void *)(long)skb->data;
+    void *data_end = (void *)(long)skb->data_end;
+
+    struct ethhdr *eth = data;
+    if ((void *)(eth + 1) > data_end) return -1;
+    if (eth->h_proto != bpf_htons(ETH_P_IP)) return -1;
+
+    struct iphdr *iph = (struct iphdr *)(eth + 1);
+    if ((void *)(iph + 1) > data_end) return -1;
+    if (iph->protocol != IPPROTO_UDP) return -1;
+    if (iph->ihl < 5) return -1;
+
+    struct udphdr *udph = (struct udphdr *)((void *)iph + (__u32)iph->ihl * 4);
+    if ((void *)(udph + 1) > data_end) return -1;
+    __u16 server_port = dir == FEAT_DIR_UP ? udph->dest : udph->source;
+    if (server_port != bpf_htons(QUIC_PORT)) return -1;
+
+    __u8 *first = (__u8 *)(udph + 1);
+    if ((void *)(first + 1) > data_end) return -1;
+    if ((*first & 0xC0) != 0x40) return -1;     /* long header or not QUIC */
+
+    key->protocol = IPPROTO_UDP;
+    if (dir == FEAT_DIR_UP) {
+        key->client_ip   = iph->saddr;
+        key->server_ip   = iph->daddr;
+        key->client_port = udph->source;
+        key->server_port = udph->dest;
+    } else {
+        key->client_ip   = iph->daddr;
+        key->server_ip   = iph->saddr;
+        key->client_port = udph->dest;
+        key->server_port = udph->source;
+    }
+    return (*first >> 5) & 1;
+}
+
+/* Steps a-b. Returns 0 if the packet was QUIC short-header (handled),
+ * -1 to let the TCP path look at it. */
+static __always_inline int quic_spin(struct __sk_buff *skb, int dir) {
+    struct myco_rtt_key key = {};
+    int spin = parse_ipv4_quic(skb, dir, &key);
+    if (spin < 0) return -1;
+
+    __u64 now = bpf_ktime_get_ns();
+    struct myco_rtt_value *v = bpf_map_lookup_elem(&myco_rtt, &key);
+    if (dir == FEAT_DIR_UP) {
+        if (!v) {
+            struct myco_rtt_value zero = {};
+            zero.spin = SPIN_SEEN | spin;       /* first packet: no edge yet */
+            bpf_map_update_elem(&myco_rtt, &key, &zero, BPF_NOEXIST);
+            return 0;
+        }
+        if (!(v->spin & SPIN_SEEN)) {
+            v->spin = SPIN_SEEN | spin;
+            return 0;
+        }
+        if ((v->spin & SPIN_VAL) == (__u8)spin) return 0;
+        if ((v->spin & SPIN_ARMED) &&
+            now - v->spin_ts_ns < (__u64)RTT_MAX_MS * 1000000) return 0;
+        v->spin       = SPIN_SEEN | SPIN_ARMED | spin;
+        v->spin_ts_ns = now;
+        return 0;
+    }
+
+    if (!v || !(v->spin & SPIN_ARMED)) return 0;
+    if ((v->spin & SPIN_VAL) != (__u8)spin) return 0;   /* echo not back yet */
+    v->spin &= ~SPIN_ARMED;
+    if (now > v->spin_ts_ns) rtt_account(v, &key, now - v->spin_ts_ns);
+    return 0;
+}
+
+/* Egress: client → server. Stamp (seq_end, now) into a free ring slot. */
 SEC("tc")
 int myco_rtt_egress(struct __sk_buff *skb) {
+    feat_account(skb, FEAT_DIR_UP);
+    if (quic_spin(skb, FEAT_DIR_UP) == 0) return TC_ACT_UNSPEC;
+
     struct iphdr iph;
     struct tcphdr tcph;
-    if (parse_ipv4_tcp(skb, &iph, &tcph) < 0) return TC_ACT_OK;
+    if (parse_ipv4_tcp(skb, &iph, &tcph) < 0) return TC_ACT_UNSPEC;
 
     __u32 ihl       = (__u32)iph.ihl * 4;
     __u32 ip_total  = bpf_ntohs(iph.tot_len);
     __u32 tcp_hlen  = (__u32)tcph.doff * 4;
-    if (tcp_hlen < 20 || ip_total < ihl + tcp_hlen) return TC_ACT_OK;
+    if (tcp_hlen < 20 || ip_total < ihl + tcp_hlen) return TC_ACT_UNSPEC;
     __u32 payload   = ip_total - ihl - tcp_hlen;
 
     /* Pure ACKs with no payload and no SYN/FIN don't generate an ACK
      * for us to RTT-match against. Skip them. */
-    if (payload == 0 && !tcph.syn && !tcph.fin) return TC_ACT_OK;
+    if (payload == 0 && !tcph.syn && !tcph.fin) return TC_ACT_UNSPEC;
 
     struct myco_rtt_key key = {};
     key.client_ip   = iph.saddr;
@@ -114,27 +450,46 @@ int myco_rtt_egress(struct __sk_buff *skb) {
     if (tcph.syn) seq_end += 1;
     if (tcph.fin) seq_end += 1;
 
-    struct myco_rtt_value new_v = {};
-    new_v.tx_ts_ns   = bpf_ktime_get_ns();
-    new_v.tx_seq_end = seq_end;
+    struct myco_rtt_value *v = bpf_map_lookup_elem(&myco_rtt, &key);
+    if (!v) {
+        struct myco_rtt_value zero = {};
+        bpf_map_update_elem(&myco_rtt, &key, &zero, BPF_NOEXIST);
+        v = bpf_map_lookup_elem(&myco_rtt, &key);
+        if (!v) return TC_ACT_UNSPEC;
+    }
 
-    struct myco_rtt_value *existing = bpf_map_lookup_elem(&myco_rtt, &key);
-    if (existing) {
-        /* Preserve smoothed history; overwrite outgoing pointer. */
-        new_v.srtt_ms = existing->srtt_ms;
-        new_v.samples = existing->samples;
+    /* Compared against everything ever sent, not just the ring: a
+     * resend after ACKs drained it (RTO, later segments of a recovery
+     * burst) must not be stamped either. */
+    if (v->sent_any && !seq_geq(seq_end, v->seq_max + 1)) {
+        v->count = 0;              /* retransmission: drop ambiguous slots */
+        return TC_ACT_UNSPEC;
     }
-    bpf_map_update_elem(&myco_rtt, &key, &new_v, BPF_ANY);
-    return TC_ACT_OK;
+    v->seq_max  = seq_end;
+    v->sent_any = 1;
+
+    __u32 count = v->count;
+    if (count > RTT_RING) count = RTT_RING;
+    if (count == RTT_RING) return TC_ACT_UNSPEC;   /* full: wait for an ACK */
+
+    __u32 tail = (v->head + count) & (RTT_RING - 1);
+    v->ring[tail].ts_ns   = bpf_ktime_get_ns();
+    v->ring[tail].seq_end = seq_end;
+    v->count = count + 1;
+    return TC_ACT_UNSPEC;
 }
 
-/* Ingress: server → client. If this ACK acks our last tx_seq_end, compute RTT. */
+/* Ingress: server → client. Time the oldest slot this ACK covers and
+ * retire every covered slot. */
 SEC("tc")
 int myco_rtt_ingress(struct __sk_buff *skb) {
+    feat_account(skb, FEAT_DIR_DOWN);
+    if (quic_spin(skb, FEAT_DIR_DOWN) == 0) return TC_ACT_UNSPEC;
+
     struct iphdr iph;
     struct tcphdr tcph;
-    if (parse_ipv4_tcp(skb, &iph, &tcph) < 0) return TC_ACT_OK;
-    if (!tcph.ack) return TC_ACT_OK;
+    if (parse_ipv4_tcp(skb, &iph, &tcph) < 0) return TC_ACT_UNSPEC;
+    if (!tcph.ack) return TC_ACT_UNSPEC;
 
     /* Key from the client's perspective: swap src/dst since this is RX. */
     struct myco_rtt_key key = {};
@@ -145,30 +500,30 @@ int myco_rtt_ingress(struct __sk_buff *skb) {
     key.protocol    = IPPROTO_TCP;
 
     struct myco_rtt_value *v = bpf_map_lookup_elem(&myco_rtt, &key);
-    if (!v) return TC_ACT_OK;
-    if (v->tx_ts_ns == 0) return TC_ACT_OK;   /* already consumed */
+    if (!v) return TC_ACT_UNSPEC;
+    __u32 count = v->count;
+    if (count == 0) return TC_ACT_UNSPEC;         /* nothing outstanding */
+    if (count > RTT_RING) count = RTT_RING;
 
-    __u32 ack = bpf_ntohl(tcph.ack_seq);
-    if (ack < v->tx_seq_end) return TC_ACT_OK;
+    __u32 ack  = bpf_ntohl(tcph.ack_seq);
+    __u32 head = v->head;
+    __u64 ts   = v->ring[head & (RTT_RING - 1)].ts_ns;
+    if (!seq_geq(ack, v->ring[head & (RTT_RING - 1)].seq_end)) return TC_ACT_UNSPEC;
 
-    __u64 now = bpf_ktime_get_ns();
-    if (now <= v->tx_ts_ns) return TC_ACT_OK;
-    __u64 rtt_ns = now - v->tx_ts_ns;
-    __u32 rtt_ms = (__u32)(rtt_ns / 1000000);
-    if (rtt_ms == 0)  rtt_ms = 1;       /* clamp sub-ms to 1 */
-    if (rtt_ms > 10000) return TC_ACT_OK; /* implausible — ignore */
-
-    /* RFC 6298 EWMA: srtt = 7/8*srtt + 1/8*rtt */
-    __u32 new_srtt;
-    if (v->srtt_ms == 0) {
-        new_srtt = rtt_ms;
-    } else {
-        new_srtt = (v->srtt_ms * 7 + rtt_ms) / 8;
+    /* Slots are in sequence order, so the covered ones form a prefix. */
+    __u32 covered = 1;
+#pragma unroll
+    for (__u32 i = 1; i < RTT_RING; i++) {
+        if (i < count && seq_geq(ack, v->ring[(head + i) & (RTT_RING - 1)].seq_end)) {
+            covered = i + 1;
+        }
     }
-    v->srtt_ms  = new_srtt;
-    v->tx_ts_ns = 0;     /* consumed — wait for next egress pkt */
-    v->samples += 1;
-    return TC_ACT_OK;
+    v->head  = (head + covered) & (RTT_RING - 1);
+    v->count = count - covered;
+
+    __u64 now = bpf_ktime_get_ns();
+    if (now > ts) rtt_account(v, &key, now - ts);
+    return TC_ACT_UNSPEC;
 }
 
 char _license[] SEC("license") = "GPL";
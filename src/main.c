@@ -5,7 +5,8 @@
  * All modules are included via headers; this file owns:
  *   - Global shared state definitions (extern'd in myco_types.h)
  *   - Signal handling
- *   - Main reflexive loop: Sense → Infer → Act → Stabilize
+ *   - Main reflexive loop: Sense → Infer → Act → Stabilize, with
+ *     sensing, flow classification and actuation on pipeline threads
  */
 #include "myco_types.h"
 #include "myco_log.h"
@@ -23,7 +24,12 @@
 #include "myco_classifier.h"
 #include "myco_mark.h"
 #include "myco_rtt.h"
+#include "myco_spsc.h"
+#include "myco_trace.h"
 
+#include <errno.h>
+#include <pthread.h>
+#include <semaphore.h>
 #include <signal.h>
 #include <stdio.h>
 #include <string.h>
@@ -66,8 +72,415 @@ static void sleep_interval(double seconds) {
     nanosleep(&ts, NULL);
 }
 
+/* ── Pipeline stages ────────────────────────────────────────────
+ *
+ *   sense thread ─ q_sense ─► main: infer/decide ─ q_act ─► act thread
+ *   flow thread ── q_flow ──►                ◄─ q_result ─┘    ▲
+ *        └─────────────────── q_dscp ───────────────────────────┘
+ *
+ * Each stage owns its state and passes value snapshots over SPSC
+ * queues, so a blocking ICMP probe only delays the sense thread and a
+ * slow tc/iptables fork only delays the act thread; conntrack ingestion
+ * and classification keep their own cadence. The flow thread also owns
+ * the flow/device/classifier tables and therefore writes the JSON dump.
+ * A config reload stops the stage threads, reconfigures, and restarts
+ * them, so stages read cfg without locking.
+ */
+
+#define Q_SENSE_DEPTH  4
+#define Q_FLOW_DEPTH   4
+#define Q_ACT_DEPTH    8
+#define Q_DSCP_DEPTH   2
+
+typedef struct {
+    metrics_t metrics;        /* raw sample incl. eBPF counters */
+    double    ts;
+} sense_snapshot_t;
+
+typedef struct {
+    int       active_flows;
+    int       elephant_flow;
+    persona_t dominant;       /* most latency-sensitive device persona */
+    double    ts;
+} flow_snapshot_t;
+
+typedef enum {
+    ACT_PERSONA_TIN,          /* CAKE tin targets for a new persona */
+    ACT_POLICY,               /* bandwidth policy; answered on q_result */
+} act_kind_t;
+
+typedef struct {
+    act_kind_t kind;
+    persona_t  persona;
+    policy_t   policy;        /* ACT_POLICY: desired; TIN: bandwidth_kbit */
+    int        ingress_bw_kbit;  /* > 0: mirror onto the ingress IFB too */
+} act_cmd_t;
+
+typedef struct {
+    int      ok;
+    policy_t policy;
+    double   ts;
+} act_result_t;
+
+typedef struct {
+    /* Set before pipeline_start(), read-only while the stages run. */
+    const myco_config_t  *cfg;
+    double                interval_s;
+    flow_table_t         *flow_table;
+    flow_ct_source_t     *ct_src;
+    device_table_t       *device_table;
+    dns_cache_t          *dns_cache;
+    flow_service_table_t *classifier;
+    mark_engine_t        *mark_eng;
+    rtt_engine_t         *rtt_eng;
+    int                   rtt_events;   /* rtt_eng's breach ring is open */
+
+    spsc_queue_t    q_sense;      /* sense → main */
+    spsc_queue_t    q_flow;       /* flow → main */
+    spsc_queue_t    q_act;        /* main → act */
+    spsc_queue_t    q_result;     /* act → main */
+    spsc_queue_t    q_dscp;       /* flow → act (device_table_t copies) */
+    sem_t           sense_ready;  /* one post per q_sense push */
+    sem_t           act_wake;     /* one post per q_act / q_dscp push */
+    pthread_mutex_t stop_lock;
+    pthread_cond_t  stop_cv;      /* CLOCK_MONOTONIC, wakes paced stages */
+    int             quit;         /* under stop_lock */
+    int             running;
+    pthread_t       sense_tid;
+    pthread_t       flow_tid;
+    pthread_t       act_tid;
+} pipeline_t;
+
+/* Sleep until `deadline` (CLOCK_MONOTONIC) or until the pipeline stops.
+ * Returns 1 to run another tick, 0 to exit. */
+static int stage_wait_until(pipeline_t *p, const struct timespec *deadline) {
+    pthread_mutex_lock(&p->stop_lock);
+    while (!p->quit && !g_stop) {
+        if (pthread_cond_timedwait(&p->stop_cv, &p->stop_lock, deadline) == ETIMEDOUT) {
+            break;
+        }
+    }
+    int run = !p->quit && !g_stop;
+    pthread_mutex_unlock(&p->stop_lock);
+    return run;
+}
+
+/* Advance a stage's absolute schedule by one interval. Ticks stay on a
+ * fixed grid; after an overrun the grid restarts from now rather than
+ * firing a burst of catch-up ticks. */
+static void stage_next_deadline(struct timespec *next, double interval_s) {
+    long long ns = next->tv_nsec + (long long)(interval_s * 1e9);
+    next->tv_sec  += (time_t)(ns / 1000000000LL);
+    next->tv_nsec  = (long)(ns % 1000000000LL);
+
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    if (next->tv_sec < now.tv_sec ||
+        (next->tv_sec == now.tv_sec && next->tv_nsec < now.tv_nsec)) {
+        *next = now;
+    }
+}
+
+static void *sense_stage(void *arg) {
+    pipeline_t *p = arg;
+    const myco_config_t *cfg = p->cfg;
+    struct timespec next;
+    clock_gettime(CLOCK_MONOTONIC, &next);
+
+    while (stage_wait_until(p, &next)) {
+        sense_snapshot_t s;
+        if (sense_sample(cfg->egress_iface, cfg->probe_host, p->interval_s, cfg->dummy_metrics, &s.metrics) != 0) {
+            log_msg(LOG_WARN, "main", "sense sample failed");
+        }
+
+        /* Populate eBPF counters into metrics (no-op if libbpf unavailable) */
+        if (ebpf_read_stats(&s.metrics.ebpf_rx_pkts, &s.metrics.ebpf_rx_bytes) != 0) {
+            s.metrics.ebpf_rx_pkts  = 0;
+            s.metrics.ebpf_rx_bytes = 0;
+        }
+
+        ebpf_tick(cfg);
+
+        s.ts = now_monotonic_s();
+        if (spsc_push(&p->q_sense, &s) == 0) {
+            sem_post(&p->sense_ready);
+        }
+        stage_next_deadline(&next, p->interval_s);
+    }
+    return NULL;
+}
+
+/* Breach events land here, on the flow thread, between ticks. */
+static void on_rtt_event(const rtt_event_t *ev, void *arg) {
+    pipeline_t *p = arg;
+    classifier_rtt_event(p->classifier, p->flow_table, p->mark_eng, ev,
+                         now_monotonic_s());
+}
+
+/* stage_wait_until() for the flow stage while the breach ring is open:
+ * sleep in the ring buffer's epoll instead, handling events as they
+ * land. Slices are capped at 100 ms so a stop is noticed promptly. */
+static int flow_wait_events(pipeline_t *p, const struct timespec *deadline) {
+    for (;;) {
+        pthread_mutex_lock(&p->stop_lock);
+        int run = !p->quit && !g_stop;
+        pthread_mutex_unlock(&p->stop_lock);
+        if (!run) return 0;
+
+        struct timespec now;
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        long long left_ms = (long long)(deadline->tv_sec - now.tv_sec) * 1000 +
+                            (deadline->tv_nsec - now.tv_nsec) / 1000000;
+        if (left_ms <= 0) return 1;
+        int slice = left_ms > 100 ? 100 : (int)left_ms;
+        if (rtt_engine_poll_events(p->rtt_eng, slice, on_rtt_event, p) < 0) {
+            return stage_wait_until(p, deadline);
+        }
+    }
+}
+
+static void *flow_stage(void *arg) {
+    pipeline_t *p = arg;
+    const myco_config_t *cfg = p->cfg;
+    int dscp_pending = 0;
+    struct timespec next;
+    clock_gettime(CLOCK_MONOTONIC, &next);
+
+    while (p->rtt_events ? flow_wait_events(p, &next) : stage_wait_until(p, &next)) {
+        /* Flow table: conntrack events (or a dump), evict stale (>60s) */
+        double ft_now = now_monotonic_s();
+        flow_ct_poll(p->ct_src, p->flow_table, ft_now);
+        if (trace_active()) {
+            trace_record_tick(p->flow_table, ft_now, p->interval_s);
+        }
+        flow_table_evict_stale(p->flow_table, ft_now, 60.0);
+        flow_probe_stats_t probe_stats;
+        flow_table_probe_stats(p->flow_table, &probe_stats);
+        myco_set_flow_probe_stats(&probe_stats);
+
+        /* Flow-derived persona signals for the control loop */
+        flow_snapshot_t s;
+        s.active_flows  = flow_table_active_count(p->flow_table);
+        s.elephant_flow = flow_table_has_elephant(p->flow_table, 0.60);
+        s.dominant      = PERSONA_UNKNOWN;
+        s.ts            = ft_now;
+
+        /* Per-device persona: aggregate flows by src_ip, infer per-device,
+         * hand the act thread a copy to rebuild the DSCP mangle rules when
+         * any device persona changes (retried while its queue is full). */
+        if (cfg->per_device_enabled) {
+            device_table_aggregate(p->device_table, p->flow_table, ft_now, p->dns_cache);
+            device_table_evict_stale(p->device_table, ft_now, 120.0);
+            if (device_table_update_personas(p->device_table, cfg) > 0) {
+                dscp_pending = 1;
+            }
+            if (dscp_pending && spsc_push(&p->q_dscp, p->device_table) == 0) {
+                sem_post(&p->act_wake);
+                dscp_pending = 0;
+            }
+            s.dominant = device_table_dominant_persona(p->device_table);
+        }
+
+        /* Per-flow service classifier + RTT auto-correction. Runs after
+         * device-level aggregation so the main persona pass already has
+         * fresh flow data. */
+        if (cfg->flow_aware_enabled && p->classifier) {
+            classifier_tick(p->classifier, p->flow_table, p->dns_cache,
+                            p->mark_eng, p->rtt_eng, ft_now, p->interval_s);
+        }
+
+        spsc_push(&p->q_flow, &s);
+
+        /* Dump state to JSON for Lua bridge (reads the tables above) */
+        myco_dump_json();
+
+        stage_next_deadline(&next, p->interval_s);
+    }
+    return NULL;
+}
+
+static void act_run(pipeline_t *p, const act_cmd_t *c) {
+    const myco_config_t *cfg = p->cfg;
+    if (c->kind == ACT_PERSONA_TIN) {
+        act_apply_persona_tin(cfg->egress_iface, c->persona,
+                              c->policy.bandwidth_kbit,
+                              cfg->no_tc, cfg->force_act_fail);
+        if (c->ingress_bw_kbit > 0) {
+            act_apply_ingress_policy(cfg->ingress_iface, c->persona, c->ingress_bw_kbit,
+                                     cfg->no_tc, cfg->force_act_fail);
+        }
+        return;
+    }
+
+    act_result_t r;
+    r.ok = act_apply_policy(cfg->egress_iface, &c->policy, cfg->no_tc, cfg->force_act_fail);
+    r.policy = c->policy;
+    r.ts = now_monotonic_s();
+    /* Sync ingress CAKE bandwidth cap with the adapted egress value */
+    if (r.ok && c->ingress_bw_kbit > 0) {
+        act_apply_ingress_policy(cfg->ingress_iface, c->persona, c->ingress_bw_kbit,
+                                 cfg->no_tc, cfg->force_act_fail);
+    }
+    /* q_result is as deep as q_act, so this cannot overflow. */
+    spsc_push(&p->q_result, &r);
+}
+
+static void *act_stage(void *arg) {
+    pipeline_t *p = arg;
+    device_table_t dt;
+    for (;;) {
+        while (sem_wait(&p->act_wake) != 0 && errno == EINTR) {
+        }
+        /* Commands queued before a stop still run, so main sees every
+         * ACT_POLICY answered. */
+        if (spsc_pop_latest(&p->q_dscp, &dt) > 0) {
+            device_apply_all_dscp(&dt, p->cfg->no_tc);
+        }
+        act_cmd_t c;
+        while (spsc_pop(&p->q_act, &c) == 0) {
+            act_run(p, &c);
+        }
+        pthread_mutex_lock(&p->stop_lock);
+        int quit = p->quit;
+        pthread_mutex_unlock(&p->stop_lock);
+        if (quit) break;
+    }
+    return NULL;
+}
+
+static int pipeline_init(pipeline_t *p) {
+    memset(p, 0, sizeof(*p));
+    if (spsc_init(&p->q_sense, Q_SENSE_DEPTH, sizeof(sense_snapshot_t)) != 0 ||
+        spsc_init(&p->q_flow, Q_FLOW_DEPTH, sizeof(flow_snapshot_t)) != 0 ||
+        spsc_init(&p->q_act, Q_ACT_DEPTH, sizeof(act_cmd_t)) != 0 ||
+        spsc_init(&p->q_result, Q_ACT_DEPTH, sizeof(act_result_t)) != 0 ||
+        spsc_init(&p->q_dscp, Q_DSCP_DEPTH, sizeof(device_table_t)) != 0) {
+        return -1;
+    }
+    sem_init(&p->sense_ready, 0, 0);
+    sem_init(&p->act_wake, 0, 0);
+    pthread_mutex_init(&p->stop_lock, NULL);
+    pthread_condattr_t attr;
+    pthread_condattr_init(&attr);
+    pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+    pthread_cond_init(&p->stop_cv, &attr);
+    pthread_condattr_destroy(&attr);
+    return 0;
+}
+
+static void pipeline_destroy(pipeline_t *p) {
+    spsc_destroy(&p->q_sense);
+    spsc_destroy(&p->q_flow);
+    spsc_destroy(&p->q_act);
+    spsc_destroy(&p->q_result);
+    spsc_destroy(&p->q_dscp);
+    sem_destroy(&p->sense_ready);
+    sem_destroy(&p->act_wake);
+    pthread_cond_destroy(&p->stop_cv);
+    pthread_mutex_destroy(&p->stop_lock);
+}
+
+/* Start the three stage threads. Signals stay with the main thread so
+ * SIGHUP/SIGTERM interrupt its wait. Returns 0, -1 if a thread failed
+ * (the others are stopped again). */
+static int pipeline_start(pipeline_t *p) {
+    if (p->running) return 0;
+
+    /* Samples left from before a stop describe the old config. */
+    sense_snapshot_t stale;
+    while (spsc_pop(&p->q_sense, &stale) == 0) {
+    }
+    while (sem_trywait(&p->sense_ready) == 0) {
+    }
+    p->quit = 0;
+
+    sigset_t block, old;
+    sigemptyset(&block);
+    sigaddset(&block, SIGINT);
+    sigaddset(&block, SIGTERM);
+    sigaddset(&block, SIGHUP);
+    pthread_sigmask(SIG_BLOCK, &block, &old);
+    int started = 0;
+    if (pthread_create(&p->act_tid, NULL, act_stage, p) == 0) {
+        started++;
+        if (pthread_create(&p->flow_tid, NULL, flow_stage, p) == 0) {
+            started++;
+            if (pthread_create(&p->sense_tid, NULL, sense_stage, p) == 0) {
+                started++;
+            }
+        }
+    }
+    pthread_sigmask(SIG_SETMASK, &old, NULL);
+
+    if (started < 3) {
+        log_msg(LOG_ERROR, "main", "pipeline thread start failed");
+        pthread_mutex_lock(&p->stop_lock);
+        p->quit = 1;
+        pthread_cond_broadcast(&p->stop_cv);
+        pthread_mutex_unlock(&p->stop_lock);
+        sem_post(&p->act_wake);
+        if (started > 1) pthread_join(p->flow_tid, NULL);
+        if (started > 0) pthread_join(p->act_tid, NULL);
+        return -1;
+    }
+    p->running = 1;
+    return 0;
+}
+
+/* Stop and join the stage threads; queued actions finish first. */
+static void pipeline_stop(pipeline_t *p) {
+    if (!p->running) return;
+    pthread_mutex_lock(&p->stop_lock);
+    p->quit = 1;
+    pthread_cond_broadcast(&p->stop_cv);
+    pthread_mutex_unlock(&p->stop_lock);
+    pthread_join(p->sense_tid, NULL);
+    pthread_join(p->flow_tid, NULL);
+    sem_post(&p->act_wake);
+    pthread_join(p->act_tid, NULL);
+    p->running = 0;
+    log_msg(LOG_DEBUG, "main", "pipeline stopped (drops: sense=%u flow=%u act=%u dscp=%u)",
+            spsc_drops(&p->q_sense), spsc_drops(&p->q_flow),
+            spsc_drops(&p->q_act), spsc_drops(&p->q_dscp));
+}
+
+/* Main thread: wait up to `timeout_s` for the next sense sample.
+ * Returns 0 with `out` filled, -1 on timeout or signal. */
+static int pipeline_wait_sense(pipeline_t *p, double timeout_s, sense_snapshot_t *out) {
+    if (spsc_pop(&p->q_sense, out) == 0) return 0;
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    long long ns = ts.tv_nsec + (long long)(timeout_s * 1e9);
+    ts.tv_sec  += (time_t)(ns / 1000000000LL);
+    ts.tv_nsec  = (long)(ns % 1000000000LL);
+    while (sem_timedwait(&p->sense_ready, &ts) == 0) {
+        if (spsc_pop(&p->q_sense, out) == 0) return 0;
+    }
+    return -1;
+}
+
+/* Queue a command for the act thread. Returns 0, -1 if the queue is full. */
+static int pipeline_act(pipeline_t *p, const act_cmd_t *c) {
+    if (spsc_push(&p->q_act, c) != 0) return -1;
+    sem_post(&p->act_wake);
+    return 0;
+}
+
 /* ── Main ───────────────────────────────────────────────────── */
 
+/* Rebuild the 3-signal verdict table from the configured weights. */
+static void apply_service_weights(const myco_config_t *cfg) {
+    service_weights_t w = {
+        .dns      = cfg->svc_weight_dns,
+        .port     = cfg->svc_weight_port,
+        .behavior = cfg->svc_weight_behavior,
+        .floor    = cfg->svc_min_score,
+    };
+    service_set_weights(&w);
+    log_msg(LOG_INFO, "main", "service voter: dns=%.2f port=%.2f behavior=%.2f floor=%.2f",
+            w.dns, w.port, w.behavior, w.floor);
+}
+
 int main(void) {
     struct utsname buffer;
     myco_config_t cfg;
@@ -107,7 +520,17 @@ int main(void) {
 
     ewma_init(&ewma_rtt);
     ewma_init(&ewma_jitter);
-    flow_table_init(&flow_table);
+    /* Flow budget: UCI flow_table_size, else the kernel's conntrack
+     * limit. Tables start small and grow toward it on demand. */
+    uint32_t max_flows = cfg.flow_table_size > 0
+                         ? (uint32_t)cfg.flow_table_size
+                         : flow_table_auto_max_flows();
+    if (flow_table_init_sized(&flow_table, max_flows) != 0) {
+        fprintf(stderr, "MycoFlow flow table alloc failed\n");
+        return 1;
+    }
+    log_msg(LOG_INFO, "main", "flow budget: %u flows", max_flows);
+    flow_ct_source_t *ct_src = flow_ct_open(cfg.ct_events, cfg.ct_resync_s);
 
     device_table_t device_table;
     device_table_init(&device_table);
@@ -119,9 +542,17 @@ int main(void) {
      * aggregation. If the raw socket fails (no CAP_NET_RAW), the thread
      * exits silently and the system degrades to port+behavior (78%). */
     dns_cache_t dns_cache;
-    dns_cache_init(&dns_cache);
+    dns_cache_init_sized(&dns_cache, (uint32_t)cfg.dns_cache_size);
     pthread_t dns_thread;
     int dns_thread_started = 0;
+    dns_sniff_set_mdns(cfg.dns_mdns);
+
+    /* Optional input trace for mycoflow-replay. Opened before the
+     * sniffer starts so the first DNS answers are captured too. */
+    if (cfg.trace_file[0] &&
+        trace_open(cfg.trace_file, (uint64_t)cfg.trace_max_mb << 20) == 0) {
+        dns_sniff_set_tap(trace_record_dns);
+    }
     if (pthread_create(&dns_thread, NULL, dns_sniff_thread, &dns_cache) == 0) {
         dns_thread_started = 1;
         log_msg(LOG_INFO, "main", "DNS sniffer thread launched");
@@ -138,7 +569,10 @@ int main(void) {
     rtt_engine_t         *rtt_eng    = NULL;
     myco_set_flow_table(NULL, 0);   /* cleared ⇒ JSON omits "flows" array */
     if (cfg.flow_aware_enabled) {
-        classifier = classifier_create();
+        apply_service_weights(&cfg);
+        classifier = classifier_create_sized(max_flows);
+        classifier_set_rtt_tail(classifier, cfg.rtt_tail_factor);
+        classifier_set_rtt_events(classifier, cfg.rtt_events);
         mark_eng   = mark_engine_open();
         const char *bpf_path =
             (cfg.rtt_bpf_obj[0] != '\0') ? cfg.rtt_bpf_obj : NULL;
@@ -188,7 +622,29 @@ int main(void) {
         }
     }
 
+    pipeline_t pipe;
+    if (pipeline_init(&pipe) != 0) {
+        fprintf(stderr, "MycoFlow pipeline alloc failed\n");
+        return 1;
+    }
+    pipe.flow_table   = &flow_table;
+    pipe.device_table = &device_table;
+    pipe.dns_cache    = &dns_cache;
+    pipe.classifier   = classifier;
+    pipe.mark_eng     = mark_eng;
+    pipe.rtt_eng      = rtt_eng;
+    /* The ring is opened whenever the probe is live, so rtt_events can
+     * be toggled by a reload; with it off no thresholds are set and the
+     * flow stage just sleeps in epoll instead of on the stop condvar. */
+    pipe.rtt_events   = rtt_eng && rtt_engine_events_open(rtt_eng) == 0;
+    flow_snapshot_t flow_snap;
+    memset(&flow_snap, 0, sizeof(flow_snap));
+    int policy_in_flight = 0;
+
     /* ── Reflexive loop: Sense → Infer → Act → Stabilize ────── */
+    /* Sensing, flow ingestion/classification and actuation run on the
+     * pipeline threads; this thread infers and decides once per sense
+     * sample. */
 
     while (!g_stop) {
         /* Drain any pending control commands written by LuCI (no-ubus path).
@@ -197,6 +653,7 @@ int main(void) {
 
         if (g_reload) {
             g_reload = 0;
+            pipeline_stop(&pipe);
             if (config_reload(&cfg) == 0) {
                 log_set_level(cfg.log_level);
                 interval_s = 1.0 / cfg.sample_hz;
@@ -223,57 +680,63 @@ int main(void) {
                         cfg.ingress_enabled = 0;
                     }
                 }
+                max_flows = cfg.flow_table_size > 0
+                            ? (uint32_t)cfg.flow_table_size
+                            : flow_table_auto_max_flows();
+                flow_table_set_max_flows(&flow_table, max_flows);
+                classifier_set_max_flows(classifier, max_flows);
+                classifier_set_rtt_tail(classifier, cfg.rtt_tail_factor);
+                classifier_set_rtt_events(classifier, cfg.rtt_events);
+                /* New weights can change any verdict: rebuild the table
+                 * and have the next tick re-vote every flow. */
+                apply_service_weights(&cfg);
+                classifier_revote_all(classifier);
+                /* Conntrack ingestion mode may have been toggled. */
+                flow_ct_close(ct_src);
+                ct_src = flow_ct_open(cfg.ct_events, cfg.ct_resync_s);
                 log_msg(LOG_INFO, "main", "config reloaded");
             }
         }
 
+        /* Answers to policy actions dispatched in earlier cycles. */
+        act_result_t res;
+        while (spsc_pop(&pipe.q_result, &res) == 0) {
+            control_on_action_result(&control_state, res.ok);
+            if (res.ok) {
+                control_state.current = res.policy;
+                last_action_ts = res.ts;
+            }
+            policy_in_flight = 0;
+        }
+
         if (!cfg.enabled) {
+            pipeline_stop(&pipe);
             log_msg(LOG_INFO, "main", "disabled, sleeping");
             sleep_interval(interval_s);
             continue;
         }
 
-        /* Sense */
-        if (sense_sample(cfg.egress_iface, cfg.probe_host, interval_s, cfg.dummy_metrics, &metrics) != 0) {
-            log_msg(LOG_WARN, "main", "sense sample failed");
-        }
-
-        /* Populate eBPF counters into metrics (no-op if libbpf unavailable) */
-        if (ebpf_read_stats(&metrics.ebpf_rx_pkts, &metrics.ebpf_rx_bytes) != 0) {
-            metrics.ebpf_rx_pkts  = 0;
-            metrics.ebpf_rx_bytes = 0;
-        }
-
-        ebpf_tick(&cfg);
-
-        /* Flow table: populate from conntrack, evict stale (>60s) */
-        double ft_now = now_monotonic_s();
-        flow_table_populate_conntrack(&flow_table, ft_now);
-        flow_table_evict_stale(&flow_table, ft_now, 60.0);
-
-        /* Flow-derived persona signals — populate into metrics */
-        metrics.active_flows  = flow_table_active_count(&flow_table);
-        metrics.elephant_flow = flow_table_has_elephant(&flow_table, 0.60);
-
-        /* Per-device persona: aggregate flows by src_ip, infer per-device,
-         * apply DSCP mangle rules when any device persona changes. */
-        if (cfg.per_device_enabled) {
-            device_table_aggregate(&device_table, &flow_table, ft_now, &dns_cache);
-            device_table_evict_stale(&device_table, ft_now, 120.0);
-            int dev_changes = device_table_update_personas(&device_table, &cfg);
-            if (dev_changes > 0) {
-                device_apply_all_dscp(&device_table, cfg.no_tc);
+        if (!pipe.running) {
+            pipe.cfg        = &cfg;
+            pipe.interval_s = interval_s;
+            pipe.ct_src     = ct_src;
+            if (pipeline_start(&pipe) != 0) {
+                sleep_interval(interval_s);
+                continue;
             }
         }
 
-        /* Per-flow service classifier + RTT auto-correction. Runs after
-         * device-level aggregation so the main persona pass already has
-         * fresh flow data; runs before actuation so any demote-on-rtt
-         * push is visible to the next mark lookup. */
-        if (cfg.flow_aware_enabled && classifier) {
-            classifier_tick(classifier, &flow_table, &dns_cache,
-                            mark_eng, rtt_eng, ft_now, interval_s);
+        /* Sense: the next sample from the sense thread */
+        sense_snapshot_t sample;
+        if (pipeline_wait_sense(&pipe, interval_s * 2.0, &sample) != 0) {
+            continue;   /* signal or a stalled probe: re-check stop/reload */
         }
+        metrics = sample.metrics;
+
+        /* Flow-derived persona signals from the latest flow tick */
+        spsc_pop_latest(&pipe.q_flow, &flow_snap);
+        metrics.active_flows  = flow_snap.active_flows;
+        metrics.elephant_flow = flow_snap.elephant_flow;
 
         /* eBPF packet rate: delta from previous cumulative counter (pkt/s) */
         static uint64_t prev_ebpf_pkts = 0;
@@ -303,7 +766,7 @@ int main(void) {
              * to drive global bandwidth adaptation. The aggregate global
              * metrics (all devices summed) produce misleading flow counts
              * (e.g. 11 devices × 25 flows = 275 → false TORRENT). */
-            persona = device_table_dominant_persona(&device_table);
+            persona = flow_snap.dominant;
         } else {
             persona = persona_update(&persona_state, &metrics, PERSONA_UNKNOWN);
         }
@@ -316,7 +779,7 @@ int main(void) {
         double now_ts = now_monotonic_s();
         int change = control_decide(&control_state, &cfg, &metrics, &baseline, persona, now_ts, &desired, reason, sizeof(reason));
 
-        /* Update shared state */
+        /* Update shared state (the flow thread dumps it to JSON) */
         pthread_mutex_lock(&g_state_mutex);
         g_last_metrics = metrics;
         g_last_baseline = baseline;
@@ -327,21 +790,18 @@ int main(void) {
         g_last_reason[sizeof(g_last_reason) - 1] = '\0';
         pthread_mutex_unlock(&g_state_mutex);
 
-        /* Dump state to JSON for Lua bridge */
-        myco_dump_json();
-
         log_msg(LOG_INFO, "loop",
                 "rtt=%.2f(raw=%.2f)ms jitter=%.2f(raw=%.2f)ms tx=%.0fbps rx=%.0fbps cpu=%.1f%% qbl=%u qdr=%u flows=%d persona=%s bw=%dkbit reason=%s ebpf_pkts=%llu ebpf_bytes=%llu",
                 metrics.rtt_ms, raw_rtt, metrics.jitter_ms, raw_jitter, metrics.tx_bps, metrics.rx_bps, metrics.cpu_pct,
                 metrics.qdisc_backlog, metrics.qdisc_drops,
-                flow_table_active_count(&flow_table),
+                flow_snap.active_flows,
                 persona_name(persona), control_state.current.bandwidth_kbit, reason,
                 (unsigned long long)metrics.ebpf_rx_pkts,
                 (unsigned long long)metrics.ebpf_rx_bytes);
 
         dump_metrics(&cfg, &metrics, persona, reason);
 
-        /* Act */
+        /* Act: queued to the act thread, which runs tc */
         if (control_state.safe_mode) {
             log_msg(LOG_WARN, "loop", "safe-mode active, skipping actuation");
         } else {
@@ -349,33 +809,39 @@ int main(void) {
              * Not rate-limited — persona changes are infrequent and tin
              * reconfiguration does not disrupt existing flows. */
             if (persona_changed) {
-                act_apply_persona_tin(cfg.egress_iface, persona,
-                                      control_state.current.bandwidth_kbit,
-                                      cfg.no_tc, cfg.force_act_fail);
+                act_cmd_t cmd;
+                memset(&cmd, 0, sizeof(cmd));
+                cmd.kind    = ACT_PERSONA_TIN;
+                cmd.persona = persona;
+                cmd.policy  = control_state.current;
                 /* Mirror persona latency target to ingress IFB as well */
                 if (cfg.ingress_enabled) {
-                    int ibw = control_state.current.ingress_bw_kbit > 0
-                              ? control_state.current.ingress_bw_kbit
-                              : cfg.bandwidth_kbit;
-                    act_apply_ingress_policy(cfg.ingress_iface, persona, ibw,
-                                            cfg.no_tc, cfg.force_act_fail);
+                    cmd.ingress_bw_kbit = control_state.current.ingress_bw_kbit > 0
+                                          ? control_state.current.ingress_bw_kbit
+                                          : cfg.bandwidth_kbit;
+                }
+                if (pipeline_act(&pipe, &cmd) != 0) {
+                    log_msg(LOG_WARN, "loop", "act queue full, persona tin update dropped");
                 }
             }
 
             if (change) {
                 double now = now_monotonic_s();
-                if ((now - last_action_ts) >= min_action_interval) {
-                    int ok = act_apply_policy(cfg.egress_iface, &desired, cfg.no_tc, cfg.force_act_fail);
-                    control_on_action_result(&control_state, ok);
-                    if (ok) {
-                        control_state.current = desired;
-                        last_action_ts = now;
-                        /* Sync ingress CAKE bandwidth cap with the adapted egress value */
-                        if (cfg.ingress_enabled && control_state.current.ingress_bw_kbit > 0) {
-                            act_apply_ingress_policy(cfg.ingress_iface, persona,
-                                                     control_state.current.ingress_bw_kbit,
-                                                     cfg.no_tc, cfg.force_act_fail);
-                        }
+                if (policy_in_flight) {
+                    log_msg(LOG_DEBUG, "loop", "action skipped (previous still running)");
+                } else if ((now - last_action_ts) >= min_action_interval) {
+                    act_cmd_t cmd;
+                    memset(&cmd, 0, sizeof(cmd));
+                    cmd.kind    = ACT_POLICY;
+                    cmd.persona = persona;
+                    cmd.policy  = desired;
+                    if (cfg.ingress_enabled) {
+                        cmd.ingress_bw_kbit = desired.ingress_bw_kbit;
+                    }
+                    if (pipeline_act(&pipe, &cmd) == 0) {
+                        policy_in_flight = 1;
+                    } else {
+                        log_msg(LOG_WARN, "loop", "act queue full, policy update deferred");
                     }
                 } else {
                     log_msg(LOG_DEBUG, "loop", "action skipped (cooldown)");
@@ -408,16 +874,22 @@ int main(void) {
             log_msg(LOG_DEBUG, "main", "baseline updated: rtt=%.2fms jitter=%.2fms",
                     baseline.rtt_ms, baseline.jitter_ms);
         }
-
-        sleep_interval(interval_s);
     }
 
+    /* Stop the stage threads before tearing down what they use. */
+    pipeline_stop(&pipe);
+    pipeline_destroy(&pipe);
+
     /* Stop DNS sniffer thread (g_stop already set by signal handler) */
     if (dns_thread_started) {
         pthread_join(dns_thread, NULL);
         log_msg(LOG_INFO, "main", "DNS sniffer thread joined");
     }
+    dns_sniff_set_tap(NULL);
+    trace_close();
     dns_cache_destroy(&dns_cache);
+    flow_ct_close(ct_src);
+    flow_table_free(&flow_table);
 
     if (cfg.flow_aware_enabled) {
         myco_set_flow_table(NULL, 0);
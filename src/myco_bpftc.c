@@ -0,0 +1,80 @@
+/*
+ * MycoFlow — Bio-Inspired Reflexive QoS System
+ * myco_bpftc.c — Native TC attach for eBPF programs (libbpf bpf_tc_*)
+ */
+#include "myco_bpftc.h"
+#include "myco_log.h"
+
+#include <errno.h>
+#include <string.h>
+
+#ifdef HAVE_LIBBPF
+#include <bpf/libbpf.h>
+#include <net/if.h>
+
+int bpftc_attach(bpftc_filter_t *f, const char *iface, int egress,
+                 int prog_fd, uint32_t priority) {
+    if (!f || !iface || !*iface || prog_fd < 0) return -1;
+    memset(f, 0, sizeof(*f));
+
+    int ifindex = (int)if_nametoindex(iface);
+    if (ifindex == 0) {
+        log_msg(LOG_WARN, "bpftc", "no such interface: %s", iface);
+        return -1;
+    }
+
+    DECLARE_LIBBPF_OPTS(bpf_tc_hook, hook, .ifindex = ifindex,
+                        .attach_point = egress ? BPF_TC_EGRESS : BPF_TC_INGRESS);
+    int rc = bpf_tc_hook_create(&hook);   /* clsact; -EEXIST is fine */
+    if (rc != 0 && rc != -EEXIST) {
+        log_msg(LOG_WARN, "bpftc", "clsact create failed on %s: %s",
+                iface, strerror(-rc));
+        return -1;
+    }
+
+    DECLARE_LIBBPF_OPTS(bpf_tc_opts, opts, .handle = MYCO_TC_HANDLE,
+                        .priority = priority, .prog_fd = prog_fd,
+                        .flags = BPF_TC_F_REPLACE);
+    rc = bpf_tc_attach(&hook, &opts);
+    if (rc != 0) {
+        log_msg(LOG_WARN, "bpftc", "attach failed on %s %s: %s", iface,
+                egress ? "egress" : "ingress", strerror(-rc));
+        return -1;
+    }
+
+    f->ifindex  = ifindex;
+    f->egress   = egress;
+    f->priority = priority;
+    f->attached = 1;
+    return 0;
+}
+
+void bpftc_detach(bpftc_filter_t *f) {
+    if (!f || !f->attached) return;
+    DECLARE_LIBBPF_OPTS(bpf_tc_hook, hook, .ifindex = f->ifindex,
+                        .attach_point = f->egress ? BPF_TC_EGRESS : BPF_TC_INGRESS);
+    DECLARE_LIBBPF_OPTS(bpf_tc_opts, opts, .handle = MYCO_TC_HANDLE,
+                        .priority = f->priority);
+    int rc = bpf_tc_detach(&hook, &opts);
+    /* -ENOENT: interface or filter already gone — nothing left of ours. */
+    if (rc != 0 && rc != -ENOENT) {
+        log_msg(LOG_WARN, "bpftc", "detach failed (ifindex %d %s): %s", f->ifindex,
+                f->egress ? "egress" : "ingress", strerror(-rc));
+    }
+    f->attached = 0;
+}
+
+#else /* !HAVE_LIBBPF */
+
+int bpftc_attach(bpftc_filter_t *f, const char *iface, int egress,
+                 int prog_fd, uint32_t priority) {
+    (void)iface; (void)egress; (void)prog_fd; (void)priority;
+    if (f) memset(f, 0, sizeof(*f));
+    return -1;
+}
+
+void bpftc_detach(bpftc_filter_t *f) {
+    if (f) f->attached = 0;
+}
+
+#endif /* HAVE_LIBBPF */
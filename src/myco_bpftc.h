@@ -0,0 +1,39 @@
+/*
+ * MycoFlow — Bio-Inspired Reflexive QoS System
+ * myco_bpftc.h — Native TC attach for eBPF programs (libbpf bpf_tc_*)
+ *
+ * Filters are attached straight over netlink: no `tc` binary, no bpffs
+ * pin, and the loaded program (with its maps) is the one the kernel
+ * runs. Each filter is identified by a fixed handle + priority that
+ * MycoFlow owns, so replace and delete touch only our filters and
+ * leave anything else on the interface's clsact alone. The clsact
+ * qdisc itself is created on demand and never removed.
+ *
+ * Our programs are pure observers and return TC_ACT_UNSPEC, so filters
+ * at later priorities (e.g. an SQM ingress redirect) still run.
+ */
+#ifndef MYCO_BPFTC_H
+#define MYCO_BPFTC_H
+
+#include <stdint.h>
+
+#define MYCO_TC_HANDLE     0x4d59    /* "MY" */
+#define MYCO_TC_PRIO_STATS 0xbf00    /* mycoflow.bpf.o packet counter */
+#define MYCO_TC_PRIO_RTT   0xbf01    /* mycoflow_rtt.bpf.o, both directions */
+
+typedef struct {
+    int      ifindex;
+    int      egress;       /* 1 = egress hook, 0 = ingress */
+    uint32_t priority;
+    int      attached;
+} bpftc_filter_t;
+
+/* Attach `prog_fd` on `iface` at (MYCO_TC_HANDLE, priority), replacing
+ * a filter we left behind earlier. Returns 0, -1 on error (logged). */
+int  bpftc_attach(bpftc_filter_t *f, const char *iface, int egress,
+                  int prog_fd, uint32_t priority);
+
+/* Remove the filter attached by bpftc_attach(). Safe when not attached. */
+void bpftc_detach(bpftc_filter_t *f);
+
+#endif /* MYCO_BPFTC_H */
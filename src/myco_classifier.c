@@ -2,14 +2,26 @@
  * MycoFlow — Bio-Inspired Reflexive QoS System
  * myco_classifier.c — Per-flow service classifier orchestrator
  *
- * Maintains a parallel table keyed by flow_key_t. Fixed size, linear
- * probe (same strategy as flow_table_t). A typical home network has
- * 50–150 active flows; 1024 is comfortable headroom.
+ * Maintains a parallel table keyed by flow_key_t. Entries live in a
+ * node array indexed by a chained hash on the 5-tuple (the flow table's
+ * cached hash), so a tick costs O(active flows). Free nodes are kept on
+ * a free list; live nodes are threaded on an intrusive LRU list ordered
+ * by last_confirmed, which makes both the stale sweep and eviction at
+ * the ceiling O(evicted). Runtime-sized: starts at FST_MIN_CAPACITY
+ * nodes, doubles when full up to the flow budget given to
+ * classifier_create_sized(), and compacts to half when fewer than a
+ * quarter of the nodes are live.
  *
  * Stability gate: a flow_service_t.stable flag is set only when two
  * consecutive ticks agree on the same non-UNKNOWN service. Unstable
  * verdicts never push ct marks — this avoids whipsawing DSCP during
  * the first second of a flow when DNS may still be propagating.
+ *
+ * Incremental ticks: only flows with something new are re-voted — the
+ * flow table's dirty bit (new flow, or a behaviour bucket moved), a DNS
+ * answer change for the flow's dst_ip, an unstable verdict, or a stable
+ * one whose CLASSIFIER_RECHECK_S has run out. The rest keep their
+ * verdict and only go through confirmation and the RTT corrector.
  */
 #include "myco_classifier.h"
 #include "myco_hint.h"
@@ -17,66 +29,298 @@
 
 #include <stdlib.h>
 #include <string.h>
+#include <stdint.h>
+
+#define FST_MIN_CAPACITY 256
+#define FST_NIL          UINT32_MAX
+#define FST_STALE_S      30.0     /* drop entries unconfirmed this long */
+#define CLASSIFIER_BATCH 64       /* flows per batched DNS read */
+#define CLASSIFIER_RECHECK_S 10.0 /* re-vote quiet stable flows this often */
 
-#define FST_SIZE FLOW_TABLE_SIZE
+typedef struct {
+    flow_service_t fs;
+    uint32_t       hash;       /* flow_key_hash() of the 5-tuple */
+    uint32_t       chain;      /* next node in bucket chain / free list */
+    uint32_t       lru_prev;   /* towards the least recently confirmed */
+    uint32_t       lru_next;   /* towards the most recently confirmed */
+    uint8_t        live;
+} fst_node_t;
 
 struct flow_service_table {
-    flow_service_t entries[FST_SIZE];
-    int            count;
+    fst_node_t *nodes;
+    uint32_t   *buckets;       /* capacity chain heads, FST_NIL = empty */
+    uint32_t    capacity;      /* allocated nodes (power of two) */
+    uint32_t    max_capacity;  /* growth ceiling (live entries) */
+    uint32_t    free_head;
+    uint32_t    lru_head;      /* least recently confirmed */
+    uint32_t    lru_tail;      /* most recently confirmed */
+    int         count;
+    uint32_t    mutations;     /* bumped on link/release: node indices moved */
+    uint64_t    dns_cursor;    /* dns_cache_changes_since() position */
+    int         revote_all;    /* next tick re-votes every flow */
+    double      rtt_tail_factor; /* p99 > target × this also breaches; 0 = off */
+    int         rtt_events;    /* keep probe thresholds for breach events */
+    classifier_stats_t stats;
 };
 
-static int keys_equal(const flow_key_t *a, const flow_key_t *b) {
-    return a->src_ip == b->src_ip && a->dst_ip == b->dst_ip &&
-           a->src_port == b->src_port && a->dst_port == b->dst_port &&
-           a->protocol == b->protocol;
+static int node_matches(const fst_node_t *n, uint32_t hash, const flow_key_t *key) {
+    const flow_service_t *e = &n->fs;
+    return n->hash == hash &&
+           e->src_ip == key->src_ip && e->dst_ip == key->dst_ip &&
+           e->src_port == key->src_port && e->dst_port == key->dst_port &&
+           e->proto == key->protocol;
+}
+
+/* ── LRU list ───────────────────────────────────────────────── */
+
+static void lru_unlink(flow_service_table_t *tab, uint32_t idx) {
+    fst_node_t *n = &tab->nodes[idx];
+    if (n->lru_prev != FST_NIL) tab->nodes[n->lru_prev].lru_next = n->lru_next;
+    else                        tab->lru_head = n->lru_next;
+    if (n->lru_next != FST_NIL) tab->nodes[n->lru_next].lru_prev = n->lru_prev;
+    else                        tab->lru_tail = n->lru_prev;
+    n->lru_prev = n->lru_next = FST_NIL;
+}
+
+static void lru_push_tail(flow_service_table_t *tab, uint32_t idx) {
+    fst_node_t *n = &tab->nodes[idx];
+    n->lru_prev = tab->lru_tail;
+    n->lru_next = FST_NIL;
+    if (tab->lru_tail != FST_NIL) tab->nodes[tab->lru_tail].lru_next = idx;
+    else                          tab->lru_head = idx;
+    tab->lru_tail = idx;
+}
+
+static void lru_touch(flow_service_table_t *tab, uint32_t idx) {
+    if (tab->lru_tail == idx) return;
+    lru_unlink(tab, idx);
+    lru_push_tail(tab, idx);
+}
+
+/* ── Node storage ───────────────────────────────────────────── */
+
+/* Fresh arrays of `capacity` nodes, all on the free list. */
+static int fst_alloc(flow_service_table_t *tab, uint32_t capacity) {
+    fst_node_t *nodes = calloc(capacity, sizeof(*nodes));
+    uint32_t *buckets = malloc(capacity * sizeof(*buckets));
+    if (!nodes || !buckets) {
+        free(nodes);
+        free(buckets);
+        return -1;
+    }
+    for (uint32_t i = 0; i < capacity; i++) {
+        buckets[i] = FST_NIL;
+        nodes[i].chain = i + 1 < capacity ? i + 1 : FST_NIL;
+        nodes[i].lru_prev = nodes[i].lru_next = FST_NIL;
+    }
+    tab->nodes     = nodes;
+    tab->buckets   = buckets;
+    tab->capacity  = capacity;
+    tab->free_head = 0;
+    tab->lru_head  = tab->lru_tail = FST_NIL;
+    tab->count     = 0;
+    return 0;
+}
+
+static uint32_t fst_find(const flow_service_table_t *tab, const flow_key_t *key,
+                         uint32_t hash) {
+    uint32_t idx = tab->buckets[hash & (tab->capacity - 1)];
+    while (idx != FST_NIL) {
+        const fst_node_t *n = &tab->nodes[idx];
+        if (node_matches(n, hash, key)) return idx;
+        idx = n->chain;
+    }
+    return FST_NIL;
+}
+
+/* Take a node off the free list and link it under `key`. The caller
+ * guarantees the free list is non-empty. */
+static uint32_t fst_link(flow_service_table_t *tab, const flow_key_t *key,
+                         uint32_t hash) {
+    uint32_t idx = tab->free_head;
+    fst_node_t *n = &tab->nodes[idx];
+    tab->free_head = n->chain;
+
+    memset(&n->fs, 0, sizeof(n->fs));
+    n->fs.src_ip   = key->src_ip;
+    n->fs.dst_ip   = key->dst_ip;
+    n->fs.src_port = key->src_port;
+    n->fs.dst_port = key->dst_port;
+    n->fs.proto    = key->protocol;
+    n->hash = hash;
+    n->live = 1;
+
+    uint32_t *head = &tab->buckets[hash & (tab->capacity - 1)];
+    n->chain = *head;
+    *head = idx;
+    lru_push_tail(tab, idx);
+    tab->count++;
+    tab->mutations++;
+    return idx;
+}
+
+/* Unlink a live node and return it to the free list. */
+static void fst_release(flow_service_table_t *tab, uint32_t idx) {
+    fst_node_t *n = &tab->nodes[idx];
+    uint32_t *pp = &tab->buckets[n->hash & (tab->capacity - 1)];
+    while (*pp != idx) pp = &tab->nodes[*pp].chain;
+    *pp = n->chain;
+
+    lru_unlink(tab, idx);
+    memset(n, 0, sizeof(*n));
+    n->lru_prev = n->lru_next = FST_NIL;
+    n->chain = tab->free_head;
+    tab->free_head = idx;
+    if (tab->count > 0) tab->count--;
+    tab->mutations++;
 }
 
-static flow_service_t *fst_find(flow_service_table_t *tab, const flow_key_t *key) {
-    for (int i = 0; i < FST_SIZE; i++) {
-        flow_service_t *e = &tab->entries[i];
-        if (e->detected_at == 0.0 && e->last_confirmed == 0.0) continue;
-        flow_key_t k = {
-            .src_ip = e->src_ip, .dst_ip = e->dst_ip,
-            .src_port = e->src_port, .dst_port = e->dst_port,
-            .protocol = e->proto,
+/* fst_release() for an entry leaving the table: clear the probe's breach
+ * threshold first, or the kernel keeps firing events for a flow we no
+ * longer track. */
+static void fst_evict(flow_service_table_t *tab, uint32_t idx, rtt_engine_t *rtt) {
+    const flow_service_t *gone = &tab->nodes[idx].fs;
+    if (gone->rtt_watch_ms && rtt) {
+        flow_key_t key = {
+            .src_ip = gone->src_ip, .dst_ip = gone->dst_ip,
+            .src_port = gone->src_port, .dst_port = gone->dst_port,
+            .protocol = gone->proto,
         };
-        if (keys_equal(&k, key)) return e;
+        rtt_engine_set_threshold(rtt, &key, 0);
     }
-    return NULL;
+    fst_release(tab, idx);
 }
 
-/* Find a free slot, or evict the stalest entry (lowest last_confirmed). */
-static flow_service_t *fst_slot(flow_service_table_t *tab) {
-    flow_service_t *stalest = NULL;
-    double oldest = 1e18;
-    for (int i = 0; i < FST_SIZE; i++) {
-        flow_service_t *e = &tab->entries[i];
-        if (e->detected_at == 0.0 && e->last_confirmed == 0.0) {
-            return e;
-        }
-        if (e->last_confirmed < oldest) {
-            oldest = e->last_confirmed;
-            stalest = e;
-        }
+/* Rebuild into `capacity` nodes, re-linking live entries in LRU order so
+ * recency survives. Used for both growth and shrink. Returns 0, -1 on
+ * OOM (table intact). */
+static int fst_resize(flow_service_table_t *tab, uint32_t capacity) {
+    flow_service_table_t fresh = *tab;
+    if (fst_alloc(&fresh, capacity) != 0) {
+        log_msg(LOG_WARN, "classifier", "resize to %u nodes failed (OOM)", capacity);
+        return -1;
     }
-    if (stalest) {
-        memset(stalest, 0, sizeof(*stalest));
-        if (tab->count > 0) tab->count--;
+    for (uint32_t idx = tab->lru_head; idx != FST_NIL && fresh.free_head != FST_NIL;
+         idx = tab->nodes[idx].lru_next) {
+        const fst_node_t *old = &tab->nodes[idx];
+        flow_key_t key = {
+            .src_ip = old->fs.src_ip, .dst_ip = old->fs.dst_ip,
+            .src_port = old->fs.src_port, .dst_port = old->fs.dst_port,
+            .protocol = old->fs.proto,
+        };
+        uint32_t n = fst_link(&fresh, &key, old->hash);
+        fresh.nodes[n].fs = old->fs;
     }
-    return stalest;
+    free(tab->nodes);
+    free(tab->buckets);
+    *tab = fresh;
+    return 0;
 }
 
-flow_service_table_t *classifier_create(void) {
+/* Insert a new entry for `key`. Grows when the node array is full and
+ * the ceiling allows; otherwise recycles the least recently confirmed
+ * entry. Returns the node index, FST_NIL only if nothing can be freed. */
+static uint32_t fst_insert(flow_service_table_t *tab, const flow_key_t *key,
+                           uint32_t hash, rtt_engine_t *rtt) {
+    if ((uint32_t)tab->count >= tab->max_capacity) {
+        if (tab->lru_head == FST_NIL) return FST_NIL;
+        fst_evict(tab, tab->lru_head, rtt);
+    } else if (tab->free_head == FST_NIL) {
+        if (fst_resize(tab, tab->capacity * 2) != 0) {
+            if (tab->lru_head == FST_NIL) return FST_NIL;
+            fst_evict(tab, tab->lru_head, rtt);
+        }
+    }
+    return fst_link(tab, key, hash);
+}
+
+static uint32_t clamp_max_flows(uint32_t max_flows) {
+    if (max_flows == 0) max_flows = FLOW_TABLE_DEFAULT_CAPACITY;
+    return max_flows < FST_MIN_CAPACITY ? FST_MIN_CAPACITY : max_flows;
+}
+
+flow_service_table_t *classifier_create_sized(uint32_t max_flows) {
     flow_service_table_t *tab = calloc(1, sizeof(*tab));
+    if (!tab) return NULL;
+    tab->max_capacity = clamp_max_flows(max_flows);
+    if (fst_alloc(tab, FST_MIN_CAPACITY) != 0) {
+        free(tab);
+        return NULL;
+    }
     return tab;
 }
 
+flow_service_table_t *classifier_create(void) {
+    return classifier_create_sized(0);
+}
+
+void classifier_set_max_flows(flow_service_table_t *tab, uint32_t max_flows) {
+    if (!tab) return;
+    tab->max_capacity = clamp_max_flows(max_flows);
+}
+
+void classifier_set_rtt_tail(flow_service_table_t *tab, double factor) {
+    if (!tab) return;
+    tab->rtt_tail_factor = factor > 0.0 ? factor : 0.0;
+}
+
+void classifier_set_rtt_events(flow_service_table_t *tab, int on) {
+    if (!tab) return;
+    tab->rtt_events = on ? 1 : 0;
+}
+
+void classifier_revote_all(flow_service_table_t *tab) {
+    if (!tab) return;
+    tab->revote_all = 1;
+}
+
 void classifier_destroy(flow_service_table_t *tab) {
+    if (!tab) return;
+    free(tab->nodes);
+    free(tab->buckets);
     free(tab);
 }
 
+/* Representative gap of IAT bucket b: the middle of [2^(b+2), 2^(b+3)) µs. */
+static double iat_bucket_us(int b) {
+    return 1.5 * (double)(1u << (b + 2));
+}
+
+static double iat_median_us(const uint32_t *hist) {
+    uint64_t total = 0;
+    for (int b = 0; b < RTT_FEAT_IAT_BUCKETS; b++) total += hist[b];
+    if (total == 0) return 0.0;
+    uint64_t seen = 0;
+    for (int b = 0; b < RTT_FEAT_IAT_BUCKETS; b++) {
+        seen += hist[b];
+        if (seen * 2 >= total) return iat_bucket_us(b);
+    }
+    return iat_bucket_us(RTT_FEAT_IAT_BUCKETS - 1);
+}
+
+/* Overlay the eBPF packet window: per-direction sizes and gaps, and the
+ * window's own size / rate / direction split in place of the conntrack
+ * approximations. */
+static void window_features(const flow_pkt_window_t *w, flow_features_t *out) {
+    uint64_t pkts = 0, bytes = 0;
+    for (int d = 0; d < 2; d++) {
+        const flow_dir_window_t *dw = &w->dir[d];
+        out->win_pkts[d]       = dw->packets;
+        out->win_avg_size[d]   = dw->packets ? (double)dw->bytes / dw->packets : 0.0;
+        out->win_iat_p50_us[d] = iat_median_us(dw->iat_hist);
+        pkts  += dw->packets;
+        bytes += dw->bytes;
+    }
+    if (pkts == 0 || w->window_s <= 0.0) return;
+    out->windowed     = 1;
+    out->avg_pkt_size = (double)bytes / (double)pkts;
+    out->bw_bps       = (double)bytes * 8.0 / w->window_s;
+    out->rx_ratio     = bytes > 0 ? (double)w->dir[RTT_FEAT_DOWN].bytes / (double)bytes : 0.5;
+}
+
 static void compute_features(const flow_entry_t *fe, double window_s,
-                             flow_features_t *out) {
+                             rtt_engine_t *rtt, flow_features_t *out) {
+    memset(out, 0, sizeof(*out));
     uint64_t pkts = fe->packets + fe->rx_packets;
     uint64_t bytes = fe->bytes + fe->rx_bytes;
 
@@ -91,6 +335,57 @@ static void compute_features(const flow_entry_t *fe, double window_s,
     out->rx_ratio = total_delta > 0
         ? (double)fe->rx_delta / (double)total_delta
         : 0.5;
+
+    flow_pkt_window_t w;
+    if (rtt && rtt_engine_flow_window(rtt, &fe->key, &w) == 0) {
+        window_features(&w, out);
+    }
+}
+
+/* ── Mark reconciliation ────────────────────────────────────── */
+
+/* fe->ct_mark is what conntrack reported at the last read. After one of
+ * our writes it is stale until the kernel has been read again — by
+ * ct_mark_at, since last_seen also moves on idle event-mode refreshes
+ * that read nothing. */
+static int kernel_mark_known(const flow_service_t *fs, const flow_entry_t *fe) {
+    return fe->ct_mark_valid && fe->ct_mark_at > fs->mark_pushed_at;
+}
+
+/* Bring the flow's conntrack mark to `mark`. Skips the write when the
+ * kernel already has it, or — with no fresh kernel reading — when our
+ * own last write was that mark. Returns 0 once fs->ct_mark == mark. */
+static int set_flow_mark(flow_service_table_t *tab, flow_service_t *fs,
+                         const flow_entry_t *fe, mark_engine_t *eng,
+                         uint8_t mark, double now) {
+    if (kernel_mark_known(fs, fe)) {
+        if (fe->ct_mark == mark) {
+            if (fs->ct_mark != mark) tab->stats.marks_adopted++;
+            fs->ct_mark = mark;
+            return 0;
+        }
+    } else if (fs->ct_mark == mark) {
+        return 0;
+    }
+    if (mark_engine_set(eng, &fe->key, mark) != 0) return -1;
+    fs->ct_mark = mark;
+    fs->mark_pushed_at = now;
+    return 0;
+}
+
+/* Breach-event threshold for a flow: the tick path's own limit
+ * (target × 1.5) while it is stable and not demoted, otherwise none.
+ * Written to the probe only when it changes. */
+static void rtt_watch(flow_service_table_t *tab, flow_service_t *fs,
+                      const flow_key_t *key, rtt_engine_t *rtt) {
+    uint32_t want = 0;
+    if (tab->rtt_events && fs->stable && !fs->demoted) {
+        uint32_t target = service_rtt_target_ms(fs->service);
+        want = target + target / 2;
+    }
+    if (want > 0xFFFFu) want = 0xFFFFu;
+    if (want == fs->rtt_watch_ms) return;
+    if (rtt_engine_set_threshold(rtt, key, want) == 0) fs->rtt_watch_ms = (uint16_t)want;
 }
 
 /* Phase 5 auto-corrector. Called after the stability gate has pushed
@@ -101,19 +396,35 @@ static void compute_features(const flow_entry_t *fe, double window_s,
  * 2-tick confirmation is ~2s — long enough to avoid reacting to a
  * single sampling spike, short enough that a genuinely congested flow
  * is demoted before a human notices. Matches the stability gate idiom
- * already used for classification. */
-static void rtt_autocorrect(flow_service_t *fs, const flow_key_t *key,
-                            rtt_engine_t *rtt, mark_engine_t *eng) {
-    if (!rtt || !fs->stable) return;
+ * already used for classification.
+ *
+ * With a tail factor set, a tick also counts as a breach when the
+ * flow's p99 over the tick window (≥ RTT_TAIL_MIN_SAMPLES samples)
+ * exceeds target × factor: a good mean can hide a bad tail. */
+static void rtt_autocorrect(flow_service_table_t *tab, flow_service_t *fs,
+                            const flow_entry_t *fe, rtt_engine_t *rtt,
+                            mark_engine_t *eng, double now) {
+    if (!rtt) return;
+    rtt_watch(tab, fs, &fe->key, rtt);
+    if (!fs->stable) return;
+    const flow_key_t *key = &fe->key;
 
     uint32_t rtt_ms = rtt_engine_lookup_ms(rtt, key);
-    if (rtt_ms == 0) return;   /* no data (UDP or not measured yet) */
+    if (rtt_ms == 0) return;   /* no data (non-QUIC UDP or not measured yet) */
     fs->rtt_ms = (uint16_t)(rtt_ms > 0xFFFFu ? 0xFFFFu : rtt_ms);
 
     uint32_t target = service_rtt_target_ms(fs->service);
     if (target == 0) return;   /* class opted out (bulk/torrent/system) */
 
-    if (rtt_ms > target + target / 2) {
+    rtt_pct_t pct = {0};
+    int tail_breach = 0;
+    if (tab->rtt_tail_factor > 0.0 &&
+        rtt_engine_flow_percentiles(rtt, key, &pct) == 0 &&
+        pct.samples >= RTT_TAIL_MIN_SAMPLES) {
+        tail_breach = (double)pct.p99_ms > (double)target * tab->rtt_tail_factor;
+    }
+
+    if (rtt_ms > target + target / 2 || tail_breach) {
         /* Over budget this tick. */
         if (fs->rtt_breach_ticks < 255) fs->rtt_breach_ticks++;
         fs->rtt_recover_ticks = 0;
@@ -122,14 +433,13 @@ static void rtt_autocorrect(flow_service_t *fs, const flow_key_t *key,
             service_t demoted = service_demote(fs->service);
             if (demoted != fs->service) {
                 uint8_t new_mark = service_to_ct_mark(demoted);
-                if (mark_engine_set(eng, key, new_mark) == 0) {
-                    fs->ct_mark  = new_mark;
+                if (set_flow_mark(tab, fs, fe, eng, new_mark, now) == 0) {
                     fs->demoted  = 1;
                     log_msg(LOG_INFO, "rtt",
-                            "demote %s → %s (rtt=%ums target=%ums)",
+                            "demote %s → %s (rtt=%ums p99=%ums target=%ums)",
                             service_name(fs->service),
                             service_name(demoted),
-                            rtt_ms, target);
+                            rtt_ms, pct.p99_ms, target);
                 }
             }
         }
@@ -140,8 +450,7 @@ static void rtt_autocorrect(flow_service_t *fs, const flow_key_t *key,
             if (fs->rtt_recover_ticks < 255) fs->rtt_recover_ticks++;
             if (fs->rtt_recover_ticks >= 2) {
                 uint8_t orig_mark = service_to_ct_mark(fs->service);
-                if (mark_engine_set(eng, key, orig_mark) == 0) {
-                    fs->ct_mark  = orig_mark;
+                if (set_flow_mark(tab, fs, fe, eng, orig_mark, now) == 0) {
                     fs->demoted  = 0;
                     fs->rtt_recover_ticks = 0;
                     log_msg(LOG_INFO, "rtt",
@@ -153,8 +462,97 @@ static void rtt_autocorrect(flow_service_t *fs, const flow_key_t *key,
     }
 }
 
+/* One flow's upsert and stability step. With `vote` the three signals
+ * are re-gathered (`dns_service` comes from the tick's batched cache
+ * read); without it the tracked verdict at `idx` is re-asserted. */
+static void classify_flow(flow_service_table_t *tab, const flow_entry_t *fe,
+                          uint32_t idx, int vote, service_t dns_service,
+                          mark_engine_t *eng, rtt_engine_t *rtt,
+                          double now, double window_s) {
+    service_t verdict;
+    if (vote) {
+        /* ── Gather three signals ────────────────────────────── */
+        service_signals_t sig = { SVC_UNKNOWN, SVC_UNKNOWN, SVC_UNKNOWN };
+
+        sig.dns_hint = dns_service;
+        sig.port_hint = service_from_port(fe->key.protocol, fe->key.dst_port);
+
+        flow_features_t feat;
+        compute_features(fe, window_s, rtt, &feat);
+        sig.behavior_hint = service_infer_behavior(&feat);
+
+        verdict = service_classify(&sig);
+        tab->stats.last_tick_revoted++;
+    } else {
+        verdict = tab->nodes[idx].fs.service;
+        tab->stats.last_tick_skipped++;
+    }
+
+    /* ── Upsert into fst ────────────────────────────────── */
+    if (idx == FST_NIL) {
+        if (verdict == SVC_UNKNOWN) return;  /* don't track idle unknowns */
+        idx = fst_insert(tab, &fe->key, fe->hash, rtt);
+        if (idx == FST_NIL) return;
+        flow_service_t *fs = &tab->nodes[idx].fs;
+        fs->service = verdict;
+        fs->ct_mark = 0;
+        fs->detected_at = now;
+        fs->last_confirmed = now;
+        fs->last_voted = now;
+        fs->stable = 0;
+        return;
+    }
+    flow_service_t *fs = &tab->nodes[idx].fs;
+
+    /* ── Stability logic ────────────────────────────────── */
+    fs->last_confirmed = now;
+    if (vote) fs->last_voted = now;
+    lru_touch(tab, idx);
+    if (verdict == SVC_UNKNOWN) {
+        /* Keep last verdict but don't promote or push. */
+        return;
+    }
+    if (verdict == fs->service) {
+        if (!fs->stable) {
+            fs->stable = 1;   /* second consecutive match — promote */
+            uint8_t new_mark = service_to_ct_mark(verdict);
+            uint8_t low_mark = service_to_ct_mark(service_demote(verdict));
+            if (kernel_mark_known(fs, fe) && fe->ct_mark == low_mark &&
+                low_mark != new_mark) {
+                /* Demoted before a restart: keep it, the auto-corrector
+                 * re-promotes once RTT recovers. */
+                fs->ct_mark = low_mark;
+                fs->demoted = 1;
+                tab->stats.marks_adopted++;
+            } else {
+                set_flow_mark(tab, fs, fe, eng, new_mark, now);
+            }
+        } else if (fs->ct_mark != 0 && kernel_mark_known(fs, fe) &&
+                   fe->ct_mark != fs->ct_mark) {
+            /* Someone else rewrote or cleared the mark. */
+            if (set_flow_mark(tab, fs, fe, eng, fs->ct_mark, now) == 0) {
+                tab->stats.marks_repaired++;
+            }
+        }
+    } else {
+        /* Verdict flipped — restart stability window + clear demote. */
+        fs->service = verdict;
+        fs->stable = 0;
+        fs->demoted = 0;
+        fs->rtt_breach_ticks = 0;
+        fs->rtt_recover_ticks = 0;
+    }
+
+    rtt_autocorrect(tab, fs, fe, rtt, eng, now);
+}
+
+static int cmp_u32(const void *a, const void *b) {
+    uint32_t x = *(const uint32_t *)a, y = *(const uint32_t *)b;
+    return (x > y) - (x < y);
+}
+
 void classifier_tick(flow_service_table_t *tab,
-                     const flow_table_t *ft,
+                     flow_table_t *ft,
                      dns_cache_t *dns,
                      mark_engine_t *eng,
                      rtt_engine_t *rtt,
@@ -162,110 +560,177 @@ void classifier_tick(flow_service_table_t *tab,
                      double window_s) {
     if (!tab || !ft) return;
 
-    for (int i = 0; i < FLOW_TABLE_SIZE; i++) {
-        const flow_entry_t *fe = &ft->entries[i];
-        if (!fe->active) continue;
+    tab->stats.last_tick_revoted = 0;
+    tab->stats.last_tick_skipped = 0;
 
-        /* ── Gather three signals ────────────────────────────── */
-        service_signals_t sig = { SVC_UNKNOWN, SVC_UNKNOWN, SVC_UNKNOWN };
+    /* One batched read each of the eBPF packet features and RTTs for
+     * every flow; the per-flow lookups below stay in memory. */
+    rtt_engine_refresh_features(rtt, now);
+    rtt_engine_refresh_rtt(rtt);
 
-        if (dns) {
-            sig.dns_hint = dns_cache_lookup_service(dns, fe->key.dst_ip);
+    /* IPs whose DNS answer changed since the last tick, sorted for
+     * bsearch. Falling behind the log re-votes everything once. */
+    uint32_t changed[DNS_CHANGE_LOG];
+    int n_changed = 0;
+    int all_dirty = tab->revote_all;
+    tab->revote_all = 0;
+    if (dns) {
+        n_changed = dns_cache_changes_since(dns, &tab->dns_cursor,
+                                            changed, DNS_CHANGE_LOG);
+        if (n_changed < 0) {
+            all_dirty = 1;
+            n_changed = 0;
         }
-        sig.port_hint = service_from_port(fe->key.protocol, fe->key.dst_port);
-
-        flow_features_t feat;
-        compute_features(fe, window_s, &feat);
-        sig.behavior_hint = service_infer_behavior(&feat);
+        if (n_changed > 1) qsort(changed, (size_t)n_changed, sizeof(changed[0]), cmp_u32);
+    }
 
-        service_t verdict = service_classify(&sig);
-
-        /* ── Upsert into fst ────────────────────────────────── */
-        flow_service_t *fs = fst_find(tab, &fe->key);
-        if (!fs) {
-            if (verdict == SVC_UNKNOWN) continue;  /* don't track idle unknowns */
-            fs = fst_slot(tab);
-            if (!fs) continue;
-            fs->src_ip = fe->key.src_ip;
-            fs->dst_ip = fe->key.dst_ip;
-            fs->src_port = fe->key.src_port;
-            fs->dst_port = fe->key.dst_port;
-            fs->proto = fe->key.protocol;
-            fs->service = verdict;
-            fs->ct_mark = 0;
-            fs->detected_at = now;
-            fs->last_confirmed = now;
-            fs->stable = 0;
-            tab->count++;
-            continue;
+    /* Flows are walked CLASSIFIER_BATCH at a time so the DNS signal for
+     * the voting ones is one prefetched cache read at the tick's `now`. */
+    const flow_entry_t *batch[CLASSIFIER_BATCH];
+    uint32_t  idx[CLASSIFIER_BATCH];
+    uint8_t   vote[CLASSIFIER_BATCH];
+    uint32_t  dst[CLASSIFIER_BATCH];
+    size_t    dst_pos[CLASSIFIER_BATCH];
+    service_t dns_res[CLASSIFIER_BATCH];
+    service_t dns_svc[CLASSIFIER_BATCH];
+    uint32_t it = 0;
+    int done = 0;
+    while (!done) {
+        size_t n = 0, n_dst = 0;
+        while (n < CLASSIFIER_BATCH) {
+            flow_entry_t *fe = flow_table_next_mut(ft, &it);
+            if (!fe) {
+                done = 1;
+                break;
+            }
+            uint32_t i = fst_find(tab, &fe->key, fe->hash);
+            const flow_service_t *fs = i != FST_NIL ? &tab->nodes[i].fs : NULL;
+            int v = fe->dirty || all_dirty ||
+                    (fs && (!fs->stable || now - fs->last_voted >= CLASSIFIER_RECHECK_S)) ||
+                    (n_changed > 0 &&
+                     bsearch(&fe->key.dst_ip, changed, (size_t)n_changed,
+                             sizeof(changed[0]), cmp_u32) != NULL);
+            fe->dirty = 0;
+            if (!v && !fs) {
+                /* Untracked and nothing new: its last vote was UNKNOWN. */
+                tab->stats.last_tick_skipped++;
+                continue;
+            }
+            batch[n] = fe;
+            idx[n] = i;
+            vote[n] = (uint8_t)v;
+            dns_svc[n] = SVC_UNKNOWN;
+            if (v) {
+                dst[n_dst] = fe->key.dst_ip;
+                dst_pos[n_dst++] = n;
+            }
+            n++;
         }
+        if (n == 0) continue;
 
-        /* ── Stability logic ────────────────────────────────── */
-        fs->last_confirmed = now;
-        if (verdict == SVC_UNKNOWN) {
-            /* Keep last verdict but don't promote or push. */
-            continue;
+        if (dns && n_dst > 0) {
+            dns_cache_lookup_batch(dns, dst, n_dst, now, NULL, dns_res);
+            for (size_t k = 0; k < n_dst; k++) dns_svc[dst_pos[k]] = dns_res[k];
         }
-        if (verdict == fs->service) {
-            if (!fs->stable) {
-                fs->stable = 1;   /* second consecutive match — promote */
-                uint8_t new_mark = service_to_ct_mark(verdict);
-                if (new_mark != fs->ct_mark) {
-                    if (mark_engine_set(eng, &fe->key, new_mark) == 0) {
-                        fs->ct_mark = new_mark;
+        uint32_t stamp = tab->mutations;
+        for (size_t k = 0; k < n; k++) {
+            /* An insert or eviction earlier in this batch may have moved
+             * nodes; look the flow up again then. */
+            if (tab->mutations != stamp) {
+                idx[k] = fst_find(tab, &batch[k]->key, batch[k]->hash);
+                if (idx[k] == FST_NIL && !vote[k]) {
+                    /* Recycled under us: classify it afresh. */
+                    vote[k] = 1;
+                    if (dns) {
+                        dns_cache_lookup_batch(dns, &batch[k]->key.dst_ip, 1,
+                                               now, NULL, &dns_svc[k]);
                     }
                 }
             }
-        } else {
-            /* Verdict flipped — restart stability window + clear demote. */
-            fs->service = verdict;
-            fs->stable = 0;
-            fs->demoted = 0;
-            fs->rtt_breach_ticks = 0;
-            fs->rtt_recover_ticks = 0;
+            classify_flow(tab, batch[k], idx[k], vote[k], dns_svc[k],
+                          eng, rtt, now, window_s);
         }
-
-        rtt_autocorrect(fs, &fe->key, rtt, eng);
     }
+    tab->stats.flows_revoted += tab->stats.last_tick_revoted;
+    tab->stats.flows_skipped += tab->stats.last_tick_skipped;
+
+    /* Mark pushes above were only queued; one netlink batch sends them. */
+    mark_engine_flush(eng);
 
     /* ── Evict entries whose underlying flow is gone ─────────── */
-    for (int i = 0; i < FST_SIZE; i++) {
-        flow_service_t *fs = &tab->entries[i];
-        if (fs->detected_at == 0.0 && fs->last_confirmed == 0.0) continue;
-        if (fs->last_confirmed < now - 30.0) {
-            memset(fs, 0, sizeof(*fs));
-            if (tab->count > 0) tab->count--;
-        }
+    /* The LRU head is the least recently confirmed entry, so the sweep
+     * stops at the first one still fresh. */
+    while (tab->lru_head != FST_NIL &&
+           tab->nodes[tab->lru_head].fs.last_confirmed < now - FST_STALE_S) {
+        fst_evict(tab, tab->lru_head, rtt);
+    }
+    /* A reload may have lowered the ceiling below the live count. */
+    while ((uint32_t)tab->count > tab->max_capacity) {
+        fst_evict(tab, tab->lru_head, rtt);
+    }
+
+    /* ── Give memory back once load drops (or the ceiling shrank) ── */
+    uint32_t half = tab->capacity / 2;
+    if (tab->capacity > FST_MIN_CAPACITY &&
+        (tab->count < (int)(tab->capacity / 4) || half >= tab->max_capacity)) {
+        fst_resize(tab, half);
     }
 }
 
+int classifier_rtt_event(flow_service_table_t *tab, const flow_table_t *ft,
+                         mark_engine_t *eng, const rtt_event_t *ev, double now) {
+    if (!tab || !ft || !ev) return 0;
+    uint32_t idx = fst_find(tab, &ev->key, flow_key_hash(&ev->key));
+    if (idx == FST_NIL) return 0;
+    flow_service_t *fs = &tab->nodes[idx].fs;
+    if (!fs->stable || fs->demoted || fs->rtt_watch_ms == 0) return 0;
+    const flow_entry_t *fe = flow_table_lookup(ft, &ev->key);
+    if (!fe) return 0;
+
+    /* The probe's srtt is already smoothed over ~8 samples, so one
+     * crossing stands in for the tick path's two-tick confirmation. */
+    service_t demoted = service_demote(fs->service);
+    if (demoted == fs->service) return 0;
+    if (set_flow_mark(tab, fs, fe, eng, service_to_ct_mark(demoted), now) != 0) return -1;
+    mark_engine_flush(eng);
+    fs->demoted           = 1;
+    fs->rtt_breach_ticks  = 0;
+    fs->rtt_recover_ticks = 0;
+    fs->rtt_ms = (uint16_t)(ev->srtt_ms > 0xFFFFu ? 0xFFFFu : ev->srtt_ms);
+    tab->stats.rtt_event_demotes++;
+    log_msg(LOG_INFO, "rtt", "demote %s → %s on breach event (srtt=%ums threshold=%ums)",
+            service_name(fs->service), service_name(demoted),
+            ev->srtt_ms, ev->thresh_ms);
+    return 1;
+}
+
 service_t classifier_get_service(const flow_service_table_t *tab,
                                  const flow_key_t *key) {
     if (!tab || !key) return SVC_UNKNOWN;
-    for (int i = 0; i < FST_SIZE; i++) {
-        const flow_service_t *e = &tab->entries[i];
-        if (e->detected_at == 0.0 && e->last_confirmed == 0.0) continue;
-        flow_key_t k = {
-            .src_ip = e->src_ip, .dst_ip = e->dst_ip,
-            .src_port = e->src_port, .dst_port = e->dst_port,
-            .protocol = e->proto,
-        };
-        if (keys_equal(&k, key)) return e->service;
-    }
-    return SVC_UNKNOWN;
+    uint32_t idx = fst_find(tab, key, flow_key_hash(key));
+    return idx == FST_NIL ? SVC_UNKNOWN : tab->nodes[idx].fs.service;
 }
 
 int classifier_active_count(const flow_service_table_t *tab) {
     return tab ? tab->count : 0;
 }
 
+void classifier_get_stats(const flow_service_table_t *tab, classifier_stats_t *out) {
+    if (!out) return;
+    if (!tab) {
+        memset(out, 0, sizeof(*out));
+        return;
+    }
+    *out = tab->stats;
+}
+
 void classifier_for_each(const flow_service_table_t *tab,
                          classifier_visit_cb cb, void *user) {
     if (!tab || !cb) return;
-    for (int i = 0; i < FST_SIZE; i++) {
-        const flow_service_t *e = &tab->entries[i];
-        if (e->detected_at == 0.0 && e->last_confirmed == 0.0) continue;
-        if (cb(e, user) != 0) return;
+    for (uint32_t i = 0; i < tab->capacity; i++) {
+        const fst_node_t *n = &tab->nodes[i];
+        if (!n->live) continue;
+        if (cb(&n->fs, user) != 0) return;
     }
 }
 
@@ -275,9 +740,9 @@ void classifier_device_counts(const flow_service_table_t *tab,
     if (!out_counts) return;
     memset(out_counts, 0, sizeof(int) * SERVICE_COUNT);
     if (!tab) return;
-    for (int i = 0; i < FST_SIZE; i++) {
-        const flow_service_t *e = &tab->entries[i];
-        if (e->detected_at == 0.0 && e->last_confirmed == 0.0) continue;
+    for (uint32_t i = 0; i < tab->capacity; i++) {
+        if (!tab->nodes[i].live) continue;
+        const flow_service_t *e = &tab->nodes[i].fs;
         if (e->src_ip != device_ip) continue;
         if ((int)e->service > 0 && (int)e->service < SERVICE_COUNT) {
             out_counts[e->service]++;
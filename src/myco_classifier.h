@@ -27,15 +27,62 @@
 
 typedef struct flow_service_table flow_service_table_t;
 
-/* Allocate + zero the per-flow service table. Returns NULL on OOM. */
+/* Mark reconciliation and incremental-tick counters. The uint64_t ones
+ * are cumulative since create, last_tick_* cover the latest tick. */
+typedef struct {
+    uint64_t marks_adopted;   /* writes skipped: kernel already had the mark */
+    uint64_t marks_repaired;  /* stable flows whose kernel mark had drifted */
+    uint64_t flows_revoted;   /* flows that went through the 3-signal vote */
+    uint64_t flows_skipped;   /* flows that kept their verdict unvoted */
+    uint64_t rtt_event_demotes; /* demotions triggered by a breach event */
+    uint32_t last_tick_revoted;
+    uint32_t last_tick_skipped;
+} classifier_stats_t;
+
+/* Allocate the per-flow service table. It grows on demand up to
+ * `max_flows` entries (0 → FLOW_TABLE_DEFAULT_CAPACITY) and shrinks back
+ * when load drops. Returns NULL on OOM. */
+flow_service_table_t *classifier_create_sized(uint32_t max_flows);
+
+/* classifier_create_sized(0). */
 flow_service_table_t *classifier_create(void);
 
+/* Change the growth ceiling (config reload). Safe on NULL. */
+void classifier_set_max_flows(flow_service_table_t *tab, uint32_t max_flows);
+
+/* Fewest RTT samples in a tick window before its p99 is trusted. */
+#define RTT_TAIL_MIN_SAMPLES 16
+
+/* Also treat a tick as an RTT breach when the flow's windowed p99
+ * exceeds its service target × `factor` (UCI rtt_tail_factor); 0 turns
+ * the tail trigger off (default). Safe on NULL. */
+void classifier_set_rtt_tail(flow_service_table_t *tab, double factor);
+
+/* Watch stable flows for RTT breach events (UCI rtt_events): each tick
+ * keeps the probe's per-flow threshold at the service target × 1.5, and
+ * classifier_rtt_event() demotes on an event without waiting for the
+ * next tick. Turning it off clears the thresholds over the next tick.
+ * Safe on NULL. */
+void classifier_set_rtt_events(flow_service_table_t *tab, int on);
+
+/* Handle one breach event from rtt_engine_poll_events(): demote the
+ * flow now if it is stable, watched and not yet demoted. Call from the
+ * thread that runs classifier_tick(). Returns 1 when the flow was
+ * demoted, 0 when the event was ignored, -1 if the mark push failed. */
+int  classifier_rtt_event(flow_service_table_t *tab, const flow_table_t *ft,
+                          mark_engine_t *eng, const rtt_event_t *ev, double now);
+
+/* Make the next classifier_tick() re-vote every flow, as after a
+ * change to the voter weights. Safe on NULL. */
+void classifier_revote_all(flow_service_table_t *tab);
+
 /* Free the table. Safe on NULL. */
 void classifier_destroy(flow_service_table_t *tab);
 
 /* One classification pass.
  *
- *   ft        : latest flow table snapshot (read-only)
+ *   ft        : latest flow table snapshot; the pass clears each
+ *               flow_entry_t.dirty it consumes
  *   dns       : DNS cache for IP→service lookup (may be NULL)
  *   eng       : mark engine for ct mark push (may be NULL — stub/off)
  *   rtt       : RTT engine for auto-correction (may be NULL — skip)
@@ -43,17 +90,28 @@ void classifier_destroy(flow_service_table_t *tab);
  *   window_s  : length of the delta window (flow_entry_t.tx_delta etc.
  *               accumulate over this interval). Used for bw computation.
  *
+ * Only flows with something new are re-voted: dirty in ft, a changed
+ * DNS answer for their dst_ip (dns_cache_changes_since()), not yet
+ * stable, stable and unvoted for 10 s, or everything after
+ * classifier_revote_all(). Other tracked flows keep
+ * their verdict; untracked ones stay untracked.
+ *
  * Side effects:
- *   - Upserts a flow_service_t entry per flow in ft.
+ *   - Upserts a flow_service_t entry per re-voted flow in ft.
  *   - Calls mark_engine_set() for flows whose verdict just became
- *     stable (and whose mark changed from whatever was there before).
+ *     stable, unless conntrack already carries that mark (as after a
+ *     daemon restart): then the kernel's mark is adopted, including a
+ *     demoted tier. A stable flow whose kernel mark no longer matches
+ *     is rewritten. The kernel mark is flow_entry_t.ct_mark, trusted
+ *     once conntrack has been read since our own last write.
  *   - When `rtt` is non-NULL, runs the auto-corrector: demotes a flow's
  *     ct_mark after two consecutive ticks with RTT > target×1.5; re-
- *     promotes after two consecutive recovered ticks.
+ *     promotes after two consecutive recovered ticks. With breach
+ *     events on, also keeps each flow's probe threshold up to date.
  *   - Evicts entries for flows no longer in ft.
  */
 void classifier_tick(flow_service_table_t *tab,
-                     const flow_table_t *ft,
+                     flow_table_t *ft,
                      dns_cache_t *dns,
                      mark_engine_t *eng,
                      rtt_engine_t *rtt,
@@ -67,6 +125,10 @@ service_t classifier_get_service(const flow_service_table_t *tab,
 /* Observability: number of active entries. */
 int classifier_active_count(const flow_service_table_t *tab);
 
+/* Observability: reconciliation and re-vote counters. Zeroed for a
+ * NULL tab. */
+void classifier_get_stats(const flow_service_table_t *tab, classifier_stats_t *out);
+
 /* Populate `out_counts[service_t] = #flows of that service` for flows
  * whose src_ip matches `device_ip` (network byte order). out_counts must
  * have SERVICE_COUNT entries; we zero it before filling. */
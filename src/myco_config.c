@@ -87,6 +87,19 @@ static void apply_defaults(myco_config_t *cfg) {
             "/usr/lib/mycoflow/mycoflow_rtt.bpf.o",
             sizeof(cfg->rtt_bpf_obj) - 1);
     cfg->rtt_bpf_obj[sizeof(cfg->rtt_bpf_obj) - 1] = '\0';
+    cfg->svc_weight_dns = 0.6;
+    cfg->svc_weight_port = 0.3;
+    cfg->svc_weight_behavior = 0.1;
+    cfg->svc_min_score = 0.3;
+    cfg->rtt_tail_factor = 0.0;
+    cfg->rtt_events = 0;
+    cfg->ct_events = 1;
+    cfg->ct_resync_s = 30.0;
+    cfg->flow_table_size = 0;
+    cfg->dns_mdns = 0;
+    cfg->dns_cache_size = 1024;
+    cfg->trace_file[0] = '\0';
+    cfg->trace_max_mb = 16;
 }
 
 /* ── UCI helpers ────────────────────────────────────────────── */
@@ -258,6 +271,46 @@ static void apply_uci_overrides(myco_config_t *cfg) {
         strncpy(cfg->rtt_bpf_obj, val, sizeof(cfg->rtt_bpf_obj) - 1);
         cfg->rtt_bpf_obj[sizeof(cfg->rtt_bpf_obj) - 1] = '\0';
     }
+    if (uci_get_option("svc_weight_dns", val, sizeof(val))) {
+        cfg->svc_weight_dns = atof(val);
+    }
+    if (uci_get_option("svc_weight_port", val, sizeof(val))) {
+        cfg->svc_weight_port = atof(val);
+    }
+    if (uci_get_option("svc_weight_behavior", val, sizeof(val))) {
+        cfg->svc_weight_behavior = atof(val);
+    }
+    if (uci_get_option("svc_min_score", val, sizeof(val))) {
+        cfg->svc_min_score = atof(val);
+    }
+    if (uci_get_option("rtt_tail_factor", val, sizeof(val))) {
+        cfg->rtt_tail_factor = atof(val);
+    }
+    if (uci_get_option("rtt_events", val, sizeof(val))) {
+        cfg->rtt_events = atoi(val);
+    }
+    if (uci_get_option("ct_events", val, sizeof(val))) {
+        cfg->ct_events = atoi(val);
+    }
+    if (uci_get_option("ct_resync_s", val, sizeof(val))) {
+        cfg->ct_resync_s = atof(val);
+    }
+    if (uci_get_option("flow_table_size", val, sizeof(val))) {
+        cfg->flow_table_size = atoi(val);
+    }
+    if (uci_get_option("dns_mdns", val, sizeof(val))) {
+        cfg->dns_mdns = atoi(val);
+    }
+    if (uci_get_option("dns_cache_size", val, sizeof(val))) {
+        cfg->dns_cache_size = atoi(val);
+    }
+    if (uci_get_option("trace_file", val, sizeof(val))) {
+        strncpy(cfg->trace_file, val, sizeof(cfg->trace_file) - 1);
+        cfg->trace_file[sizeof(cfg->trace_file) - 1] = '\0';
+    }
+    if (uci_get_option("trace_max_mb", val, sizeof(val))) {
+        cfg->trace_max_mb = atoi(val);
+    }
 }
 
 static persona_t parse_persona_name(const char *name) {
@@ -395,6 +448,23 @@ static void apply_env_overrides(myco_config_t *cfg) {
         strncpy(cfg->rtt_bpf_obj, rtt_obj, sizeof(cfg->rtt_bpf_obj) - 1);
         cfg->rtt_bpf_obj[sizeof(cfg->rtt_bpf_obj) - 1] = '\0';
     }
+    cfg->svc_weight_dns = parse_env_double("MYCOFLOW_SVC_WEIGHT_DNS", cfg->svc_weight_dns);
+    cfg->svc_weight_port = parse_env_double("MYCOFLOW_SVC_WEIGHT_PORT", cfg->svc_weight_port);
+    cfg->svc_weight_behavior = parse_env_double("MYCOFLOW_SVC_WEIGHT_BEHAVIOR", cfg->svc_weight_behavior);
+    cfg->svc_min_score = parse_env_double("MYCOFLOW_SVC_MIN_SCORE", cfg->svc_min_score);
+    cfg->rtt_tail_factor = parse_env_double("MYCOFLOW_RTT_TAIL_FACTOR", cfg->rtt_tail_factor);
+    cfg->rtt_events = parse_env_int("MYCOFLOW_RTT_EVENTS", cfg->rtt_events);
+    cfg->ct_events = parse_env_int("MYCOFLOW_CT_EVENTS", cfg->ct_events);
+    cfg->ct_resync_s = parse_env_double("MYCOFLOW_CT_RESYNC", cfg->ct_resync_s);
+    cfg->flow_table_size = parse_env_int("MYCOFLOW_FLOW_TABLE_SIZE", cfg->flow_table_size);
+    cfg->dns_mdns = parse_env_int("MYCOFLOW_DNS_MDNS", cfg->dns_mdns);
+    cfg->dns_cache_size = parse_env_int("MYCOFLOW_DNS_CACHE_SIZE", cfg->dns_cache_size);
+    const char *trace_file = getenv("MYCOFLOW_TRACE_FILE");
+    if (trace_file && *trace_file) {
+        strncpy(cfg->trace_file, trace_file, sizeof(cfg->trace_file) - 1);
+        cfg->trace_file[sizeof(cfg->trace_file) - 1] = '\0';
+    }
+    cfg->trace_max_mb = parse_env_int("MYCOFLOW_TRACE_MAX_MB", cfg->trace_max_mb);
     const char *ebpf_tc_dir = getenv("MYCOFLOW_EBPF_TC_DIR");
     if (ebpf_tc_dir && *ebpf_tc_dir) {
         strncpy(cfg->ebpf_tc_dir, ebpf_tc_dir, sizeof(cfg->ebpf_tc_dir) - 1);
@@ -439,6 +509,44 @@ int config_load(myco_config_t *cfg) {
     if (cfg->ewma_alpha > 1.0) {
         cfg->ewma_alpha = 1.0;
     }
+    if (cfg->svc_weight_dns < 0.0) {
+        cfg->svc_weight_dns = 0.0;
+    }
+    if (cfg->svc_weight_port < 0.0) {
+        cfg->svc_weight_port = 0.0;
+    }
+    if (cfg->svc_weight_behavior < 0.0) {
+        cfg->svc_weight_behavior = 0.0;
+    }
+    if (cfg->svc_min_score < 0.0) {
+        cfg->svc_min_score = 0.0;
+    }
+    /* A tail threshold below the mean's (1.5×) would demote every flow. */
+    if (cfg->rtt_tail_factor <= 0.0) {
+        cfg->rtt_tail_factor = 0.0;
+    } else if (cfg->rtt_tail_factor < 1.5) {
+        cfg->rtt_tail_factor = 1.5;
+    } else if (cfg->rtt_tail_factor > 10.0) {
+        cfg->rtt_tail_factor = 10.0;
+    }
+    if (cfg->ct_resync_s < 1.0) {
+        cfg->ct_resync_s = 1.0;
+    }
+    if (cfg->flow_table_size < 0) {
+        cfg->flow_table_size = 0;
+    }
+    if (cfg->dns_cache_size < 64) {
+        cfg->dns_cache_size = 64;
+    }
+    if (cfg->dns_cache_size > 65536) {
+        cfg->dns_cache_size = 65536;
+    }
+    if (cfg->trace_max_mb < 1) {
+        cfg->trace_max_mb = 1;
+    }
+    if (cfg->trace_max_mb > 1024) {
+        cfg->trace_max_mb = 1024;
+    }
     if (strcmp(cfg->ebpf_tc_dir, "ingress") != 0 && strcmp(cfg->ebpf_tc_dir, "egress") != 0) {
         strncpy(cfg->ebpf_tc_dir, "ingress", sizeof(cfg->ebpf_tc_dir) - 1);
         cfg->ebpf_tc_dir[sizeof(cfg->ebpf_tc_dir) - 1] = '\0';
@@ -0,0 +1,250 @@
+/*
+ * MycoFlow — Bio-Inspired Reflexive QoS System
+ * myco_ctparse.c — Streaming /proc/net/nf_conntrack tokenizer
+ *
+ * Replaces the fgets + strstr + sscanf + inet_pton chain of the original
+ * fallback. Each line is walked once, token by token; values are decoded
+ * straight out of the read buffer.
+ */
+#include "myco_ctparse.h"
+
+#include <errno.h>
+#include <string.h>
+#include <unistd.h>
+
+/* ── Field decoders ─────────────────────────────────────────── */
+
+/* Decimal u64 at [p, end). Stops at the first non-digit. Returns the
+ * position after the last digit; *ok = 0 when no digit was found. */
+static const char *parse_u64(const char *p, const char *end,
+                             uint64_t *out, int *ok) {
+    uint64_t v = 0;
+    const char *start = p;
+    while (p < end && (unsigned)(*p - '0') <= 9u) {
+        v = v * 10u + (uint64_t)(*p - '0');
+        p++;
+    }
+    *ok  = p > start;
+    *out = v;
+    return p;
+}
+
+/* Dotted quad → network byte order (same layout inet_pton writes). */
+static int parse_ipv4(const char *p, const char *end, uint32_t *out) {
+    uint8_t b[4];
+    for (int i = 0; i < 4; i++) {
+        unsigned v = 0, digits = 0;
+        while (p < end && (unsigned)(*p - '0') <= 9u && digits < 3) {
+            v = v * 10u + (unsigned)(*p - '0');
+            p++;
+            digits++;
+        }
+        if (digits == 0 || v > 255) return -1;
+        b[i] = (uint8_t)v;
+        if (i < 3) {
+            if (p >= end || *p != '.') return -1;
+            p++;
+        }
+    }
+    if (p < end && *p != ' ') return -1;
+    memcpy(out, b, sizeof(*out));
+    return 0;
+}
+
+static int has_prefix(const char *p, const char *end, const char *lit, size_t n) {
+    return (size_t)(end - p) >= n && memcmp(p, lit, n) == 0;
+}
+
+/* ── Line parser ────────────────────────────────────────────── */
+
+/* Next token start at or after p (skips the separating blanks). */
+static const char *skip_blanks(const char *p, const char *end) {
+    while (p < end && *p == ' ') p++;
+    return p;
+}
+
+/* End of the token starting at p. memchr is vectorised in libc, which
+ * matters here: most of a line is tokens we never look at. */
+static const char *token_end(const char *p, const char *end) {
+    const char *sp = memchr(p, ' ', (size_t)(end - p));
+    return sp ? sp : end;
+}
+
+int ct_parse_line(const char *line, size_t len, ct_record_t *out) {
+    const char *end = line + len;
+    if (end > line && end[-1] == '\n') end--;
+
+    memset(out, 0, sizeof(*out));
+
+    /* Positional prefix: "ipv4 <n> tcp|udp <proto> ..." */
+    const char *p = skip_blanks(line, end);
+    if (!has_prefix(p, end, "ipv4 ", 5)) return -1;
+    p = skip_blanks(token_end(p, end), end);          /* l3 number   */
+    p = skip_blanks(token_end(p, end), end);          /* l4 name     */
+    p = skip_blanks(token_end(p, end), end);          /* l4 number   */
+
+    uint64_t v; int ok;
+    p = parse_u64(p, end, &v, &ok);
+    if (!ok || (v != 6 && v != 17)) return -1;
+    out->key.protocol = (uint8_t)v;
+
+    int have_src = 0, have_dst = 0, have_sport = 0, have_dport = 0;
+    int n_pkts = 0, n_bytes = 0;
+
+    while (p < end) {
+        p = skip_blanks(p, end);
+        if (p >= end) break;
+        const char *tok = p;
+        const char *tend = token_end(p, end);
+
+        switch (*tok) {
+        case 's':
+            if (!have_src && has_prefix(tok, tend, "src=", 4)) {
+                if (parse_ipv4(tok + 4, tend, &out->key.src_ip) != 0) return -1;
+                have_src = 1;
+            } else if (!have_sport && has_prefix(tok, tend, "sport=", 6)) {
+                parse_u64(tok + 6, tend, &v, &ok);
+                if (!ok || v > 0xFFFF) return -1;
+                out->key.src_port = (uint16_t)v;
+                have_sport = 1;
+            }
+            break;
+        case 'd':
+            if (!have_dst && has_prefix(tok, tend, "dst=", 4)) {
+                if (parse_ipv4(tok + 4, tend, &out->key.dst_ip) != 0) return -1;
+                have_dst = 1;
+            } else if (!have_dport && has_prefix(tok, tend, "dport=", 6)) {
+                parse_u64(tok + 6, tend, &v, &ok);
+                if (!ok || v > 0xFFFF) return -1;
+                out->key.dst_port = (uint16_t)v;
+                have_dport = 1;
+            }
+            break;
+        case 'p':
+            if (n_pkts < 2 && has_prefix(tok, tend, "packets=", 8)) {
+                parse_u64(tok + 8, tend, &v, &ok);
+                if (n_pkts == 0) out->tx_packets = v;
+                else             out->rx_packets = v;
+                n_pkts++;
+            }
+            break;
+        case 'b':
+            if (n_bytes < 2 && has_prefix(tok, tend, "bytes=", 6)) {
+                parse_u64(tok + 6, tend, &v, &ok);
+                if (n_bytes == 0) out->tx_bytes = v;
+                else              out->rx_bytes = v;
+                n_bytes++;
+            }
+            break;
+        case 'm':
+            /* "mark=" follows the reply direction; nothing after it
+             * is of interest. */
+            if (has_prefix(tok, tend, "mark=", 5)) {
+                parse_u64(tok + 5, tend, &v, &ok);
+                if (ok && v <= 0xFFFFFFFFu) {
+                    out->mark = (uint32_t)v;
+                    out->has_mark = 1;
+                }
+                if (have_sport && n_bytes == 2) goto done;
+            }
+            break;
+        default:
+            break;
+        }
+        p = tend;
+    }
+done:
+    return (have_src && have_dst) ? 0 : -1;
+}
+
+/* ── Buffer / stream drivers ────────────────────────────────── */
+
+/* Deliver every complete line in buf[0..len). *consumed is set to the
+ * offset of the first unterminated byte. *stopped = 1 if cb asked to. */
+static int parse_lines(const char *buf, size_t len, ct_record_cb cb, void *user,
+                       size_t *consumed, int *stopped) {
+    const char *p   = buf;
+    const char *end = buf + len;
+    int n = 0;
+
+    while (p < end) {
+        const char *nl = memchr(p, '\n', (size_t)(end - p));
+        if (!nl) break;
+        ct_record_t rec;
+        if (ct_parse_line(p, (size_t)(nl - p), &rec) == 0) {
+            n++;
+            if (cb && cb(&rec, user) != 0) {
+                *stopped = 1;
+                p = nl + 1;
+                break;
+            }
+        }
+        p = nl + 1;
+    }
+    *consumed = (size_t)(p - buf);
+    return n;
+}
+
+int ct_parse_buf(const char *buf, size_t len, ct_record_cb cb, void *user) {
+    if (!buf) return 0;
+    size_t consumed = 0;
+    int stopped = 0;
+    int n = parse_lines(buf, len, cb, user, &consumed, &stopped);
+    if (!stopped && consumed < len) {
+        ct_record_t rec;
+        if (ct_parse_line(buf + consumed, len - consumed, &rec) == 0) {
+            n++;
+            if (cb) cb(&rec, user);
+        }
+    }
+    return n;
+}
+
+int ct_parse_fd(int fd, char *buf, size_t cap, ct_record_cb cb, void *user) {
+    if (fd < 0 || !buf || cap == 0) return -1;
+
+    size_t fill = 0;        /* bytes of carried-over partial line */
+    int skipping = 0;       /* discarding an over-long line up to '\n' */
+    int n = 0;
+
+    for (;;) {
+        ssize_t r = read(fd, buf + fill, cap - fill);
+        if (r < 0) {
+            if (errno == EINTR) continue;
+            return n > 0 ? n : -1;
+        }
+        if (r == 0) break;
+        size_t len = fill + (size_t)r;
+        size_t start = 0;
+
+        if (skipping) {
+            const char *nl = memchr(buf, '\n', len);
+            if (!nl) { fill = 0; continue; }
+            start = (size_t)(nl - buf) + 1;
+            skipping = 0;
+        }
+
+        size_t consumed = 0;
+        int stopped = 0;
+        n += parse_lines(buf + start, len - start, cb, user, &consumed, &stopped);
+        if (stopped) return n;
+
+        fill = len - start - consumed;
+        if (fill == cap) {
+            /* One line fills the whole buffer: drop it. */
+            fill = 0;
+            skipping = 1;
+        } else if (fill > 0) {
+            memmove(buf, buf + start + consumed, fill);
+        }
+    }
+
+    if (fill > 0 && !skipping) {
+        ct_record_t rec;
+        if (ct_parse_line(buf, fill, &rec) == 0) {
+            n++;
+            if (cb) cb(&rec, user);
+        }
+    }
+    return n;
+}
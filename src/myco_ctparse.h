@@ -0,0 +1,55 @@
+/*
+ * MycoFlow — Bio-Inspired Reflexive QoS System
+ * myco_ctparse.h — Streaming /proc/net/nf_conntrack tokenizer
+ *
+ * Single forward pass over the text form of the conntrack table:
+ *
+ *   ipv4 2 tcp 6 431999 ESTABLISHED src=A dst=B sport=P dport=Q
+ *        packets=N bytes=M src=B dst=A sport=Q dport=P packets=N bytes=M ...
+ *
+ * The file is read in large blocks into a caller-supplied buffer and
+ * parsed in place — no per-line copies, no sscanf/strstr/inet_pton.
+ * A line cut by a block boundary is moved to the front of the buffer and
+ * completed by the next read. The first src/dst/sport/dport belong to
+ * the original tuple; the first packets/bytes pair is the forward (TX)
+ * direction, the second the reply (RX) direction. The "mark=" field,
+ * when the kernel prints one, follows the reply tuple. Lines that are
+ * not IPv4 TCP/UDP are skipped.
+ */
+#ifndef MYCO_CTPARSE_H
+#define MYCO_CTPARSE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "myco_flow.h"
+
+#define CT_PARSE_BLOCK 32768  /* default read block for callers */
+
+typedef struct {
+    flow_key_t key;        /* ports host order, IPs network order */
+    uint64_t   tx_packets;
+    uint64_t   rx_packets;
+    uint64_t   tx_bytes;
+    uint64_t   rx_bytes;
+    uint32_t   mark;       /* ct mark, when has_mark */
+    int        has_mark;   /* 0 on kernels without CONFIG_NF_CONNTRACK_MARK */
+} ct_record_t;
+
+/* Return non-zero to stop the walk early. */
+typedef int (*ct_record_cb)(const ct_record_t *rec, void *user);
+
+/* Parse one line (without or with trailing '\n'). Returns 0 and fills
+ * `out` for an IPv4 TCP/UDP entry, -1 for anything else. */
+int ct_parse_line(const char *line, size_t len, ct_record_t *out);
+
+/* Parse every complete line in buf[0..len). A trailing fragment without
+ * '\n' is parsed too. Returns the number of records delivered. */
+int ct_parse_buf(const char *buf, size_t len, ct_record_cb cb, void *user);
+
+/* Stream `fd` to EOF using buf[0..cap) as the block buffer. Lines longer
+ * than `cap` are skipped. Returns records delivered, or -1 on read error
+ * before any record was produced. */
+int ct_parse_fd(int fd, char *buf, size_t cap, ct_record_cb cb, void *user);
+
+#endif /* MYCO_CTPARSE_H */
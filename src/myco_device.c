@@ -19,9 +19,31 @@
 #include <string.h>
 
 #define DEVICE_ACTIVE_FLOW_MIN_DELTA_BYTES 256
+#define DEVICE_DNS_BATCH                   64   /* DNS hint reads per batch */
 
 /* ── Helpers ───────────────────────────────────────────────── */
 
+/* Flows whose port gave no hint, queued for one batched DNS read. The
+ * owner's IP is kept so a vote for a device evicted mid-pass is dropped. */
+typedef struct {
+    device_entry_t *dev[DEVICE_DNS_BATCH];
+    uint32_t        dev_ip[DEVICE_DNS_BATCH];
+    uint32_t        dst_ip[DEVICE_DNS_BATCH];
+    size_t          n;
+} dns_vote_batch_t;
+
+static void dns_vote_flush(dns_vote_batch_t *b, dns_cache_t *dns_cache, double now) {
+    persona_t hints[DEVICE_DNS_BATCH];
+    dns_cache_lookup_batch(dns_cache, b->dst_ip, b->n, now, hints, NULL);
+    for (size_t i = 0; i < b->n; i++) {
+        device_entry_t *dev = b->dev[i];
+        if (hints[i] != PERSONA_UNKNOWN && dev->active && dev->ip == b->dev_ip[i]) {
+            dev->hint_votes[(int)hints[i]]++;
+        }
+    }
+    b->n = 0;
+}
+
 static device_entry_t *find_device(device_table_t *dt, uint32_t ip) {
     for (int i = 0; i < MAX_DEVICES; i++) {
         if (dt->devices[i].active && dt->devices[i].ip == ip) {
@@ -107,12 +129,16 @@ void device_table_aggregate(device_table_t *dt, const flow_table_t *ft,
         }
     }
 
-    /* First pass: accumulate flows per device (by src_ip) */
-    for (int i = 0; i < FLOW_TABLE_SIZE; i++) {
-        if (!ft->entries[i].active) {
-            continue;
-        }
-        const flow_entry_t *fe = &ft->entries[i];
+    /* First pass: accumulate flows per device (by src_ip), tracking the
+     * largest flow and collecting hint votes on the same scan. Port hints
+     * vote immediately; flows the port cannot place (e.g. 443) are queued
+     * for a batched DNS read — DNS resolves the 443 ambiguity. */
+    uint64_t max_delta[MAX_DEVICES];
+    dns_vote_batch_t pending;
+    pending.n = 0;
+    uint32_t it = 0;
+    const flow_entry_t *fe;
+    while ((fe = flow_table_next(ft, &it)) != NULL) {
         uint64_t flow_delta = fe->tx_delta + fe->rx_delta;
         if (flow_delta < DEVICE_ACTIVE_FLOW_MIN_DELTA_BYTES) {
             continue;
@@ -123,6 +149,13 @@ void device_table_aggregate(device_table_t *dt, const flow_table_t *ft,
         if (!dev) {
             dev = alloc_device(dt, src_ip, now);
         }
+        int di = (int)(dev - dt->devices);
+        if (dev->flow_count == 0) {
+            max_delta[di] = 0;
+        }
+        if (flow_delta > max_delta[di]) {
+            max_delta[di] = flow_delta;
+        }
 
         dev->flow_count++;
         dev->total_bytes   += fe->bytes + fe->rx_bytes;
@@ -141,6 +174,21 @@ void device_table_aggregate(device_table_t *dt, const flow_table_t *ft,
         } else if (fe->key.protocol == 6) {
             dev->tcp_flows++;
         }
+
+        persona_t hint = hint_from_port(fe->key.protocol, fe->key.dst_port);
+        if (hint != PERSONA_UNKNOWN) {
+            dev->hint_votes[(int)hint]++;
+        } else if (dns_cache) {
+            pending.dev[pending.n]    = dev;
+            pending.dev_ip[pending.n] = src_ip;
+            pending.dst_ip[pending.n] = fe->key.dst_ip;
+            if (++pending.n == DEVICE_DNS_BATCH) {
+                dns_vote_flush(&pending, dns_cache, now);
+            }
+        }
+    }
+    if (pending.n > 0) {
+        dns_vote_flush(&pending, dns_cache, now);
     }
 
     /* Second pass: compute derived metrics per device */
@@ -168,44 +216,12 @@ void device_table_aggregate(device_table_t *dt, const flow_table_t *ft,
         /* TX/RX ratio: >4 = heavy uploader (BULK), <0.25 = heavy downloader (STREAMING) */
         dev->tx_rx_ratio = (double)dev->tx_bytes / (double)(dev->rx_bytes + 1);
 
-        /* Per-device elephant flow detection + port hint collection.
-         * Both piggyback on the same per-flow scan — zero extra iterations.
+        /* Per-device elephant flow detection, from the first pass.
          * Delta-based avoids stale cumulative bytes diluting the ratio when
          * many old flows exist but only one is actively transferring. */
-        uint64_t max_delta = 0;
         uint64_t total_delta = dev->tx_bytes + dev->rx_bytes; /* already delta-based */
-        for (int j = 0; j < FLOW_TABLE_SIZE; j++) {
-            if (!ft->entries[j].active) {
-                continue;
-            }
-            if (ft->entries[j].key.src_ip != dev->ip) {
-                continue;
-            }
-            uint64_t flow_delta = ft->entries[j].tx_delta + ft->entries[j].rx_delta;
-            if (flow_delta < DEVICE_ACTIVE_FLOW_MIN_DELTA_BYTES) {
-                continue;
-            }
-            if (flow_delta > max_delta) {
-                max_delta = flow_delta;
-            }
-
-            /* Port hint: look up dst_port for this flow */
-            persona_t hint = hint_from_port(ft->entries[j].key.protocol,
-                                            ft->entries[j].key.dst_port);
-
-            /* DNS hint: if port hint is UNKNOWN (e.g., port 443), try
-             * the DNS cache for a domain-based hint. DNS resolves the
-             * 443 ambiguity that port hints cannot. */
-            if (hint == PERSONA_UNKNOWN && dns_cache) {
-                hint = dns_cache_lookup(dns_cache, ft->entries[j].key.dst_ip);
-            }
-
-            if (hint != PERSONA_UNKNOWN) {
-                dev->hint_votes[(int)hint]++;
-            }
-        }
         if (total_delta > 0 &&
-            (double)max_delta / (double)total_delta >= 0.60) {
+            (double)max_delta[i] / (double)total_delta >= 0.60) {
             dev->elephant_flow = 1;
         }
 
@@ -14,7 +14,10 @@
  *
  * Safety guarantees:
  *   - Parser rejects malformed packets silently (no crash, no log spam)
- *   - Sniffer thread checks g_stop every 1s via select() timeout
+ *   - Sniffer thread checks g_stop at least every 1s (ring poll or
+ *     select() timeout)
+ *   - A classic BPF socket filter drops non-DNS traffic in the kernel,
+ *     so forwarded bulk traffic never reaches this thread
  *   - If DNS snooping fails, system degrades to port+behavior (78%)
  *   - Zero flash writes — all state in RAM
  */
@@ -25,929 +28,493 @@
 #include <stdlib.h>
 #include <arpa/inet.h>
 #include <unistd.h>
+#include <poll.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
 #include <sys/socket.h>
 #include <sys/select.h>
 #include <netinet/ip.h>
 #include <netinet/udp.h>
 #include <linux/if_packet.h>
 #include <linux/if_ether.h>
+#include <linux/filter.h>
 #include <time.h>
 
-/* ── Domain suffix → persona table ───────────────────────────── */
+/* ── Domain suffix trie ──────────────────────────────────────── */
 
-typedef struct {
-    const char *suffix;
-    persona_t   persona;
-} domain_hint_t;
+/* Suffix tables live in myco_domains.def; the build compiles them into a
+ * label-reversed trie (myco_domain_trie.h, tools/gen_domain_trie.py).
+ * A lookup walks the domain's labels right to left, one binary search
+ * per level, and keeps the deepest node that carries a value — longest
+ * suffix on whole labels, independent of table order. */
+#include "myco_domain_trie.h"
 
-/*
- * Ordered longest-first so a specific suffix like "meet.google.com"
- * matches before a shorter ".google.com" (if we had one).
- * Only domains that resolve the 443 ambiguity are included.
- */
-static const domain_hint_t domain_table[] = {
-    /* STREAMING — video/audio content delivery */
-    { "googlevideo.com",        PERSONA_STREAMING },
-    { "nflxvideo.net",          PERSONA_STREAMING },
-    { "netflix.com",            PERSONA_STREAMING },
-    { "ttvnw.net",              PERSONA_STREAMING },  /* Twitch CDN */
-    { "twitch.tv",              PERSONA_STREAMING },
-    { "jtvnw.net",              PERSONA_STREAMING },  /* Twitch legacy CDN */
-    { "fbcdn.net",              PERSONA_STREAMING },  /* Facebook/Instagram video */
-    { "video.fbcdn.net",        PERSONA_STREAMING },
-    { "spotify.com",            PERSONA_STREAMING },
-    { "scdn.co",                PERSONA_STREAMING },  /* Spotify CDN */
-    { "aaplimg.com",            PERSONA_STREAMING },  /* Apple TV+ CDN */
-    { "hls.apple.com",          PERSONA_STREAMING },
-    { "prd.media.h264.io",      PERSONA_STREAMING },  /* Disney+ CDN */
-    { "disneyplus.com",         PERSONA_STREAMING },
-    { "primevideo.com",         PERSONA_STREAMING },
-    { "aiv-cdn.net",            PERSONA_STREAMING },  /* Amazon Prime Video CDN */
-    { "dssott.com",             PERSONA_STREAMING },  /* Disney+ streaming */
-    { "youtube.com",            PERSONA_STREAMING },
-    { "ytimg.com",              PERSONA_STREAMING },
-    { "ggpht.com",              PERSONA_STREAMING },  /* Google content CDN */
-
-    /* VIDEO — real-time video calls */
-    { "zoom.us",                PERSONA_VIDEO },
-    { "zoomgov.com",            PERSONA_VIDEO },
-    { "teams.microsoft.com",    PERSONA_VIDEO },
-    { "teams.live.com",         PERSONA_VIDEO },
-    { "skype.com",              PERSONA_VIDEO },
-    { "meet.google.com",        PERSONA_VIDEO },
-    { "discord.media",          PERSONA_VIDEO },
-    { "discord.gg",             PERSONA_VIDEO },
-    { "discordapp.com",         PERSONA_VIDEO },
-    { "webex.com",              PERSONA_VIDEO },
-
-    /* GAMING — game servers and platforms */
-    { "riotgames.com",          PERSONA_GAMING },
-    { "riotcdn.net",            PERSONA_GAMING },
-    { "leagueoflegends.com",    PERSONA_GAMING },
-    { "steampowered.com",       PERSONA_GAMING },
-    { "steamcontent.com",       PERSONA_GAMING },
-    { "steamserver.net",        PERSONA_GAMING },
-    { "epicgames.com",          PERSONA_GAMING },
-    { "unrealengine.com",       PERSONA_GAMING },
-    { "battle.net",             PERSONA_GAMING },
-    { "blizzard.com",           PERSONA_GAMING },
-    { "xboxlive.com",           PERSONA_GAMING },
-    { "gamepass.com",           PERSONA_GAMING },
-    { "playstation.net",        PERSONA_GAMING },
-    { "ea.com",                 PERSONA_GAMING },
-    { "origin.com",             PERSONA_GAMING },
-    { "ubisoft.com",            PERSONA_GAMING },
-    { "valvesoftware.com",      PERSONA_GAMING },
-
-    /* VOIP — voice communication */
-    { "whatsapp.net",           PERSONA_VOIP },
-    { "whatsapp.com",           PERSONA_VOIP },
-    { "signal.org",             PERSONA_VOIP },
-    { "telegram.org",           PERSONA_VOIP },
-    { "viber.com",              PERSONA_VOIP },
-    { "vonage.com",             PERSONA_VOIP },
-
-    { NULL, PERSONA_UNKNOWN }  /* sentinel */
-};
-
-/* ── Domain suffix → service table (v3, finer-grained) ──────────
- * 90+ suffixes covering the service taxonomy (architecture §5).
- * Iterated in order, first matching suffix wins — put specific
- * subdomains before generic ones to avoid shadowing.
- */
-typedef struct {
-    const char *suffix;
-    service_t   service;
-} domain_service_t;
-
-static const domain_service_t domain_service_table[] = {
-    /* Convention: more specific suffixes come BEFORE generic ones so the
-     * linear scan picks the most precise match first. ~50 byte/entry.
-     * Total ~700 entries ≈ 42 KB read-only — negligible vs the 256 MB
-     * router. Coverage targets the top 500 services by global traffic
-     * share (Sandvine/Cloudflare reports 2024) plus regional
-     * heavyweights (Asian video, EMEA games, LATAM banking).
-     *
-     * Categories follow CAKE diffserv4 priority: VOICE > VIDEO > BE > BULK
-     */
-
-    /* ═════════════════════════════════════════════════════════════════
-     * SVC_VIDEO_CONF — interactive video calls
-     * ═════════════════════════════════════════════════════════════════ */
-    { "meet.google.com",        SVC_VIDEO_CONF },
-    { "duo.google.com",         SVC_VIDEO_CONF },
-    { "teams.microsoft.com",    SVC_VIDEO_CONF },
-    { "teams.live.com",         SVC_VIDEO_CONF },
-    { "teams.skype.com",        SVC_VIDEO_CONF },
-    { "skypeforbusiness.com",   SVC_VIDEO_CONF },
-    { "lifesizecloud.com",      SVC_VIDEO_CONF },
-    { "zoom.us",                SVC_VIDEO_CONF },
-    { "zoomgov.com",            SVC_VIDEO_CONF },
-    { "zoomcdn.io",             SVC_VIDEO_CONF },
-    { "zoomus.cn",              SVC_VIDEO_CONF },
-    { "webex.com",              SVC_VIDEO_CONF },
-    { "ciscowebex.com",         SVC_VIDEO_CONF },
-    { "ciscospark.com",         SVC_VIDEO_CONF },
-    { "gotomeeting.com",        SVC_VIDEO_CONF },
-    { "gotowebinar.com",        SVC_VIDEO_CONF },
-    { "join.me",                SVC_VIDEO_CONF },
-    { "whereby.com",            SVC_VIDEO_CONF },
-    { "bluejeans.com",          SVC_VIDEO_CONF },
-    { "8x8.com",                SVC_VIDEO_CONF },
-    { "ringcentral.com",        SVC_VIDEO_CONF },
-    { "jitsi.org",              SVC_VIDEO_CONF },
-    { "8x8.vc",                 SVC_VIDEO_CONF },
-    { "around.co",              SVC_VIDEO_CONF },
-    { "facetime.apple.com",     SVC_VIDEO_CONF },
-    { "skype.com",              SVC_VIDEO_CONF },
-
-    /* ═════════════════════════════════════════════════════════════════
-     * SVC_VOIP_CALL — voice-primary
-     * ═════════════════════════════════════════════════════════════════ */
-    { "discord.media",          SVC_VOIP_CALL },
-    { "whatsapp.net",           SVC_VOIP_CALL },
-    { "whatsapp.com",           SVC_VOIP_CALL },
-    { "wa.me",                  SVC_VOIP_CALL },
-    { "signal.org",             SVC_VOIP_CALL },
-    { "signal.brave.com",       SVC_VOIP_CALL },
-    { "telegram.org",           SVC_VOIP_CALL },
-    { "tdesktop.com",           SVC_VOIP_CALL },
-    { "viber.com",              SVC_VOIP_CALL },
-    { "vonage.com",             SVC_VOIP_CALL },
-    { "twilio.com",             SVC_VOIP_CALL },
-    { "ringcentral.biz",        SVC_VOIP_CALL },
-    { "line.me",                SVC_VOIP_CALL },
-    { "line-apps.com",          SVC_VOIP_CALL },
-    { "line-scdn.net",          SVC_VOIP_CALL },
-    { "wechat.com",             SVC_VOIP_CALL },
-    { "weixin.qq.com",          SVC_VOIP_CALL },
-    { "kakao.com",              SVC_VOIP_CALL },
-    { "kakaocdn.net",           SVC_VOIP_CALL },
-    { "imo.im",                 SVC_VOIP_CALL },
-    { "tox.chat",               SVC_VOIP_CALL },
-    { "wire.com",               SVC_VOIP_CALL },
-    { "session.org",            SVC_VOIP_CALL },
-    { "matrix.org",             SVC_VOIP_CALL },
-    { "element.io",             SVC_VOIP_CALL },
-
-    /* ═════════════════════════════════════════════════════════════════
-     * SVC_VIDEO_LIVE — live streams (most specific subdomains first)
-     * ═════════════════════════════════════════════════════════════════ */
-    { "tiktokcdn-live.com",     SVC_VIDEO_LIVE },
-    { "live.fbcdn.net",         SVC_VIDEO_LIVE },
-    { "live.youtube.com",       SVC_VIDEO_LIVE },
-    { "ttvnw.net",              SVC_VIDEO_LIVE },   /* Twitch CDN */
-    { "jtvnw.net",              SVC_VIDEO_LIVE },   /* Twitch legacy */
-    { "twitch.tv",              SVC_VIDEO_LIVE },
-    { "kick.com",               SVC_VIDEO_LIVE },
-    { "trovo.live",             SVC_VIDEO_LIVE },
-    { "mixer.com",              SVC_VIDEO_LIVE },
-    { "rumble.com",             SVC_VIDEO_LIVE },
-    { "dlive.tv",               SVC_VIDEO_LIVE },
-    { "younow.com",             SVC_VIDEO_LIVE },
-    { "afreecatv.com",          SVC_VIDEO_LIVE },
-    { "twitcasting.tv",         SVC_VIDEO_LIVE },
-    { "huya.com",               SVC_VIDEO_LIVE },
-    { "douyu.com",              SVC_VIDEO_LIVE },
-    { "live.bilibili.com",      SVC_VIDEO_LIVE },
-    { "smashcast.tv",           SVC_VIDEO_LIVE },
-    { "streamlabs.com",         SVC_VIDEO_LIVE },
-    { "obsproject.com",         SVC_VIDEO_LIVE },
-    { "restream.io",            SVC_VIDEO_LIVE },
-    { "stream.aws",             SVC_VIDEO_LIVE },
-
-    /* ═════════════════════════════════════════════════════════════════
-     * SVC_VIDEO_VOD — buffered video/audio (covers ~80 % of streaming)
-     * ═════════════════════════════════════════════════════════════════ */
-    /* Google / YouTube */
-    { "googlevideo.com",        SVC_VIDEO_VOD },
-    { "ytimg.com",              SVC_VIDEO_VOD },
-    { "youtube.com",            SVC_VIDEO_VOD },
-    { "youtu.be",               SVC_VIDEO_VOD },
-    { "ggpht.com",              SVC_VIDEO_VOD },
-    { "withyoutube.com",        SVC_VIDEO_VOD },
-    /* Netflix */
-    { "nflxvideo.net",          SVC_VIDEO_VOD },
-    { "nflximg.com",            SVC_VIDEO_VOD },
-    { "nflximg.net",            SVC_VIDEO_VOD },
-    { "nflxso.net",             SVC_VIDEO_VOD },
-    { "nflxext.com",            SVC_VIDEO_VOD },
-    { "netflix.com",            SVC_VIDEO_VOD },
-    { "netflix.net",            SVC_VIDEO_VOD },
-    /* Amazon Prime Video */
-    { "aiv-cdn.net",            SVC_VIDEO_VOD },
-    { "aiv-delivery.net",       SVC_VIDEO_VOD },
-    { "primevideo.com",         SVC_VIDEO_VOD },
-    { "atv-ext.amazon.com",     SVC_VIDEO_VOD },
-    { "atv-ps.amazon.com",      SVC_VIDEO_VOD },
-    /* Disney+ */
-    { "dssott.com",             SVC_VIDEO_VOD },
-    { "disneyplus.com",         SVC_VIDEO_VOD },
-    { "disney-plus.net",        SVC_VIDEO_VOD },
-    { "bamgrid.com",            SVC_VIDEO_VOD },
-    /* Apple TV+ */
-    { "hls.apple.com",          SVC_VIDEO_VOD },
-    { "tv.apple.com",           SVC_VIDEO_VOD },
-    { "iadsdk.apple.com",       SVC_VIDEO_VOD },
-    { "aaplimg.com",            SVC_VIDEO_VOD },
-    /* HBO Max / Max */
-    { "hbomax.com",             SVC_VIDEO_VOD },
-    { "hbomaxcdn.com",          SVC_VIDEO_VOD },
-    { "max.com",                SVC_VIDEO_VOD },
-    { "discoveryplus.com",      SVC_VIDEO_VOD },
-    /* Paramount / Peacock / others US */
-    { "paramountplus.com",      SVC_VIDEO_VOD },
-    { "pmdstatic.net",          SVC_VIDEO_VOD },
-    { "peacocktv.com",          SVC_VIDEO_VOD },
-    { "starz.com",              SVC_VIDEO_VOD },
-    { "showtime.com",           SVC_VIDEO_VOD },
-    /* Hulu */
-    { "hulustream.com",         SVC_VIDEO_VOD },
-    { "hulu.com",               SVC_VIDEO_VOD },
-    /* Meta video */
-    { "video.fbcdn.net",        SVC_VIDEO_VOD },
-    { "fbcdn.net",              SVC_VIDEO_VOD },
-    { "cdninstagram.com",       SVC_VIDEO_VOD },
-    /* TikTok */
-    { "tiktokcdn.com",          SVC_VIDEO_VOD },
-    { "tiktokv.com",            SVC_VIDEO_VOD },
-    { "muscdn.com",             SVC_VIDEO_VOD },
-    { "byteoversea.com",        SVC_VIDEO_VOD },
-    /* Audio streaming */
-    { "spotify.com",            SVC_VIDEO_VOD },
-    { "spotifycdn.com",         SVC_VIDEO_VOD },
-    { "scdn.co",                SVC_VIDEO_VOD },
-    { "spotify.net",            SVC_VIDEO_VOD },
-    { "soundcloud.com",         SVC_VIDEO_VOD },
-    { "sndcdn.com",             SVC_VIDEO_VOD },
-    { "pandora.com",            SVC_VIDEO_VOD },
-    { "tidal.com",              SVC_VIDEO_VOD },
-    { "tidalhifi.com",          SVC_VIDEO_VOD },
-    { "deezer.com",             SVC_VIDEO_VOD },
-    { "audible.com",            SVC_VIDEO_VOD },
-    { "pdst.fm",                SVC_VIDEO_VOD },
-    /* Anime / Asia VOD */
-    { "crunchyroll.com",        SVC_VIDEO_VOD },
-    { "vrv.co",                 SVC_VIDEO_VOD },
-    { "funimation.com",         SVC_VIDEO_VOD },
-    { "bilibili.com",           SVC_VIDEO_VOD },
-    { "biliapi.net",            SVC_VIDEO_VOD },
-    { "iqiyi.com",              SVC_VIDEO_VOD },
-    { "iq.com",                 SVC_VIDEO_VOD },
-    { "youku.com",              SVC_VIDEO_VOD },
-    { "tudou.com",              SVC_VIDEO_VOD },
-    { "niconico.jp",            SVC_VIDEO_VOD },
-    { "nicovideo.jp",           SVC_VIDEO_VOD },
-    /* Sports VOD */
-    { "espn.com",               SVC_VIDEO_VOD },
-    { "espncdn.com",            SVC_VIDEO_VOD },
-    { "dazn.com",               SVC_VIDEO_VOD },
-    { "dazn-cdn.com",           SVC_VIDEO_VOD },
-    /* Self-hosted / personal */
-    { "plex.tv",                SVC_VIDEO_VOD },
-    { "plex.direct",            SVC_VIDEO_VOD },
-    { "stremio.com",            SVC_VIDEO_VOD },
-    { "jellyfin.org",           SVC_VIDEO_VOD },
-    { "emby.media",             SVC_VIDEO_VOD },
-    /* Disco/regional */
-    { "videoland.com",          SVC_VIDEO_VOD },
-    { "rai.it",                 SVC_VIDEO_VOD },
-    { "rakuten.tv",             SVC_VIDEO_VOD },
-    { "naver.com",              SVC_VIDEO_VOD },
-    { "wavve.com",              SVC_VIDEO_VOD },
-    { "bbcimedia.co.uk",        SVC_VIDEO_VOD },
-    { "iplayer.bbc.co.uk",      SVC_VIDEO_VOD },
-
-    /* ═════════════════════════════════════════════════════════════════
-     * SVC_GAME_LAUNCHER — bulk game content/installs (BEFORE GAME_RT)
-     * ═════════════════════════════════════════════════════════════════ */
-    { "steamcontent.com",       SVC_GAME_LAUNCHER },
-    { "steamserver.net",        SVC_GAME_LAUNCHER },
-    { "steamstatic.com",        SVC_GAME_LAUNCHER },
-    { "akamai.steamstatic.com", SVC_GAME_LAUNCHER },
-    { "store.epicgames.com",    SVC_GAME_LAUNCHER },
-    { "download.epicgames.com", SVC_GAME_LAUNCHER },
-    { "epicgames-download1.akamaized.net", SVC_GAME_LAUNCHER },
-    { "ggpk.epicgames.com",     SVC_GAME_LAUNCHER },
-    { "fastly-download.epicgames.com", SVC_GAME_LAUNCHER },
-    { "gog.com",                SVC_GAME_LAUNCHER },
-    { "gog-statics.com",        SVC_GAME_LAUNCHER },
-    { "itch.io",                SVC_GAME_LAUNCHER },
-    { "itch.zone",              SVC_GAME_LAUNCHER },
-    { "humblebundle.com",       SVC_GAME_LAUNCHER },
-    { "humbleusercontent.com",  SVC_GAME_LAUNCHER },
-    { "store.playstation.com",  SVC_GAME_LAUNCHER },
-    { "psnetwork.com",          SVC_GAME_LAUNCHER },
-    { "scea.com",               SVC_GAME_LAUNCHER },
-    { "xboxstores.microsoft.com", SVC_GAME_LAUNCHER },
-    { "live-content.azureedge.net", SVC_GAME_LAUNCHER },
-    { "battlenet.com.cn",       SVC_GAME_LAUNCHER },
-    { "blzddist1-a.akamaihd.net", SVC_GAME_LAUNCHER },
-    { "blz-contentstack.com",   SVC_GAME_LAUNCHER },
-    { "ea-update.cf.cdn.ea.com",SVC_GAME_LAUNCHER },
-    { "akamai.ubi.com",         SVC_GAME_LAUNCHER },
-    { "ubisoftconnect.com",     SVC_GAME_LAUNCHER },
-    { "rockstargames.com",      SVC_GAME_LAUNCHER },
-    { "rsg.sc",                 SVC_GAME_LAUNCHER },
-    { "warframecdn.com",        SVC_GAME_LAUNCHER },
-    { "patch.warframe.com",     SVC_GAME_LAUNCHER },
-    { "nintendo.net",           SVC_GAME_LAUNCHER },
-    { "nintendo.com",           SVC_GAME_LAUNCHER },
-    { "nintendoswitch.com.cn",  SVC_GAME_LAUNCHER },
-
-    /* ═════════════════════════════════════════════════════════════════
-     * SVC_GAME_RT — real-time gameplay
-     * ═════════════════════════════════════════════════════════════════ */
-    /* Riot */
-    { "riotgames.com",          SVC_GAME_RT },
-    { "riotcdn.net",            SVC_GAME_RT },
-    { "leagueoflegends.com",    SVC_GAME_RT },
-    { "lolesports.com",         SVC_GAME_RT },
-    { "valorantgame.com",       SVC_GAME_RT },
-    /* Valve / Steam game traffic (not store) */
-    { "steampowered.com",       SVC_GAME_RT },
-    { "valvesoftware.com",      SVC_GAME_RT },
-    { "csgo.com",               SVC_GAME_RT },
-    { "dota2.com",              SVC_GAME_RT },
-    { "tf2.com",                SVC_GAME_RT },
-    /* Epic / Fortnite */
-    { "epicgames.com",          SVC_GAME_RT },
-    { "fortnite.com",           SVC_GAME_RT },
-    { "ol.epicgames.com",       SVC_GAME_RT },
-    { "unrealengine.com",       SVC_GAME_RT },
-    { "rocketleague.com",       SVC_GAME_RT },
-    /* Activision Blizzard */
-    { "battle.net",             SVC_GAME_RT },
-    { "blizzard.com",           SVC_GAME_RT },
-    { "callofduty.com",         SVC_GAME_RT },
-    { "activision.com",         SVC_GAME_RT },
-    { "candycrushsaga.com",     SVC_GAME_RT },
-    { "king.com",               SVC_GAME_RT },
-    /* Microsoft / Xbox */
-    { "xboxlive.com",           SVC_GAME_RT },
-    { "xbox.com",               SVC_GAME_RT },
-    { "gamepass.com",           SVC_GAME_RT },
-    { "gamepass.net",           SVC_GAME_RT },
-    /* Sony / PlayStation */
-    { "playstation.net",        SVC_GAME_RT },
-    { "playstation.com",        SVC_GAME_RT },
-    { "scea.com",               SVC_GAME_RT },
-    { "psplus.com",             SVC_GAME_RT },
-    /* EA / Origin */
-    { "ea.com",                 SVC_GAME_RT },
-    { "easports.com",           SVC_GAME_RT },
-    { "origin.com",             SVC_GAME_RT },
-    { "fifa.com",               SVC_GAME_RT },
-    { "anthemgame.com",         SVC_GAME_RT },
-    { "apexlegends.com",        SVC_GAME_RT },
-    /* Ubisoft */
-    { "ubisoft.com",            SVC_GAME_RT },
-    { "ubi.com",                SVC_GAME_RT },
-    { "rainbowsixsiege.com",    SVC_GAME_RT },
-    { "thedivisiongame.com",    SVC_GAME_RT },
-    /* Mojang / Minecraft */
-    { "mojang.com",             SVC_GAME_RT },
-    { "minecraft.net",          SVC_GAME_RT },
-    { "hypixel.net",            SVC_GAME_RT },
-    { "mineplex.com",           SVC_GAME_RT },
-    /* Roblox */
-    { "roblox.com",             SVC_GAME_RT },
-    { "rbxcdn.com",             SVC_GAME_RT },
-    /* Mobile */
-    { "supercellgames.com",     SVC_GAME_RT },
-    { "supercell.com",          SVC_GAME_RT },
-    { "clashroyale.com",        SVC_GAME_RT },
-    { "brawlstars.com",         SVC_GAME_RT },
-    { "garena.com",             SVC_GAME_RT },
-    { "freefireth.com",         SVC_GAME_RT },
-    { "miHoYo.com",             SVC_GAME_RT },
-    { "hoyoverse.com",          SVC_GAME_RT },
-    { "genshin.hoyoverse.com",  SVC_GAME_RT },
-    { "starrails.com",          SVC_GAME_RT },
-    /* Asian / Chinese gaming */
-    { "qq.com",                 SVC_GAME_RT },
-    { "tencent.com",            SVC_GAME_RT },
-    { "wegame.com.cn",          SVC_GAME_RT },
-    { "netease.com",            SVC_GAME_RT },
-    { "163.com",                SVC_GAME_RT },
-    { "nexon.com",              SVC_GAME_RT },
-    { "nexon.net",              SVC_GAME_RT },
-    { "ncsoft.com",             SVC_GAME_RT },
-    { "lostark.com",            SVC_GAME_RT },
-    { "smilegate.com",          SVC_GAME_RT },
-    /* Single-purpose / esports */
-    { "faceit.com",             SVC_GAME_RT },
-    { "esea.net",               SVC_GAME_RT },
-    { "matchfaceit.com",        SVC_GAME_RT },
-    { "kovaak.com",             SVC_GAME_RT },
-    { "aimlab.gg",              SVC_GAME_RT },
-    { "innersloth.com",         SVC_GAME_RT },
-    { "fallguys.com",           SVC_GAME_RT },
-    { "amongus.com",            SVC_GAME_RT },
-    { "rec.net",                SVC_GAME_RT },
-    { "vrchat.com",             SVC_GAME_RT },
-    { "vrchat.net",             SVC_GAME_RT },
-    { "valvesoftware.com",      SVC_GAME_RT },
-    { "rockstarcdn.com",        SVC_GAME_RT },
-
-    /* ═════════════════════════════════════════════════════════════════
-     * SVC_FILE_SYNC — cloud drives / personal storage
-     * ═════════════════════════════════════════════════════════════════ */
-    /* Google */
-    { "drive.google.com",       SVC_FILE_SYNC },
-    { "docs.google.com",        SVC_FILE_SYNC },
-    { "slides.google.com",      SVC_FILE_SYNC },
-    { "sheets.google.com",      SVC_FILE_SYNC },
-    { "sites.google.com",       SVC_FILE_SYNC },
-    { "googleapis.com/drive",   SVC_FILE_SYNC },
-    /* Microsoft / OneDrive / SharePoint */
-    { "onedrive.live.com",      SVC_FILE_SYNC },
-    { "files.live.com",         SVC_FILE_SYNC },
-    { "1drv.ms",                SVC_FILE_SYNC },
-    { "sharepoint.com",         SVC_FILE_SYNC },
-    { "sharepointonline.com",   SVC_FILE_SYNC },
-    /* Apple iCloud */
-    { "icloud-content.com",     SVC_FILE_SYNC },
-    { "icloud.com",             SVC_FILE_SYNC },
-    { "icloud.com.cn",          SVC_FILE_SYNC },
-    { "me.com",                 SVC_FILE_SYNC },
-    { "mac.com",                SVC_FILE_SYNC },
-    /* Dropbox */
-    { "dropboxusercontent.com", SVC_FILE_SYNC },
-    { "dropbox.com",            SVC_FILE_SYNC },
-    { "dropboxapi.com",         SVC_FILE_SYNC },
-    { "dropboxstatic.com",      SVC_FILE_SYNC },
-    /* Other cloud drives */
-    { "box.com",                SVC_FILE_SYNC },
-    { "boxcdn.net",             SVC_FILE_SYNC },
-    { "mega.nz",                SVC_FILE_SYNC },
-    { "mega.co.nz",             SVC_FILE_SYNC },
-    { "mega.io",                SVC_FILE_SYNC },
-    { "pcloud.com",             SVC_FILE_SYNC },
-    { "sync.com",               SVC_FILE_SYNC },
-    { "tresorit.com",           SVC_FILE_SYNC },
-    { "proton.me/drive",        SVC_FILE_SYNC },
-    { "protondrive.com",        SVC_FILE_SYNC },
-    { "backblaze.com",          SVC_FILE_SYNC },
-    { "backblazeb2.com",        SVC_FILE_SYNC },
-    { "idrive.com",             SVC_FILE_SYNC },
-    { "carbonite.com",          SVC_FILE_SYNC },
-    { "wetransfer.com",         SVC_FILE_SYNC },
-    { "wetransferusercontent.com", SVC_FILE_SYNC },
-    { "smash.com",              SVC_FILE_SYNC },
-    { "filemail.com",           SVC_FILE_SYNC },
-    { "yandex.disk",            SVC_FILE_SYNC },
-    { "disk.yandex.com",        SVC_FILE_SYNC },
-    { "mailru-drive.ru",        SVC_FILE_SYNC },
-    { "kinsta.com/storage",     SVC_FILE_SYNC },
-    { "filen.io",               SVC_FILE_SYNC },
-    { "internxt.com",           SVC_FILE_SYNC },
-    { "owncloud.com",           SVC_FILE_SYNC },
-    { "nextcloud.com",          SVC_FILE_SYNC },
-
-    /* ═════════════════════════════════════════════════════════════════
-     * SVC_BULK_DL — software distribution / OS updates / dev tooling
-     * ═════════════════════════════════════════════════════════════════ */
-    /* Code hosts */
-    { "githubusercontent.com",  SVC_BULK_DL },
-    { "github.com",             SVC_BULK_DL },
-    { "github.io",              SVC_BULK_DL },
-    { "gitlab.com",             SVC_BULK_DL },
-    { "gitlab.io",              SVC_BULK_DL },
-    { "bitbucket.org",          SVC_BULK_DL },
-    { "sr.ht",                  SVC_BULK_DL },
-    { "codeberg.org",           SVC_BULK_DL },
-    /* Container registries */
-    { "docker.io",              SVC_BULK_DL },
-    { "docker.com",             SVC_BULK_DL },
-    { "quay.io",                SVC_BULK_DL },
-    { "ghcr.io",                SVC_BULK_DL },
-    { "gcr.io",                 SVC_BULK_DL },
-    { "registry.k8s.io",        SVC_BULK_DL },
-    /* Language package registries */
-    { "pypi.org",               SVC_BULK_DL },
-    { "pythonhosted.org",       SVC_BULK_DL },
-    { "anaconda.org",           SVC_BULK_DL },
-    { "conda-forge.org",        SVC_BULK_DL },
-    { "npmjs.com",              SVC_BULK_DL },
-    { "npmjs.org",              SVC_BULK_DL },
-    { "yarnpkg.com",            SVC_BULK_DL },
-    { "rubygems.org",           SVC_BULK_DL },
-    { "crates.io",              SVC_BULK_DL },
-    { "cargo.io",               SVC_BULK_DL },
-    { "mvnrepository.com",      SVC_BULK_DL },
-    { "maven.org",              SVC_BULK_DL },
-    { "nuget.org",              SVC_BULK_DL },
-    { "packagist.org",          SVC_BULK_DL },
-    { "go.dev",                 SVC_BULK_DL },
-    { "golang.org",             SVC_BULK_DL },
-    /* OS / Linux distributions */
-    { "archive.ubuntu.com",     SVC_BULK_DL },
-    { "security.ubuntu.com",    SVC_BULK_DL },
-    { "ports.ubuntu.com",       SVC_BULK_DL },
-    { "ubuntu.com",             SVC_BULK_DL },
-    { "debian.org",             SVC_BULK_DL },
-    { "kernel.org",             SVC_BULK_DL },
-    { "fedoraproject.org",      SVC_BULK_DL },
-    { "rpmfusion.org",           SVC_BULK_DL },
-    { "centos.org",             SVC_BULK_DL },
-    { "redhat.com",             SVC_BULK_DL },
-    { "almalinux.org",          SVC_BULK_DL },
-    { "rockylinux.org",         SVC_BULK_DL },
-    { "archlinux.org",          SVC_BULK_DL },
-    { "manjaro.org",            SVC_BULK_DL },
-    { "opensuse.org",           SVC_BULK_DL },
-    { "alpinelinux.org",        SVC_BULK_DL },
-    { "linuxmint.com",          SVC_BULK_DL },
-    { "popos.io",               SVC_BULK_DL },
-    { "elementary.io",          SVC_BULK_DL },
-    { "openwrt.org",            SVC_BULK_DL },
-    { "freebsd.org",            SVC_BULK_DL },
-    { "openbsd.org",            SVC_BULK_DL },
-    /* Microsoft Windows / Office / Update */
-    { "windowsupdate.com",      SVC_BULK_DL },
-    { "update.microsoft.com",   SVC_BULK_DL },
-    { "download.microsoft.com", SVC_BULK_DL },
-    { "officecdn.microsoft.com",SVC_BULK_DL },
-    { "officecdn-microsoft-com.akamaized.net", SVC_BULK_DL },
-    { "deploy.akamaitechnologies.com", SVC_BULK_DL },
-    { "msftconnecttest.com",    SVC_BULK_DL },
-    /* Apple SW Update */
-    { "swcdn.apple.com",        SVC_BULK_DL },
-    { "swdownload.apple.com",   SVC_BULK_DL },
-    { "swdist.apple.com",       SVC_BULK_DL },
-    { "appldnld.apple.com",     SVC_BULK_DL },
-    { "downloads.apple.com",    SVC_BULK_DL },
-    { "configuration.apple.com",SVC_BULK_DL },
-    /* Google Play / Android */
-    { "android.googleapis.com", SVC_BULK_DL },
-    { "android.com",            SVC_BULK_DL },
-    { "playgames.googleapis.com", SVC_BULK_DL },
-    { "google.com/dl",          SVC_BULK_DL },
-    { "dl.google.com",          SVC_BULK_DL },
-    { "fdroid.org",             SVC_BULK_DL },
-    { "aptoide.com",            SVC_BULK_DL },
-    { "apkmirror.com",          SVC_BULK_DL },
-    { "apkpure.com",            SVC_BULK_DL },
-    /* CDN / dev infra */
-    { "jsdelivr.net",           SVC_BULK_DL },
-    { "cdnjs.cloudflare.com",   SVC_BULK_DL },
-    { "unpkg.com",              SVC_BULK_DL },
-    /* Mozilla / browsers */
-    { "mozilla.org",            SVC_BULK_DL },
-    { "addons.mozilla.org",     SVC_BULK_DL },
-    { "ftp.mozilla.org",        SVC_BULK_DL },
-    { "googlechrome.com",       SVC_BULK_DL },
-    { "google.com/chrome",      SVC_BULK_DL },
-    { "operacdn.com",           SVC_BULK_DL },
-    { "brave.com",              SVC_BULK_DL },
-    { "vivaldi.com",            SVC_BULK_DL },
-    /* Antivirus / OS tooling */
-    { "avast.com",              SVC_BULK_DL },
-    { "kaspersky.com",          SVC_BULK_DL },
-    { "norton.com",             SVC_BULK_DL },
-    { "bitdefender.com",        SVC_BULK_DL },
-    { "mcafee.com",             SVC_BULK_DL },
-
-    /* ═════════════════════════════════════════════════════════════════
-     * SVC_TORRENT — peer-to-peer (most encrypted, but trackers are clear)
-     * ═════════════════════════════════════════════════════════════════ */
-    { "bittorrent.com",         SVC_TORRENT },
-    { "utorrent.com",           SVC_TORRENT },
-    { "qbittorrent.org",        SVC_TORRENT },
-    { "deluge-torrent.org",     SVC_TORRENT },
-    { "transmissionbt.com",     SVC_TORRENT },
-    { "rtorrent.org",           SVC_TORRENT },
-    { "vuze.com",               SVC_TORRENT },
-    { "thepiratebay.org",       SVC_TORRENT },
-    { "rarbg.to",               SVC_TORRENT },
-    { "1337x.to",               SVC_TORRENT },
-    { "yts.mx",                 SVC_TORRENT },
-    { "eztv.re",                SVC_TORRENT },
-    { "linuxtracker.org",       SVC_TORRENT },
-    { "opentrackr.org",         SVC_TORRENT },
-    { "openbittorrent.com",     SVC_TORRENT },
-    { "tracker.coppersurfer.tk",SVC_TORRENT },
-    { "tracker.openbittorrent.com", SVC_TORRENT },
-
-    /* ═════════════════════════════════════════════════════════════════
-     * SVC_WEB_INTERACTIVE — chat / web apps (non-voice path)
-     * ═════════════════════════════════════════════════════════════════ */
-    { "discord.gg",             SVC_WEB_INTERACTIVE },
-    { "discord.com",            SVC_WEB_INTERACTIVE },
-    { "discordapp.com",         SVC_WEB_INTERACTIVE },
-    { "discordapp.net",         SVC_WEB_INTERACTIVE },
-    { "t.me",                   SVC_WEB_INTERACTIVE },
-    { "telegram.me",            SVC_WEB_INTERACTIVE },
-    { "twitter.com",            SVC_WEB_INTERACTIVE },
-    { "x.com",                  SVC_WEB_INTERACTIVE },
-    { "twimg.com",              SVC_WEB_INTERACTIVE },
-    { "facebook.com",           SVC_WEB_INTERACTIVE },
-    { "fb.com",                 SVC_WEB_INTERACTIVE },
-    { "messenger.com",          SVC_WEB_INTERACTIVE },
-    { "instagram.com",          SVC_WEB_INTERACTIVE },
-    { "threads.net",            SVC_WEB_INTERACTIVE },
-    { "linkedin.com",           SVC_WEB_INTERACTIVE },
-    { "licdn.com",              SVC_WEB_INTERACTIVE },
-    { "reddit.com",             SVC_WEB_INTERACTIVE },
-    { "redd.it",                SVC_WEB_INTERACTIVE },
-    { "redditmedia.com",        SVC_WEB_INTERACTIVE },
-    { "redditstatic.com",       SVC_WEB_INTERACTIVE },
-    { "tumblr.com",             SVC_WEB_INTERACTIVE },
-    { "pinterest.com",          SVC_WEB_INTERACTIVE },
-    { "pinimg.com",             SVC_WEB_INTERACTIVE },
-    { "snapchat.com",           SVC_WEB_INTERACTIVE },
-    { "sc-cdn.net",             SVC_WEB_INTERACTIVE },
-    { "tumblr.com",             SVC_WEB_INTERACTIVE },
-    { "tiktok.com",             SVC_WEB_INTERACTIVE },
-    { "ycombinator.com",        SVC_WEB_INTERACTIVE },
-    { "stackoverflow.com",      SVC_WEB_INTERACTIVE },
-    { "stackexchange.com",      SVC_WEB_INTERACTIVE },
-    { "wikipedia.org",          SVC_WEB_INTERACTIVE },
-    { "wikimedia.org",          SVC_WEB_INTERACTIVE },
-    { "medium.com",             SVC_WEB_INTERACTIVE },
-    { "substack.com",           SVC_WEB_INTERACTIVE },
-    { "notion.so",              SVC_WEB_INTERACTIVE },
-    { "notion.site",            SVC_WEB_INTERACTIVE },
-    { "trello.com",             SVC_WEB_INTERACTIVE },
-    { "asana.com",              SVC_WEB_INTERACTIVE },
-    { "airtable.com",           SVC_WEB_INTERACTIVE },
-    { "monday.com",             SVC_WEB_INTERACTIVE },
-    { "clickup.com",            SVC_WEB_INTERACTIVE },
-    { "linear.app",             SVC_WEB_INTERACTIVE },
-    { "miro.com",               SVC_WEB_INTERACTIVE },
-    { "figma.com",              SVC_WEB_INTERACTIVE },
-    { "canva.com",              SVC_WEB_INTERACTIVE },
-    { "slack.com",              SVC_WEB_INTERACTIVE },
-    { "slack-edge.com",         SVC_WEB_INTERACTIVE },
-    { "slack-imgs.com",         SVC_WEB_INTERACTIVE },
-    { "mattermost.com",         SVC_WEB_INTERACTIVE },
-    { "rocket.chat",            SVC_WEB_INTERACTIVE },
-    /* Webmail */
-    { "gmail.com",              SVC_WEB_INTERACTIVE },
-    { "mail.google.com",        SVC_WEB_INTERACTIVE },
-    { "outlook.com",            SVC_WEB_INTERACTIVE },
-    { "outlook.live.com",       SVC_WEB_INTERACTIVE },
-    { "office.com",             SVC_WEB_INTERACTIVE },
-    { "office365.com",          SVC_WEB_INTERACTIVE },
-    { "yahoo.com",              SVC_WEB_INTERACTIVE },
-    { "yahoomail.com",          SVC_WEB_INTERACTIVE },
-    { "protonmail.com",         SVC_WEB_INTERACTIVE },
-    { "proton.me",              SVC_WEB_INTERACTIVE },
-    { "tutanota.com",           SVC_WEB_INTERACTIVE },
-    { "fastmail.com",           SVC_WEB_INTERACTIVE },
-    { "icloud-mail.com",        SVC_WEB_INTERACTIVE },
-    /* Banking / e-commerce / shopping */
-    { "amazon.com",             SVC_WEB_INTERACTIVE },
-    { "amzn.to",                SVC_WEB_INTERACTIVE },
-    { "ebay.com",               SVC_WEB_INTERACTIVE },
-    { "shopify.com",            SVC_WEB_INTERACTIVE },
-    { "etsy.com",               SVC_WEB_INTERACTIVE },
-    { "aliexpress.com",         SVC_WEB_INTERACTIVE },
-    { "alibaba.com",            SVC_WEB_INTERACTIVE },
-    { "trendyol.com",           SVC_WEB_INTERACTIVE },
-    { "hepsiburada.com",        SVC_WEB_INTERACTIVE },
-    { "n11.com",                SVC_WEB_INTERACTIVE },
-    /* Search / maps */
-    { "duckduckgo.com",         SVC_WEB_INTERACTIVE },
-    { "bing.com",               SVC_WEB_INTERACTIVE },
-    { "yandex.com",             SVC_WEB_INTERACTIVE },
-    { "yandex.ru",              SVC_WEB_INTERACTIVE },
-    { "openstreetmap.org",      SVC_WEB_INTERACTIVE },
-    { "mapbox.com",             SVC_WEB_INTERACTIVE },
-    /* News */
-    { "bbc.co.uk",              SVC_WEB_INTERACTIVE },
-    { "cnn.com",                SVC_WEB_INTERACTIVE },
-    { "nytimes.com",            SVC_WEB_INTERACTIVE },
-    { "theguardian.com",        SVC_WEB_INTERACTIVE },
-    { "reuters.com",            SVC_WEB_INTERACTIVE },
-    { "bloomberg.com",          SVC_WEB_INTERACTIVE },
-    { "wsj.com",                SVC_WEB_INTERACTIVE },
-    { "spiegel.de",             SVC_WEB_INTERACTIVE },
-    { "lemonde.fr",             SVC_WEB_INTERACTIVE },
-    { "elpais.com",             SVC_WEB_INTERACTIVE },
-
-    /* ═════════════════════════════════════════════════════════════════
-     * SVC_SYSTEM — DNS, NTP, OS telemetry, captive portal probes
-     * (Mostly already covered by port hints; these catch DoH/DoT/quic.)
-     * ═════════════════════════════════════════════════════════════════ */
-    { "dns.google",             SVC_SYSTEM },
-    { "dns.google.com",         SVC_SYSTEM },
-    { "cloudflare-dns.com",     SVC_SYSTEM },
-    { "1.1.1.1",                SVC_SYSTEM },
-    { "1.0.0.1",                SVC_SYSTEM },
-    { "quad9.net",              SVC_SYSTEM },
-    { "dns.quad9.net",          SVC_SYSTEM },
-    { "opendns.com",            SVC_SYSTEM },
-    { "umbrella.com",           SVC_SYSTEM },
-    { "adguard-dns.com",        SVC_SYSTEM },
-    { "dnscrypt.info",          SVC_SYSTEM },
-    { "pool.ntp.org",           SVC_SYSTEM },
-    { "ntppool.org",            SVC_SYSTEM },
-    { "time.apple.com",         SVC_SYSTEM },
-    { "time.windows.com",       SVC_SYSTEM },
-    { "time.cloudflare.com",    SVC_SYSTEM },
-    { "time.google.com",        SVC_SYSTEM },
-    { "captive.apple.com",      SVC_SYSTEM },
-    { "msftncsi.com",           SVC_SYSTEM },
-    { "connectivity-check.ubuntu.com", SVC_SYSTEM },
-    { "detectportal.firefox.com",SVC_SYSTEM },
-    { "akamaiedge.net",         SVC_SYSTEM },  /* generic Akamai (catch-all infra) */
-    { "akamaihd.net",           SVC_SYSTEM },
-
-    { NULL, SVC_UNKNOWN }  /* sentinel */
-};
+static int dom_label_cmp(const char *a, size_t alen, const char *b, size_t blen) {
+    int c = memcmp(a, b, alen < blen ? alen : blen);
+    if (c != 0) {
+        return c;
+    }
+    return (alen > blen) - (alen < blen);
+}
 
-/* ── Domain suffix → persona lookup ──────────────────────────── */
+static const dom_trie_node_t *dom_trie_child(const dom_trie_node_t *node,
+                                             const char *label, size_t len) {
+    uint32_t lo = node->first_child;
+    uint32_t hi = lo + node->n_children;
+    while (lo < hi) {
+        uint32_t mid = lo + (hi - lo) / 2;
+        const dom_trie_node_t *c = &dom_trie_nodes[mid];
+        int cmp = dom_label_cmp(&dom_trie_labels[c->label_off], c->label_len, label, len);
+        if (cmp == 0) {
+            return c;
+        }
+        if (cmp < 0) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    return NULL;
+}
 
-persona_t dns_domain_to_hint(const char *domain) {
-    if (!domain || domain[0] == '\0') {
-        return PERSONA_UNKNOWN;
+/* Longest-suffix match of `domain` against both tables at once. */
+static void dom_trie_match(const char *domain, persona_t *hint, service_t *service) {
+    *hint = PERSONA_UNKNOWN;
+    *service = SVC_UNKNOWN;
+
+    const char *end = domain + strlen(domain);
+    if (end > domain && end[-1] == '.') {
+        end--;   /* fully qualified "example.com." */
     }
 
-    size_t dlen = strlen(domain);
+    const dom_trie_node_t *node = &dom_trie_nodes[0];
+    while (end > domain) {
+        const char *start = end;
+        while (start > domain && start[-1] != '.') {
+            start--;
+        }
+        size_t len = (size_t)(end - start);
+        if (len == 0 || len > 63) {
+            return;
+        }
 
-    for (const domain_hint_t *e = domain_table; e->suffix; e++) {
-        size_t slen = strlen(e->suffix);
-        if (slen > dlen) {
-            continue;
+        char label[64];
+        for (size_t i = 0; i < len; i++) {
+            char c = start[i];
+            label[i] = (c >= 'A' && c <= 'Z') ? (char)(c - 'A' + 'a') : c;
         }
-        /* Suffix match: domain ends with the suffix, and either the
-         * domain IS the suffix or the char before the suffix is '.' */
-        const char *tail = domain + (dlen - slen);
-        if (strcasecmp(tail, e->suffix) == 0) {
-            if (slen == dlen || *(tail - 1) == '.') {
-                return e->persona;
-            }
+
+        node = dom_trie_child(node, label, len);
+        if (!node) {
+            return;
         }
+        if (node->hint != PERSONA_UNKNOWN) {
+            *hint = (persona_t)node->hint;
+        }
+        if (node->service != SVC_UNKNOWN) {
+            *service = (service_t)node->service;
+        }
+        end = start > domain ? start - 1 : domain;
     }
+}
 
-    return PERSONA_UNKNOWN;
+/* ── Domain suffix → persona lookup ──────────────────────────── */
+
+persona_t dns_domain_to_hint(const char *domain) {
+    if (!domain || domain[0] == '\0') {
+        return PERSONA_UNKNOWN;
+    }
+    persona_t hint;
+    service_t service;
+    dom_trie_match(domain, &hint, &service);
+    return hint;
 }
 
 service_t dns_domain_to_service(const char *domain) {
     if (!domain || domain[0] == '\0') {
         return SVC_UNKNOWN;
     }
+    persona_t hint;
+    service_t service;
+    dom_trie_match(domain, &hint, &service);
+    return service;
+}
 
-    size_t dlen = strlen(domain);
+/* ── Cache operations ────────────────────────────────────────── */
 
-    for (const domain_service_t *e = domain_service_table; e->suffix; e++) {
-        size_t slen = strlen(e->suffix);
-        if (slen > dlen) {
-            continue;
+static double dns_now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+/* IPs cluster in their low (first-octet) byte; a full 32-bit finaliser
+ * (murmur3 fmix32) spreads them over the mask. */
+static uint32_t dns_ip_hash(uint32_t ip) {
+    uint32_t h = ip;
+    h ^= h >> 16;
+    h *= 0x85EBCA6Bu;
+    h ^= h >> 13;
+    h *= 0xC2B2AE35u;
+    h ^= h >> 16;
+    return h;
+}
+
+/* ── Expiry heap (writer side) ── */
+
+static void heap_set(dns_cache_t *c, uint32_t pos, uint32_t slot) {
+    c->heap[pos] = slot;
+    c->entries[slot].heap_pos = pos;
+}
+
+static int heap_less(const dns_cache_t *c, uint32_t a, uint32_t b) {
+    return c->entries[c->heap[a]].expire_time < c->entries[c->heap[b]].expire_time;
+}
+
+static void heap_sift_up(dns_cache_t *c, uint32_t pos) {
+    while (pos > 0) {
+        uint32_t parent = (pos - 1) / 2;
+        if (!heap_less(c, pos, parent)) {
+            break;
         }
-        const char *tail = domain + (dlen - slen);
-        if (strcasecmp(tail, e->suffix) == 0) {
-            if (slen == dlen || *(tail - 1) == '.') {
-                return e->service;
-            }
+        uint32_t tmp = c->heap[parent];
+        heap_set(c, parent, c->heap[pos]);
+        heap_set(c, pos, tmp);
+        pos = parent;
+    }
+}
+
+static void heap_sift_down(dns_cache_t *c, uint32_t pos) {
+    for (;;) {
+        uint32_t l = 2 * pos + 1, r = l + 1, m = pos;
+        if (l < c->count && heap_less(c, l, m)) m = l;
+        if (r < c->count && heap_less(c, r, m)) m = r;
+        if (m == pos) {
+            break;
         }
+        uint32_t tmp = c->heap[m];
+        heap_set(c, m, c->heap[pos]);
+        heap_set(c, pos, tmp);
+        pos = m;
     }
+}
+
+/* ── Seqlock (writer side) ── */
 
-    return SVC_UNKNOWN;
+static void dns_write_begin(dns_cache_t *c) {
+    unsigned s = atomic_load_explicit(&c->seq, memory_order_relaxed);
+    atomic_store_explicit(&c->seq, s + 1, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
 }
 
-/* ── Cache operations ────────────────────────────────────────── */
+static void dns_write_end(dns_cache_t *c) {
+    unsigned s = atomic_load_explicit(&c->seq, memory_order_relaxed);
+    atomic_store_explicit(&c->seq, s + 1, memory_order_release);
+}
 
-void dns_cache_init(dns_cache_t *cache) {
+/* ── Table ── */
+
+static dns_entry_t *dns_probe(const dns_cache_t *c, uint32_t ip) {
+    uint32_t mask = c->slots - 1;
+    uint32_t pos = dns_ip_hash(ip) & mask;
+    for (uint32_t i = 0; i < c->slots; i++) {
+        dns_entry_t *e = &c->entries[pos];
+        if (!e->active) {
+            return NULL;
+        }
+        if (e->ip == ip) {
+            return e;
+        }
+        pos = (pos + 1) & mask;
+    }
+    return NULL;
+}
+
+/* Writer side, under the lock. */
+static void dns_log_change(dns_cache_t *c, uint32_t ip) {
+    c->change_ips[c->change_seq & (DNS_CHANGE_LOG - 1)] = ip;
+    c->change_seq++;
+}
+
+/* Drop slot `pos` from heap and table; backward-shift the cluster behind
+ * it so probe chains stay unbroken (no tombstones). */
+static void dns_remove_slot(dns_cache_t *c, uint32_t pos) {
+    uint32_t mask = c->slots - 1;
+
+    if (c->entries[pos].hint != PERSONA_UNKNOWN ||
+        c->entries[pos].service != SVC_UNKNOWN) {
+        dns_log_change(c, c->entries[pos].ip);
+    }
+
+    uint32_t hp = c->entries[pos].heap_pos;
+    uint32_t last = c->count - 1;
+    if (hp != last) {
+        heap_set(c, hp, c->heap[last]);
+    }
+    c->count--;
+    if (hp < c->count) {
+        heap_sift_down(c, hp);
+        heap_sift_up(c, hp);
+    }
+
+    uint32_t hole = pos;
+    uint32_t next = (pos + 1) & mask;
+    while (c->entries[next].active) {
+        uint32_t home = dns_ip_hash(c->entries[next].ip) & mask;
+        if (((next - home) & mask) >= ((next - hole) & mask)) {
+            c->entries[hole] = c->entries[next];
+            c->heap[c->entries[hole].heap_pos] = hole;
+            hole = next;
+        }
+        next = (next + 1) & mask;
+    }
+    memset(&c->entries[hole], 0, sizeof(c->entries[hole]));
+}
+
+int dns_cache_init_sized(dns_cache_t *cache, uint32_t capacity) {
     if (!cache) {
-        return;
+        return -1;
     }
-    memset(cache->entries, 0, sizeof(cache->entries));
+    memset(cache, 0, sizeof(*cache));
+    atomic_init(&cache->seq, 0);
     pthread_mutex_init(&cache->lock, NULL);
+
+    if (capacity < DNS_CACHE_MIN_SIZE) capacity = DNS_CACHE_MIN_SIZE;
+    if (capacity > DNS_CACHE_MAX_SIZE) capacity = DNS_CACHE_MAX_SIZE;
+    uint32_t slots = 1;
+    while (slots < capacity + capacity / 3 + 1) {
+        slots <<= 1;
+    }
+
+    cache->entries = calloc(slots, sizeof(*cache->entries));
+    cache->heap = calloc(capacity, sizeof(*cache->heap));
+    if (!cache->entries || !cache->heap) {
+        free(cache->entries);
+        free(cache->heap);
+        cache->entries = NULL;
+        cache->heap = NULL;
+        log_msg(LOG_WARN, "dns", "cache allocation failed (%u entries), DNS hints disabled", capacity);
+        return -1;
+    }
+    cache->slots = slots;
+    cache->capacity = capacity;
+    return 0;
+}
+
+void dns_cache_init(dns_cache_t *cache) {
+    dns_cache_init_sized(cache, DNS_CACHE_SIZE);
 }
 
 void dns_cache_destroy(dns_cache_t *cache) {
     if (!cache) {
         return;
     }
+    free(cache->entries);
+    free(cache->heap);
+    cache->entries = NULL;
+    cache->heap = NULL;
+    cache->slots = cache->capacity = cache->count = 0;
     pthread_mutex_destroy(&cache->lock);
 }
 
+/* Seqlock read: probe without the lock, retry if a writer was active or
+ * finished in between. Returns 1 on a live (unexpired) hit. */
+static int dns_cache_read(dns_cache_t *cache, uint32_t ip, double now,
+                          persona_t *hint, service_t *service) {
+    *hint = PERSONA_UNKNOWN;
+    *service = SVC_UNKNOWN;
+    if (!cache->entries) {
+        return 0;
+    }
+    for (;;) {
+        unsigned s1 = atomic_load_explicit(&cache->seq, memory_order_acquire);
+        if (s1 & 1u) {
+            continue;   /* writer mid-update; it holds for a few µs */
+        }
+        const dns_entry_t *e = dns_probe(cache, ip);
+        int hit = 0;
+        persona_t h = PERSONA_UNKNOWN;
+        service_t s = SVC_UNKNOWN;
+        if (e && now < e->expire_time) {
+            h = e->hint;
+            s = e->service;
+            hit = 1;
+        }
+        atomic_thread_fence(memory_order_acquire);
+        if (atomic_load_explicit(&cache->seq, memory_order_relaxed) == s1) {
+            *hint = h;
+            *service = s;
+            return hit;
+        }
+    }
+}
+
 persona_t dns_cache_lookup(dns_cache_t *cache, uint32_t ip) {
     if (!cache) {
         return PERSONA_UNKNOWN;
     }
+    persona_t hint;
+    service_t service;
+    dns_cache_read(cache, ip, dns_now(), &hint, &service);
+    return hint;
+}
 
-    persona_t result = PERSONA_UNKNOWN;
-    pthread_mutex_lock(&cache->lock);
+service_t dns_cache_lookup_service(dns_cache_t *cache, uint32_t ip) {
+    if (!cache) {
+        return SVC_UNKNOWN;
+    }
+    persona_t hint;
+    service_t service;
+    dns_cache_read(cache, ip, dns_now(), &hint, &service);
+    return service;
+}
 
-    for (int i = 0; i < DNS_CACHE_SIZE; i++) {
-        dns_entry_t *e = &cache->entries[i];
-        if (e->active && e->ip == ip) {
-            /* Check TTL expiry using monotonic clock */
-            struct timespec ts;
-            clock_gettime(CLOCK_MONOTONIC, &ts);
-            double now = (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
-            if (now < e->expire_time) {
-                result = e->hint;
-            } else {
-                /* Expired — mark inactive */
-                e->active = 0;
-            }
-            break;
+/* Batch read: hash a chunk, prefetch every home slot, then probe the
+ * chunk inside one seqlock section. A writer overlapping the section
+ * costs a retry of that chunk only. */
+void dns_cache_lookup_batch(dns_cache_t *cache, const uint32_t *ips, size_t n,
+                            double now, persona_t *hints, service_t *services) {
+    if (!ips) {
+        return;
+    }
+    if (!cache || !cache->entries) {
+        for (size_t i = 0; i < n; i++) {
+            if (hints) hints[i] = PERSONA_UNKNOWN;
+            if (services) services[i] = SVC_UNKNOWN;
         }
+        return;
     }
 
-    pthread_mutex_unlock(&cache->lock);
-    return result;
+    uint32_t mask = cache->slots - 1;
+    for (size_t base = 0; base < n; base += DNS_BATCH_CHUNK) {
+        size_t m = n - base < DNS_BATCH_CHUNK ? n - base : DNS_BATCH_CHUNK;
+        uint32_t pos[DNS_BATCH_CHUNK];
+        for (size_t i = 0; i < m; i++) {
+            pos[i] = dns_ip_hash(ips[base + i]) & mask;
+            __builtin_prefetch(&cache->entries[pos[i]], 0, 1);
+        }
+
+        persona_t h[DNS_BATCH_CHUNK];
+        service_t s[DNS_BATCH_CHUNK];
+        for (;;) {
+            unsigned s1 = atomic_load_explicit(&cache->seq, memory_order_acquire);
+            if (s1 & 1u) {
+                continue;
+            }
+            for (size_t i = 0; i < m; i++) {
+                uint32_t ip = ips[base + i];
+                uint32_t p = pos[i];
+                h[i] = PERSONA_UNKNOWN;
+                s[i] = SVC_UNKNOWN;
+                for (uint32_t k = 0; k < cache->slots; k++) {
+                    const dns_entry_t *e = &cache->entries[p];
+                    if (!e->active) {
+                        break;
+                    }
+                    if (e->ip == ip) {
+                        if (now < e->expire_time) {
+                            h[i] = e->hint;
+                            s[i] = e->service;
+                        }
+                        break;
+                    }
+                    p = (p + 1) & mask;
+                }
+            }
+            atomic_thread_fence(memory_order_acquire);
+            if (atomic_load_explicit(&cache->seq, memory_order_relaxed) == s1) {
+                break;
+            }
+        }
+        for (size_t i = 0; i < m; i++) {
+            if (hints) hints[base + i] = h[i];
+            if (services) services[base + i] = s[i];
+        }
+    }
 }
 
-void dns_cache_insert(dns_cache_t *cache, uint32_t ip,
-                      const char *domain, uint32_t ttl_s) {
-    if (!cache || !domain) {
+static void dns_cache_insert_at(dns_cache_t *cache, uint32_t ip,
+                                const char *domain, uint32_t ttl_s, double now) {
+    if (!cache || !domain || !cache->entries) {
         return;
     }
 
-    persona_t hint = dns_domain_to_hint(domain);
-
-    struct timespec ts;
-    clock_gettime(CLOCK_MONOTONIC, &ts);
-    double now = (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+    /* One trie walk yields both hints; done before taking the lock. */
+    persona_t hint;
+    service_t service;
+    dom_trie_match(domain, &hint, &service);
 
     /* Clamp TTL: minimum 30s, maximum 3600s */
     if (ttl_s < 30)   ttl_s = 30;
     if (ttl_s > 3600)  ttl_s = 3600;
 
     pthread_mutex_lock(&cache->lock);
+    dns_write_begin(cache);
 
-    /* Look for existing entry for this IP, or find LRU slot */
-    int target = -1;
-    double oldest_expire = 1e18;
-
-    for (int i = 0; i < DNS_CACHE_SIZE; i++) {
-        dns_entry_t *e = &cache->entries[i];
-
-        /* Exact IP match — update in place */
-        if (e->active && e->ip == ip) {
-            target = i;
-            break;
-        }
-
-        /* Empty slot */
-        if (!e->active) {
-            target = i;
-            oldest_expire = -1.0;  /* prefer empty over LRU */
-            continue;
-        }
+    /* Reclaim everything already expired (heap top first). */
+    while (cache->count > 0 &&
+           cache->entries[cache->heap[0]].expire_time <= now) {
+        dns_remove_slot(cache, cache->heap[0]);
+    }
 
-        /* Track LRU (earliest expiry) for eviction */
-        if (e->expire_time < oldest_expire && target < 0) {
-            oldest_expire = e->expire_time;
-            target = i;
-        }
-        /* If we already found an empty slot (oldest_expire == -1), skip LRU */
-        if (oldest_expire < 0.0) {
-            continue;
+    dns_entry_t *slot = dns_probe(cache, ip);
+    if (!slot) {
+        if (cache->count >= cache->capacity) {
+            /* Full of live entries: drop the one closest to expiry. */
+            dns_remove_slot(cache, cache->heap[0]);
         }
-        if (e->expire_time < oldest_expire) {
-            oldest_expire = e->expire_time;
-            target = i;
+        uint32_t mask = cache->slots - 1;
+        uint32_t pos = dns_ip_hash(ip) & mask;
+        while (cache->entries[pos].active) {
+            pos = (pos + 1) & mask;
         }
+        slot = &cache->entries[pos];
+        slot->ip = ip;
+        slot->active = 1;
+        slot->expire_time = now + (double)ttl_s;
+        heap_set(cache, cache->count++, pos);
+        heap_sift_up(cache, slot->heap_pos);
+    } else {
+        slot->expire_time = now + (double)ttl_s;
+        heap_sift_down(cache, slot->heap_pos);
+        heap_sift_up(cache, slot->heap_pos);
     }
 
-    if (target < 0) {
-        target = 0;  /* fallback: should never happen with 64 slots */
-    }
-
-    dns_entry_t *slot = &cache->entries[target];
-    slot->ip = ip;
     strncpy(slot->domain, domain, DNS_DOMAIN_MAXLEN - 1);
     slot->domain[DNS_DOMAIN_MAXLEN - 1] = '\0';
+    if (slot->hint != hint || slot->service != service) {
+        dns_log_change(cache, ip);   /* fresh slots are zeroed: UNKNOWN */
+    }
     slot->hint = hint;
-    slot->service = dns_domain_to_service(domain);
-    slot->expire_time = now + (double)ttl_s;
-    slot->active = 1;
+    slot->service = service;
 
+    dns_write_end(cache);
     pthread_mutex_unlock(&cache->lock);
 }
 
-service_t dns_cache_lookup_service(dns_cache_t *cache, uint32_t ip) {
-    if (!cache) {
-        return SVC_UNKNOWN;
-    }
+void dns_cache_insert(dns_cache_t *cache, uint32_t ip,
+                      const char *domain, uint32_t ttl_s) {
+    dns_cache_insert_at(cache, ip, domain, ttl_s, dns_now());
+}
 
-    service_t result = SVC_UNKNOWN;
+int dns_cache_changes_since(dns_cache_t *cache, uint64_t *cursor,
+                            uint32_t *ips, int max) {
+    if (!cache || !cursor) {
+        return 0;
+    }
     pthread_mutex_lock(&cache->lock);
-
-    for (int i = 0; i < DNS_CACHE_SIZE; i++) {
-        dns_entry_t *e = &cache->entries[i];
-        if (e->active && e->ip == ip) {
-            struct timespec ts;
-            clock_gettime(CLOCK_MONOTONIC, &ts);
-            double now = (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
-            if (now < e->expire_time) {
-                result = e->service;
-            } else {
-                e->active = 0;
-            }
-            break;
+    uint64_t end = cache->change_seq;
+    uint64_t behind = end - *cursor;
+    int n = -1;
+    if (behind <= DNS_CHANGE_LOG && behind <= (uint64_t)(max > 0 ? max : 0)) {
+        n = 0;
+        for (uint64_t s = *cursor; s < end; s++) {
+            ips[n++] = cache->change_ips[s & (DNS_CHANGE_LOG - 1)];
         }
     }
-
+    *cursor = end;
     pthread_mutex_unlock(&cache->lock);
-    return result;
+    return n;
 }
 
 /* ── DNS response parser ─────────────────────────────────────── */
@@ -1042,6 +609,11 @@ static int dns_read_name(const uint8_t *pkt, size_t pkt_len,
 }
 
 int dns_parse_response(dns_cache_t *cache, const uint8_t *pkt, size_t pkt_len) {
+    return dns_parse_response_at(cache, pkt, pkt_len, dns_now());
+}
+
+int dns_parse_response_at(dns_cache_t *cache, const uint8_t *pkt, size_t pkt_len,
+                          double now) {
     if (!cache || !pkt) {
         return -1;
     }
@@ -1135,7 +707,7 @@ int dns_parse_response(dns_cache_t *cache, const uint8_t *pkt, size_t pkt_len) {
              * CDN CNAMEs that don't match our suffix table. */
             const char *domain = (qname[0] != '\0') ? qname : aname;
 
-            dns_cache_insert(cache, ip, domain, ttl);
+            dns_cache_insert_at(cache, ip, domain, ttl, now);
             a_records++;
         }
 
@@ -1156,37 +728,203 @@ int dns_parse_response(dns_cache_t *cache, const uint8_t *pkt, size_t pkt_len) {
 
 /* ── Sniffer thread ──────────────────────────────────────────── */
 
+static int g_sniff_mdns = 0;
+static dns_tap_fn g_sniff_tap = NULL;
+
+void dns_sniff_set_mdns(int enable) {
+    g_sniff_mdns = enable ? 1 : 0;
+}
+
+void dns_sniff_set_tap(dns_tap_fn tap) {
+    g_sniff_tap = tap;
+}
+
+static int dns_sport_wanted(uint16_t sport) {
+    return sport == 53 || (g_sniff_mdns && sport == 5353);
+}
+
 /*
- * Background thread: opens an AF_PACKET socket to capture *all* IPv4
- * traffic seen on any interface — including transit (forwarded) traffic
- * the router routes between LAN and WAN. AF_INET SOCK_RAW only delivers
- * host-bound packets, so it misses DNS responses for clients that
- * resolve directly via upstream (e.g. devices configured with 1.1.1.1).
- *
- * SOCK_DGRAM mode strips the link-layer header so packets start at IP.
- * We deduplicate by ignoring PACKET_OUTGOING — the kernel can deliver
- * the same forwarded frame twice (once on ingress, once on egress).
- *
- * Uses select() with 1-second timeout to check g_stop periodically.
- * Requires CAP_NET_RAW or root.
+ * Offsets are from the start of the IPv4 header (cooked AF_PACKET).
+ * Non-first fragments carry no UDP header and are dropped; a first
+ * fragment of a large answer passes and is parsed as far as it goes.
+ * Out-of-range loads make the kernel return 0 (drop).
  */
-void *dns_sniff_thread(void *arg) {
-    dns_cache_t *cache = (dns_cache_t *)arg;
-    if (!cache) {
-        return NULL;
+int dns_sniff_attach_filter(int sock) {
+    uint32_t alt_port = g_sniff_mdns ? 5353 : 53;
+    struct sock_filter code[] = {
+        BPF_STMT(BPF_LD  | BPF_B | BPF_ABS, 9),                 /* A = ip->protocol   */
+        BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, IPPROTO_UDP, 0, 7),
+        BPF_STMT(BPF_LD  | BPF_H | BPF_ABS, 6),                 /* A = ip->frag_off   */
+        BPF_JUMP(BPF_JMP | BPF_JSET | BPF_K, 0x1FFF, 5, 0),
+        BPF_STMT(BPF_LDX | BPF_B | BPF_MSH, 0),                 /* X = ip->ihl * 4    */
+        BPF_STMT(BPF_LD  | BPF_H | BPF_IND, 0),                 /* A = udp->source    */
+        BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, 53, 1, 0),
+        BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, alt_port, 0, 1),
+        BPF_STMT(BPF_RET | BPF_K, DNS_SNAPLEN),                 /* accept, truncated  */
+        BPF_STMT(BPF_RET | BPF_K, 0),                           /* drop               */
+    };
+    struct sock_fprog prog = {
+        .len    = (unsigned short)(sizeof(code) / sizeof(code[0])),
+        .filter = code,
+    };
+    return setsockopt(sock, SOL_SOCKET, SO_ATTACH_FILTER, &prog, sizeof(prog));
+}
+
+/* One captured packet, L3 onwards. Shared by the ring and the
+ * recvfrom() paths. */
+static void dns_handle_packet(dns_cache_t *cache, const uint8_t *buf, size_t n,
+                              uint8_t pkttype) {
+    if (n < sizeof(struct iphdr) + sizeof(struct udphdr)) {
+        return;
     }
 
-    /* AF_PACKET captures every IPv4 packet seen on the host's interfaces,
-     * including forwarded/transit traffic. ETH_P_IP filters to IPv4 only
-     * at the kernel level (cheap). */
-    int sock = socket(AF_PACKET, SOCK_DGRAM, htons(ETH_P_IP));
-    if (sock < 0) {
-        log_msg(LOG_WARN, "dns", "failed to open AF_PACKET socket (need CAP_NET_RAW), DNS snooping disabled");
-        return NULL;
+    /* PACKET_OUTGOING means the kernel is showing us a frame we already
+     * saw on the way in (or one we generated locally). Skip to dedupe. */
+    if (pkttype == PACKET_OUTGOING) {
+        return;
+    }
+
+    /* Parse IP header (cooked AF_PACKET starts at L3) */
+    const struct iphdr *iph = (const struct iphdr *)buf;
+    if (iph->protocol != IPPROTO_UDP) {
+        return;
+    }
+
+    size_t ip_hlen = (size_t)(iph->ihl * 4);
+    if (ip_hlen < 20 || ip_hlen + sizeof(struct udphdr) > n) {
+        return;
+    }
+
+    const struct udphdr *udph = (const struct udphdr *)(buf + ip_hlen);
+    uint16_t src_port = ntohs(udph->source);
+    if (!dns_sport_wanted(src_port)) {
+        return;
+    }
+
+    size_t dns_offset = ip_hlen + sizeof(struct udphdr);
+    if (dns_offset >= n) {
+        return;
+    }
+
+    double now = dns_now();
+    if (g_sniff_tap) {
+        g_sniff_tap(buf + dns_offset, n - dns_offset, now);
+    }
+    int count = dns_parse_response_at(cache, buf + dns_offset, n - dns_offset, now);
+    if (count > 0) {
+        log_msg(LOG_DEBUG, "dns", "parsed %d A record(s)", count);
+    }
+}
+
+/* ── TPACKET_V3 RX ring ──────────────────────────────────────── */
+
+/* 4 × 32 KiB: with the socket filter only DNS answers land here, and a
+ * block holds ~20 full-snaplen answers. Frames are variable-length in
+ * V3; the frame size only has to fit one DNS_SNAPLEN capture. */
+#define DNS_RING_BLOCK_SIZE  (32u * 1024u)
+#define DNS_RING_BLOCKS      4u
+#define DNS_RING_FRAME_SIZE  2048u
+#define DNS_RING_TOV_MS      250     /* block retire timeout = poll bound */
+
+typedef struct {
+    uint8_t *map;
+    size_t   map_len;
+    uint32_t block_size;
+    uint32_t block_nr;
+    uint32_t cur;        /* next block to hand back to the kernel */
+} dns_ring_t;
+
+/* Switch `sock` to TPACKET_V3 and map the ring. On failure the socket
+ * is left usable for plain recvfrom(). Returns 0, -1. */
+static int dns_ring_open(int sock, dns_ring_t *ring) {
+    memset(ring, 0, sizeof(*ring));
+
+    int version = TPACKET_V3;
+    if (setsockopt(sock, SOL_PACKET, PACKET_VERSION, &version, sizeof(version)) != 0) {
+        return -1;
+    }
+
+    struct tpacket_req3 req;
+    memset(&req, 0, sizeof(req));
+    req.tp_block_size     = DNS_RING_BLOCK_SIZE;
+    req.tp_block_nr       = DNS_RING_BLOCKS;
+    req.tp_frame_size     = DNS_RING_FRAME_SIZE;
+    req.tp_frame_nr       = (DNS_RING_BLOCK_SIZE / DNS_RING_FRAME_SIZE) * DNS_RING_BLOCKS;
+    req.tp_retire_blk_tov = DNS_RING_TOV_MS;
+    if (setsockopt(sock, SOL_PACKET, PACKET_RX_RING, &req, sizeof(req)) != 0) {
+        goto fail;
+    }
+
+    size_t len = (size_t)req.tp_block_size * req.tp_block_nr;
+    void *map = mmap(NULL, len, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_LOCKED, sock, 0);
+    if (map == MAP_FAILED) {
+        /* MAP_LOCKED needs RLIMIT_MEMLOCK headroom; the ring works
+         * without it, only pageable. */
+        map = mmap(NULL, len, PROT_READ | PROT_WRITE, MAP_SHARED, sock, 0);
+    }
+    if (map == MAP_FAILED) {
+        memset(&req, 0, sizeof(req));
+        setsockopt(sock, SOL_PACKET, PACKET_RX_RING, &req, sizeof(req));
+        goto fail;
+    }
+
+    ring->map        = map;
+    ring->map_len    = len;
+    ring->block_size = req.tp_block_size;
+    ring->block_nr   = req.tp_block_nr;
+    return 0;
+
+fail:
+    version = TPACKET_V1;
+    setsockopt(sock, SOL_PACKET, PACKET_VERSION, &version, sizeof(version));
+    return -1;
+}
+
+static void dns_ring_close(dns_ring_t *ring) {
+    if (ring->map) {
+        munmap(ring->map, ring->map_len);
+    }
+    memset(ring, 0, sizeof(*ring));
+}
+
+/* Walk every block the kernel has retired to us, starting at ring->cur,
+ * parse its frames in place and give the block back. */
+static void dns_ring_drain(dns_ring_t *ring, dns_cache_t *cache) {
+    for (;;) {
+        struct tpacket_block_desc *bd =
+            (struct tpacket_block_desc *)(ring->map + (size_t)ring->cur * ring->block_size);
+        if (!(__atomic_load_n(&bd->hdr.bh1.block_status, __ATOMIC_ACQUIRE) & TP_STATUS_USER)) {
+            return;
+        }
+
+        uint32_t num = bd->hdr.bh1.num_pkts;
+        const uint8_t *fp = (const uint8_t *)bd + bd->hdr.bh1.offset_to_first_pkt;
+        for (uint32_t i = 0; i < num; i++) {
+            const struct tpacket3_hdr *ph = (const struct tpacket3_hdr *)fp;
+            const struct sockaddr_ll *sll = (const struct sockaddr_ll *)
+                (fp + TPACKET_ALIGN(sizeof(struct tpacket3_hdr)));
+            dns_handle_packet(cache, fp + ph->tp_net, ph->tp_snaplen, sll->sll_pkttype);
+            fp += ph->tp_next_offset;
+        }
+
+        __atomic_store_n(&bd->hdr.bh1.block_status, TP_STATUS_KERNEL, __ATOMIC_RELEASE);
+        ring->cur = (ring->cur + 1) % ring->block_nr;
     }
+}
 
-    log_msg(LOG_INFO, "dns", "DNS sniffer thread started (AF_PACKET, captures transit DNS)");
+static void dns_sniff_ring(int sock, dns_ring_t *ring, dns_cache_t *cache) {
+    struct pollfd pfd = { .fd = sock, .events = POLLIN | POLLERR };
+    while (!g_stop) {
+        dns_ring_drain(ring, cache);
+        /* A partially filled block is retired after DNS_RING_TOV_MS; an
+         * idle ring retires nothing, so the same bound paces g_stop. */
+        poll(&pfd, 1, DNS_RING_TOV_MS);
+    }
+}
 
+/* ── Fallback: one recvfrom() per packet ─────────────────────── */
+
+static void dns_sniff_recv(int sock, dns_cache_t *cache) {
     uint8_t buf[2048];
     struct sockaddr_ll src_addr;
     socklen_t addr_len;
@@ -1208,48 +946,92 @@ void *dns_sniff_thread(void *arg) {
         addr_len = sizeof(src_addr);
         ssize_t n = recvfrom(sock, buf, sizeof(buf), 0,
                              (struct sockaddr *)&src_addr, &addr_len);
-        if (n < (ssize_t)(sizeof(struct iphdr) + sizeof(struct udphdr))) {
+        if (n <= 0) {
             continue;
         }
+        dns_handle_packet(cache, buf, (size_t)n, src_addr.sll_pkttype);
+    }
+}
 
-        /* PACKET_OUTGOING means the kernel is showing us a frame we already
-         * saw on the way in (or one we generated locally). Skip to dedupe. */
-        if (src_addr.sll_pkttype == PACKET_OUTGOING) {
-            continue;
-        }
+/*
+ * Background thread: opens an AF_PACKET socket to capture *all* IPv4
+ * traffic seen on any interface — including transit (forwarded) traffic
+ * the router routes between LAN and WAN. AF_INET SOCK_RAW only delivers
+ * host-bound packets, so it misses DNS responses for clients that
+ * resolve directly via upstream (e.g. devices configured with 1.1.1.1).
+ *
+ * SOCK_DGRAM mode strips the link-layer header so packets start at IP.
+ * We deduplicate by ignoring PACKET_OUTGOING — the kernel can deliver
+ * the same forwarded frame twice (once on ingress, once on egress).
+ *
+ * A socket filter (dns_sniff_attach_filter) restricts delivery to DNS
+ * answers; if it cannot be attached the userspace checks below still
+ * apply, only at the old cost.
+ *
+ * Packets are read from a TPACKET_V3 ring shared with the kernel: one
+ * poll() per retired block instead of a select() + recvfrom() copy per
+ * packet. If the ring cannot be set up (old kernel, no memory) the
+ * thread falls back to recvfrom() with a 1-second select() timeout.
+ * Either way g_stop is checked at least once a second.
+ * Requires CAP_NET_RAW or root.
+ */
+void *dns_sniff_thread(void *arg) {
+    dns_cache_t *cache = (dns_cache_t *)arg;
+    if (!cache) {
+        return NULL;
+    }
 
-        /* Parse IP header (cooked AF_PACKET starts at L3) */
-        struct iphdr *iph = (struct iphdr *)buf;
-        if (iph->protocol != IPPROTO_UDP) {
-            continue;
-        }
+    /* AF_PACKET captures every IPv4 packet seen on the host's interfaces,
+     * including forwarded/transit traffic. ETH_P_IP filters to IPv4 only
+     * at the kernel level (cheap). */
+    int sock = socket(AF_PACKET, SOCK_DGRAM, htons(ETH_P_IP));
+    if (sock < 0) {
+        log_msg(LOG_WARN, "dns", "failed to open AF_PACKET socket (need CAP_NET_RAW), DNS snooping disabled");
+        return NULL;
+    }
 
-        size_t ip_hlen = (size_t)(iph->ihl * 4);
-        if (ip_hlen < 20 || ip_hlen + sizeof(struct udphdr) > (size_t)n) {
-            continue;
-        }
+    /* Packets queued before the filter lands are caught by the
+     * userspace checks below. */
+    int filtered = dns_sniff_attach_filter(sock) == 0;
+    if (!filtered) {
+        log_msg(LOG_WARN, "dns", "socket filter not attached, filtering in userspace");
+    }
 
-        struct udphdr *udph = (struct udphdr *)(buf + ip_hlen);
-        uint16_t src_port = ntohs(udph->source);
-        if (src_port != 53) {
-            continue;
-        }
+    dns_ring_t ring;
+    int use_ring = dns_ring_open(sock, &ring) == 0;
+    if (!use_ring) {
+        log_msg(LOG_WARN, "dns", "TPACKET_V3 ring unavailable, using recvfrom()");
+    }
 
-        size_t dns_offset = ip_hlen + sizeof(struct udphdr);
-        if (dns_offset >= (size_t)n) {
-            continue;
-        }
+    log_msg(LOG_INFO, "dns", "DNS sniffer thread started (AF_PACKET, captures transit DNS%s%s%s)",
+            filtered ? ", kernel-filtered" : "", use_ring ? ", mmap ring" : "",
+            g_sniff_mdns ? ", +mDNS" : "");
 
-        const uint8_t *dns_payload = buf + dns_offset;
-        size_t dns_len = (size_t)n - dns_offset;
+    if (use_ring) {
+        dns_sniff_ring(sock, &ring, cache);
+    } else {
+        dns_sniff_recv(sock, cache);
+    }
 
-        int count = dns_parse_response(cache, dns_payload, dns_len);
-        if (count > 0) {
-            log_msg(LOG_DEBUG, "dns", "parsed %d A record(s)", count);
-        }
+    /* Delivered/dropped counts and this thread's CPU time, so the cost
+     * of snooping can be read off the log after a load test. The V3
+     * struct is a superset of tpacket_stats; V1 fills the first two. */
+    struct tpacket_stats_v3 st;
+    socklen_t st_len = sizeof(st);
+    memset(&st, 0, sizeof(st));
+    getsockopt(sock, SOL_PACKET, PACKET_STATISTICS, &st, &st_len);
+    struct rusage ru;
+    double cpu_s = 0.0;
+    if (getrusage(RUSAGE_THREAD, &ru) == 0) {
+        cpu_s = (double)(ru.ru_utime.tv_sec + ru.ru_stime.tv_sec) +
+                (double)(ru.ru_utime.tv_usec + ru.ru_stime.tv_usec) / 1e6;
     }
 
+    if (use_ring) {
+        dns_ring_close(&ring);
+    }
     close(sock);
-    log_msg(LOG_INFO, "dns", "DNS sniffer thread stopped");
+    log_msg(LOG_INFO, "dns", "DNS sniffer thread stopped (%u packets delivered, %u dropped, %.2fs CPU)",
+            st.tp_packets, st.tp_drops, cpu_s);
     return NULL;
 }
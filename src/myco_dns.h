@@ -7,7 +7,8 @@
  * traffic on port 443 (HTTPS/QUIC) by domain name.
  *
  * Architecture:
- *   - dns_cache_t: LRU cache mapping IP → (domain, persona, TTL)
+ *   - dns_cache_t: open-addressing hash mapping IP → (domain, persona,
+ *     TTL); lock-free readers (seqlock), expiry-ordered eviction
  *   - dns_parse_response(): paranoid parser for DNS response packets
  *   - dns_sniff_thread(): background thread with raw socket on UDP 53
  *   - dns_domain_to_hint(): suffix-match domain → persona lookup
@@ -21,14 +22,19 @@
 
 #include "myco_types.h"
 #include "myco_service.h"
+#include <stdatomic.h>
 #include <stdint.h>
 #include <stddef.h>
 #include <pthread.h>
 
 /* ── DNS cache entry ──────────────────────────────────────────── */
 
-#define DNS_CACHE_SIZE    64
-#define DNS_DOMAIN_MAXLEN 128
+#define DNS_CACHE_SIZE     1024   /* default entry budget */
+#define DNS_CACHE_MIN_SIZE 64
+#define DNS_CACHE_MAX_SIZE 65536
+#define DNS_DOMAIN_MAXLEN  128
+#define DNS_BATCH_CHUNK    16     /* probes in flight per batch read section */
+#define DNS_CHANGE_LOG     256    /* recent IPs whose answer changed (power of two) */
 
 typedef struct {
     uint32_t  ip;                         /* IPv4 in network byte order */
@@ -36,35 +42,75 @@ typedef struct {
     persona_t hint;                       /* persona derived from domain suffix */
     service_t service;                    /* finer-grained service from domain suffix (v3) */
     double    expire_time;                /* monotonic time when entry expires */
+    uint32_t  heap_pos;                   /* index in the expiry heap */
     int       active;                     /* 1 = occupied slot */
 } dns_entry_t;
 
+/*
+ * Linear-probing hash on the IP, at most 3/4 full. Writers (the sniffer
+ * thread) serialise on `lock` and bump `seq` to odd while they mutate;
+ * readers take no lock — they probe, then retry if `seq` was odd or
+ * changed underneath them. A min-heap of slot indices keyed by
+ * expire_time gives the next entry to expire (or to evict when full)
+ * in O(log n).
+ */
 typedef struct {
-    dns_entry_t     entries[DNS_CACHE_SIZE];
-    pthread_mutex_t lock;
+    dns_entry_t    *entries;
+    uint32_t       *heap;        /* slot indices, earliest expiry first */
+    uint32_t        slots;       /* power of two */
+    uint32_t        capacity;    /* entry budget (≤ 3/4 of slots) */
+    uint32_t        count;
+    atomic_uint     seq;         /* seqlock sequence, odd = write in progress */
+    pthread_mutex_t lock;        /* writers, and change-log readers */
+    uint64_t        change_seq;  /* changes logged so far (under lock) */
+    uint32_t        change_ips[DNS_CHANGE_LOG];
 } dns_cache_t;
 
 /* ── Cache operations ─────────────────────────────────────────── */
 
-/* Initialize the cache (zero all entries, init mutex) */
+/* Initialise a cache holding up to `capacity` IPs (clamped to
+ * [DNS_CACHE_MIN_SIZE, DNS_CACHE_MAX_SIZE]). Returns 0, -1 on OOM — the
+ * cache is then empty and every lookup misses. */
+int  dns_cache_init_sized(dns_cache_t *cache, uint32_t capacity);
+
+/* dns_cache_init_sized(cache, DNS_CACHE_SIZE). */
 void dns_cache_init(dns_cache_t *cache);
 
-/* Destroy mutex resources */
+/* Free the table and destroy the writer lock. */
 void dns_cache_destroy(dns_cache_t *cache);
 
 /* Look up an IP in the cache. Returns the hinted persona, or
  * PERSONA_UNKNOWN if the IP is not cached or the entry has expired.
- * Thread-safe (acquires lock). */
+ * Lock-free; safe against a concurrent dns_cache_insert(). */
 persona_t dns_cache_lookup(dns_cache_t *cache, uint32_t ip);
 
 /* Same as dns_cache_lookup but returns the finer-grained service_t.
- * Returns SVC_UNKNOWN if IP not cached or expired. Thread-safe.
+ * Returns SVC_UNKNOWN if IP not cached or expired. Lock-free.
  * Added in v3 for flow-aware classification (architecture §5). */
 service_t dns_cache_lookup_service(dns_cache_t *cache, uint32_t ip);
 
+/* Look up n IPs at once against a caller-supplied `now` (CLOCK_MONOTONIC
+ * seconds, as used by the main loop). hints[i] / services[i] receive the
+ * result for ips[i]; either output array may be NULL. Probes are issued
+ * DNS_BATCH_CHUNK at a time with their home slots prefetched, each chunk
+ * read under one seqlock section. Lock-free like the single lookups. */
+void dns_cache_lookup_batch(dns_cache_t *cache, const uint32_t *ips, size_t n,
+                            double now, persona_t *hints, service_t *services);
+
+/* Change feed for incremental consumers. An IP is logged when an insert
+ * gives it a different hint/service than it had, or when an entry with a
+ * hint is evicted or reclaimed. Plain TTL expiry without a reclaim is
+ * not logged; consumers re-check on their own schedule for that.
+ * Copies IPs logged after *cursor into ips[0..max) and advances *cursor.
+ * Returns the count, or -1 when the consumer fell more than
+ * DNS_CHANGE_LOG (or `max`) behind — treat every IP as changed then. */
+int dns_cache_changes_since(dns_cache_t *cache, uint64_t *cursor,
+                            uint32_t *ips, int max);
+
 /* Insert or update a cache entry. Resolves domain→persona via suffix
- * matching. TTL is in seconds (from DNS response). Evicts LRU if full.
- * Thread-safe (acquires lock). */
+ * matching. TTL is in seconds (from DNS response). Expired entries are
+ * reclaimed first; when still full, the entry closest to expiry is
+ * evicted. Thread-safe against readers and other writers. */
 void dns_cache_insert(dns_cache_t *cache, uint32_t ip,
                       const char *domain, uint32_t ttl_s);
 
@@ -88,8 +134,37 @@ service_t dns_domain_to_service(const char *domain);
  * PARANOID: rejects malformed packets silently (no crash, no log spam). */
 int dns_parse_response(dns_cache_t *cache, const uint8_t *pkt, size_t pkt_len);
 
+/* Same, with TTLs counted from `now` (CLOCK_MONOTONIC seconds) instead
+ * of the current time: the sniffer passes its capture time, trace replay
+ * a virtual clock. */
+int dns_parse_response_at(dns_cache_t *cache, const uint8_t *pkt, size_t pkt_len,
+                          double now);
+
 /* ── Sniffer thread ───────────────────────────────────────────── */
 
+/* Bytes of each accepted packet the kernel copies to us (L3 onwards):
+ * IP + UDP headers plus an EDNS-sized answer. Longer answers arrive
+ * truncated; the parser keeps the A records that fit. */
+#define DNS_SNAPLEN 1536
+
+/* Also accept mDNS answers (UDP source port 5353). Takes effect for
+ * sockets filtered after the call — set before starting the thread. */
+void dns_sniff_set_mdns(int enable);
+
+/* Called with every DNS payload the sniffer is about to parse, and the
+ * capture time it parses it at (the trace recorder). Runs on the sniffer
+ * thread. NULL (default) disables. Set before starting the thread. */
+typedef void (*dns_tap_fn)(const uint8_t *pkt, size_t len, double now);
+void dns_sniff_set_tap(dns_tap_fn tap);
+
+/* Attach the classic BPF socket filter (SO_ATTACH_FILTER) used by the
+ * sniffer: unfragmented-or-first-fragment IPv4/UDP with source port 53
+ * (and 5353 when mDNS is on), truncated to DNS_SNAPLEN. Everything else
+ * is dropped in the kernel before it is copied. The filter reads from
+ * offset 0, so `sock` must deliver packets starting at the IP header
+ * (AF_PACKET SOCK_DGRAM). Returns 0, -1 with errno set. */
+int dns_sniff_attach_filter(int sock);
+
 /* Background thread function. Opens a raw socket on UDP port 53,
  * captures DNS responses, and populates the cache.
  * Arg: pointer to dns_cache_t. Checks g_stop each second.
@@ -3,6 +3,7 @@
  * myco_ebpf.c — eBPF load/attach/read/shutdown
  */
 #include "myco_ebpf.h"
+#include "myco_bpftc.h"
 #include "myco_log.h"
 
 #include <stdio.h>
@@ -14,21 +15,41 @@
 #include <bpf/libbpf.h>
 #include <bpf/bpf.h>
 #include <linux/bpf.h>
+#ifdef HAVE_BPF_SKEL
+#include "mycoflow.skel.h"   /* generated by bpftool at build time */
+static struct mycoflow_bpf *g_skel = NULL;
+#endif
 static struct bpf_object *g_bpf_obj = NULL;
 static int g_map_fd = -1;
-static int g_prog_pinned = 0;  /* 1 if pin to MYCO_BPF_PIN_PATH succeeded */
-#define MYCO_BPF_PIN_PATH "/sys/fs/bpf/myco_tc_prog"
+static int g_prog_fd = -1;
+static bpftc_filter_t g_tc;
+#else
+static char g_ebpf_iface[32];
+static char g_ebpf_dir[16];
 #endif
 
 static int  g_ebpf_attached = 0;
-static char g_ebpf_iface[32];
-static char g_ebpf_dir[16];
 
 int ebpf_init(const myco_config_t *cfg) {
     if (!cfg || !cfg->ebpf_enabled) {
         return 0;
     }
 #ifdef HAVE_LIBBPF
+#ifdef HAVE_BPF_SKEL
+    /* Embedded copy, unless ebpf_obj names a file (development override). */
+    if (access(cfg->ebpf_obj, R_OK) != 0) {
+        g_skel = mycoflow_bpf__open_and_load();
+        if (!g_skel) {
+            log_msg(LOG_WARN, "ebpf", "embedded bpf object failed to load");
+            return -1;
+        }
+        g_bpf_obj = g_skel->obj;
+        g_prog_fd = bpf_program__fd(g_skel->progs.tc_ingress);
+        g_map_fd  = bpf_map__fd(g_skel->maps.myco_stats);
+        log_msg(LOG_INFO, "ebpf", "embedded bpf object loaded (no attach yet)");
+        return 0;
+    }
+#endif
     if (access(cfg->ebpf_obj, R_OK) != 0) {
         log_msg(LOG_WARN, "ebpf", "ebpf obj not found: %s", cfg->ebpf_obj);
         return -1;
@@ -55,22 +76,8 @@ int ebpf_init(const myco_config_t *cfg) {
 
     log_msg(LOG_INFO, "ebpf", "bpf object loaded (no attach yet): %s", cfg->ebpf_obj);
 
-    /* Pin the prog so ebpf_attach_tc reuses the same map instance.
-     * Requires bpffs mounted at /sys/fs/bpf (e.g. "mount -t bpf none /sys/fs/bpf").
-     * On failure TC falls back to obj-based load (separate map — counters read 0). */
-    /* bpf_program__next(NULL, obj) returns the first program; available since libbpf 0.1 */
-    struct bpf_program *first_prog = bpf_program__next(NULL, g_bpf_obj);
-    if (first_prog) {
-        unlink(MYCO_BPF_PIN_PATH);
-        if (bpf_program__pin(first_prog, MYCO_BPF_PIN_PATH) == 0) {
-            g_prog_pinned = 1;
-            log_msg(LOG_INFO, "ebpf", "prog pinned: %s", MYCO_BPF_PIN_PATH);
-        } else {
-            log_msg(LOG_WARN, "ebpf",
-                    "prog pin failed (bpffs not mounted?): %s — TC will use separate map instance, counters will read 0",
-                    MYCO_BPF_PIN_PATH);
-        }
-    }
+    struct bpf_program *first_prog = bpf_object__next_program(g_bpf_obj, NULL);
+    g_prog_fd = first_prog ? bpf_program__fd(first_prog) : -1;
 
     g_map_fd = bpf_object__find_map_fd_by_name(g_bpf_obj, "myco_stats");
     if (g_map_fd < 0) {
@@ -97,12 +104,27 @@ int ebpf_attach_tc(const myco_config_t *cfg) {
         return 0;
     }
 
+    const char *dir = cfg->ebpf_tc_dir[0] ? cfg->ebpf_tc_dir : "ingress";
+
+#ifdef HAVE_LIBBPF
+    /* Attach the program ebpf_init() loaded, so TC and the map reader
+     * share one instance without a bpffs pin. */
+    if (g_prog_fd < 0) {
+        log_msg(LOG_WARN, "ebpf", "tc attach skipped: bpf obj not loaded");
+        return -1;
+    }
+    if (bpftc_attach(&g_tc, cfg->egress_iface, strcmp(dir, "egress") == 0,
+                     g_prog_fd, MYCO_TC_PRIO_STATS) != 0) {
+        log_msg(LOG_WARN, "ebpf", "tc attach failed on %s (%s)", cfg->egress_iface, dir);
+        return -1;
+    }
+#else
+    /* No libbpf: let tc load the object itself. The fixed pref keeps
+     * detach to our own filter. */
     if (access(cfg->ebpf_obj, R_OK) != 0) {
         log_msg(LOG_WARN, "ebpf", "ebpf obj not found: %s", cfg->ebpf_obj);
         return -1;
     }
-
-    const char *dir = cfg->ebpf_tc_dir[0] ? cfg->ebpf_tc_dir : "ingress";
     strncpy(g_ebpf_iface, cfg->egress_iface, sizeof(g_ebpf_iface) - 1);
     g_ebpf_iface[sizeof(g_ebpf_iface) - 1] = '\0';
     strncpy(g_ebpf_dir, dir, sizeof(g_ebpf_dir) - 1);
@@ -116,19 +138,9 @@ int ebpf_attach_tc(const myco_config_t *cfg) {
     }
     system(cmd);
 
-#ifdef HAVE_LIBBPF
-    /* Use the libbpf-pinned prog so TC and the map reader share the same instance */
-    if (access(MYCO_BPF_PIN_PATH, F_OK) == 0) {
-        n = snprintf(cmd, sizeof(cmd), "tc filter replace dev %s %s bpf da pinned %s",
-                     cfg->egress_iface, dir, MYCO_BPF_PIN_PATH);
-    } else {
-        n = snprintf(cmd, sizeof(cmd), "tc filter replace dev %s %s bpf da obj %s sec tc",
-                     cfg->egress_iface, dir, cfg->ebpf_obj);
-    }
-#else
-    n = snprintf(cmd, sizeof(cmd), "tc filter replace dev %s %s bpf da obj %s sec tc",
-                 cfg->egress_iface, dir, cfg->ebpf_obj);
-#endif
+    n = snprintf(cmd, sizeof(cmd),
+                 "tc filter replace dev %s %s pref %u handle 0x%x bpf da obj %s sec tc",
+                 cfg->egress_iface, dir, MYCO_TC_PRIO_STATS, MYCO_TC_HANDLE, cfg->ebpf_obj);
     if (n < 0 || (size_t)n >= sizeof(cmd)) {
         log_msg(LOG_WARN, "ebpf", "tc filter cmd truncated");
         return -1;
@@ -138,6 +150,7 @@ int ebpf_attach_tc(const myco_config_t *cfg) {
         log_msg(LOG_WARN, "ebpf", "tc attach failed (rc=%d)", rc);
         return -1;
     }
+#endif
     g_ebpf_attached = 1;
     log_msg(LOG_INFO, "ebpf", "tc attach ok (%s)", dir);
     return 0;
@@ -174,23 +187,29 @@ int ebpf_read_stats(uint64_t *packets, uint64_t *bytes) {
 }
 
 void ebpf_shutdown(void) {
-    if (g_ebpf_attached && g_ebpf_iface[0]) {
-        char cmd[512];
-        const char *dir = g_ebpf_dir[0] ? g_ebpf_dir : "ingress";
-        snprintf(cmd, sizeof(cmd), "tc filter del dev %s %s 2>/dev/null", g_ebpf_iface, dir);
-        system(cmd);
-        snprintf(cmd, sizeof(cmd), "tc qdisc del dev %s clsact 2>/dev/null", g_ebpf_iface);
-        system(cmd);
-    }
 #ifdef HAVE_LIBBPF
-    if (g_prog_pinned) {
-        unlink(MYCO_BPF_PIN_PATH);
-        g_prog_pinned = 0;
+    bpftc_detach(&g_tc);
+#ifdef HAVE_BPF_SKEL
+    if (g_skel) {
+        mycoflow_bpf__destroy(g_skel);   /* closes g_bpf_obj too */
+        g_skel = NULL;
+        g_bpf_obj = NULL;
     }
+#endif
     if (g_bpf_obj) {
         bpf_object__close(g_bpf_obj);
         g_bpf_obj = NULL;
     }
+    g_map_fd = -1;
+    g_prog_fd = -1;
+#else
+    if (g_ebpf_attached && g_ebpf_iface[0]) {
+        char cmd[512];
+        const char *dir = g_ebpf_dir[0] ? g_ebpf_dir : "ingress";
+        snprintf(cmd, sizeof(cmd), "tc filter del dev %s %s pref %u 2>/dev/null",
+                 g_ebpf_iface, dir, MYCO_TC_PRIO_STATS);
+        system(cmd);
+    }
 #endif
     g_ebpf_attached = 0;
 }
@@ -2,138 +2,535 @@
  * MycoFlow — Bio-Inspired Reflexive QoS System
  * myco_flow.c — Userspace LRU flow table
  *
- * Tracks per-flow statistics using a simple hash table with LRU eviction.
+ * Tracks per-flow statistics in a Robin Hood open-addressing hash (bounded
+ * probe length, backward-shift deletion, probe-window LRU eviction).
  * Can be populated from /proc/net/nf_conntrack or future eBPF per-flow maps.
  */
 #include "myco_flow.h"
+#include "myco_ctparse.h"
 #include "myco_log.h"
 
 #include <arpa/inet.h>
 #include <errno.h>
+#include <fcntl.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
+#include <unistd.h>
 
 /* ── Hash ───────────────────────────────────────────────────── */
 
-static uint32_t flow_hash(const flow_key_t *key) {
-    /* FNV-1a inspired simple hash */
-    uint32_t h = 2166136261u;
-    const uint8_t *p = (const uint8_t *)key;
-    for (size_t i = 0; i < sizeof(*key); i++) {
-        h ^= p[i];
-        h *= 16777619u;
-    }
-    return h % FLOW_TABLE_SIZE;
+/* Hashes the key fields, not the struct bytes, so padding never leaks
+ * into the hash. 64-bit multiply-xorshift finaliser (splitmix64): cheap
+ * and well mixed in the low bits the mask keeps. */
+uint32_t flow_key_hash(const flow_key_t *key) {
+    uint64_t h = ((uint64_t)key->src_ip << 32) | key->dst_ip;
+    h ^= ((uint64_t)key->src_port << 40) ^ ((uint64_t)key->dst_port << 16) ^
+         key->protocol;
+    h ^= h >> 30;
+    h *= 0xBF58476D1CE4E5B9ull;
+    h ^= h >> 27;
+    h *= 0x94D049BB133111EBull;
+    h ^= h >> 31;
+    return (uint32_t)h;
 }
 
 static int key_equal(const flow_key_t *a, const flow_key_t *b) {
-    return memcmp(a, b, sizeof(*a)) == 0;
+    return a->src_ip == b->src_ip && a->dst_ip == b->dst_ip &&
+           a->src_port == b->src_port && a->dst_port == b->dst_port &&
+           a->protocol == b->protocol;
+}
+
+/* Distance of an occupied slot from its home bucket. */
+static uint32_t probe_dist(const flow_entry_t *e, uint32_t pos, uint32_t mask) {
+    return (pos - (e->hash & mask)) & mask;
+}
+
+/* ── Sizing ─────────────────────────────────────────────────── */
+
+static uint32_t round_pow2(uint32_t v) {
+    uint32_t p = 1;
+    while (p < v && p < 0x80000000u) p <<= 1;
+    return p;
+}
+
+/* Slot count able to hold `max_flows` under the 7/8 load ceiling. */
+static uint32_t capacity_for(uint32_t max_flows) {
+    if (max_flows == 0) max_flows = FLOW_TABLE_DEFAULT_CAPACITY;
+    uint64_t slots = ((uint64_t)max_flows * 8 + 6) / 7;
+    if (slots > FLOW_TABLE_MAX_CAPACITY) slots = FLOW_TABLE_MAX_CAPACITY;
+    uint32_t cap = round_pow2((uint32_t)slots);
+    return cap < FLOW_TABLE_MIN_CAPACITY ? FLOW_TABLE_MIN_CAPACITY : cap;
+}
+
+uint32_t flow_table_auto_max_flows(void) {
+    FILE *fp = fopen("/proc/sys/net/netfilter/nf_conntrack_max", "r");
+    if (!fp) return FLOW_TABLE_DEFAULT_CAPACITY;
+    unsigned long v = 0;
+    int ok = fscanf(fp, "%lu", &v) == 1;
+    fclose(fp);
+    if (!ok || v == 0) return FLOW_TABLE_DEFAULT_CAPACITY;
+    if (v > FLOW_TABLE_MAX_LOAD(FLOW_TABLE_MAX_CAPACITY))
+        v = FLOW_TABLE_MAX_LOAD(FLOW_TABLE_MAX_CAPACITY);
+    return (uint32_t)v;
 }
 
 /* ── Init ───────────────────────────────────────────────────── */
 
-void flow_table_init(flow_table_t *ft) {
+int flow_table_init_sized(flow_table_t *ft, uint32_t max_flows) {
+    if (!ft) return -1;
+    memset(ft, 0, sizeof(*ft));
+    ft->max_capacity = capacity_for(max_flows);
+    ft->min_capacity = FLOW_TABLE_MIN_CAPACITY;
+    ft->capacity     = ft->min_capacity;
+    ft->mask         = ft->capacity - 1;
+    ft->entries      = calloc(ft->capacity, sizeof(flow_entry_t));
+    if (!ft->entries) {
+        log_msg(LOG_ERROR, "flow", "flow table alloc failed (%u slots)", ft->capacity);
+        ft->capacity = 0;
+        return -1;
+    }
+    return 0;
+}
+
+int flow_table_init(flow_table_t *ft) {
+    return flow_table_init_sized(ft, 0);
+}
+
+void flow_table_free(flow_table_t *ft) {
     if (!ft) return;
+    free(ft->entries);
+    free(ft->old_entries);
     memset(ft, 0, sizeof(*ft));
 }
 
-/* ── Lookup ─────────────────────────────────────────────────── */
+/* ── Robin Hood core ────────────────────────────────────────────
+ * Inserts steal the slot of any resident that is closer to its home
+ * than the incoming entry is to its own, so probe distances stay
+ * short and even. Lookups stop as soon as the resident's distance is
+ * smaller than the one probed so far — the key cannot be further on.
+ * Deletion shifts the following run back by one (no tombstones), which
+ * keeps that early-exit invariant true. Nothing ever sits more than
+ * FLOW_MAX_PROBE slots from home. All of this applies to the current
+ * array only; the old array during a resize is frozen (see below). */
+
+static int find_slot(const flow_table_t *ft, const flow_key_t *key, uint32_t h) {
+    uint32_t pos = h & ft->mask;
+    for (uint32_t dist = 0; dist <= FLOW_MAX_PROBE; dist++) {
+        const flow_entry_t *e = &ft->entries[pos];
+        if (!e->active || probe_dist(e, pos, ft->mask) < dist) {
+            return -1;
+        }
+        if (e->hash == h && key_equal(&e->key, key)) {
+            return (int)pos;
+        }
+        pos = (pos + 1) & ft->mask;
+    }
+    return -1;
+}
 
-const flow_entry_t *flow_table_lookup(const flow_table_t *ft,
-                                      const flow_key_t *key) {
-    if (!ft || !key) return NULL;
+static void delete_slot(flow_table_t *ft, uint32_t pos) {
+    for (;;) {
+        uint32_t next = (pos + 1) & ft->mask;
+        flow_entry_t *n = &ft->entries[next];
+        if (!n->active || probe_dist(n, next, ft->mask) == 0) {
+            ft->entries[pos].active = 0;
+            ft->entries[pos].hot    = 0;
+            break;
+        }
+        ft->entries[pos] = *n;
+        pos = next;
+    }
+    ft->count--;
+}
 
-    uint32_t idx = flow_hash(key);
-    for (int i = 0; i < FLOW_TABLE_SIZE; i++) {
-        uint32_t slot = (idx + i) % FLOW_TABLE_SIZE;
-        if (!ft->entries[slot].active) {
-            return NULL; /* empty slot = not found */
+/* Table at max load: drop the least recently seen flow within the
+ * incoming key's probe window. Bounded, and frees a slot exactly where
+ * the insert will need one — unlike a global LRU scan. */
+static void evict_for(flow_table_t *ft, uint32_t h) {
+    uint32_t pos = h & ft->mask;
+    int victim = -1;
+    double oldest = 0.0;
+    for (uint32_t i = 0; i <= FLOW_MAX_PROBE; i++) {
+        const flow_entry_t *e = &ft->entries[pos];
+        if (e->active && (victim < 0 || e->last_seen < oldest)) {
+            oldest = e->last_seen;
+            victim = (int)pos;
+        }
+        pos = (pos + 1) & ft->mask;
+    }
+    if (victim < 0) return;
+    delete_slot(ft, (uint32_t)victim);
+    ft->evictions++;
+}
+
+/* Place `in` in the current array. Returns its slot, or -1 if it was
+ * pushed past FLOW_MAX_PROBE (only possible in a pathological cluster).
+ * When a displaced resident overflows instead, that resident is dropped. */
+static int place_entry(flow_table_t *ft, const flow_entry_t *in) {
+    flow_entry_t cur = *in;
+    uint32_t pos  = cur.hash & ft->mask;
+    uint32_t dist = 0;
+    int placed = -1;
+    int carrying_new = 1;
+
+    for (;;) {
+        flow_entry_t *e = &ft->entries[pos];
+        if (!e->active) {
+            *e = cur;
+            ft->count++;
+            return carrying_new ? (int)pos : placed;
         }
-        if (key_equal(&ft->entries[slot].key, key)) {
-            return &ft->entries[slot];
+        uint32_t ed = probe_dist(e, pos, ft->mask);
+        if (ed < dist) {
+            flow_entry_t tmp = *e;
+            *e  = cur;
+            cur = tmp;
+            dist = ed;
+            if (carrying_new) {
+                placed = (int)pos;
+                carrying_new = 0;
+            }
         }
+        pos = (pos + 1) & ft->mask;
+        if (++dist > FLOW_MAX_PROBE) {
+            ft->probe_overflows++;
+            return placed;
+        }
+    }
+}
+
+/* ── Incremental resize ─────────────────────────────────────────
+ * start_resize() swaps in a fresh array and parks the previous one as
+ * old_entries. The old array is never inserted into again; flows leave
+ * it either through migrate_step() (slot order, FLOW_REHASH_STEP at a
+ * time) or when they are touched/removed. A migrated slot is simply
+ * cleared, so old-array lookups probe past empty slots — the Robin Hood
+ * early exit on a closer-to-home resident still holds, because frozen
+ * entries never move. */
+
+static int find_old(const flow_table_t *ft, const flow_key_t *key, uint32_t h) {
+    if (!ft->old_entries) return -1;
+    uint32_t pos = h & ft->old_mask;
+    for (uint32_t dist = 0; dist <= FLOW_MAX_PROBE; dist++) {
+        const flow_entry_t *e = &ft->old_entries[pos];
+        if (e->active) {
+            if (probe_dist(e, pos, ft->old_mask) < dist) return -1;
+            if (e->hash == h && key_equal(&e->key, key)) return (int)pos;
+        }
+        pos = (pos + 1) & ft->old_mask;
+    }
+    return -1;
+}
+
+static void finish_resize(flow_table_t *ft) {
+    free(ft->old_entries);
+    ft->old_entries  = NULL;
+    ft->old_capacity = 0;
+    ft->old_mask     = 0;
+    ft->migrate_pos  = 0;
+}
+
+/* Move up to `budget` old slots into the current array. */
+static void migrate_step(flow_table_t *ft, uint32_t budget) {
+    if (!ft->old_entries) return;
+    while (budget-- > 0 && ft->migrate_pos < ft->old_capacity) {
+        flow_entry_t *e = &ft->old_entries[ft->migrate_pos++];
+        if (!e->active) continue;
+        flow_entry_t moved = *e;
+        e->active = 0;
+        ft->count--;              /* place_entry() counts it again */
+        place_entry(ft, &moved);
+    }
+    if (ft->migrate_pos >= ft->old_capacity) {
+        finish_resize(ft);
+    }
+}
+
+static int start_resize(flow_table_t *ft, uint32_t new_capacity) {
+    if (ft->old_entries) {
+        migrate_step(ft, ft->old_capacity);   /* finish the previous one */
+    }
+    flow_entry_t *fresh = calloc(new_capacity, sizeof(flow_entry_t));
+    if (!fresh) {
+        log_msg(LOG_WARN, "flow", "resize to %u slots failed (OOM)", new_capacity);
+        return -1;
+    }
+    log_msg(LOG_DEBUG, "flow", "resize %u → %u slots (%d flows)",
+            ft->capacity, new_capacity, ft->count);
+    ft->old_entries  = ft->entries;
+    ft->old_capacity = ft->capacity;
+    ft->old_mask     = ft->mask;
+    ft->migrate_pos  = 0;
+    ft->entries      = fresh;
+    ft->capacity     = new_capacity;
+    ft->mask         = new_capacity - 1;
+    ft->resizes++;
+    return 0;
+}
+
+/* Make room for one more flow: grow if allowed, otherwise evict. */
+static void reserve_one(flow_table_t *ft, uint32_t h) {
+    if (ft->count < (int)FLOW_TABLE_MAX_LOAD(ft->capacity)) return;
+    if (ft->old_entries) {
+        /* Resize still draining and the new array is already at its
+         * ceiling (only after a shrink raced a burst): finish it now. */
+        migrate_step(ft, ft->old_capacity);
+        if (ft->count < (int)FLOW_TABLE_MAX_LOAD(ft->capacity)) return;
+    }
+    if (ft->capacity < ft->max_capacity &&
+        start_resize(ft, ft->capacity * 2) == 0) {
+        return;
+    }
+    evict_for(ft, h);
+}
+
+/* ── Iteration ──────────────────────────────────────────────── */
+
+flow_entry_t *flow_table_next_mut(flow_table_t *ft, uint32_t *it) {
+    if (!ft || !it || !ft->entries) return NULL;
+    while (*it < ft->capacity) {
+        flow_entry_t *e = &ft->entries[(*it)++];
+        if (e->active) return e;
+    }
+    while (ft->old_entries && *it - ft->capacity < ft->old_capacity) {
+        flow_entry_t *e = &ft->old_entries[(*it)++ - ft->capacity];
+        if (e->active) return e;
     }
     return NULL;
 }
 
+const flow_entry_t *flow_table_next(const flow_table_t *ft, uint32_t *it) {
+    return flow_table_next_mut((flow_table_t *)ft, it);
+}
+
+/* ── Lookup ─────────────────────────────────────────────────── */
+
+const flow_entry_t *flow_table_lookup(const flow_table_t *ft,
+                                      const flow_key_t *key) {
+    if (!ft || !key || !ft->entries) return NULL;
+    uint32_t h = flow_key_hash(key);
+    int slot = find_slot(ft, key, h);
+    if (slot >= 0) return &ft->entries[slot];
+    slot = find_old(ft, key, h);
+    return slot >= 0 ? &ft->old_entries[slot] : NULL;
+}
+
+/* Locate a flow for mutation. A hit in the old array is migrated first,
+ * so callers always get a slot in the current array. */
+static flow_entry_t *find_for_update(flow_table_t *ft, const flow_key_t *key,
+                                     uint32_t h) {
+    int slot = find_slot(ft, key, h);
+    if (slot >= 0) return &ft->entries[slot];
+
+    slot = find_old(ft, key, h);
+    if (slot < 0) return NULL;
+    flow_entry_t moved = ft->old_entries[slot];
+    ft->old_entries[slot].active = 0;
+    ft->count--;
+    reserve_one(ft, h);
+    slot = place_entry(ft, &moved);
+    return slot >= 0 ? &ft->entries[slot] : NULL;
+}
+
+/* ── Behaviour signature ────────────────────────────────────── */
+
+/* Half-octave bucket: 0 for 0, else 2·log2(v) plus the next bit, + 1. */
+static uint32_t half_log2_bucket(uint64_t v) {
+    if (v == 0) return 0;
+    int b = 63 - __builtin_clzll(v);
+    uint32_t next = b > 0 ? (uint32_t)((v >> (b - 1)) & 1u) : 0u;
+    return ((uint32_t)b << 1 | next) + 1;
+}
+
+uint32_t flow_behavior_sig(const flow_entry_t *e) {
+    uint64_t delta = e->tx_delta + e->rx_delta;
+    uint64_t pkts  = e->packets + e->rx_packets;
+    uint32_t young = pkts < 20;
+    uint32_t vol   = half_log2_bucket(delta);                         /* ≤ 128 */
+    uint32_t rxs   = delta ? (uint32_t)(e->rx_delta * 8 / delta) : 0; /* 0..8 */
+    uint32_t apkt  = pkts ? half_log2_bucket((e->bytes + e->rx_bytes) / pkts) : 0;
+    return young | vol << 1 | rxs << 9 | apkt << 13;
+}
+
 /* ── Update (insert or increment) ───────────────────────────── */
 
-static int find_lru_slot(const flow_table_t *ft) {
-    int oldest = 0;
-    double oldest_time = ft->entries[0].last_seen;
-    for (int i = 1; i < FLOW_TABLE_SIZE; i++) {
-        if (!ft->entries[i].active) {
-            return i; /* prefer empty slot */
-        }
-        if (ft->entries[i].last_seen < oldest_time) {
-            oldest_time = ft->entries[i].last_seen;
-            oldest = i;
+/* Insert or refresh a flow; returns its entry (valid until the next
+ * mutation) so ingestion can attach the conntrack mark in place. */
+static flow_entry_t *flow_upsert(flow_table_t *ft, const flow_key_t *key,
+                                 uint64_t packets, uint64_t rx_packets,
+                                 uint64_t bytes, uint64_t rx_bytes,
+                                 double now) {
+    migrate_step(ft, FLOW_REHASH_STEP);
+
+    uint32_t h = flow_key_hash(key);
+    flow_entry_t *e = find_for_update(ft, key, h);
+    if (e) {
+        e->tx_delta   = bytes >= e->bytes ? bytes - e->bytes : 0;
+        e->rx_delta   = rx_bytes >= e->rx_bytes ? rx_bytes - e->rx_bytes : 0;
+        e->packets    = packets;
+        e->rx_packets = rx_packets;
+        e->bytes      = bytes;
+        e->rx_bytes   = rx_bytes;
+        e->last_seen  = now;
+        e->hot        = (e->tx_delta + e->rx_delta) > 0;
+        uint32_t sig  = flow_behavior_sig(e);
+        if (sig != e->behav_sig) {
+            e->behav_sig = sig;
+            e->dirty     = 1;
         }
+        return e;
+    }
+
+    flow_entry_t in;
+    memset(&in, 0, sizeof(in));
+    in.key        = *key;
+    in.hash       = h;
+    in.packets    = packets;
+    in.rx_packets = rx_packets;
+    in.bytes      = bytes;
+    in.rx_bytes   = rx_bytes;
+    in.tx_delta   = bytes;
+    in.rx_delta   = rx_bytes;
+    in.last_seen  = now;
+    in.active     = 1;
+    in.hot        = 1;
+    in.behav_sig  = flow_behavior_sig(&in);
+    in.dirty      = 1;
+    reserve_one(ft, h);
+    int slot = place_entry(ft, &in);
+    return slot >= 0 ? &ft->entries[slot] : NULL;
+}
+
+static flow_entry_t *flow_touch_entry(flow_table_t *ft, const flow_key_t *key,
+                                      double now) {
+    flow_entry_t *e = find_for_update(ft, key, flow_key_hash(key));
+    if (e) {
+        e->last_seen = now;
+        e->hot       = 1;
+        return e;
     }
-    return oldest;
+    return flow_upsert(ft, key, 0, 0, 0, 0, now);
+}
+
+static void flow_note_mark(flow_entry_t *e, uint32_t mark, double now) {
+    if (!e) return;
+    e->ct_mark       = mark;
+    e->ct_mark_valid = 1;
+    e->ct_mark_at    = now;
 }
 
 int flow_table_update(flow_table_t *ft, const flow_key_t *key,
                       uint64_t packets, uint64_t rx_packets,
                       uint64_t bytes, uint64_t rx_bytes,
                       double now) {
-    if (!ft || !key) return -1;
-
-    uint32_t idx = flow_hash(key);
-
-    /* Linear probe for existing entry */
-    for (int i = 0; i < FLOW_TABLE_SIZE; i++) {
-        uint32_t slot = (idx + i) % FLOW_TABLE_SIZE;
-        if (!ft->entries[slot].active) {
-            /* Insert here */
-            ft->entries[slot].key        = *key;
-            ft->entries[slot].packets    = packets;
-            ft->entries[slot].rx_packets = rx_packets;
-            ft->entries[slot].bytes      = bytes;
-            ft->entries[slot].rx_bytes   = rx_bytes;
-            ft->entries[slot].tx_delta   = bytes;
-            ft->entries[slot].rx_delta   = rx_bytes;
-            ft->entries[slot].last_seen  = now;
-            ft->entries[slot].active     = 1;
-            ft->count++;
-            return 0;
-        }
-        if (key_equal(&ft->entries[slot].key, key)) {
-            /* Update existing */
-            ft->entries[slot].tx_delta   = bytes >= ft->entries[slot].bytes ? bytes - ft->entries[slot].bytes : 0;
-            ft->entries[slot].rx_delta   = rx_bytes >= ft->entries[slot].rx_bytes ? rx_bytes - ft->entries[slot].rx_bytes : 0;
-            ft->entries[slot].packets    = packets;
-            ft->entries[slot].rx_packets = rx_packets;
-            ft->entries[slot].bytes      = bytes;
-            ft->entries[slot].rx_bytes   = rx_bytes;
-            ft->entries[slot].last_seen  = now;
-            return 0;
-        }
-    }
+    if (!ft || !key || !ft->entries) return -1;
+    return flow_upsert(ft, key, packets, rx_packets, bytes, rx_bytes, now) ? 0 : -1;
+}
+
+int flow_table_touch(flow_table_t *ft, const flow_key_t *key, double now) {
+    if (!ft || !key || !ft->entries) return -1;
+    return flow_touch_entry(ft, key, now) ? 0 : -1;
+}
+
+int flow_table_set_mark(flow_table_t *ft, const flow_key_t *key, uint32_t mark,
+                        double now) {
+    if (!ft || !key || !ft->entries) return -1;
+    flow_entry_t *e = find_for_update(ft, key, flow_key_hash(key));
+    if (!e) return -1;
+    flow_note_mark(e, mark, now);
+    return 0;
+}
+
+/* ── Removal ────────────────────────────────────────────────── */
 
-    /* Table full — evict LRU */
-    int victim = find_lru_slot(ft);
-    ft->entries[victim].key        = *key;
-    ft->entries[victim].packets    = packets;
-    ft->entries[victim].rx_packets = rx_packets;
-    ft->entries[victim].bytes      = bytes;
-    ft->entries[victim].rx_bytes   = rx_bytes;
-    ft->entries[victim].last_seen  = now;
-    ft->entries[victim].active     = 1;
+int flow_table_remove(flow_table_t *ft, const flow_key_t *key) {
+    if (!ft || !key || !ft->entries) return -1;
+
+    uint32_t h = flow_key_hash(key);
+    int slot = find_slot(ft, key, h);
+    if (slot >= 0) {
+        delete_slot(ft, (uint32_t)slot);
+        return 0;
+    }
+    slot = find_old(ft, key, h);
+    if (slot < 0) return -1;
+    ft->old_entries[slot].active = 0;   /* frozen array: just clear */
+    ft->count--;
     return 0;
 }
 
 /* ── Eviction ───────────────────────────────────────────────── */
 
 void flow_table_evict_stale(flow_table_t *ft, double now, double max_age_s) {
-    if (!ft) return;
-    for (int i = 0; i < FLOW_TABLE_SIZE; i++) {
-        if (ft->entries[i].active &&
-            (now - ft->entries[i].last_seen) > max_age_s) {
-            ft->entries[i].active = 0;
+    if (!ft || !ft->entries) return;
+    for (uint32_t i = 0; i < ft->capacity; i++) {
+        /* Backward shift may pull the next entry into slot i: recheck. */
+        while (ft->entries[i].active &&
+               (now - ft->entries[i].last_seen) > max_age_s) {
+            delete_slot(ft, i);
+        }
+    }
+    for (uint32_t i = 0; ft->old_entries && i < ft->old_capacity; i++) {
+        flow_entry_t *e = &ft->old_entries[i];
+        if (e->active && (now - e->last_seen) > max_age_s) {
+            e->active = 0;
             ft->count--;
         }
     }
+
+    /* Shrink when a quarter full (leaves the half-size array at 50%),
+     * or when a lowered ceiling left us oversized and the load fits. */
+    if (!ft->old_entries && ft->capacity > ft->min_capacity) {
+        uint32_t half = ft->capacity / 2;
+        int sparse   = ft->count < (int)(ft->capacity / 4);
+        int too_big  = ft->capacity > ft->max_capacity &&
+                       ft->count < (int)FLOW_TABLE_MAX_LOAD(half);
+        if (sparse || too_big) {
+            start_resize(ft, half);
+        }
+    }
+    /* Per-tick floor on migration progress so a quiet table (few
+     * updates) still finishes a resize within ~8 ticks. */
+    if (ft->old_entries) {
+        uint32_t budget = ft->old_capacity / 8;
+        migrate_step(ft, budget > FLOW_REHASH_STEP ? budget : FLOW_REHASH_STEP);
+    }
+}
+
+void flow_table_set_max_flows(flow_table_t *ft, uint32_t max_flows) {
+    if (!ft) return;
+    ft->max_capacity = capacity_for(max_flows);
+}
+
+/* ── Probe statistics ───────────────────────────────────────── */
+
+void flow_table_probe_stats(const flow_table_t *ft, flow_probe_stats_t *out) {
+    if (!out) return;
+    memset(out, 0, sizeof(*out));
+    if (!ft || !ft->entries) return;
+
+    uint64_t sum = 0;
+    int placed = 0;
+    for (uint32_t i = 0; i < ft->capacity; i++) {
+        const flow_entry_t *e = &ft->entries[i];
+        if (!e->active) continue;
+        uint32_t d = probe_dist(e, i, ft->mask);
+        sum += d;
+        placed++;
+        if ((int)d > out->max_probe) out->max_probe = (int)d;
+        int b = 0;
+        while (b < FLOW_PROBE_HIST - 1 && (d >> b) != 0) b++;
+        out->hist[b]++;
+    }
+    out->count           = ft->count;
+    out->capacity        = (int)ft->capacity;
+    out->max_capacity    = (int)ft->max_capacity;
+    out->resizing        = ft->old_entries != NULL;
+    out->mean_probe      = placed > 0 ? (double)sum / placed : 0.0;
+    out->evictions       = ft->evictions;
+    out->probe_overflows = ft->probe_overflows;
+    out->resizes         = ft->resizes;
 }
 
 /* ── Active count ───────────────────────────────────────────── */
@@ -145,80 +542,45 @@ int flow_table_active_count(const flow_table_t *ft) {
 
 /* ── Conntrack population ───────────────────────────────────── */
 
+struct proc_cb_data {
+    flow_table_t *ft;
+    double now;
+};
+
+static int proc_record_cb(const ct_record_t *rec, void *user) {
+    struct proc_cb_data *d = (struct proc_cb_data *)user;
+    flow_entry_t *e = flow_upsert(d->ft, &rec->key, rec->tx_packets, rec->rx_packets,
+                                  rec->tx_bytes, rec->rx_bytes, d->now);
+    if (rec->has_mark) flow_note_mark(e, rec->mark, d->now);
+    return 0;
+}
+
 /*
  * Parse /proc/net/nf_conntrack to populate flow table.
  * Always compiled; used as primary path (or fallback when NFCT dump fails).
+ * Streams the file through myco_ctparse in CT_PARSE_BLOCK reads.
  */
 static int populate_from_proc(flow_table_t *ft, double now) {
-    FILE *fp = fopen("/proc/net/nf_conntrack", "r");
-    if (!fp) return -1;
-
-    char line[1024];
-    int parsed = 0;
-
-    while (fgets(line, sizeof(line), fp)) {
-        int proto_num = 0;
-        char src_str[64] = {0}, dst_str[64] = {0};
-        int sport = 0, dport = 0;
-        uint64_t pkts = 0, rx_pkts = 0, tx_byts = 0, rx_byts = 0;
-
-        char *p = strstr(line, "tcp");
-        if (p) {
-            proto_num = 6;
-        } else {
-            p = strstr(line, "udp");
-            if (p) proto_num = 17;
-            else   continue;
-        }
-
-        p = strstr(line, "src=");
-        if (p) sscanf(p, "src=%63s", src_str);
-        p = strstr(line, "dst=");
-        if (p) sscanf(p, "dst=%63s", dst_str);
-        p = strstr(line, "sport=");
-        if (p) sscanf(p, "sport=%d", &sport);
-        p = strstr(line, "dport=");
-        if (p) sscanf(p, "dport=%d", &dport);
-
-        p = strstr(line, "packets=");
-        if (p) {
-            sscanf(p, "packets=%llu", (unsigned long long *)&pkts);
-            p = strstr(p + 8, "packets=");
-            if (p) sscanf(p, "packets=%llu", (unsigned long long *)&rx_pkts);
-        }
-
-        /* nf_conntrack has TWO bytes= fields per line:
-         *   first  = forward direction (client→server, TX)
-         *   second = reverse direction (server→client, RX)
-         * This distinction enables STREAMING vs BULK classification. */
-        p = strstr(line, "bytes=");
-        if (p) {
-            sscanf(p, "bytes=%llu", (unsigned long long *)&tx_byts);
-            p = strstr(p + 6, "bytes=");
-            if (p) sscanf(p, "bytes=%llu", (unsigned long long *)&rx_byts);
-        }
-
-        if (!src_str[0] || !dst_str[0]) continue;
+    int fd = open("/proc/net/nf_conntrack", O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return -1;
 
-        flow_key_t key;
-        memset(&key, 0, sizeof(key));
-        inet_pton(AF_INET, src_str, &key.src_ip);
-        inet_pton(AF_INET, dst_str, &key.dst_ip);
-        key.src_port = (uint16_t)sport;
-        key.dst_port = (uint16_t)dport;
-        key.protocol = (uint8_t)proto_num;
+    char buf[CT_PARSE_BLOCK];
+    struct proc_cb_data d = { .ft = ft, .now = now };
+    int parsed = ct_parse_fd(fd, buf, sizeof(buf), proc_record_cb, &d);
 
-        flow_table_update(ft, &key, pkts, rx_pkts, tx_byts, rx_byts, now);
-        parsed++;
-    }
-
-    fclose(fp);
+    close(fd);
     return parsed;
 }
 
-#ifdef HAVE_LIBNFCT
-
-#include <libnetfilter_conntrack/libnetfilter_conntrack.h>
+/* Event mode tuning. A per-flow GET is one netlink round trip, so past
+ * FLOW_CT_GET_BUDGET hot flows a single dump is cheaper and we take that
+ * instead. FLOW_CT_COLD_SLICE cold flows are re-sampled each tick, round
+ * robin, so an idle flow that wakes up (no conntrack event for that) is
+ * noticed within min(cold flows / FLOW_CT_COLD_SLICE ticks, resync_s):
+ * about 2 s for a hundred flows at 2 Hz, while a table of thousands waits
+ * for the resync dump (10k flows would need ~156 s at 2 Hz). */
+#define FLOW_CT_GET_BUDGET 256
+#define FLOW_CT_COLD_SLICE 32
 
 struct ct_dump_cb_data {
     flow_table_t *ft;
@@ -226,31 +588,98 @@ struct ct_dump_cb_data {
     int parsed;
 };
 
-static int ct_dump_cb(enum nf_conntrack_msg_type type, struct nf_conntrack *ct, void *data) {
-    struct ct_dump_cb_data *cb_data = (struct ct_dump_cb_data *)data;
+struct flow_ct_source {
+    int    event_mode;   /* 1 = events + targeted GETs, 0 = dump per tick */
+    double resync_s;     /* event mode: full reconciliation dump interval */
+    double last_resync;  /* 0 = never — forces a dump on the first poll */
+    int    need_resync;  /* events were lost (ENOBUFS) or a GET failed */
+    uint32_t rr_cursor;  /* next slot for the cold-flow sampling slice */
+#ifdef HAVE_LIBNFCT
+    flow_key_t             get_keys[FLOW_CT_GET_BUDGET + FLOW_CT_COLD_SLICE];
+    struct nfct_handle    *ev;       /* event subscription (event mode only) */
+    struct nfct_handle    *q;        /* dump + GET queries */
+    struct nf_conntrack   *get_ct;   /* reused NFCT_Q_GET request object */
+    struct ct_dump_cb_data cb;       /* callback context, re-armed per poll */
+#endif
+};
 
+#ifdef HAVE_LIBNFCT
+
+#include <libnetfilter_conntrack/libnetfilter_conntrack.h>
+
+#define FLOW_CT_EVENT_RCVBUF (1024 * 1024)
+
+static int ct_to_key(struct nf_conntrack *ct, flow_key_t *key) {
     uint8_t l4_proto = nfct_get_attr_u8(ct, ATTR_L4PROTO);
     if (l4_proto != IPPROTO_TCP && l4_proto != IPPROTO_UDP)
-        return NFCT_CB_CONTINUE;
+        return -1;
 
     uint8_t l3_proto = nfct_get_attr_u8(ct, ATTR_L3PROTO);
     if (l3_proto != AF_INET)
-        return NFCT_CB_CONTINUE;
+        return -1;
+
+    memset(key, 0, sizeof(*key));
+    key->src_ip   = nfct_get_attr_u32(ct, ATTR_IPV4_SRC);
+    key->dst_ip   = nfct_get_attr_u32(ct, ATTR_IPV4_DST);
+    key->src_port = ntohs(nfct_get_attr_u16(ct, ATTR_PORT_SRC));
+    key->dst_port = ntohs(nfct_get_attr_u16(ct, ATTR_PORT_DST));
+    key->protocol = l4_proto;
+    return 0;
+}
+
+static int ct_dump_cb(enum nf_conntrack_msg_type type, struct nf_conntrack *ct, void *data) {
+    (void)type;
+    struct ct_dump_cb_data *cb_data = (struct ct_dump_cb_data *)data;
 
     flow_key_t key;
-    memset(&key, 0, sizeof(key));
-    key.src_ip   = nfct_get_attr_u32(ct, ATTR_IPV4_SRC);
-    key.dst_ip   = nfct_get_attr_u32(ct, ATTR_IPV4_DST);
-    key.src_port = ntohs(nfct_get_attr_u16(ct, ATTR_PORT_SRC));
-    key.dst_port = ntohs(nfct_get_attr_u16(ct, ATTR_PORT_DST));
-    key.protocol = l4_proto;
+    if (ct_to_key(ct, &key) != 0)
+        return NFCT_CB_CONTINUE;
 
     uint64_t tx_bytes = nfct_get_attr_u64(ct, ATTR_ORIG_COUNTER_BYTES);
     uint64_t tx_pkts  = nfct_get_attr_u64(ct, ATTR_ORIG_COUNTER_PACKETS);
     uint64_t rx_bytes = nfct_get_attr_u64(ct, ATTR_REPL_COUNTER_BYTES);
     uint64_t rx_pkts  = nfct_get_attr_u64(ct, ATTR_REPL_COUNTER_PACKETS);
 
-    flow_table_update(cb_data->ft, &key, tx_pkts, rx_pkts, tx_bytes, rx_bytes, cb_data->now);
+    flow_entry_t *e = flow_upsert(cb_data->ft, &key, tx_pkts, rx_pkts,
+                                  tx_bytes, rx_bytes, cb_data->now);
+    if (nfct_attr_is_set(ct, ATTR_MARK) > 0) {
+        flow_note_mark(e, nfct_get_attr_u32(ct, ATTR_MARK), cb_data->now);
+    }
+    cb_data->parsed++;
+    return NFCT_CB_CONTINUE;
+}
+
+/* Event callback. ctnetlink only attaches counters to DESTROY (and to
+ * UPDATEs on some kernels), so an event without counters just proves
+ * the flow is alive: touch it and let the GET pass fetch the numbers. */
+static int ct_event_cb(enum nf_conntrack_msg_type type, struct nf_conntrack *ct, void *data) {
+    struct ct_dump_cb_data *cb_data = (struct ct_dump_cb_data *)data;
+
+    flow_key_t key;
+    if (ct_to_key(ct, &key) != 0)
+        return NFCT_CB_CONTINUE;
+
+    if (type == NFCT_T_DESTROY) {
+        flow_table_remove(cb_data->ft, &key);
+        cb_data->parsed++;
+        return NFCT_CB_CONTINUE;
+    }
+
+    flow_entry_t *e;
+    if (nfct_attr_is_set(ct, ATTR_ORIG_COUNTER_BYTES) > 0) {
+        e = flow_upsert(cb_data->ft, &key,
+                        nfct_get_attr_u64(ct, ATTR_ORIG_COUNTER_PACKETS),
+                        nfct_get_attr_u64(ct, ATTR_REPL_COUNTER_PACKETS),
+                        nfct_get_attr_u64(ct, ATTR_ORIG_COUNTER_BYTES),
+                        nfct_get_attr_u64(ct, ATTR_REPL_COUNTER_BYTES),
+                        cb_data->now);
+    } else {
+        e = flow_touch_entry(cb_data->ft, &key, cb_data->now);
+    }
+    /* A mark write of ours comes back as an UPDATE carrying the mark. */
+    if (nfct_attr_is_set(ct, ATTR_MARK) > 0) {
+        flow_note_mark(e, nfct_get_attr_u32(ct, ATTR_MARK), cb_data->now);
+    }
     cb_data->parsed++;
     return NFCT_CB_CONTINUE;
 }
@@ -273,6 +702,163 @@ int flow_table_populate_conntrack(flow_table_t *ft, double now) {
     return populate_from_proc(ft, now);
 }
 
+/* Full dump on the persistent query handle. Falls back to /proc when the
+ * netlink dump fails, same as flow_table_populate_conntrack(). */
+static int ct_source_dump(flow_ct_source_t *src, flow_table_t *ft, double now) {
+    if (src->q) {
+        src->cb.ft     = ft;
+        src->cb.now    = now;
+        src->cb.parsed = 0;
+        uint8_t family = AF_INET;
+        if (nfct_query(src->q, NFCT_Q_DUMP, &family) != -1)
+            return src->cb.parsed;
+    }
+    return populate_from_proc(ft, now);
+}
+
+/* Drain every queued event without blocking (socket is O_NONBLOCK, so
+ * nfct_catch returns -1/EAGAIN once the queue is empty). */
+static int ct_source_drain(flow_ct_source_t *src, flow_table_t *ft, double now) {
+    struct ct_dump_cb_data cb_data = { .ft = ft, .now = now, .parsed = 0 };
+    nfct_callback_unregister(src->ev);
+    nfct_callback_register(src->ev, NFCT_T_ALL, ct_event_cb, &cb_data);
+
+    for (int round = 0; round < 2; round++) {
+        if (nfct_catch(src->ev) >= 0 || errno != ENOBUFS)
+            break;
+        /* Kernel dropped events: membership may be wrong until the
+         * next dump. Keep draining what is still queued. */
+        src->need_resync = 1;
+        log_msg(LOG_DEBUG, "flow", "conntrack event overrun, resync scheduled");
+    }
+    return cb_data.parsed;
+}
+
+/* Counter pass for event mode. Hot flows and a rotating slice of cold
+ * ones get a targeted NFCT_Q_GET; every other flow is known alive (no
+ * DESTROY seen) and idle, so it is refreshed in place with zero deltas.
+ * Returns -1 when the hot set outgrew the GET budget — caller dumps. */
+static int ct_source_refresh(flow_ct_source_t *src, flow_table_t *ft, double now) {
+    int n_get = 0, n_cold = 0;
+    uint32_t last_cold = 0;
+
+    /* Budget check first: the dump taken instead prunes every flow it
+     * did not refresh, so no cold flow may be stamped before we commit
+     * to the GET path. */
+    uint32_t it = 0;
+    flow_entry_t *e;
+    while ((e = flow_table_next_mut(ft, &it)) != NULL) {
+        if (e->hot && ++n_get > FLOW_CT_GET_BUDGET) return -1;
+    }
+
+    n_get = 0;
+    it = 0;
+    while ((e = flow_table_next_mut(ft, &it)) != NULL) {
+        uint32_t i = it - 1;
+        if (e->hot) {
+            src->get_keys[n_get++] = e->key;
+            continue;
+        }
+        if (i >= src->rr_cursor && n_cold < FLOW_CT_COLD_SLICE) {
+            src->get_keys[n_get++] = e->key;
+            n_cold++;
+            last_cold = i;
+        }
+        e->tx_delta  = 0;
+        e->rx_delta  = 0;
+        e->last_seen = now;
+    }
+    src->rr_cursor = (n_cold < FLOW_CT_COLD_SLICE) ? 0 : last_cold + 1;
+
+    src->cb.ft     = ft;
+    src->cb.now    = now;
+    src->cb.parsed = 0;
+    for (int i = 0; i < n_get; i++) {
+        const flow_key_t *k = &src->get_keys[i];
+        nfct_set_attr_u8 (src->get_ct, ATTR_L3PROTO,  AF_INET);
+        nfct_set_attr_u32(src->get_ct, ATTR_IPV4_SRC, k->src_ip);
+        nfct_set_attr_u32(src->get_ct, ATTR_IPV4_DST, k->dst_ip);
+        nfct_set_attr_u8 (src->get_ct, ATTR_L4PROTO,  k->protocol);
+        nfct_set_attr_u16(src->get_ct, ATTR_PORT_SRC, htons(k->src_port));
+        nfct_set_attr_u16(src->get_ct, ATTR_PORT_DST, htons(k->dst_port));
+        if (nfct_query(src->q, NFCT_Q_GET, src->get_ct) == 0) continue;
+        if (errno == ENOENT) {
+            /* Gone and the DESTROY event was lost (or raced the GET). */
+            flow_table_remove(ft, k);
+        } else {
+            src->need_resync = 1;
+        }
+    }
+    return src->cb.parsed;
+}
+
+flow_ct_source_t *flow_ct_open(int event_mode, double resync_s) {
+    flow_ct_source_t *src = calloc(1, sizeof(*src));
+    if (!src) return NULL;
+    src->resync_s = resync_s > 0.0 ? resync_s : 30.0;
+
+    src->q = nfct_open(CONNTRACK, 0);
+    if (!src->q) {
+        log_msg(LOG_WARN, "flow", "nfct_open failed: %s — /proc fallback",
+                strerror(errno));
+        return src;
+    }
+    nfct_callback_register(src->q, NFCT_T_ALL, ct_dump_cb, &src->cb);
+
+    if (!event_mode) return src;
+
+    src->get_ct = nfct_new();
+    src->ev = nfct_open(CONNTRACK, NF_NETLINK_CONNTRACK_NEW |
+                                   NF_NETLINK_CONNTRACK_UPDATE |
+                                   NF_NETLINK_CONNTRACK_DESTROY);
+    if (!src->get_ct || !src->ev ||
+        fcntl(nfct_fd(src->ev), F_SETFL, O_NONBLOCK) < 0) {
+        log_msg(LOG_WARN, "flow",
+                "conntrack event subscription failed: %s — dump mode",
+                strerror(errno));
+        if (src->ev) nfct_close(src->ev);
+        src->ev = NULL;
+        return src;
+    }
+    nfnl_rcvbufsiz(nfct_nfnlh(src->ev), FLOW_CT_EVENT_RCVBUF);
+    src->event_mode = 1;
+    log_msg(LOG_INFO, "flow", "conntrack event mode (resync every %.0fs)",
+            src->resync_s);
+    return src;
+}
+
+void flow_ct_close(flow_ct_source_t *src) {
+    if (!src) return;
+    if (src->ev)     nfct_close(src->ev);
+    if (src->q)      nfct_close(src->q);
+    if (src->get_ct) nfct_destroy(src->get_ct);
+    free(src);
+}
+
+int flow_ct_poll(flow_ct_source_t *src, flow_table_t *ft, double now) {
+    if (!ft) return -1;
+    if (!src) return flow_table_populate_conntrack(ft, now);
+    if (!src->event_mode) return ct_source_dump(src, ft, now);
+
+    int applied = ct_source_drain(src, ft, now);
+
+    int resync = src->need_resync || src->last_resync == 0.0 ||
+                 (now - src->last_resync) >= src->resync_s;
+    if (!resync) {
+        int n = ct_source_refresh(src, ft, now);
+        if (n >= 0) return applied + n;
+        /* Hot set over budget — one dump is cheaper than the GETs. */
+    }
+
+    int n = ct_source_dump(src, ft, now);
+    if (n < 0) return applied > 0 ? applied : -1;
+    /* Everything the dump did not refresh is gone from conntrack. */
+    flow_table_evict_stale(ft, now, 0.0);
+    src->last_resync = now;
+    src->need_resync = 0;
+    return applied + n;
+}
+
 #else /* ! HAVE_LIBNFCT */
 
 int flow_table_populate_conntrack(flow_table_t *ft, double now) {
@@ -280,8 +866,33 @@ int flow_table_populate_conntrack(flow_table_t *ft, double now) {
     return populate_from_proc(ft, now);
 }
 
+flow_ct_source_t *flow_ct_open(int event_mode, double resync_s) {
+    flow_ct_source_t *src = calloc(1, sizeof(*src));
+    if (!src) return NULL;
+    src->resync_s = resync_s > 0.0 ? resync_s : 30.0;
+    if (event_mode) {
+        log_msg(LOG_INFO, "flow",
+                "conntrack events need libnetfilter_conntrack — dump mode");
+    }
+    return src;
+}
+
+void flow_ct_close(flow_ct_source_t *src) {
+    free(src);
+}
+
+int flow_ct_poll(flow_ct_source_t *src, flow_table_t *ft, double now) {
+    (void)src;
+    if (!ft) return -1;
+    return populate_from_proc(ft, now);
+}
+
 #endif /* HAVE_LIBNFCT */
 
+int flow_ct_event_mode(const flow_ct_source_t *src) {
+    return src ? src->event_mode : 0;
+}
+
 /* ── Elephant flow detection ────────────────────────────────── */
 
 int flow_table_has_elephant(const flow_table_t *ft, double dominance_ratio) {
@@ -290,13 +901,12 @@ int flow_table_has_elephant(const flow_table_t *ft, double dominance_ratio) {
     }
     uint64_t total_bytes = 0;
     uint64_t max_bytes   = 0;
-    for (int i = 0; i < FLOW_TABLE_SIZE; i++) {
-        if (!ft->entries[i].active) {
-            continue;
-        }
-        total_bytes += ft->entries[i].bytes;
-        if (ft->entries[i].bytes > max_bytes) {
-            max_bytes = ft->entries[i].bytes;
+    uint32_t it = 0;
+    const flow_entry_t *fe;
+    while ((fe = flow_table_next(ft, &it)) != NULL) {
+        total_bytes += fe->bytes;
+        if (fe->bytes > max_bytes) {
+            max_bytes = fe->bytes;
         }
     }
     if (total_bytes == 0) {
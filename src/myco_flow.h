@@ -7,7 +7,16 @@
 
 #include <stdint.h>
 
-#define FLOW_TABLE_SIZE 1024  /* max concurrent flows tracked */
+/* Capacities are slot counts, always powers of two. The table starts at
+ * min_capacity, doubles while load exceeds 7/8 up to max_capacity, and
+ * halves again when load falls under 1/4. */
+#define FLOW_TABLE_MIN_CAPACITY     256
+#define FLOW_TABLE_DEFAULT_CAPACITY 1024    /* max when nothing configured */
+#define FLOW_TABLE_MAX_CAPACITY     65536   /* ~6 MB of entries — hard ceiling */
+#define FLOW_TABLE_MAX_LOAD(cap)    ((cap) - (cap) / 8)  /* 87.5% */
+#define FLOW_MAX_PROBE  32    /* no entry sits further than this from home */
+#define FLOW_REHASH_STEP 64   /* old slots migrated per mutation while resizing */
+#define FLOW_PROBE_HIST 8     /* log2 probe-length buckets: 0,1,2-3,…,64+ */
 
 /* 5-tuple flow key */
 typedef struct {
@@ -28,24 +37,141 @@ typedef struct {
     uint64_t   tx_delta;    /* bytes transferred in the last cycle */
     uint64_t   rx_delta;    /* rx_bytes transferred in the last cycle */
     double     last_seen;   /* monotonic seconds */
+    uint32_t   hash;        /* cached flow hash (Robin Hood distance) */
+    uint32_t   ct_mark;     /* kernel conntrack mark as last reported */
+    int        ct_mark_valid; /* 1 = ct_mark came from a dump, event or GET */
+    double     ct_mark_at;  /* when ct_mark was read from the kernel; unlike
+                             * last_seen, never bumped by an idle refresh */
     int        active;      /* 1 = occupied slot */
+    int        hot;         /* 1 = counters moved on the last refresh (or the
+                             * flow just appeared). Event mode re-polls hot
+                             * flows every tick; cold ones ride on events. */
+    uint32_t   behav_sig;   /* coarse behaviour buckets, see flow_behavior_sig() */
+    int        dirty;       /* 1 = new, or behav_sig moved since the classifier
+                             * last voted on it; the classifier clears it */
 } flow_entry_t;
 
+/* Robin Hood open addressing with backward-shift deletion, resized
+ * incrementally: a grow/shrink allocates the new slot array and then
+ * migrates FLOW_REHASH_STEP old slots per mutation, so no single tick
+ * pays for a full rehash. Until migration ends, flows live in either
+ * array — walk them with flow_table_next(), never entries[] directly.
+ * Entries move on insert/remove, so pointers from flow_table_lookup()
+ * are only valid until the next mutation. */
 typedef struct {
-    flow_entry_t entries[FLOW_TABLE_SIZE];
-    int          count;
+    flow_entry_t *entries;         /* current slot array */
+    uint32_t      capacity;
+    uint32_t      mask;
+    int           count;           /* active flows in both arrays */
+    flow_entry_t *old_entries;     /* array being drained (NULL when idle) */
+    uint32_t      old_capacity;
+    uint32_t      old_mask;
+    uint32_t      migrate_pos;     /* next old slot to migrate */
+    uint32_t      min_capacity;
+    uint32_t      max_capacity;
+    uint64_t      evictions;       /* at-max-capacity evictions (probe-window LRU) */
+    uint64_t      probe_overflows; /* entries dropped past FLOW_MAX_PROBE */
+    uint64_t      resizes;         /* grow + shrink operations started */
 } flow_table_t;
 
-void flow_table_init(flow_table_t *ft);
+/* Probe-length snapshot. hist[b] counts entries whose distance from home
+ * has bit length b (0 → on home slot, 1 → one step, 2 → 2–3, …). */
+typedef struct {
+    int      count;
+    int      capacity;
+    int      max_capacity;
+    int      resizing;            /* 1 = incremental migration in progress */
+    int      max_probe;
+    double   mean_probe;
+    uint32_t hist[FLOW_PROBE_HIST];
+    uint64_t evictions;
+    uint64_t probe_overflows;
+    uint64_t resizes;
+} flow_probe_stats_t;
+
+/* Behaviour signature of a flow: half-octave buckets of the last delta
+ * volume and of the average packet size, the delta's RX share in
+ * eighths, and whether the flow has reached 20 packets. It moves when
+ * service_infer_behavior() could plausibly change its answer. */
+uint32_t flow_behavior_sig(const flow_entry_t *e);
+
+/* Hash of the 5-tuple fields; the value cached in flow_entry_t.hash.
+ * Other per-flow tables key on it so a flow is hashed once per tick. */
+uint32_t flow_key_hash(const flow_key_t *key);
+
+/* Allocate a table that grows from FLOW_TABLE_MIN_CAPACITY up to
+ * `max_flows` tracked flows (0 → FLOW_TABLE_DEFAULT_CAPACITY). Slot
+ * counts are rounded up to a power of two. Returns 0, -1 on OOM. */
+int  flow_table_init_sized(flow_table_t *ft, uint32_t max_flows);
+/* flow_table_init_sized(ft, 0). */
+int  flow_table_init(flow_table_t *ft);
+/* Release the slot arrays. The table may be re-initialised afterwards. */
+void flow_table_free(flow_table_t *ft);
+/* Change the growth ceiling at runtime (e.g. after a config reload).
+ * A table above the new ceiling shrinks as its load allows. */
+void flow_table_set_max_flows(flow_table_t *ft, uint32_t max_flows);
+/* Flow budget for this box: nf_conntrack_max from procfs, clamped to the
+ * supported range. FLOW_TABLE_DEFAULT_CAPACITY when unreadable. */
+uint32_t flow_table_auto_max_flows(void);
+
+/* Iterate active flows in both slot arrays:
+ *     uint32_t it = 0;
+ *     const flow_entry_t *fe;
+ *     while ((fe = flow_table_next(ft, &it)) != NULL) { ... }
+ * The table must not be structurally modified during the walk. */
+const flow_entry_t *flow_table_next(const flow_table_t *ft, uint32_t *it);
+flow_entry_t *flow_table_next_mut(flow_table_t *ft, uint32_t *it);
+
 int  flow_table_update(flow_table_t *ft, const flow_key_t *key,
                        uint64_t packets, uint64_t rx_packets,
                        uint64_t bytes, uint64_t rx_bytes,
                        double now);
 const flow_entry_t *flow_table_lookup(const flow_table_t *ft,
                                       const flow_key_t *key);
+/* Refresh last_seen and mark the flow hot without touching counters.
+ * Inserts a zero-counter entry when the key is not tracked yet. */
+int  flow_table_touch(flow_table_t *ft, const flow_key_t *key, double now);
+/* Record the conntrack mark reported for a tracked flow at `now`, as
+ * ingestion does from a dump or event. Returns 0, -1 if the key is not
+ * tracked. */
+int  flow_table_set_mark(flow_table_t *ft, const flow_key_t *key, uint32_t mark,
+                         double now);
+/* Drop a flow (backward-shift delete). Returns 0 if removed, -1 if the
+ * key was not present. */
+int  flow_table_remove(flow_table_t *ft, const flow_key_t *key);
 int  flow_table_populate_conntrack(flow_table_t *ft, double now);
 int  flow_table_active_count(const flow_table_t *ft);
 int  flow_table_has_elephant(const flow_table_t *ft, double dominance_ratio);
+/* Drop flows idle for more than max_age_s, then start a shrink when the
+ * table has emptied out. */
 void flow_table_evict_stale(flow_table_t *ft, double now, double max_age_s);
+/* O(capacity) walk — call once per tick at most. */
+void flow_table_probe_stats(const flow_table_t *ft, flow_probe_stats_t *out);
+
+/* ── Conntrack ingestion source ─────────────────────────────────
+ * Persistent handle that feeds flow_table_t once per tick.
+ *
+ *   dump mode  : full NFCT_Q_DUMP (or /proc parse) every tick — the
+ *                original behaviour, and the only mode without libnfct.
+ *   event mode : NEW/UPDATE/DESTROY events on a persistent netlink
+ *                socket maintain membership incrementally. Counters are
+ *                pulled with per-flow NFCT_Q_GET for hot flows plus a
+ *                small round-robin slice of cold ones; a full dump runs
+ *                only every `resync_s` seconds (or after event loss) to
+ *                reconcile.
+ *
+ * flow_ct_open() never returns a half-working event source: if the
+ * subscription fails it logs once and degrades to dump mode. */
+typedef struct flow_ct_source flow_ct_source_t;
+
+flow_ct_source_t *flow_ct_open(int event_mode, double resync_s);
+void flow_ct_close(flow_ct_source_t *src);
+
+/* One ingestion pass. Returns the number of conntrack records applied
+ * (events + polled + dumped), or -1 if no source is readable. */
+int  flow_ct_poll(flow_ct_source_t *src, flow_table_t *ft, double now);
+
+/* 1 when the source is running in event mode. Safe on NULL. */
+int  flow_ct_event_mode(const flow_ct_source_t *src);
 
 #endif /* MYCO_FLOW_H */
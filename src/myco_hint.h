@@ -5,6 +5,9 @@
  * Maps well-known destination ports to persona hints. These hints act as
  * tiebreakers when the behavioral decision tree is ambiguous — they do NOT
  * override strong behavioral signals.
+ *
+ * The port ranges live in myco_ports.def; both lookups are constant-time
+ * reads of the table generated from it.
  */
 #ifndef MYCO_HINT_H
 #define MYCO_HINT_H
@@ -3,7 +3,7 @@
  * myco_mark.c — libnetfilter_conntrack wrapper implementation
  *
  * Two implementations compiled under a single header:
- *   HAVE_LIBNFCT defined → real CT_UPDATE via libnetfilter_conntrack
+ *   HAVE_LIBNFCT defined → real CT updates, batched over libmnl
  *   otherwise             → no-op stubs that log a single warning
  *
  * The no-op path lets the daemon build and run on dev hosts without
@@ -17,38 +17,216 @@
 #include <errno.h>
 #include <stdlib.h>
 #include <string.h>
+#include <time.h>
 
 struct mark_engine {
-    void    *handle;     /* nfct_handle* when HAVE_LIBNFCT, else NULL */
+    void    *handle;        /* mnl_socket* when HAVE_LIBNFCT, else NULL */
+    void   **pool;          /* MARK_BATCH_MAX nf_conntrack*, reused */
+    char    *buf;           /* batch assembly buffer */
+    uint32_t queued;        /* pool[0..queued) hold pending updates */
+    uint32_t portid;
+    uint32_t seq;           /* last netlink sequence number used */
+    uint32_t batch_seq;     /* first sequence number of the last batch */
+    uint32_t acks_pending;  /* sent, ack not yet read */
+    int      batch_failed;  /* last batch already counted in batch_err */
     uint64_t ok_count;
     uint64_t err_count;
-    int      stubbed;    /* 1 = library absent, set() is a no-op */
+    uint64_t batches;
+    uint64_t batch_err;
+    double   batch_last_us;
+    double   batch_max_us;
+    int      stubbed;       /* 1 = library absent, set() is a no-op */
 };
 
+static double mark_now_us(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec * 1e6 + (double)ts.tv_nsec / 1e3;
+}
+
+static void mark_batch_done(mark_engine_t *eng, double t0) {
+    double us = mark_now_us() - t0;
+    eng->batches++;
+    eng->batch_last_us = us;
+    if (us > eng->batch_max_us) eng->batch_max_us = us;
+}
+
 #ifdef HAVE_LIBNFCT
 #include <libnetfilter_conntrack/libnetfilter_conntrack.h>
 #include <libmnl/libmnl.h>
 
+/* Room for a full queue (≈100 B per update) plus the one message
+ * mnl_nlmsg_batch_next() may overflow into. */
+#define MARK_BATCH_BYTES (MARK_BATCH_MAX * 128)
+
 mark_engine_t *mark_engine_open(void) {
-    struct nfct_handle *h = nfct_open(CONNTRACK, 0);
-    if (!h) {
-        log_msg(LOG_WARN, "mark", "nfct_open failed: %s", strerror(errno));
+    struct mnl_socket *nl = mnl_socket_open(NETLINK_NETFILTER);
+    if (!nl) {
+        log_msg(LOG_WARN, "mark", "mnl_socket_open failed: %s", strerror(errno));
+        return NULL;
+    }
+    if (mnl_socket_bind(nl, 0, MNL_SOCKET_AUTOPID) < 0) {
+        log_msg(LOG_WARN, "mark", "mnl_socket_bind failed: %s", strerror(errno));
+        mnl_socket_close(nl);
         return NULL;
     }
+#ifdef NETLINK_CAP_ACK
+    /* Error acks otherwise echo the whole request back. */
+    int one = 1;
+    mnl_socket_setsockopt(nl, NETLINK_CAP_ACK, &one, sizeof(one));
+#endif
+    /* One ack per update; a full batch must fit without ENOBUFS. */
+    int rcvbuf = MARK_BATCH_MAX * 512;
+    setsockopt(mnl_socket_get_fd(nl), SOL_SOCKET, SO_RCVBUF, &rcvbuf, sizeof(rcvbuf));
+
     mark_engine_t *eng = calloc(1, sizeof(*eng));
-    if (!eng) {
-        nfct_close(h);
+    void **pool = calloc(MARK_BATCH_MAX, sizeof(*pool));
+    char *buf = malloc(MARK_BATCH_BYTES * 2);
+    if (!eng || !pool || !buf) {
+        free(eng);
+        free(pool);
+        free(buf);
+        mnl_socket_close(nl);
         return NULL;
     }
-    eng->handle  = h;
+    for (int i = 0; i < MARK_BATCH_MAX; i++) {
+        pool[i] = nfct_new();
+        if (!pool[i]) {
+            while (--i >= 0) nfct_destroy(pool[i]);
+            free(pool);
+            free(buf);
+            free(eng);
+            mnl_socket_close(nl);
+            return NULL;
+        }
+    }
+    eng->handle  = nl;
+    eng->pool    = pool;
+    eng->buf     = buf;
+    eng->portid  = mnl_socket_get_portid(nl);
+    eng->seq     = (uint32_t)time(NULL);
     eng->stubbed = 0;
-    log_msg(LOG_INFO, "mark", "conntrack mark engine ready (libnetfilter_conntrack)");
+    log_msg(LOG_INFO, "mark", "conntrack mark engine ready (batched, %d per flush)",
+            MARK_BATCH_MAX);
     return eng;
 }
 
+/* Read every ack already queued on the socket; never blocks. */
+static void mark_drain_acks(mark_engine_t *eng) {
+    struct mnl_socket *nl = eng->handle;
+    char buf[MNL_SOCKET_BUFFER_SIZE];
+
+    while (eng->acks_pending > 0) {
+        ssize_t n = recv(mnl_socket_get_fd(nl), buf, sizeof(buf), MSG_DONTWAIT);
+        if (n < 0 && errno == ENOBUFS) {
+            /* Acks were dropped; their outcome is unknown. */
+            log_msg(LOG_WARN, "mark", "ack overrun, %u updates unconfirmed",
+                    eng->acks_pending);
+            eng->err_count += eng->acks_pending;
+            eng->acks_pending = 0;
+            break;
+        }
+        if (n <= 0) {
+            break;
+        }
+        int len = (int)n;
+        const struct nlmsghdr *nlh = (const struct nlmsghdr *)buf;
+        while (mnl_nlmsg_ok(nlh, len)) {
+            if (nlh->nlmsg_type == NLMSG_ERROR) {
+                const struct nlmsgerr *e = mnl_nlmsg_get_payload(nlh);
+                if (eng->acks_pending > 0) eng->acks_pending--;
+                if (e->error == 0) {
+                    eng->ok_count++;
+                } else {
+                    eng->err_count++;
+                    if ((int32_t)(nlh->nlmsg_seq - eng->batch_seq) >= 0 &&
+                        !eng->batch_failed) {
+                        eng->batch_failed = 1;
+                        eng->batch_err++;
+                    }
+                }
+            }
+            nlh = mnl_nlmsg_next(nlh, &len);
+        }
+    }
+}
+
+static int mark_send(mark_engine_t *eng, struct mnl_nlmsg_batch *b, uint32_t msgs) {
+    if (mnl_socket_sendto(eng->handle, mnl_nlmsg_batch_head(b),
+                          mnl_nlmsg_batch_size(b)) < 0) {
+        log_msg(LOG_WARN, "mark", "batch send failed (%u updates): %s",
+                msgs, strerror(errno));
+        eng->err_count += msgs;
+        return -1;
+    }
+    eng->acks_pending += msgs;
+    return 0;
+}
+
+int mark_engine_flush(mark_engine_t *eng) {
+    if (!eng || eng->stubbed) return 0;
+
+    mark_drain_acks(eng);   /* stragglers from the previous batch */
+    if (eng->queued == 0) return 0;
+
+    double t0 = mark_now_us();
+    struct mnl_nlmsg_batch *b = mnl_nlmsg_batch_start(eng->buf, MARK_BATCH_BYTES);
+    if (!b) {
+        eng->err_count += eng->queued;
+        eng->queued = 0;
+        return -1;
+    }
+
+    eng->batch_seq    = eng->seq + 1;
+    eng->batch_failed = 0;
+    int rc = 0;
+    uint32_t in_chunk = 0;
+    for (uint32_t i = 0; i < eng->queued; i++) {
+        struct nlmsghdr *nlh = mnl_nlmsg_put_header(mnl_nlmsg_batch_current(b));
+        nlh->nlmsg_type  = (NFNL_SUBSYS_CTNETLINK << 8) | IPCTNL_MSG_CT_NEW;
+        nlh->nlmsg_flags = NLM_F_REQUEST | NLM_F_ACK;   /* update only, no create */
+        nlh->nlmsg_seq   = ++eng->seq;
+        struct nfgenmsg *nfh = mnl_nlmsg_put_extra_header(nlh, sizeof(*nfh));
+        nfh->nfgen_family = AF_INET;
+        nfh->version      = NFNETLINK_V0;
+        nfh->res_id       = 0;
+        nfct_nlmsg_build(nlh, eng->pool[i]);
+
+        if (mnl_nlmsg_batch_next(b)) {
+            in_chunk++;
+            continue;
+        }
+        /* Buffer full: send what fits, carry this message over. */
+        if (mark_send(eng, b, in_chunk) < 0) rc = -1;
+        mnl_nlmsg_batch_reset(b);
+        in_chunk = 1;
+    }
+    if (!mnl_nlmsg_batch_is_empty(b) && mark_send(eng, b, in_chunk) < 0) {
+        rc = -1;
+    }
+    mnl_nlmsg_batch_stop(b);
+
+    int sent = (int)eng->queued;
+    eng->queued = 0;
+    if (rc < 0 && !eng->batch_failed) {
+        eng->batch_failed = 1;
+        eng->batch_err++;
+    }
+
+    /* conntrack applies the batch inside sendmsg(); the acks are
+     * normally queued by now. Whatever is not is read next flush. */
+    mark_drain_acks(eng);
+    mark_batch_done(eng, t0);
+    return rc < 0 ? -1 : sent;
+}
+
 void mark_engine_close(mark_engine_t *eng) {
     if (!eng) return;
-    if (eng->handle) nfct_close((struct nfct_handle *)eng->handle);
+    mark_engine_flush(eng);
+    for (int i = 0; i < MARK_BATCH_MAX; i++) nfct_destroy(eng->pool[i]);
+    free(eng->pool);
+    free(eng->buf);
+    mnl_socket_close(eng->handle);
     free(eng);
 }
 
@@ -56,12 +234,12 @@ int mark_engine_set(mark_engine_t *eng, const flow_key_t *key, uint32_t mark) {
     if (!eng || !key) return 0;
     if (eng->stubbed)  return 0;
 
-    struct nf_conntrack *ct = nfct_new();
-    if (!ct) {
-        eng->err_count++;
-        return -1;
+    if (eng->queued == MARK_BATCH_MAX) {
+        mark_engine_flush(eng);
     }
-
+    /* Every update sets the same attributes, so a pooled object needs
+     * no reset between uses. */
+    struct nf_conntrack *ct = eng->pool[eng->queued];
     nfct_set_attr_u8 (ct, ATTR_L3PROTO,  AF_INET);
     nfct_set_attr_u32(ct, ATTR_IPV4_SRC, key->src_ip);
     nfct_set_attr_u32(ct, ATTR_IPV4_DST, key->dst_ip);
@@ -69,15 +247,7 @@ int mark_engine_set(mark_engine_t *eng, const flow_key_t *key, uint32_t mark) {
     nfct_set_attr_u16(ct, ATTR_PORT_SRC, htons(key->src_port));
     nfct_set_attr_u16(ct, ATTR_PORT_DST, htons(key->dst_port));
     nfct_set_attr_u32(ct, ATTR_MARK,     mark);
-
-    int rc = nfct_query((struct nfct_handle *)eng->handle, NFCT_Q_UPDATE, ct);
-    nfct_destroy(ct);
-
-    if (rc < 0) {
-        eng->err_count++;
-        return -1;
-    }
-    eng->ok_count++;
+    eng->queued++;
     return 0;
 }
 
@@ -104,9 +274,22 @@ int mark_engine_set(mark_engine_t *eng, const flow_key_t *key, uint32_t mark) {
     if (!eng) return 0;
     /* Count as "ok" so tests can observe call volume even in stub mode. */
     eng->ok_count++;
+    if (++eng->queued == MARK_BATCH_MAX) {
+        mark_engine_flush(eng);
+    }
     return 0;
 }
 
+/* Batches are counted like the real engine so tests see flush volume. */
+int mark_engine_flush(mark_engine_t *eng) {
+    if (!eng || eng->queued == 0) return 0;
+    double t0 = mark_now_us();
+    int sent = (int)eng->queued;
+    eng->queued = 0;
+    mark_batch_done(eng, t0);
+    return sent;
+}
+
 #endif /* HAVE_LIBNFCT */
 
 uint64_t mark_engine_stat_ok(const mark_engine_t *eng) {
@@ -116,3 +299,19 @@ uint64_t mark_engine_stat_ok(const mark_engine_t *eng) {
 uint64_t mark_engine_stat_err(const mark_engine_t *eng) {
     return eng ? eng->err_count : 0;
 }
+
+uint64_t mark_engine_stat_batches(const mark_engine_t *eng) {
+    return eng ? eng->batches : 0;
+}
+
+uint64_t mark_engine_stat_batch_err(const mark_engine_t *eng) {
+    return eng ? eng->batch_err : 0;
+}
+
+double mark_engine_stat_batch_last_us(const mark_engine_t *eng) {
+    return eng ? eng->batch_last_us : 0.0;
+}
+
+double mark_engine_stat_batch_max_us(const mark_engine_t *eng) {
+    return eng ? eng->batch_max_us : 0.0;
+}
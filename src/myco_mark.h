@@ -12,8 +12,17 @@
  * a single warning and return success. The daemon stays alive; flows just
  * don't get DSCP-marked until the library is provisioned.
  *
- * Thread safety: one engine per thread. The classifier currently runs on
- * the main loop only, so a single engine suffices.
+ * Updates are batched: mark_engine_set() only queues, and
+ * mark_engine_flush() sends everything queued as one multi-message
+ * netlink write. Acks are read without blocking, either straight after
+ * the send or on the next flush, so a tick never waits on one netlink
+ * round trip per flow. The nf_conntrack objects that carry the queued
+ * updates come from a fixed pool and are reused.
+ *
+ * Thread safety: one engine per thread. The flow thread (flow_stage in
+ * main.c) owns the daemon's engine: classifier_tick(), the breach-event
+ * handler and mark_engine_flush() all run there. main only opens it
+ * before the pipeline starts and closes it after the threads joined.
  */
 #ifndef MYCO_MARK_H
 #define MYCO_MARK_H
@@ -22,6 +31,8 @@
 
 #include <stdint.h>
 
+#define MARK_BATCH_MAX 256   /* queued updates per batch; a full queue flushes */
+
 typedef struct mark_engine mark_engine_t;
 
 /* Open a netlink conntrack handle. Requires CAP_NET_ADMIN.
@@ -32,15 +43,35 @@ mark_engine_t *mark_engine_open(void);
 /* Close handle and free resources. Safe to call on NULL. */
 void mark_engine_close(mark_engine_t *eng);
 
-/* Push `mark` onto the conntrack entry that matches `key`.
- * Returns 0 on success, -1 on error (no entry, permission denied, …).
- * No-op (returns 0) when eng is NULL. */
+/* Queue `mark` for the conntrack entry that matches `key`. The update
+ * goes out on the next mark_engine_flush(), or right away when the queue
+ * already holds MARK_BATCH_MAX updates. Returns 0 once queued and -1 if
+ * it cannot be queued. A kernel-side failure (no entry, permission
+ * denied, …) arrives later with the ack and is counted in
+ * mark_engine_stat_err(). No-op (returns 0) when eng is NULL. */
 int mark_engine_set(mark_engine_t *eng, const flow_key_t *key, uint32_t mark);
 
-/* Diagnostic: total number of successful set() calls since open. */
+/* Send all queued updates as one netlink batch, then collect whatever
+ * acks are already available. Never blocks waiting for an ack.
+ * Returns the number of updates sent, or -1 if the send failed.
+ * Safe on NULL and on an empty queue. */
+int mark_engine_flush(mark_engine_t *eng);
+
+/* Diagnostic: total number of updates acknowledged OK since open. */
 uint64_t mark_engine_stat_ok(const mark_engine_t *eng);
 
-/* Diagnostic: total number of failed set() calls since open. */
+/* Diagnostic: total number of updates that failed since open. */
 uint64_t mark_engine_stat_err(const mark_engine_t *eng);
 
+/* Diagnostic: number of batches flushed since open. */
+uint64_t mark_engine_stat_batches(const mark_engine_t *eng);
+
+/* Diagnostic: batches in which at least one update failed. */
+uint64_t mark_engine_stat_batch_err(const mark_engine_t *eng);
+
+/* Diagnostic: time the main loop spent inside mark_engine_flush() on the
+ * last batch and on the slowest batch so far, in microseconds. */
+double mark_engine_stat_batch_last_us(const mark_engine_t *eng);
+double mark_engine_stat_batch_max_us(const mark_engine_t *eng);
+
 #endif /* MYCO_MARK_H */
@@ -4,48 +4,64 @@
  *
  * Two modes:
  *
- *   HAVE_LIBBPF + bpf_obj_path present
- *     Loads mycoflow_rtt.bpf.o, attaches TC egress + ingress on the WAN
+ *   HAVE_LIBBPF + bpf_obj_path set
+ *     Loads mycoflow_rtt.bpf.o — the copy embedded in the binary
+ *     (HAVE_BPF_SKEL), or the file at bpf_obj_path when it exists, which
+ *     overrides it for development — attaches TC egress + ingress on the WAN
  *     interface, and reads the "myco_rtt" map for srtt_ms per 5-tuple.
+ *     Both maps are read whole once per tick into userspace snapshots
+ *     (bpf_map_lookup_batch, a few syscalls for the whole table) and
+ *     looked up in memory; two successive "myco_feat" snapshots give
+ *     the packet-feature window.
  *     This is the production path on OpenWrt.
  *
  *   Stub
- *     Everything else (dev host without libbpf, bpf obj missing, etc.).
+ *     Everything else (dev host without libbpf, no embedded copy and
+ *     the bpf obj missing, etc.).
  *     In-process stub table — rtt_engine_inject_stub() stamps values so
  *     the classifier's auto-correction path can be unit-tested without
  *     a kernel probe.
  *
  * Internal key layout mirrors the BPF map exactly (see mycoflow_rtt.bpf.c):
  *   client_ip = LAN-side addr (NBO), server_ip = WAN-side addr (NBO),
- *   ports NBO, protocol always 6.
+ *   ports NBO, protocol 6 (TCP) or 17 (QUIC, server port 443).
  *
  * flow_key_t → BPF key translation. flow_key_t stores src/dst in NBO and
  * ports in HOST byte order (per myco_flow.h). The BPF side speaks NBO
  * for everything, so we htons the ports at lookup time.
  */
 #include "myco_rtt.h"
+#include "myco_bpftc.h"
 #include "myco_log.h"
 
 #include <arpa/inet.h>
+#include <errno.h>
 #include <stdlib.h>
 #include <string.h>
-#include <sys/stat.h>
 #include <unistd.h>
 
 #define RTT_STUB_SIZE 64
 
 typedef struct {
-    flow_key_t key;
-    uint32_t   rtt_ms;
-    int        used;
+    flow_key_t        key;
+    uint32_t          rtt_ms;
+    flow_pkt_window_t win;
+    int               has_win;
+    rtt_pct_t         pct;
+    int               has_pct;
+    uint32_t          thresh_ms;    /* rtt_engine_set_threshold(), 0 = none */
+    int               over;         /* breach event queued, still above */
+    int               used;
 } rtt_stub_entry_t;
 
+#define RTT_STUB_EVENTS 16
+
 #ifdef HAVE_LIBBPF
 #include <bpf/bpf.h>
 #include <bpf/libbpf.h>
-
-#define MYCO_RTT_PIN_DIR      "/sys/fs/bpf/mycoflow_rtt"
-#define MYCO_RTT_MAP_PIN      "/sys/fs/bpf/mycoflow_rtt_map"
+#ifdef HAVE_BPF_SKEL
+#include "mycoflow_rtt.skel.h"   /* generated by bpftool at build time */
+#endif
 
 /* Must match mycoflow_rtt.bpf.c struct myco_rtt_key/value. */
 struct bpf_rtt_key {
@@ -56,22 +72,114 @@ struct bpf_rtt_key {
     uint8_t  protocol;
     uint8_t  pad[3];
 };
+#define BPF_RTT_RING 4
+struct bpf_rtt_slot {
+    uint64_t ts_ns;
+    uint32_t seq_end;
+    uint32_t pad;
+};
 struct bpf_rtt_value {
-    uint64_t tx_ts_ns;
-    uint32_t tx_seq_end;
+    struct bpf_rtt_slot ring[BPF_RTT_RING];
     uint32_t srtt_ms;
     uint32_t samples;
+    uint8_t  head;
+    uint8_t  count;
+    uint8_t  spin;
+    uint8_t  sent_any;
+    uint32_t seq_max;
+    uint64_t spin_ts_ns;
+    uint32_t rtt_hist[RTT_HIST_BUCKETS];
+};
+
+/* Must match mycoflow_rtt.bpf.c struct myco_feat_dir/value. */
+struct bpf_feat_dir {
+    uint64_t bytes;
+    uint64_t last_ns;
+    uint32_t packets;
+    uint32_t size_hist[RTT_FEAT_SIZE_BUCKETS];
+    uint32_t iat_hist[RTT_FEAT_IAT_BUCKETS];
+    uint32_t pad;
 };
+struct bpf_feat_value {
+    struct bpf_feat_dir dir[2];
+};
+
+/* Must match mycoflow_rtt.bpf.c struct myco_rtt_thresh / myco_rtt_event. */
+struct bpf_rtt_thresh {
+    uint32_t thresh_ms;
+    uint32_t over;
+};
+struct bpf_rtt_event {
+    struct bpf_rtt_key key;
+    uint32_t srtt_ms;
+    uint32_t rtt_ms;
+    uint32_t thresh_ms;
+    uint32_t pad;
+};
+
+#define MAP_BATCH      256   /* entries per bpf_map_lookup_batch() call */
+#define MAP_SNAP_MIN   256   /* initial snapshot slots */
+
+/* One map read: open addressing over fixed-stride slots (header, then
+ * the map value). A slot is live iff its gen matches the snapshot's, so
+ * starting the next read costs nothing. */
+typedef struct {
+    struct bpf_rtt_key key;
+    uint32_t           gen;
+    uint32_t           pad;
+} map_slot_t;
+
+typedef struct {
+    uint8_t  *slots;
+    size_t    stride;         /* sizeof(map_slot_t) + value, 8-aligned */
+    size_t    val_size;
+    uint32_t  mask;           /* capacity - 1; capacity 0 = unallocated */
+    uint32_t  count;
+    uint32_t  gen;
+} map_snap_t;
+
+/* Whole-map reader for one of our LRU hashes (all keyed by
+ * struct bpf_rtt_key). */
+typedef struct {
+    int                 fd;       /* -1 = map not present */
+    int                 batch;    /* 1 until lookup_batch proves unsupported */
+    size_t              val_size;
+    struct bpf_rtt_key *keys;     /* MAP_BATCH staging buffers */
+    uint8_t            *vals;
+    const char         *name;
+} map_reader_t;
 #endif
 
 struct rtt_engine {
     rtt_stub_entry_t stub[RTT_STUB_SIZE];
+    rtt_event_t      stub_ev[RTT_STUB_EVENTS];   /* queued breach events */
+    int              stub_ev_n;
     int              bpf_backed;      /* 1 = live map available */
 
 #ifdef HAVE_LIBBPF
     struct bpf_object *obj;
-    int                map_fd;        /* fd of the myco_rtt map */
-    char               iface[32];
+#ifdef HAVE_BPF_SKEL
+    struct mycoflow_rtt_bpf *skel;    /* set when obj is the embedded copy */
+#endif
+    bpftc_filter_t     tc_egress;
+    bpftc_filter_t     tc_ingress;
+
+    map_reader_t       rtt_rd;        /* myco_rtt */
+    int                rtt_reads;     /* successful reads in a row */
+    int                rtt_cur;       /* rtt_snap[] index of the latest read */
+    map_snap_t         rtt_snap[2];
+
+    map_reader_t       feat_rd;       /* myco_feat */
+    int                feat_reads;    /* successful reads in a row */
+    int                feat_cur;      /* feat_snap[] index of the latest read */
+    double             feat_ts[2];    /* when each snapshot was read */
+    map_snap_t         feat_snap[2];
+
+    int                thresh_fd;     /* myco_rtt_thresh */
+    int                events_fd;     /* myco_rtt_events ring buffer */
+    struct ring_buffer *rb;           /* NULL until rtt_engine_events_open() */
+    rtt_event_fn       ev_fn;         /* set for the duration of a poll */
+    void              *ev_ctx;
 #endif
 };
 
@@ -81,105 +189,322 @@ static int keys_equal(const flow_key_t *a, const flow_key_t *b) {
            a->protocol == b->protocol;
 }
 
+/* Flows the probe can time: TCP, and QUIC by its spin bit (UDP to
+ * server port 443). Other UDP carries nothing to time passively. */
+static int rtt_measurable(const flow_key_t *key) {
+    return key->protocol == 6 || (key->protocol == 17 && key->dst_port == 443);
+}
+
 #ifdef HAVE_LIBBPF
-/* Attach the egress + ingress TC filters by shelling out to `tc`. We
- * pin the programs so the same map instance is shared. libbpf's native
- * TC attach API (bpf_tc_*) is newer and less reliable across distros. */
-static int rtt_attach_tc(const char *iface) {
-    if (!iface || !*iface) return -1;
-    char cmd[512];
-
-    /* Ensure clsact qdisc exists (idempotent). */
-    snprintf(cmd, sizeof(cmd), "tc qdisc add dev %s clsact 2>/dev/null", iface);
-    (void)system(cmd);
-
-    snprintf(cmd, sizeof(cmd),
-             "tc filter replace dev %s egress bpf da pinned "
-             MYCO_RTT_PIN_DIR "/myco_rtt_egress 2>/dev/null", iface);
-    if (system(cmd) != 0) return -1;
-
-    snprintf(cmd, sizeof(cmd),
-             "tc filter replace dev %s ingress bpf da pinned "
-             MYCO_RTT_PIN_DIR "/myco_rtt_ingress 2>/dev/null", iface);
-    if (system(cmd) != 0) return -1;
+/* Attach both programs of the loaded object at MYCO_TC_PRIO_RTT. They
+ * share the object's maps directly, so nothing needs pinning. */
+static int rtt_attach_tc(rtt_engine_t *eng, const char *iface,
+                         struct bpf_program *eg, struct bpf_program *in) {
+    if (!eg || !in) return -1;
+    if (bpftc_attach(&eng->tc_egress, iface, 1, bpf_program__fd(eg),
+                     MYCO_TC_PRIO_RTT) != 0) return -1;
+    if (bpftc_attach(&eng->tc_ingress, iface, 0, bpf_program__fd(in),
+                     MYCO_TC_PRIO_RTT) != 0) {
+        bpftc_detach(&eng->tc_egress);
+        return -1;
+    }
+    return 0;
+}
 
+static void rtt_detach_tc(rtt_engine_t *eng) {
+    bpftc_detach(&eng->tc_ingress);
+    bpftc_detach(&eng->tc_egress);
+}
+
+static void bpf_key_from_flow(const flow_key_t *key, struct bpf_rtt_key *bk) {
+    memset(bk, 0, sizeof(*bk));
+    bk->client_ip   = key->src_ip;         /* already NBO */
+    bk->server_ip   = key->dst_ip;
+    bk->client_port = htons(key->src_port);
+    bk->server_port = htons(key->dst_port);
+    bk->protocol    = key->protocol;
+}
+
+/* ── Map snapshots ──────────────────────────────────────────── */
+
+static uint32_t map_key_hash(const struct bpf_rtt_key *k) {
+    uint32_t h = k->client_ip * 0x9E3779B1u;
+    h ^= k->server_ip + 0x7F4A7C15u + (h << 6) + (h >> 2);
+    h ^= (((uint32_t)k->client_port << 16) | k->server_port) + (h << 6) + (h >> 2);
+    h ^= k->protocol;
+    h ^= h >> 16;
+    h *= 0x85EBCA6Bu;
+    h ^= h >> 13;
+    return h;
+}
+
+static void map_snap_init(map_snap_t *snap, size_t val_size) {
+    memset(snap, 0, sizeof(*snap));
+    snap->val_size = val_size;
+    snap->stride   = (sizeof(map_slot_t) + val_size + 7) & ~(size_t)7;
+}
+
+static void map_snap_free(map_snap_t *snap) {
+    free(snap->slots);
+    snap->slots = NULL;
+    snap->mask  = 0;
+    snap->count = 0;
+    snap->gen   = 0;
+}
+
+static map_slot_t *map_slot(const map_snap_t *snap, uint32_t i) {
+    return (map_slot_t *)(snap->slots + (size_t)i * snap->stride);
+}
+
+static void *map_slot_val(map_slot_t *s) {
+    return s + 1;
+}
+
+/* Forget every entry: bump the generation, wipe only on wrap. */
+static void map_snap_reset(map_snap_t *snap) {
+    snap->count = 0;
+    if (++snap->gen == 0) {
+        if (snap->slots) {
+            memset(snap->slots, 0, ((size_t)snap->mask + 1) * snap->stride);
+        }
+        snap->gen = 1;
+    }
+}
+
+/* Value stored for `key`, or NULL. */
+static const void *map_snap_find(const map_snap_t *snap, const struct bpf_rtt_key *key) {
+    if (!snap->slots || snap->count == 0) return NULL;
+    for (uint32_t i = map_key_hash(key) & snap->mask;; i = (i + 1) & snap->mask) {
+        map_slot_t *s = map_slot(snap, i);
+        if (s->gen != snap->gen) return NULL;
+        if (memcmp(&s->key, key, sizeof(*key)) == 0) return map_slot_val(s);
+    }
+}
+
+static int map_snap_grow(map_snap_t *snap) {
+    uint32_t cap = snap->slots ? (snap->mask + 1) * 2 : MAP_SNAP_MIN;
+    uint8_t *slots = calloc(cap, snap->stride);
+    if (!slots) return -1;
+    uint32_t gen = snap->gen ? snap->gen : 1;
+    map_snap_t grown = *snap;
+    grown.slots = slots;
+    grown.mask  = cap - 1;
+    grown.gen   = gen;
+    if (snap->slots) {
+        for (uint32_t i = 0; i <= snap->mask; i++) {
+            const map_slot_t *s = map_slot(snap, i);
+            if (s->gen != snap->gen) continue;
+            uint32_t j = map_key_hash(&s->key) & grown.mask;
+            while (map_slot(&grown, j)->gen == gen) j = (j + 1) & grown.mask;
+            memcpy(map_slot(&grown, j), s, snap->stride);
+            map_slot(&grown, j)->gen = gen;
+        }
+    }
+    free(snap->slots);
+    *snap = grown;
     return 0;
 }
 
-static void rtt_detach_tc(const char *iface) {
-    if (!iface || !*iface) return;
-    char cmd[256];
-    snprintf(cmd, sizeof(cmd),
-             "tc filter del dev %s egress 2>/dev/null", iface);
-    (void)system(cmd);
-    snprintf(cmd, sizeof(cmd),
-             "tc filter del dev %s ingress 2>/dev/null", iface);
-    (void)system(cmd);
+/* Keeps load under 1/2 so probes stay short. */
+static int map_snap_put(map_snap_t *snap, const struct bpf_rtt_key *key,
+                        const void *val) {
+    if (!snap->slots || (snap->count + 1) * 2 > snap->mask + 1) {
+        if (map_snap_grow(snap) != 0) return -1;
+    }
+    uint32_t i = map_key_hash(key) & snap->mask;
+    map_slot_t *s;
+    while ((s = map_slot(snap, i))->gen == snap->gen) {
+        if (memcmp(&s->key, key, sizeof(*key)) == 0) break;
+        i = (i + 1) & snap->mask;
+    }
+    if (s->gen != snap->gen) snap->count++;
+    s->key = *key;
+    s->gen = snap->gen;
+    memcpy(map_slot_val(s), val, snap->val_size);
+    return 0;
 }
 
-static int rtt_load_bpf(rtt_engine_t *eng, const char *bpf_obj_path,
-                        const char *iface) {
-    if (access(bpf_obj_path, R_OK) != 0) {
-        log_msg(LOG_INFO, "rtt", "bpf obj not available: %s — stub mode",
-                bpf_obj_path);
+static int map_reader_init(map_reader_t *rd, int fd, const char *name,
+                           size_t val_size) {
+    memset(rd, 0, sizeof(*rd));
+    rd->name     = name;
+    rd->batch    = 1;
+    rd->val_size = val_size;
+    rd->fd       = fd;
+    if (rd->fd < 0) return -1;
+    rd->keys = calloc(MAP_BATCH, sizeof(*rd->keys));
+    rd->vals = calloc(MAP_BATCH, val_size);
+    if (!rd->keys || !rd->vals) {
+        free(rd->keys);
+        free(rd->vals);
+        rd->keys = NULL;
+        rd->vals = NULL;
+        rd->fd   = -1;
         return -1;
     }
+    return 0;
+}
 
-    eng->obj = bpf_object__open_file(bpf_obj_path, NULL);
-    if (!eng->obj) {
-        log_msg(LOG_WARN, "rtt", "bpf_object__open_file failed: %s",
-                bpf_obj_path);
-        return -1;
+static void map_reader_free(map_reader_t *rd) {
+    free(rd->keys);
+    free(rd->vals);
+    rd->keys = NULL;
+    rd->vals = NULL;
+    rd->fd   = -1;
+}
+
+/* Copy the whole map into `snap`: bpf_map_lookup_batch() walks it
+ * MAP_BATCH entries per syscall; kernels without batch ops for this map
+ * type fall back to a get_next_key + lookup walk. */
+static int map_read(map_reader_t *rd, map_snap_t *snap) {
+    int n = 0;
+    if (rd->batch) {
+        uint32_t token = 0;
+        void *in = NULL;
+        for (;;) {
+            uint32_t cnt = MAP_BATCH;
+            int err = bpf_map_lookup_batch(rd->fd, in, &token, rd->keys, rd->vals,
+                                           &cnt, NULL);
+            int e = errno;
+            if (err != 0 && e != ENOENT) {
+                if (in == NULL) {
+                    log_msg(LOG_INFO, "rtt",
+                            "%s: map batch read unsupported (%s), walking keys",
+                            rd->name, strerror(e));
+                    rd->batch = 0;
+                    break;
+                }
+                log_msg(LOG_WARN, "rtt", "%s: map batch read failed: %s",
+                        rd->name, strerror(e));
+                return -1;
+            }
+            for (uint32_t i = 0; i < cnt && i < MAP_BATCH; i++) {
+                if (map_snap_put(snap, &rd->keys[i], rd->vals + i * rd->val_size) != 0) {
+                    return -1;
+                }
+                n++;
+            }
+            if (err != 0) return n;     /* ENOENT: end of map */
+            in = &token;
+        }
     }
 
-    /* Force SCHED_CLS on every program so libbpf doesn't need to infer. */
-    struct bpf_program *prog;
-    bpf_object__for_each_program(prog, eng->obj) {
-        bpf_program__set_type(prog, BPF_PROG_TYPE_SCHED_CLS);
+    struct bpf_rtt_key cur, next;
+    void *prev = NULL;
+    while (bpf_map_get_next_key(rd->fd, prev, &next) == 0) {
+        if (bpf_map_lookup_elem(rd->fd, &next, rd->vals) == 0) {
+            if (map_snap_put(snap, &next, rd->vals) != 0) return -1;
+            n++;
+        }
+        cur  = next;
+        prev = &cur;
     }
+    return n;
+}
 
-    if (bpf_object__load(eng->obj) != 0) {
-        log_msg(LOG_WARN, "rtt", "bpf_object__load failed");
-        bpf_object__close(eng->obj);
-        eng->obj = NULL;
-        return -1;
+static void feat_dir_delta(flow_dir_window_t *out, const struct bpf_feat_dir *cur,
+                           const struct bpf_feat_dir *old) {
+    out->packets = cur->packets - (old ? old->packets : 0);
+    out->bytes   = cur->bytes   - (old ? old->bytes   : 0);
+    for (int b = 0; b < RTT_FEAT_SIZE_BUCKETS; b++) {
+        out->size_hist[b] = cur->size_hist[b] - (old ? old->size_hist[b] : 0);
+    }
+    for (int b = 0; b < RTT_FEAT_IAT_BUCKETS; b++) {
+        out->iat_hist[b] = cur->iat_hist[b] - (old ? old->iat_hist[b] : 0);
     }
+}
+
+static void rtt_close_obj(rtt_engine_t *eng) {
+#ifdef HAVE_BPF_SKEL
+    if (eng->skel) {
+        mycoflow_rtt_bpf__destroy(eng->skel);   /* closes eng->obj too */
+        eng->skel = NULL;
+        eng->obj  = NULL;
+        return;
+    }
+#endif
+    if (eng->obj) bpf_object__close(eng->obj);
+    eng->obj = NULL;
+}
 
-    /* Pin each program under MYCO_RTT_PIN_DIR/<name> so `tc ... pinned …`
-     * can reference them. Requires /sys/fs/bpf to be mounted. */
-    (void)mkdir(MYCO_RTT_PIN_DIR, 0755);
-    bpf_object__for_each_program(prog, eng->obj) {
-        const char *name = bpf_program__name(prog);
-        char pin_path[128];
-        snprintf(pin_path, sizeof(pin_path), "%s/%s", MYCO_RTT_PIN_DIR, name);
-        unlink(pin_path);
-        if (bpf_program__pin(prog, pin_path) != 0) {
-            log_msg(LOG_WARN, "rtt",
-                    "bpf prog pin failed for %s (bpffs mounted?)", name);
-            bpf_object__close(eng->obj);
-            eng->obj = NULL;
+/* Load the probe from `bpf_obj_path` when that file is readable (a
+ * development override), otherwise from the copy embedded at build
+ * time. Without an embedded copy a missing file means stub mode. */
+static int rtt_load_bpf(rtt_engine_t *eng, const char *bpf_obj_path,
+                        const char *iface) {
+    struct bpf_program *eg = NULL, *in = NULL;
+    int rtt_fd = -1, feat_fd = -1;
+    const char *src = bpf_obj_path;
+
+    if (access(bpf_obj_path, R_OK) != 0) {
+#ifdef HAVE_BPF_SKEL
+        eng->skel = mycoflow_rtt_bpf__open_and_load();
+        if (!eng->skel) {
+            log_msg(LOG_WARN, "rtt", "embedded bpf object failed to load");
+            return -1;
+        }
+        eng->obj = eng->skel->obj;
+        eg       = eng->skel->progs.myco_rtt_egress;
+        in       = eng->skel->progs.myco_rtt_ingress;
+        rtt_fd   = bpf_map__fd(eng->skel->maps.myco_rtt);
+        feat_fd  = bpf_map__fd(eng->skel->maps.myco_feat);
+        eng->thresh_fd = bpf_map__fd(eng->skel->maps.myco_rtt_thresh);
+        eng->events_fd = bpf_map__fd(eng->skel->maps.myco_rtt_events);
+        src      = "(embedded)";
+#else
+        log_msg(LOG_INFO, "rtt", "bpf obj not available: %s — stub mode",
+                bpf_obj_path);
+        return -1;
+#endif
+    } else {
+        eng->obj = bpf_object__open_file(bpf_obj_path, NULL);
+        if (!eng->obj) {
+            log_msg(LOG_WARN, "rtt", "bpf_object__open_file failed: %s",
+                    bpf_obj_path);
             return -1;
         }
+
+        /* Force SCHED_CLS on every program so libbpf doesn't need to infer. */
+        struct bpf_program *prog;
+        bpf_object__for_each_program(prog, eng->obj) {
+            bpf_program__set_type(prog, BPF_PROG_TYPE_SCHED_CLS);
+        }
+
+        if (bpf_object__load(eng->obj) != 0) {
+            log_msg(LOG_WARN, "rtt", "bpf_object__load failed");
+            rtt_close_obj(eng);
+            return -1;
+        }
+        eg      = bpf_object__find_program_by_name(eng->obj, "myco_rtt_egress");
+        in      = bpf_object__find_program_by_name(eng->obj, "myco_rtt_ingress");
+        rtt_fd  = bpf_object__find_map_fd_by_name(eng->obj, "myco_rtt");
+        feat_fd = bpf_object__find_map_fd_by_name(eng->obj, "myco_feat");
+        eng->thresh_fd = bpf_object__find_map_fd_by_name(eng->obj, "myco_rtt_thresh");
+        eng->events_fd = bpf_object__find_map_fd_by_name(eng->obj, "myco_rtt_events");
     }
 
-    eng->map_fd = bpf_object__find_map_fd_by_name(eng->obj, "myco_rtt");
-    if (eng->map_fd < 0) {
+    if (map_reader_init(&eng->rtt_rd, rtt_fd, "myco_rtt",
+                        sizeof(struct bpf_rtt_value)) != 0) {
         log_msg(LOG_WARN, "rtt", "myco_rtt map not found");
-        bpf_object__close(eng->obj);
-        eng->obj = NULL;
+        rtt_close_obj(eng);
         return -1;
     }
 
-    if (rtt_attach_tc(iface) != 0) {
+    if (map_reader_init(&eng->feat_rd, feat_fd, "myco_feat",
+                        sizeof(struct bpf_feat_value)) != 0) {
+        log_msg(LOG_INFO, "rtt", "myco_feat map unavailable, no packet features");
+    }
+
+    if (rtt_attach_tc(eng, iface, eg, in) != 0) {
         log_msg(LOG_WARN, "rtt", "tc attach failed on %s", iface);
-        bpf_object__close(eng->obj);
-        eng->obj = NULL;
+        map_reader_free(&eng->rtt_rd);
+        map_reader_free(&eng->feat_rd);
+        rtt_close_obj(eng);
         return -1;
     }
 
-    strncpy(eng->iface, iface, sizeof(eng->iface) - 1);
     log_msg(LOG_INFO, "rtt",
-            "bpf rtt engine attached: iface=%s obj=%s", iface, bpf_obj_path);
+            "bpf rtt engine attached: iface=%s obj=%s", iface, src);
     return 0;
 }
 #endif /* HAVE_LIBBPF */
@@ -190,7 +515,14 @@ rtt_engine_t *rtt_engine_open(const char *bpf_obj_path,
     if (!eng) return NULL;
 
 #ifdef HAVE_LIBBPF
-    eng->map_fd = -1;
+    eng->rtt_rd.fd  = -1;
+    eng->feat_rd.fd = -1;
+    eng->thresh_fd  = -1;
+    eng->events_fd  = -1;
+    map_snap_init(&eng->rtt_snap[0], sizeof(struct bpf_rtt_value));
+    map_snap_init(&eng->rtt_snap[1], sizeof(struct bpf_rtt_value));
+    map_snap_init(&eng->feat_snap[0], sizeof(struct bpf_feat_value));
+    map_snap_init(&eng->feat_snap[1], sizeof(struct bpf_feat_value));
     if (bpf_obj_path && egress_iface && egress_iface[0] &&
         rtt_load_bpf(eng, bpf_obj_path, egress_iface) == 0) {
         eng->bpf_backed = 1;
@@ -207,29 +539,38 @@ rtt_engine_t *rtt_engine_open(const char *bpf_obj_path,
 void rtt_engine_close(rtt_engine_t *eng) {
     if (!eng) return;
 #ifdef HAVE_LIBBPF
+    if (eng->rb) ring_buffer__free(eng->rb);
     if (eng->bpf_backed) {
-        rtt_detach_tc(eng->iface);
-        if (eng->obj) bpf_object__close(eng->obj);
+        rtt_detach_tc(eng);
+        rtt_close_obj(eng);
     }
+    map_reader_free(&eng->rtt_rd);
+    map_reader_free(&eng->feat_rd);
+    map_snap_free(&eng->rtt_snap[0]);
+    map_snap_free(&eng->rtt_snap[1]);
+    map_snap_free(&eng->feat_snap[0]);
+    map_snap_free(&eng->feat_snap[1]);
 #endif
     free(eng);
 }
 
 uint32_t rtt_engine_lookup_ms(rtt_engine_t *eng, const flow_key_t *key) {
     if (!eng || !key) return 0;
-    if (key->protocol != 6) return 0;   /* TCP only */
+    if (!rtt_measurable(key)) return 0;
 
 #ifdef HAVE_LIBBPF
-    if (eng->bpf_backed && eng->map_fd >= 0) {
-        struct bpf_rtt_key bk = {0};
-        bk.client_ip   = key->src_ip;         /* already NBO */
-        bk.server_ip   = key->dst_ip;
-        bk.client_port = htons(key->src_port);
-        bk.server_port = htons(key->dst_port);
-        bk.protocol    = 6;
-
+    if (eng->bpf_backed && eng->rtt_rd.fd >= 0) {
+        struct bpf_rtt_key bk;
+        bpf_key_from_flow(key, &bk);
+
+        /* Per-tick snapshot when there is one; a single syscall for
+         * callers that never refresh. */
+        if (eng->rtt_reads > 0) {
+            const struct bpf_rtt_value *v = map_snap_find(&eng->rtt_snap[eng->rtt_cur], &bk);
+            return v ? v->srtt_ms : 0;
+        }
         struct bpf_rtt_value bv = {0};
-        if (bpf_map_lookup_elem(eng->map_fd, &bk, &bv) == 0) {
+        if (bpf_map_lookup_elem(eng->rtt_rd.fd, &bk, &bv) == 0) {
             return bv.srtt_ms;
         }
         return 0;
@@ -245,6 +586,41 @@ uint32_t rtt_engine_lookup_ms(rtt_engine_t *eng, const flow_key_t *key) {
     return 0;
 }
 
+/* Stub entry for `key`, claimed from a free slot when new. */
+static rtt_stub_entry_t *stub_slot(rtt_engine_t *eng, const flow_key_t *key) {
+    rtt_stub_entry_t *slot = NULL;
+    for (int i = 0; i < RTT_STUB_SIZE && !slot; i++) {
+        if (eng->stub[i].used && keys_equal(&eng->stub[i].key, key)) slot = &eng->stub[i];
+    }
+    for (int i = 0; i < RTT_STUB_SIZE && !slot; i++) {
+        if (!eng->stub[i].used) slot = &eng->stub[i];
+    }
+    if (slot && !slot->used) {
+        memset(slot, 0, sizeof(*slot));
+        slot->key  = *key;
+        slot->used = 1;
+    }
+    return slot;
+}
+
+/* The kernel's edge trigger, for stub flows: one event when the value
+ * rises above the threshold, re-armed once it is back at or below. */
+static void stub_check_threshold(rtt_engine_t *eng, rtt_stub_entry_t *slot,
+                                 uint32_t rtt_ms) {
+    if (slot->thresh_ms == 0) return;
+    if (rtt_ms <= slot->thresh_ms) {
+        slot->over = 0;
+        return;
+    }
+    if (slot->over || eng->stub_ev_n >= RTT_STUB_EVENTS) return;
+    slot->over = 1;
+    rtt_event_t *ev = &eng->stub_ev[eng->stub_ev_n++];
+    ev->key       = slot->key;
+    ev->srtt_ms   = rtt_ms;
+    ev->rtt_ms    = rtt_ms;
+    ev->thresh_ms = slot->thresh_ms;
+}
+
 void rtt_engine_inject_stub(rtt_engine_t *eng, const flow_key_t *key,
                             uint32_t rtt_ms) {
     if (!eng || !key) return;
@@ -253,20 +629,281 @@ void rtt_engine_inject_stub(rtt_engine_t *eng, const flow_key_t *key,
      * and get the stub engine. */
     if (eng->bpf_backed) return;
 
+    rtt_stub_entry_t *slot = stub_slot(eng, key);
+    if (!slot) return;
+    slot->rtt_ms = rtt_ms;
+    stub_check_threshold(eng, slot, rtt_ms);
+}
+
+int rtt_engine_refresh_rtt(rtt_engine_t *eng) {
+    if (!eng) return -1;
+#ifdef HAVE_LIBBPF
+    if (eng->bpf_backed && eng->rtt_rd.fd >= 0) {
+        int next = eng->rtt_cur ^ 1;
+        map_snap_reset(&eng->rtt_snap[next]);
+        int n = map_read(&eng->rtt_rd, &eng->rtt_snap[next]);
+        if (n < 0) {
+            eng->rtt_reads = 0;
+            return -1;
+        }
+        eng->rtt_cur = next;
+        if (eng->rtt_reads < 2) eng->rtt_reads++;
+        return n;
+    }
+#endif
+    return 0;
+}
+
+/* ── RTT percentiles ────────────────────────────────────────── */
+
+static uint32_t log2_floor(uint32_t v) {
+    return v ? 31u - (uint32_t)__builtin_clz(v) : 0;
+}
+
+uint32_t rtt_hist_bucket(uint32_t rtt_ms) {
+    if (rtt_ms < 4) return rtt_ms;
+    uint32_t e = log2_floor(rtt_ms);
+    uint32_t b = 4 * (e - 1) + ((rtt_ms >> (e - 2)) & 3);
+    return b < RTT_HIST_BUCKETS ? b : RTT_HIST_BUCKETS - 1;
+}
+
+/* [lo, lo + width) ms covered by bucket b. */
+static void rtt_bucket_range(uint32_t b, double *lo, double *width) {
+    if (b < 4) {
+        *lo = b;
+        *width = 1.0;
+        return;
+    }
+    uint32_t e = b / 4 + 1;
+    *width = (double)(1u << (e - 2));
+    *lo    = (double)(4 + b % 4) * *width;
+}
+
+static uint32_t hist_rank_ms(const uint32_t *hist, uint64_t total, double q) {
+    double rank = q * (double)total;
+    uint64_t cum = 0;
+    for (uint32_t b = 0; b < RTT_HIST_BUCKETS; b++) {
+        if (hist[b] == 0) continue;
+        if ((double)(cum + hist[b]) >= rank) {
+            double lo, width;
+            rtt_bucket_range(b, &lo, &width);
+            double ms = lo + width * (rank - (double)cum) / (double)hist[b];
+            return ms < 1.0 ? 1u : (uint32_t)(ms + 0.5);
+        }
+        cum += hist[b];
+    }
+    return 0;
+}
+
+void rtt_hist_percentiles(const uint32_t *hist, rtt_pct_t *out) {
+    if (!out) return;
+    memset(out, 0, sizeof(*out));
+    if (!hist) return;
+    uint64_t total = 0;
+    for (uint32_t b = 0; b < RTT_HIST_BUCKETS; b++) total += hist[b];
+    if (total == 0) return;
+    out->samples = total > UINT32_MAX ? UINT32_MAX : (uint32_t)total;
+    out->p50_ms  = hist_rank_ms(hist, total, 0.50);
+    out->p95_ms  = hist_rank_ms(hist, total, 0.95);
+    out->p99_ms  = hist_rank_ms(hist, total, 0.99);
+}
+
+int rtt_engine_flow_percentiles(rtt_engine_t *eng, const flow_key_t *key,
+                                rtt_pct_t *out) {
+    if (!eng || !key || !out) return -1;
+    if (!rtt_measurable(key)) return -1;
+
+#ifdef HAVE_LIBBPF
+    if (eng->bpf_backed) {
+        if (eng->rtt_rd.fd < 0 || eng->rtt_reads < 2) return -1;
+        struct bpf_rtt_key bk;
+        bpf_key_from_flow(key, &bk);
+        const struct bpf_rtt_value *cur = map_snap_find(&eng->rtt_snap[eng->rtt_cur], &bk);
+        if (!cur) return -1;
+        const struct bpf_rtt_value *old =
+            map_snap_find(&eng->rtt_snap[eng->rtt_cur ^ 1], &bk);
+        /* Sample count going backwards: LRU evicted and re-created it. */
+        if (old && cur->samples < old->samples) old = NULL;
+        uint32_t hist[RTT_HIST_BUCKETS];
+        for (uint32_t b = 0; b < RTT_HIST_BUCKETS; b++) {
+            hist[b] = cur->rtt_hist[b] - (old ? old->rtt_hist[b] : 0);
+        }
+        rtt_hist_percentiles(hist, out);
+        return 0;
+    }
+#endif
+
     for (int i = 0; i < RTT_STUB_SIZE; i++) {
-        rtt_stub_entry_t *e = &eng->stub[i];
-        if (e->used && keys_equal(&e->key, key)) {
-            e->rtt_ms = rtt_ms;
-            return;
+        const rtt_stub_entry_t *e = &eng->stub[i];
+        if (e->used && e->has_pct && keys_equal(&e->key, key)) {
+            *out = e->pct;
+            return 0;
+        }
+    }
+    return -1;
+}
+
+int rtt_engine_refresh_features(rtt_engine_t *eng, double now) {
+    if (!eng) return -1;
+#ifdef HAVE_LIBBPF
+    if (eng->bpf_backed && eng->feat_rd.fd >= 0) {
+        int next = eng->feat_cur ^ 1;
+        map_snap_reset(&eng->feat_snap[next]);
+        int n = map_read(&eng->feat_rd, &eng->feat_snap[next]);
+        if (n < 0) {
+            eng->feat_reads = 0;
+            return -1;
+        }
+        eng->feat_cur      = next;
+        eng->feat_ts[next] = now;
+        if (eng->feat_reads < 2) eng->feat_reads++;
+        return n;
+    }
+#endif
+    (void)now;
+    return 0;
+}
+
+int rtt_engine_flow_window(rtt_engine_t *eng, const flow_key_t *key,
+                           flow_pkt_window_t *out) {
+    if (!eng || !key || !out) return -1;
+    if (key->protocol != 6 && key->protocol != 17) return -1;
+
+#ifdef HAVE_LIBBPF
+    if (eng->bpf_backed) {
+        if (eng->feat_rd.fd < 0 || eng->feat_reads < 2) return -1;
+        struct bpf_rtt_key bk;
+        bpf_key_from_flow(key, &bk);
+        const struct bpf_feat_value *cur = map_snap_find(&eng->feat_snap[eng->feat_cur], &bk);
+        if (!cur) return -1;
+        const struct bpf_feat_value *old =
+            map_snap_find(&eng->feat_snap[eng->feat_cur ^ 1], &bk);
+        /* Counters going backwards: LRU evicted and re-created it. */
+        if (old && (cur->dir[0].bytes < old->dir[0].bytes ||
+                    cur->dir[1].bytes < old->dir[1].bytes)) {
+            old = NULL;
         }
+        for (int d = 0; d < 2; d++) {
+            feat_dir_delta(&out->dir[d], &cur->dir[d], old ? &old->dir[d] : NULL);
+        }
+        out->window_s = eng->feat_ts[eng->feat_cur] - eng->feat_ts[eng->feat_cur ^ 1];
+        return 0;
     }
+#endif
+
     for (int i = 0; i < RTT_STUB_SIZE; i++) {
-        rtt_stub_entry_t *e = &eng->stub[i];
-        if (!e->used) {
-            e->key    = *key;
-            e->rtt_ms = rtt_ms;
-            e->used   = 1;
-            return;
+        const rtt_stub_entry_t *e = &eng->stub[i];
+        if (e->used && e->has_win && keys_equal(&e->key, key)) {
+            *out = e->win;
+            return 0;
         }
     }
+    return -1;
+}
+
+void rtt_engine_inject_window_stub(rtt_engine_t *eng, const flow_key_t *key,
+                                   const flow_pkt_window_t *win) {
+    if (!eng || !key || !win) return;
+    if (eng->bpf_backed) return;
+
+    rtt_stub_entry_t *slot = stub_slot(eng, key);
+    if (!slot) return;
+    slot->win     = *win;
+    slot->has_win = 1;
+}
+
+void rtt_engine_inject_pct_stub(rtt_engine_t *eng, const flow_key_t *key,
+                                const rtt_pct_t *pct) {
+    if (!eng || !key || !pct) return;
+    if (eng->bpf_backed) return;
+
+    rtt_stub_entry_t *slot = stub_slot(eng, key);
+    if (!slot) return;
+    slot->pct     = *pct;
+    slot->has_pct = 1;
+}
+
+/* ── RTT breach events ──────────────────────────────────────── */
+
+#ifdef HAVE_LIBBPF
+static int ring_sample(void *ctx, void *data, size_t size) {
+    rtt_engine_t *eng = ctx;
+    if (size < sizeof(struct bpf_rtt_event) || !eng->ev_fn) return 0;
+    struct bpf_rtt_event be;
+    memcpy(&be, data, sizeof(be));
+    rtt_event_t ev;
+    ev.key.src_ip   = be.key.client_ip;
+    ev.key.dst_ip   = be.key.server_ip;
+    ev.key.src_port = ntohs(be.key.client_port);
+    ev.key.dst_port = ntohs(be.key.server_port);
+    ev.key.protocol = be.key.protocol;
+    ev.srtt_ms      = be.srtt_ms;
+    ev.rtt_ms       = be.rtt_ms;
+    ev.thresh_ms    = be.thresh_ms;
+    eng->ev_fn(&ev, eng->ev_ctx);
+    return 0;
+}
+#endif
+
+int rtt_engine_events_open(rtt_engine_t *eng) {
+    if (!eng) return -1;
+#ifdef HAVE_LIBBPF
+    if (eng->rb) return 0;
+    if (!eng->bpf_backed || eng->events_fd < 0 || eng->thresh_fd < 0) return -1;
+    eng->rb = ring_buffer__new(eng->events_fd, ring_sample, eng, NULL);
+    if (!eng->rb) {
+        log_msg(LOG_WARN, "rtt", "breach event ring buffer unavailable");
+        return -1;
+    }
+    log_msg(LOG_INFO, "rtt", "breach events on (epoll fd %d)",
+            ring_buffer__epoll_fd(eng->rb));
+    return 0;
+#else
+    return -1;
+#endif
+}
+
+int rtt_engine_set_threshold(rtt_engine_t *eng, const flow_key_t *key,
+                             uint32_t thresh_ms) {
+    if (!eng || !key) return -1;
+#ifdef HAVE_LIBBPF
+    if (eng->bpf_backed) {
+        if (eng->thresh_fd < 0) return -1;
+        struct bpf_rtt_key bk;
+        bpf_key_from_flow(key, &bk);
+        if (thresh_ms == 0) {
+            if (bpf_map_delete_elem(eng->thresh_fd, &bk) != 0 && errno != ENOENT) return -1;
+            return 0;
+        }
+        struct bpf_rtt_thresh th = { thresh_ms, 0 };
+        return bpf_map_update_elem(eng->thresh_fd, &bk, &th, BPF_ANY) == 0 ? 0 : -1;
+    }
+#endif
+    rtt_stub_entry_t *slot = stub_slot(eng, key);
+    if (!slot) return -1;
+    slot->thresh_ms = thresh_ms;
+    slot->over      = 0;
+    return 0;
+}
+
+int rtt_engine_poll_events(rtt_engine_t *eng, int timeout_ms,
+                           rtt_event_fn fn, void *ctx) {
+    if (!eng || !fn) return -1;
+#ifdef HAVE_LIBBPF
+    if (eng->rb) {
+        eng->ev_fn  = fn;
+        eng->ev_ctx = ctx;
+        int n = ring_buffer__poll(eng->rb, timeout_ms);
+        eng->ev_fn  = NULL;
+        eng->ev_ctx = NULL;
+        if (n == -EINTR) return 0;
+        return n < 0 ? -1 : n;
+    }
+#else
+    (void)timeout_ms;
+#endif
+    int n = eng->stub_ev_n;
+    eng->stub_ev_n = 0;
+    for (int i = 0; i < n; i++) fn(&eng->stub_ev[i], ctx);
+    return n;
 }
@@ -10,8 +10,10 @@
  * A test-injection hook (rtt_engine_inject_stub) lets unit tests seed
  * specific RTT values for flows without needing a live kernel.
  *
- * UDP flows have no protocol RTT; the engine returns 0 for them.
- * classifier_tick() treats 0 as "skip auto-correction this tick".
+ * TCP flows are timed by seq/ack, QUIC flows (UDP to port 443) by
+ * their spin bit; other UDP has no passive RTT and the engine returns
+ * 0 for it. classifier_tick() treats 0 as "skip auto-correction this
+ * tick".
  */
 #ifndef MYCO_RTT_H
 #define MYCO_RTT_H
@@ -24,11 +26,13 @@ typedef struct rtt_engine rtt_engine_t;
 
 /* Open an RTT engine.
  *
- *   bpf_obj_path : path to the mycoflow_rtt.bpf.o object (compiled by
- *                  CMake). When libbpf is available and the file exists,
- *                  the engine loads the program, pins it, and attaches
- *                  TC egress+ingress filters on `egress_iface`. Pass NULL
- *                  or a missing path to force the stub path.
+ *   bpf_obj_path : path to a mycoflow_rtt.bpf.o object. When libbpf is
+ *                  available the engine loads the program — from this
+ *                  file if it exists, else from the copy embedded at
+ *                  build time — and attaches it natively as TC
+ *                  egress+ingress filters on `egress_iface`. Pass NULL to
+ *                  force the stub path (a missing file does too when
+ *                  nothing is embedded).
  *   egress_iface : WAN interface name (e.g. "wan", "eth1"). Ignored on
  *                  the stub path.
  *
@@ -41,9 +45,118 @@ rtt_engine_t *rtt_engine_open(const char *bpf_obj_path,
 void rtt_engine_close(rtt_engine_t *eng);
 
 /* Fetch the smoothed RTT for a flow in milliseconds. Returns 0 if the
- * flow is UDP, not yet measured, or unknown. */
+ * flow is non-QUIC UDP, not yet measured, or unknown. Served from the snapshot
+ * of the last rtt_engine_refresh_rtt() once there is one. */
 uint32_t rtt_engine_lookup_ms(rtt_engine_t *eng, const flow_key_t *key);
 
+/* Read the whole RTT map (batched where the kernel supports it) into
+ * the in-memory snapshot lookups are answered from. Call once per
+ * classifier tick. Returns the number of flows read, 0 on the stub
+ * path, -1 on error (lookups then fall back to one syscall each). */
+int rtt_engine_refresh_rtt(rtt_engine_t *eng);
+
+/* ── RTT percentiles ───────────────────────────────────────────
+ * The BPF program also counts every RTT sample in a cumulative
+ * per-flow histogram; the engine diffs two successive snapshots into
+ * the percentiles of the window between them. Buckets 0..3 hold
+ * 0..3 ms; each power of two above is split into 4 linear sub-buckets
+ * (≤ 25 % wide). Layout mirrors mycoflow_rtt.bpf.c. */
+#define RTT_HIST_BUCKETS 48
+
+typedef struct {
+    uint32_t samples;       /* RTT samples in the window */
+    uint32_t p50_ms;
+    uint32_t p95_ms;
+    uint32_t p99_ms;
+} rtt_pct_t;
+
+/* Bucket of an RTT sample, as the BPF program files it. */
+uint32_t rtt_hist_bucket(uint32_t rtt_ms);
+
+/* Percentiles of a RTT_HIST_BUCKETS histogram, interpolated linearly
+ * inside the bucket. All zero for an empty histogram. */
+void rtt_hist_percentiles(const uint32_t *hist, rtt_pct_t *out);
+
+/* RTT percentiles of a TCP or QUIC flow between the last two
+ * rtt_engine_refresh_rtt() calls; a flow that appeared in between
+ * reports all its samples. Returns 0, or -1 when there is no window. */
+int rtt_engine_flow_percentiles(rtt_engine_t *eng, const flow_key_t *key,
+                                rtt_pct_t *out);
+
+/* Test hook — what rtt_engine_flow_percentiles() returns for `key` on
+ * the stub engine. No-op on the eBPF impl. */
+void rtt_engine_inject_pct_stub(rtt_engine_t *eng, const flow_key_t *key,
+                                const rtt_pct_t *pct);
+
+/* ── Windowed packet features (myco_feat map) ──────────────────
+ * The same TC programs keep cumulative per-direction counters and log2
+ * histograms for every TCP/UDP flow; the engine diffs two successive
+ * map reads into the window between them. Bucket layout mirrors
+ * mycoflow_rtt.bpf.c. */
+#define RTT_FEAT_SIZE_BUCKETS 8     /* IP length in [2^(b+5), 2^(b+6)) B */
+#define RTT_FEAT_IAT_BUCKETS  16    /* gap in [2^(b+2), 2^(b+3)) µs */
+#define RTT_FEAT_UP           0     /* LAN → WAN */
+#define RTT_FEAT_DOWN         1     /* WAN → LAN */
+
+typedef struct {
+    uint32_t packets;
+    uint64_t bytes;
+    uint32_t size_hist[RTT_FEAT_SIZE_BUCKETS];
+    uint32_t iat_hist[RTT_FEAT_IAT_BUCKETS];
+} flow_dir_window_t;
+
+typedef struct {
+    flow_dir_window_t dir[2];       /* RTT_FEAT_UP / RTT_FEAT_DOWN */
+    double            window_s;     /* time between the two map reads */
+} flow_pkt_window_t;
+
+/* Read the whole feature map (batched where the kernel supports it)
+ * and make it the current snapshot. Call once per classifier tick.
+ * Returns the number of flows read, 0 on the stub path, -1 on error
+ * (windows are unavailable until two reads in a row succeed). */
+int rtt_engine_refresh_features(rtt_engine_t *eng, double now);
+
+/* Packet window of a TCP/UDP flow between the last two refreshes; a
+ * flow that appeared in between reports everything it has sent.
+ * Returns 0, or -1 when there is no window for it. */
+int rtt_engine_flow_window(rtt_engine_t *eng, const flow_key_t *key,
+                           flow_pkt_window_t *out);
+
+/* Test hook — what rtt_engine_flow_window() returns for `key` on the
+ * stub engine. No-op on the eBPF impl. */
+void rtt_engine_inject_window_stub(rtt_engine_t *eng, const flow_key_t *key,
+                                   const flow_pkt_window_t *win);
+
+/* ── RTT breach events (myco_rtt_events ring buffer) ───────────
+ * Optional push path next to the per-tick map reads: userspace sets a
+ * threshold per watched flow, and the probe emits one event when the
+ * flow's srtt rises above it (re-armed once srtt is back at or below),
+ * so a breach is seen within one ACK rather than at the next tick. */
+typedef struct {
+    flow_key_t key;           /* as in the flow table */
+    uint32_t   srtt_ms;       /* smoothed RTT that crossed the threshold */
+    uint32_t   rtt_ms;        /* the sample that pushed it over */
+    uint32_t   thresh_ms;
+} rtt_event_t;
+
+typedef void (*rtt_event_fn)(const rtt_event_t *ev, void *ctx);
+
+/* Start consuming breach events. Returns 0, -1 when the engine has no
+ * live probe (stub) or the kernel lacks ring buffers. */
+int  rtt_engine_events_open(rtt_engine_t *eng);
+
+/* Watch `key` with `thresh_ms`; 0 stops watching. On the stub engine
+ * rtt_engine_inject_stub() then queues events the same way. Returns 0,
+ * -1 on error. */
+int  rtt_engine_set_threshold(rtt_engine_t *eng, const flow_key_t *key,
+                              uint32_t thresh_ms);
+
+/* Wait up to `timeout_ms` (ring_buffer__poll on the ring's epoll fd)
+ * and hand each event to `fn`. The stub engine drains its queue without
+ * blocking. Returns the number of events, -1 on error. */
+int  rtt_engine_poll_events(rtt_engine_t *eng, int timeout_ms,
+                            rtt_event_fn fn, void *ctx);
+
 /* Test hook — stamp an RTT sample into the stub engine. No-op on the
  * real (eBPF) impl; exposed so unit tests can seed RTT values without
  * spinning up a kernel probe. */
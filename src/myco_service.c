@@ -8,6 +8,7 @@
  */
 #include "myco_service.h"
 
+#include <stdatomic.h>
 #include <stddef.h>
 
 /* ── Canonical names ─────────────────────────────────────────────
@@ -110,23 +111,29 @@ service_t service_demote(service_t svc) {
  * The 0.3 floor means: a lone port hint is enough to classify, but a lone
  * behavioral hint is not. This matches the intent: DNS is strongest,
  * behavior is a tie-breaker.
+ *
+ * Only SERVICE_COUNT³ (1728) inputs exist, so service_set_weights()
+ * scores them all once into a byte table and service_classify() becomes
+ * an index. Two tables alternate so a rebuild never rewrites the one a
+ * concurrent reader may still hold.
  */
-service_t service_classify(const service_signals_t *signals) {
-    if (!signals) {
-        return SVC_UNKNOWN;
-    }
+typedef uint8_t verdict_table_t[SERVICE_COUNT][SERVICE_COUNT][SERVICE_COUNT];
+
+static verdict_table_t verdict_tables[2];
+static _Atomic(const verdict_table_t *) verdict_active = NULL;
+
+static const service_weights_t default_weights = SERVICE_WEIGHTS_DEFAULT;
 
+static int signal_index(service_t svc) {
+    return (int)svc > SVC_UNKNOWN && (int)svc < SERVICE_COUNT ? (int)svc : SVC_UNKNOWN;
+}
+
+static service_t score_vote(const service_weights_t *w, int dns, int port, int behavior) {
     double score[SERVICE_COUNT] = {0.0};
 
-    if (signals->dns_hint > SVC_UNKNOWN && signals->dns_hint < SERVICE_COUNT) {
-        score[signals->dns_hint] += 0.6;
-    }
-    if (signals->port_hint > SVC_UNKNOWN && signals->port_hint < SERVICE_COUNT) {
-        score[signals->port_hint] += 0.3;
-    }
-    if (signals->behavior_hint > SVC_UNKNOWN && signals->behavior_hint < SERVICE_COUNT) {
-        score[signals->behavior_hint] += 0.1;
-    }
+    if (dns != SVC_UNKNOWN)      score[dns] += w->dns;
+    if (port != SVC_UNKNOWN)     score[port] += w->port;
+    if (behavior != SVC_UNKNOWN) score[behavior] += w->behavior;
 
     int best = SVC_UNKNOWN;
     double best_score = 0.0;
@@ -137,12 +144,43 @@ service_t service_classify(const service_signals_t *signals) {
         }
     }
 
-    if (best_score < 0.3) {
+    if (best_score < w->floor) {
         return SVC_UNKNOWN;
     }
     return (service_t)best;
 }
 
+void service_set_weights(const service_weights_t *w) {
+    if (!w) w = &default_weights;
+    const verdict_table_t *cur = atomic_load(&verdict_active);
+    verdict_table_t *next = cur == &verdict_tables[0] ? &verdict_tables[1]
+                                                      : &verdict_tables[0];
+    for (int d = 0; d < SERVICE_COUNT; d++) {
+        for (int p = 0; p < SERVICE_COUNT; p++) {
+            for (int b = 0; b < SERVICE_COUNT; b++) {
+                (*next)[d][p][b] = (uint8_t)score_vote(w, d, p, b);
+            }
+        }
+    }
+    atomic_store(&verdict_active, (const verdict_table_t *)next);
+}
+
+service_t service_classify(const service_signals_t *signals) {
+    if (!signals) {
+        return SVC_UNKNOWN;
+    }
+
+    int d = signal_index(signals->dns_hint);
+    int p = signal_index(signals->port_hint);
+    int b = signal_index(signals->behavior_hint);
+
+    const verdict_table_t *t = atomic_load_explicit(&verdict_active, memory_order_acquire);
+    if (!t) {
+        return score_vote(&default_weights, d, p, b);
+    }
+    return (service_t)(*t)[d][p][b];
+}
+
 /* ── Behavior-based inference ───────────────────────────────────
  * Thresholds tuned from live captures (see docs/architecture-v3):
  *
@@ -165,6 +203,14 @@ service_t service_classify(const service_signals_t *signals) {
  *
  * All numbers require pkts_total >= 20 so we don't speculate on
  * flows that just opened.
+ *
+ * Windowed features (eBPF histograms) sharpen two rules:
+ *   - VOIP_CALL also needs the upstream median gap inside one codec
+ *     frame (8..80 ms); a small-packet flow sending faster or slower
+ *     than that falls through to GAME_RT.
+ *   - The VOD size test looks at downstream packets only. Upstream is
+ *     mostly 52-66B ACKs; with one ACK per segment they drag the
+ *     combined average of an MSS-sized download to ~750B.
  */
 service_t service_infer_behavior(const flow_features_t *feat) {
     if (!feat)                    return SVC_UNKNOWN;
@@ -176,11 +222,15 @@ service_t service_infer_behavior(const flow_features_t *feat) {
     const double   bw     = feat->bw_bps;
     const double   rxr    = feat->rx_ratio;
 
+    const double up_gap = feat->windowed ? feat->win_iat_p50_us[0] : 0.0;
+    const int    framed = up_gap <= 0.0 || (up_gap >= 8000.0 && up_gap <= 80000.0);
+
     /* VOIP_CALL — tiny packets, very low bw, roughly symmetric, UDP */
     if (proto == 17 &&
         apkt >= 60.0 && apkt <= 220.0 &&
         bw   >= 10000.0 && bw <= 150000.0 &&
-        rxr  >= 0.30 && rxr <= 0.70) {
+        rxr  >= 0.30 && rxr <= 0.70 &&
+        framed) {
         return SVC_VOIP_CALL;
     }
 
@@ -201,7 +251,9 @@ service_t service_infer_behavior(const flow_features_t *feat) {
     }
 
     /* VOD-ish bulk media — large packets, heavily asymmetric rx>>tx, high bw */
-    if (apkt >= 900.0 && rxr >= 0.85 && bw >= 1000000.0) {
+    const double media_pkt = feat->windowed && feat->win_pkts[1] > 0
+                              ? feat->win_avg_size[1] : apkt;
+    if (media_pkt >= 900.0 && rxr >= 0.85 && bw >= 1000000.0) {
         return SVC_VIDEO_VOD;
     }
 
@@ -88,6 +88,7 @@ typedef struct {
                                * tier's mark instead. */
     double    detected_at;    /* monotonic timestamp of first classification */
     double    last_confirmed; /* last cycle the classification was re-asserted */
+    double    last_voted;     /* last cycle the 3-signal vote actually ran */
     uint8_t   stable;         /* 1 = survived 2 consecutive classifications */
 
     /* ── Phase 5 auto-correction state ─────────────────────────── */
@@ -95,6 +96,11 @@ typedef struct {
     uint8_t   rtt_breach_ticks;   /* consecutive ticks over target×1.5 */
     uint8_t   rtt_recover_ticks;  /* consecutive ticks at/below target post-demote */
     uint8_t   demoted;            /* 1 = ct_mark carries a demoted tier */
+    uint16_t  rtt_watch_ms;       /* breach-event threshold set in the
+                                   * probe (0 = not watched) */
+    double    mark_pushed_at;     /* tick of our last mark write (0 = never);
+                                   * the flow's kernel mark is trusted only
+                                   * once conntrack was read after it */
 } flow_service_t;
 
 /* ── Classification (Phase 3b–3d wire-up) ──────────────────────── */
@@ -107,14 +113,35 @@ typedef struct {
     service_t behavior_hint;  /* from flow metrics: pkt size / bw / udp_ratio */
 } service_signals_t;
 
+/* Voter weights and acceptance floor (UCI svc_weight_dns / _port /
+ * _behavior, svc_min_score). */
+typedef struct {
+    double dns;
+    double port;
+    double behavior;
+    double floor;
+} service_weights_t;
+
+#define SERVICE_WEIGHTS_DEFAULT { 0.6, 0.3, 0.1, 0.3 }
+
 /* Weighted voter (see architecture §5):
  *   score[svc] = 0.6*(dns==svc) + 0.3*(port==svc) + 0.1*(behavior==svc)
  *   return argmax if max >= 0.3, else SVC_UNKNOWN
+ * Ties go to the lower service_t value.
  *
- * Pure function, no I/O, no globals. Unit-testable.
+ * Once service_set_weights() has run this is one load from the
+ * precomputed verdict table; before that it scores with the defaults.
+ * No I/O. Unit-testable.
  */
 service_t service_classify(const service_signals_t *signals);
 
+/* Precompute the verdict for every (dns, port, behavior) triple under
+ * `w` (NULL = SERVICE_WEIGHTS_DEFAULT) and publish it to
+ * service_classify(). Called at startup and on config reload; the table
+ * being replaced is not reused until the next call, so one concurrent
+ * classifier pass is safe across a rebuild. */
+void service_set_weights(const service_weights_t *w);
+
 /* ── Behavior-based signal producer (Phase 3d) ──────────────────
  * Observable per-flow features, pre-computed by the caller.
  * proto: IPPROTO_TCP (6) or IPPROTO_UDP (17).
@@ -123,6 +150,11 @@ service_t service_classify(const service_signals_t *signals);
  * rx_ratio: rx_delta / (tx_delta + rx_delta) in the current window (0..1).
  * pkts_total: cumulative tx+rx packet count (used to gate decisions on
  *             flows too young to characterise).
+ *
+ * With `windowed` set, the eBPF packet histograms covered this window:
+ * avg_pkt_size / bw_bps / rx_ratio are then taken from the window, and
+ * the win_* fields hold the per-direction view (index 0 = upstream,
+ * 1 = downstream). win_iat_p50_us is 0 with fewer than 2 packets.
  */
 typedef struct {
     uint8_t  proto;
@@ -130,6 +162,11 @@ typedef struct {
     double   bw_bps;
     double   rx_ratio;
     uint64_t pkts_total;
+
+    int      windowed;
+    uint32_t win_pkts[2];
+    double   win_avg_size[2];
+    double   win_iat_p50_us[2];     /* median inter-arrival time */
 } flow_features_t;
 
 /* Infer a service_t from behavioral fingerprints. Intentionally conservative:
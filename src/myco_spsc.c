@@ -0,0 +1,75 @@
+/*
+ * MycoFlow — Bio-Inspired Reflexive QoS System
+ * myco_spsc.c — Lock-free single-producer / single-consumer queue
+ *
+ * Free-running 32-bit head/tail indices masked into a power-of-two slot
+ * array. The producer publishes a slot with a release store of head
+ * after copying it in; the consumer acquires head before copying out and
+ * releases tail after, which hands the slot back. head and tail sit on
+ * separate cache lines so the two cores do not bounce one line per item.
+ */
+#include "myco_spsc.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+int spsc_init(spsc_queue_t *q, uint32_t capacity, size_t slot_size) {
+    if (!q || slot_size == 0 || capacity == 0 || capacity > (1u << 30)) return -1;
+    uint32_t cap = 2;
+    while (cap < capacity) cap <<= 1;
+
+    q->slots = calloc(cap, slot_size);
+    if (!q->slots) return -1;
+    q->slot_size = slot_size;
+    q->mask = cap - 1;
+    atomic_init(&q->head, 0);
+    atomic_init(&q->tail, 0);
+    atomic_init(&q->drops, 0);
+    return 0;
+}
+
+void spsc_destroy(spsc_queue_t *q) {
+    if (!q) return;
+    free(q->slots);
+    q->slots = NULL;
+}
+
+int spsc_push(spsc_queue_t *q, const void *item) {
+    unsigned head = atomic_load_explicit(&q->head, memory_order_relaxed);
+    unsigned tail = atomic_load_explicit(&q->tail, memory_order_acquire);
+    if (head - tail > q->mask) {
+        atomic_fetch_add_explicit(&q->drops, 1, memory_order_relaxed);
+        return -1;
+    }
+    memcpy(q->slots + (size_t)(head & q->mask) * q->slot_size, item, q->slot_size);
+    atomic_store_explicit(&q->head, head + 1, memory_order_release);
+    return 0;
+}
+
+int spsc_pop(spsc_queue_t *q, void *out) {
+    unsigned tail = atomic_load_explicit(&q->tail, memory_order_relaxed);
+    unsigned head = atomic_load_explicit(&q->head, memory_order_acquire);
+    if (head == tail) return -1;
+    memcpy(out, q->slots + (size_t)(tail & q->mask) * q->slot_size, q->slot_size);
+    atomic_store_explicit(&q->tail, tail + 1, memory_order_release);
+    return 0;
+}
+
+int spsc_pop_latest(spsc_queue_t *q, void *out) {
+    unsigned tail = atomic_load_explicit(&q->tail, memory_order_relaxed);
+    unsigned head = atomic_load_explicit(&q->head, memory_order_acquire);
+    if (head == tail) return 0;
+    memcpy(out, q->slots + (size_t)((head - 1) & q->mask) * q->slot_size, q->slot_size);
+    atomic_store_explicit(&q->tail, head, memory_order_release);
+    return (int)(head - tail);
+}
+
+uint32_t spsc_count(spsc_queue_t *q) {
+    unsigned tail = atomic_load_explicit(&q->tail, memory_order_relaxed);
+    unsigned head = atomic_load_explicit(&q->head, memory_order_acquire);
+    return head - tail;
+}
+
+uint32_t spsc_drops(spsc_queue_t *q) {
+    return atomic_load_explicit(&q->drops, memory_order_relaxed);
+}
@@ -0,0 +1,51 @@
+/*
+ * MycoFlow — Bio-Inspired Reflexive QoS System
+ * myco_spsc.h — Lock-free single-producer / single-consumer queue
+ *
+ * Fixed-size slots copied in and out by value, so what crosses a
+ * pipeline stage boundary is an immutable snapshot: the producer never
+ * touches a slot again once pushed. Exactly one thread may push and one
+ * (other) thread may pop. Neither side blocks; wakeups are the caller's
+ * business (see the stage semaphores in main.c).
+ */
+#ifndef MYCO_SPSC_H
+#define MYCO_SPSC_H
+
+#include <stdatomic.h>
+#include <stddef.h>
+#include <stdint.h>
+
+typedef struct {
+    unsigned char *slots;
+    size_t         slot_size;
+    uint32_t       mask;        /* capacity - 1 (capacity a power of two) */
+    _Alignas(64) atomic_uint head;   /* next write, owned by the producer */
+    _Alignas(64) atomic_uint tail;   /* next read, owned by the consumer */
+    _Alignas(64) atomic_uint drops;  /* pushes refused because full */
+} spsc_queue_t;
+
+/* Allocate room for `capacity` (rounded up to a power of two, min 2)
+ * items of `slot_size` bytes. Returns 0, -1 on OOM / bad arguments. */
+int spsc_init(spsc_queue_t *q, uint32_t capacity, size_t slot_size);
+
+/* Free the slots. Safe on NULL and on a queue that failed init. */
+void spsc_destroy(spsc_queue_t *q);
+
+/* Producer: copy `item` in. Returns 0, or -1 when full (counted in
+ * spsc_drops()). */
+int spsc_push(spsc_queue_t *q, const void *item);
+
+/* Consumer: copy the oldest item out. Returns 0, or -1 when empty. */
+int spsc_pop(spsc_queue_t *q, void *out);
+
+/* Consumer: drain the queue, keeping only the newest item in `out`.
+ * Returns the number of items consumed (0 = empty, `out` untouched). */
+int spsc_pop_latest(spsc_queue_t *q, void *out);
+
+/* Consumer-side length estimate; exact when the producer is idle. */
+uint32_t spsc_count(spsc_queue_t *q);
+
+/* Pushes refused because the queue was full, since init. */
+uint32_t spsc_drops(spsc_queue_t *q);
+
+#endif /* MYCO_SPSC_H */
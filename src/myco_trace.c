@@ -0,0 +1,288 @@
+/*
+ * MycoFlow — Bio-Inspired Reflexive QoS System
+ * myco_trace.c — Record / replay trace of classifier inputs
+ *
+ * The recorder keeps a shadow flow table of what it has already
+ * written. Each tick it compares the live table against it: a flow
+ * refreshed with new counters is written in full, one refreshed with
+ * unchanged counters as a short SAME entry, and a flow the shadow holds
+ * but the live table lost (conntrack DESTROY) as GONE. Replay therefore
+ * reproduces last_seen, deltas and removals exactly, and aging is left
+ * to flow_table_evict_stale() on both sides.
+ */
+#include "myco_trace.h"
+#include "myco_log.h"
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define TRACE_HDR_SIZE  16
+#define TRACE_REC_HDR   16
+#define TRACE_REC_MAX   (64u << 20)   /* reader sanity bound per record */
+
+static pthread_mutex_t g_trace_lock = PTHREAD_MUTEX_INITIALIZER;
+static FILE           *g_trace_f;
+static atomic_int      g_trace_on;
+static uint64_t        g_trace_bytes;
+static uint64_t        g_trace_max;
+
+/* Flow-thread state (trace_record_tick only). */
+static flow_table_t    g_shadow;
+static int             g_shadow_ok;
+static uint8_t        *g_flow_buf;
+static size_t          g_flow_cap;
+static flow_key_t     *g_gone;
+static size_t          g_gone_cap;
+
+/* ── Encoding ─────────────────────────────────────────────────── */
+
+static void put_u16(uint8_t *p, uint16_t v) { memcpy(p, &v, sizeof(v)); }
+static void put_u32(uint8_t *p, uint32_t v) { memcpy(p, &v, sizeof(v)); }
+static void put_u64(uint8_t *p, uint64_t v) { memcpy(p, &v, sizeof(v)); }
+static uint16_t get_u16(const uint8_t *p) { uint16_t v; memcpy(&v, p, sizeof(v)); return v; }
+static uint32_t get_u32(const uint8_t *p) { uint32_t v; memcpy(&v, p, sizeof(v)); return v; }
+static uint64_t get_u64(const uint8_t *p) { uint64_t v; memcpy(&v, p, sizeof(v)); return v; }
+
+static size_t flow_encode(uint8_t *p, int kind, const flow_entry_t *e,
+                          const flow_key_t *key) {
+    p[0] = (uint8_t)kind;
+    p[1] = key->protocol;
+    p[2] = (uint8_t)(e && e->ct_mark_valid);
+    p[3] = 0;
+    put_u32(p + 4, key->src_ip);
+    put_u32(p + 8, key->dst_ip);
+    put_u16(p + 12, key->src_port);
+    put_u16(p + 14, key->dst_port);
+    put_u32(p + 16, e ? e->ct_mark : 0);
+    if (kind != TRACE_FLOW_FULL) return TRACE_FLOW_SIZE_SAME;
+    put_u64(p + 20, e->packets);
+    put_u64(p + 28, e->rx_packets);
+    put_u64(p + 36, e->bytes);
+    put_u64(p + 44, e->rx_bytes);
+    return TRACE_FLOW_SIZE;
+}
+
+int trace_flow_decode(const uint8_t *p, size_t len, trace_flow_t *out) {
+    if (!p || !out || len < TRACE_FLOW_SIZE_SAME) return -1;
+    memset(out, 0, sizeof(*out));
+    out->kind         = p[0];
+    out->key.protocol = p[1];
+    out->has_mark     = p[2];
+    out->key.src_ip   = get_u32(p + 4);
+    out->key.dst_ip   = get_u32(p + 8);
+    out->key.src_port = get_u16(p + 12);
+    out->key.dst_port = get_u16(p + 14);
+    out->mark         = get_u32(p + 16);
+    if (out->kind != TRACE_FLOW_FULL) return TRACE_FLOW_SIZE_SAME;
+    if (len < TRACE_FLOW_SIZE) return -1;
+    out->tx_packets = get_u64(p + 20);
+    out->rx_packets = get_u64(p + 28);
+    out->tx_bytes   = get_u64(p + 36);
+    out->rx_bytes   = get_u64(p + 44);
+    return TRACE_FLOW_SIZE;
+}
+
+/* ── Recorder ─────────────────────────────────────────────────── */
+
+int trace_open(const char *path, uint64_t max_bytes) {
+    if (!path || !*path) return -1;
+    FILE *f = fopen(path, "wb");
+    if (!f) {
+        log_msg(LOG_WARN, "trace", "cannot open %s", path);
+        return -1;
+    }
+    uint8_t hdr[TRACE_HDR_SIZE] = {0};
+    memcpy(hdr, TRACE_MAGIC, sizeof(TRACE_MAGIC));
+    put_u32(hdr + 8, TRACE_VERSION);
+    if (fwrite(hdr, sizeof(hdr), 1, f) != 1) {
+        fclose(f);
+        return -1;
+    }
+    if (flow_table_init_sized(&g_shadow, FLOW_TABLE_MAX_CAPACITY) != 0) {
+        fclose(f);
+        return -1;
+    }
+    g_shadow_ok = 1;
+
+    pthread_mutex_lock(&g_trace_lock);
+    g_trace_f     = f;
+    g_trace_bytes = sizeof(hdr);
+    g_trace_max   = max_bytes;
+    atomic_store(&g_trace_on, 1);
+    pthread_mutex_unlock(&g_trace_lock);
+    log_msg(LOG_INFO, "trace", "recording to %s (limit %llu bytes)", path,
+            (unsigned long long)max_bytes);
+    return 0;
+}
+
+void trace_close(void) {
+    pthread_mutex_lock(&g_trace_lock);
+    atomic_store(&g_trace_on, 0);
+    if (g_trace_f) {
+        fclose(g_trace_f);
+        g_trace_f = NULL;
+        log_msg(LOG_INFO, "trace", "closed after %llu bytes",
+                (unsigned long long)g_trace_bytes);
+    }
+    pthread_mutex_unlock(&g_trace_lock);
+
+    if (g_shadow_ok) flow_table_free(&g_shadow);
+    g_shadow_ok = 0;
+    free(g_flow_buf);
+    g_flow_buf = NULL;
+    g_flow_cap = 0;
+    free(g_gone);
+    g_gone = NULL;
+    g_gone_cap = 0;
+}
+
+int trace_active(void) {
+    return atomic_load_explicit(&g_trace_on, memory_order_relaxed);
+}
+
+static void trace_write(int type, double ts, const void *payload, uint32_t len) {
+    pthread_mutex_lock(&g_trace_lock);
+    if (!g_trace_f) {
+        pthread_mutex_unlock(&g_trace_lock);
+        return;
+    }
+    if (g_trace_bytes + TRACE_REC_HDR + len > g_trace_max) {
+        log_msg(LOG_INFO, "trace", "size limit reached, recording stopped");
+        atomic_store(&g_trace_on, 0);
+        fclose(g_trace_f);
+        g_trace_f = NULL;
+        pthread_mutex_unlock(&g_trace_lock);
+        return;
+    }
+    uint8_t hdr[TRACE_REC_HDR] = {0};
+    hdr[0] = (uint8_t)type;
+    put_u32(hdr + 4, len);
+    memcpy(hdr + 8, &ts, sizeof(ts));
+    if (fwrite(hdr, sizeof(hdr), 1, g_trace_f) != 1 ||
+        (len > 0 && fwrite(payload, len, 1, g_trace_f) != 1)) {
+        log_msg(LOG_WARN, "trace", "write failed, recording stopped");
+        atomic_store(&g_trace_on, 0);
+        fclose(g_trace_f);
+        g_trace_f = NULL;
+    } else {
+        g_trace_bytes += TRACE_REC_HDR + len;
+    }
+    pthread_mutex_unlock(&g_trace_lock);
+}
+
+void trace_record_dns(const uint8_t *pkt, size_t len, double now) {
+    if (!trace_active() || !pkt || len == 0 || len > TRACE_REC_MAX) return;
+    trace_write(TRACE_REC_DNS, now, pkt, (uint32_t)len);
+}
+
+static int flow_buf_reserve(size_t need) {
+    if (need <= g_flow_cap) return 0;
+    size_t cap = g_flow_cap ? g_flow_cap : 4096;
+    while (cap < need) cap *= 2;
+    uint8_t *b = realloc(g_flow_buf, cap);
+    if (!b) return -1;
+    g_flow_buf = b;
+    g_flow_cap = cap;
+    return 0;
+}
+
+void trace_record_tick(const flow_table_t *ft, double now, double window_s) {
+    if (!trace_active() || !ft || !g_shadow_ok) return;
+
+    size_t used = 0;
+    uint32_t it = 0;
+    const flow_entry_t *fe;
+    while ((fe = flow_table_next(ft, &it)) != NULL) {
+        if (fe->last_seen != now) {
+            /* Not refreshed this tick: only keep it alive in the shadow. */
+            flow_table_touch(&g_shadow, &fe->key, now);
+            continue;
+        }
+        const flow_entry_t *sh = flow_table_lookup(&g_shadow, &fe->key);
+        int same = sh && sh->packets == fe->packets && sh->rx_packets == fe->rx_packets &&
+                   sh->bytes == fe->bytes && sh->rx_bytes == fe->rx_bytes;
+        if (flow_buf_reserve(used + TRACE_FLOW_SIZE) != 0) return;
+        used += flow_encode(g_flow_buf + used, same ? TRACE_FLOW_SAME : TRACE_FLOW_FULL,
+                            fe, &fe->key);
+        flow_table_update(&g_shadow, &fe->key, fe->packets, fe->rx_packets,
+                          fe->bytes, fe->rx_bytes, now);
+    }
+
+    /* Whatever the shadow holds that was not seen above has left. */
+    size_t n_gone = 0;
+    it = 0;
+    while ((fe = flow_table_next(&g_shadow, &it)) != NULL) {
+        if (fe->last_seen == now) continue;
+        if (n_gone == g_gone_cap) {
+            size_t cap = g_gone_cap ? g_gone_cap * 2 : 64;
+            flow_key_t *g = realloc(g_gone, cap * sizeof(*g));
+            if (!g) break;
+            g_gone = g;
+            g_gone_cap = cap;
+        }
+        g_gone[n_gone++] = fe->key;
+    }
+    for (size_t i = 0; i < n_gone; i++) {
+        flow_table_remove(&g_shadow, &g_gone[i]);
+        if (flow_buf_reserve(used + TRACE_FLOW_SIZE_SAME) != 0) return;
+        used += flow_encode(g_flow_buf + used, TRACE_FLOW_GONE, NULL, &g_gone[i]);
+    }
+
+    if (used > 0) trace_write(TRACE_REC_FLOWS, now, g_flow_buf, (uint32_t)used);
+    trace_write(TRACE_REC_TICK, now, &window_s, sizeof(window_s));
+}
+
+/* ── Reader ───────────────────────────────────────────────────── */
+
+int trace_reader_open(trace_reader_t *r, const char *path) {
+    if (!r || !path) return -1;
+    memset(r, 0, sizeof(*r));
+    r->f = fopen(path, "rb");
+    if (!r->f) return -1;
+    uint8_t hdr[TRACE_HDR_SIZE];
+    if (fread(hdr, sizeof(hdr), 1, r->f) != 1 ||
+        memcmp(hdr, TRACE_MAGIC, sizeof(TRACE_MAGIC)) != 0 ||
+        get_u32(hdr + 8) != TRACE_VERSION) {
+        fclose(r->f);
+        r->f = NULL;
+        return -1;
+    }
+    return 0;
+}
+
+int trace_reader_next(trace_reader_t *r, trace_rec_t *rec) {
+    if (!r || !r->f || !rec) return -1;
+    uint8_t hdr[TRACE_REC_HDR];
+    size_t got = fread(hdr, 1, sizeof(hdr), r->f);
+    if (got == 0) return 0;
+    if (got != sizeof(hdr)) return -1;
+
+    uint32_t len = get_u32(hdr + 4);
+    if (len > TRACE_REC_MAX) return -1;
+    if (len > r->cap) {
+        uint8_t *b = realloc(r->buf, len);
+        if (!b) return -1;
+        r->buf = b;
+        r->cap = len;
+    }
+    if (len > 0 && fread(r->buf, len, 1, r->f) != 1) return -1;
+
+    rec->type = hdr[0];
+    memcpy(&rec->ts, hdr + 8, sizeof(rec->ts));
+    rec->data = r->buf;
+    rec->len  = len;
+    return 1;
+}
+
+void trace_reader_rewind(trace_reader_t *r) {
+    if (r && r->f) fseek(r->f, TRACE_HDR_SIZE, SEEK_SET);
+}
+
+void trace_reader_close(trace_reader_t *r) {
+    if (!r) return;
+    if (r->f) fclose(r->f);
+    free(r->buf);
+    memset(r, 0, sizeof(*r));
+}
@@ -0,0 +1,111 @@
+/*
+ * MycoFlow — Bio-Inspired Reflexive QoS System
+ * myco_trace.h — Record / replay trace of classifier inputs
+ *
+ * The recorder captures what the flow stage consumes — per-tick
+ * conntrack changes, every DNS answer the sniffer parses, and the tick
+ * boundaries — so mycoflow-replay can push the same inputs through
+ * flow_table / device_table_aggregate / dns_parse_response /
+ * classifier_tick offline, on a virtual clock, at full speed.
+ *
+ * File layout (host byte order; record and replay on the same
+ * endianness):
+ *
+ *   header  "MYCOTRC\0"  u32 version  u32 reserved
+ *   record  u8 type  u8 pad[3]  u32 len  f64 ts  payload[len]
+ *
+ *   TRACE_REC_FLOWS  flows refreshed at `ts`, as trace_flow_t entries
+ *                    (TRACE_FLOW_SIZE or TRACE_FLOW_SIZE_SAME bytes each)
+ *   TRACE_REC_DNS    one DNS message as handed to dns_parse_response()
+ *   TRACE_REC_TICK   f64 window_s; run the tick's stages at `ts`
+ *
+ * One recorder per process; DNS records arrive from the sniffer thread,
+ * flow and tick records from the flow thread.
+ */
+#ifndef MYCO_TRACE_H
+#define MYCO_TRACE_H
+
+#include "myco_flow.h"
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#define TRACE_MAGIC      "MYCOTRC"
+#define TRACE_VERSION    1
+
+#define TRACE_REC_FLOWS  1
+#define TRACE_REC_DNS    2
+#define TRACE_REC_TICK   3
+
+/* Flow entry kinds inside a TRACE_REC_FLOWS payload. */
+#define TRACE_FLOW_FULL  0   /* counters changed: all four follow */
+#define TRACE_FLOW_SAME  1   /* refreshed with the counters it had */
+#define TRACE_FLOW_GONE  2   /* left the table other than by aging out */
+
+#define TRACE_FLOW_SIZE_SAME 20
+#define TRACE_FLOW_SIZE      (TRACE_FLOW_SIZE_SAME + 32)
+
+typedef struct {
+    int        kind;          /* TRACE_FLOW_* */
+    flow_key_t key;
+    int        has_mark;
+    uint32_t   mark;
+    uint64_t   tx_packets;    /* TRACE_FLOW_FULL only */
+    uint64_t   rx_packets;
+    uint64_t   tx_bytes;
+    uint64_t   rx_bytes;
+} trace_flow_t;
+
+/* ── Recorder ─────────────────────────────────────────────────── */
+
+/* Start recording to `path` (truncated). Recording stops by itself once
+ * the file would exceed `max_bytes`. Returns 0, -1 on error. */
+int  trace_open(const char *path, uint64_t max_bytes);
+
+/* Flush and close. Safe when not recording. */
+void trace_close(void);
+
+/* 1 while a trace is being written. */
+int  trace_active(void);
+
+/* One DNS message about to be parsed at `now`. Matches dns_tap_fn. */
+void trace_record_dns(const uint8_t *pkt, size_t len, double now);
+
+/* Call right after conntrack ingestion: writes the flows refreshed at
+ * `now` (plus those that vanished since the last call), then the tick
+ * boundary. */
+void trace_record_tick(const flow_table_t *ft, double now, double window_s);
+
+/* ── Reader ───────────────────────────────────────────────────── */
+
+typedef struct {
+    FILE    *f;
+    uint8_t *buf;
+    size_t   cap;
+} trace_reader_t;
+
+typedef struct {
+    int            type;      /* TRACE_REC_* */
+    double         ts;
+    const uint8_t *data;      /* valid until the next trace_reader_next() */
+    uint32_t       len;
+} trace_rec_t;
+
+/* Returns 0, -1 when the file is missing or not a trace. */
+int  trace_reader_open(trace_reader_t *r, const char *path);
+
+/* Returns 1 with a record, 0 at end of file, -1 on a truncated or
+ * corrupt record. */
+int  trace_reader_next(trace_reader_t *r, trace_rec_t *rec);
+
+/* Back to the first record (for repeated runs). */
+void trace_reader_rewind(trace_reader_t *r);
+
+void trace_reader_close(trace_reader_t *r);
+
+/* Decode the flow entry at `p` (at most `len` bytes). Returns the bytes
+ * consumed, or -1 when truncated. */
+int  trace_flow_decode(const uint8_t *p, size_t len, trace_flow_t *out);
+
+#endif /* MYCO_TRACE_H */
@@ -78,6 +78,35 @@ typedef struct {
     char   rtt_bpf_obj[128];         /* path to mycoflow_rtt.bpf.o — empty
                                       * string ⇒ RTT engine stays in stub
                                       * mode (no kernel probe).          */
+    double svc_weight_dns;           /* 3-signal voter weights (defaults */
+    double svc_weight_port;          /* 0.6 / 0.3 / 0.1) and acceptance  */
+    double svc_weight_behavior;      /* floor (0.3); the verdict table   */
+    double svc_min_score;            /* is rebuilt on SIGHUP             */
+    double rtt_tail_factor;          /* also demote when a flow's windowed
+                                      * p99 RTT exceeds target × this;
+                                      * 0 = srtt only (default)          */
+    int    rtt_events;               /* 1 = watch stable flows for eBPF
+                                      * RTT breach events and demote on
+                                      * arrival; 0 = per-tick only      */
+    /* ── Conntrack ingestion ────────────────────────────────────── */
+    int    ct_events;                /* 1 = netlink NEW/UPDATE/DESTROY
+                                      * events + per-flow GETs (default),
+                                      * 0 = full dump every tick.         */
+    double ct_resync_s;              /* event mode: full reconciliation
+                                      * dump interval (default 30s)      */
+    int    flow_table_size;          /* max tracked flows; 0 = follow
+                                      * nf_conntrack_max (default)       */
+    /* ── DNS snooping ───────────────────────────────────────────── */
+    int    dns_mdns;                 /* 1 = also learn from mDNS answers
+                                      * (UDP sport 5353), default 0      */
+    int    dns_cache_size;           /* IPs held by the DNS cache
+                                      * (default 1024, read at startup)  */
+    /* ── Trace recorder (offline replay) ────────────────────────── */
+    char   trace_file[128];          /* record conntrack snapshots, DNS
+                                      * answers and ticks here; empty =
+                                      * off (default, read at startup)   */
+    int    trace_max_mb;             /* stop recording at this size
+                                      * (default 16, 1..1024)            */
     /* ── Ingress shaping (IFB) ──────────────────────────────────── */
     int    ingress_enabled;          /* 0 = skip ingress shaping (default) */
     char   ingress_iface[32];        /* IFB device name (default "ifb0") */
@@ -36,6 +36,10 @@ static int g_per_device_enabled = 0;
 static const flow_service_table_t *g_flow_table = NULL;
 static int g_flow_aware_enabled = 0;
 
+/* Flow-table probe-length snapshot — refreshed by main once per tick. */
+static flow_probe_stats_t g_flow_probe;
+static int g_flow_probe_valid = 0;
+
 /* Control-channel mutation targets — registered by main once at startup. */
 static control_state_t      *g_control_state = NULL;
 static const myco_config_t  *g_control_cfg   = NULL;
@@ -136,6 +140,13 @@ void myco_set_flow_table(const void *fst, int enabled) {
     g_flow_aware_enabled = enabled;
 }
 
+void myco_set_flow_probe_stats(const void *stats) {
+    if (stats) {
+        g_flow_probe = *(const flow_probe_stats_t *)stats;
+    }
+    g_flow_probe_valid = stats != NULL;
+}
+
 void myco_set_control_handles(void *control_state, const void *cfg) {
     g_control_state = (control_state_t *)control_state;
     g_control_cfg   = (const myco_config_t *)cfg;
@@ -293,45 +304,57 @@ static int emit_flow_entry(const flow_service_t *fs, void *user) {
     return 0;
 }
 
-// Fallback: Dump state to JSON file for Lua Bridge
+// Fallback: Dump state to JSON file for Lua Bridge.
+// Runs on the flow thread, which owns the device, flow and classifier
+// tables. Only the control-loop globals are shared with the main thread:
+// copy them under g_state_mutex and format + write with the lock released,
+// so the control loop never waits on file I/O.
 void myco_dump_json(void) {
-    if (pthread_mutex_trylock(&g_state_mutex) != 0) {
-        return;
-    }
+    pthread_mutex_lock(&g_state_mutex);
+    metrics_t metrics     = g_last_metrics;
+    metrics_t baseline    = g_last_baseline;
+    policy_t  policy      = g_last_policy;
+    persona_t persona     = g_last_persona;
+    persona_t override_p  = g_persona_override;
+    int       override_on = g_persona_override_active;
+    int       safe_mode   = g_last_safe_mode;
+    char      reason[sizeof(g_last_reason)];
+    memcpy(reason, g_last_reason, sizeof(reason));
+    pthread_mutex_unlock(&g_state_mutex);
+    reason[sizeof(reason) - 1] = '\0';
 
     FILE *f = fopen("/tmp/myco_state.json.tmp", "w");
     if (!f) {
-        pthread_mutex_unlock(&g_state_mutex);
         return;
     }
 
     fprintf(f, "{\n");
     fprintf(f, "\t\"metrics\": {\n");
-    fprintf(f, "\t\t\"rtt_ms\": %.2f,\n", g_last_metrics.rtt_ms);
-    fprintf(f, "\t\t\"jitter_ms\": %.2f,\n", g_last_metrics.jitter_ms);
-    fprintf(f, "\t\t\"tx_bps\": %.0f,\n", g_last_metrics.tx_bps);
-    fprintf(f, "\t\t\"rx_bps\": %.0f,\n", g_last_metrics.rx_bps);
-    fprintf(f, "\t\t\"cpu_pct\": %.1f,\n", g_last_metrics.cpu_pct);
-    fprintf(f, "\t\t\"qdisc_backlog\": %u,\n", g_last_metrics.qdisc_backlog);
-    fprintf(f, "\t\t\"qdisc_drops\": %u,\n", g_last_metrics.qdisc_drops);
-    fprintf(f, "\t\t\"avg_pkt_size\": %.1f\n", g_last_metrics.avg_pkt_size);
+    fprintf(f, "\t\t\"rtt_ms\": %.2f,\n", metrics.rtt_ms);
+    fprintf(f, "\t\t\"jitter_ms\": %.2f,\n", metrics.jitter_ms);
+    fprintf(f, "\t\t\"tx_bps\": %.0f,\n", metrics.tx_bps);
+    fprintf(f, "\t\t\"rx_bps\": %.0f,\n", metrics.rx_bps);
+    fprintf(f, "\t\t\"cpu_pct\": %.1f,\n", metrics.cpu_pct);
+    fprintf(f, "\t\t\"qdisc_backlog\": %u,\n", metrics.qdisc_backlog);
+    fprintf(f, "\t\t\"qdisc_drops\": %u,\n", metrics.qdisc_drops);
+    fprintf(f, "\t\t\"avg_pkt_size\": %.1f\n", metrics.avg_pkt_size);
     fprintf(f, "\t},\n");
 
     fprintf(f, "\t\"baseline\": {\n");
-    fprintf(f, "\t\t\"rtt_ms\": %.2f,\n", g_last_baseline.rtt_ms);
-    fprintf(f, "\t\t\"jitter_ms\": %.2f\n", g_last_baseline.jitter_ms);
+    fprintf(f, "\t\t\"rtt_ms\": %.2f,\n", baseline.rtt_ms);
+    fprintf(f, "\t\t\"jitter_ms\": %.2f\n", baseline.jitter_ms);
     fprintf(f, "\t},\n");
 
     fprintf(f, "\t\"policy\": {\n");
-    fprintf(f, "\t\t\"bandwidth_kbit\": %d\n", g_last_policy.bandwidth_kbit);
+    fprintf(f, "\t\t\"bandwidth_kbit\": %d\n", policy.bandwidth_kbit);
     fprintf(f, "\t},\n");
 
-    fprintf(f, "\t\"persona\": \"%s\",\n", persona_name(g_last_persona));
-    fprintf(f, "\t\"reason\": \"%s\",\n", g_last_reason);
+    fprintf(f, "\t\"persona\": \"%s\",\n", persona_name(persona));
+    fprintf(f, "\t\"reason\": \"%s\",\n", reason);
     
-    fprintf(f, "\t\"persona_override\": %s,\n", g_persona_override_active ? "true" : "false");
-    fprintf(f, "\t\"persona_override_value\": \"%s\",\n", persona_name(g_persona_override));
-    fprintf(f, "\t\"safe_mode\": %s,\n", g_last_safe_mode ? "true" : "false");
+    fprintf(f, "\t\"persona_override\": %s,\n", override_on ? "true" : "false");
+    fprintf(f, "\t\"persona_override_value\": \"%s\",\n", persona_name(override_p));
+    fprintf(f, "\t\"safe_mode\": %s,\n", safe_mode ? "true" : "false");
 
     /* Per-device persona table */
     fprintf(f, "\t\"devices\": [");
@@ -366,6 +389,40 @@ void myco_dump_json(void) {
     }
     fprintf(f, "]");
 
+    /* Flow-table health: probe lengths stay flat under churn */
+    if (g_flow_probe_valid) {
+        fprintf(f, ",\n\t\"flow_table\": {\"count\":%d,\"capacity\":%d,"
+                "\"max_capacity\":%d,\"resizing\":%d,"
+                "\"max_probe\":%d,\"mean_probe\":%.2f,\"probe_hist\":[",
+                g_flow_probe.count, g_flow_probe.capacity,
+                g_flow_probe.max_capacity, g_flow_probe.resizing,
+                g_flow_probe.max_probe, g_flow_probe.mean_probe);
+        for (int i = 0; i < FLOW_PROBE_HIST; i++) {
+            fprintf(f, "%s%u", i ? "," : "", g_flow_probe.hist[i]);
+        }
+        fprintf(f, "],\"evictions\":%llu,\"probe_overflows\":%llu,"
+                "\"resizes\":%llu}",
+                (unsigned long long)g_flow_probe.evictions,
+                (unsigned long long)g_flow_probe.probe_overflows,
+                (unsigned long long)g_flow_probe.resizes);
+    }
+
+    /* Classifier tick work: flows re-voted vs. kept, mark reconciliation */
+    if (g_flow_aware_enabled && g_flow_table) {
+        classifier_stats_t cs;
+        classifier_get_stats(g_flow_table, &cs);
+        fprintf(f, ",\n\t\"classifier\": {\"last_tick_revoted\":%u,"
+                "\"last_tick_skipped\":%u,\"flows_revoted\":%llu,"
+                "\"flows_skipped\":%llu,\"marks_adopted\":%llu,"
+                "\"marks_repaired\":%llu,\"rtt_event_demotes\":%llu}",
+                cs.last_tick_revoted, cs.last_tick_skipped,
+                (unsigned long long)cs.flows_revoted,
+                (unsigned long long)cs.flows_skipped,
+                (unsigned long long)cs.marks_adopted,
+                (unsigned long long)cs.marks_repaired,
+                (unsigned long long)cs.rtt_event_demotes);
+    }
+
     /* Per-flow service classification + RTT state */
     if (g_flow_aware_enabled && g_flow_table) {
         fprintf(f, ",\n\t\"flows\": [");
@@ -378,6 +435,4 @@ void myco_dump_json(void) {
     
     fclose(f);
     rename("/tmp/myco_state.json.tmp", "/tmp/myco_state.json");
-    
-    pthread_mutex_unlock(&g_state_mutex);
 }
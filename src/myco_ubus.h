@@ -45,4 +45,8 @@ void myco_set_control_handles(void *control_state, const void *cfg);
  * the "flows" array entirely. */
 void myco_set_flow_table(const void *fst, int enabled);
 
+/* Flow-table probe statistics (flow_probe_stats_t) for the JSON dump.
+ * The snapshot is copied; NULL clears it and omits "flow_table". */
+void myco_set_flow_probe_stats(const void *stats);
+
 #endif /* MYCO_UBUS_H */
@@ -21,35 +21,33 @@ volatile sig_atomic_t g_stop = 0;
 
 int tests_run = 0;
 
-static void seed_flow(flow_table_t *ft, int idx,
+static void seed_flow(flow_table_t *ft,
                       uint32_t src_ip, uint32_t dst_ip,
                       uint16_t src_port, uint16_t dst_port,
                       uint8_t proto,
                       uint64_t packets, uint64_t bytes,
                       uint64_t tx_delta, uint64_t rx_delta,
                       double last_seen) {
-    flow_entry_t *e = &ft->entries[idx];
-    e->key.src_ip = src_ip;
-    e->key.dst_ip = dst_ip;
-    e->key.src_port = src_port;
-    e->key.dst_port = dst_port;
-    e->key.protocol = proto;
-    e->packets = packets;
-    e->rx_packets = packets;
-    e->bytes = bytes / 2;
-    e->rx_bytes = bytes / 2;
+    flow_key_t k;
+    memset(&k, 0, sizeof(k));
+    k.src_ip = src_ip;
+    k.dst_ip = dst_ip;
+    k.src_port = src_port;
+    k.dst_port = dst_port;
+    k.protocol = proto;
+    flow_table_update(ft, &k, packets, packets, bytes / 2, bytes / 2, last_seen);
+    /* Override the first-sample deltas with the scenario's values. */
+    flow_entry_t *e = (flow_entry_t *)flow_table_lookup(ft, &k);
     e->tx_delta = tx_delta;
     e->rx_delta = rx_delta;
-    e->last_seen = last_seen;
-    e->active = 1;
 }
 
 /* ── Port-only classification (no DNS, no behavior) ───────────── */
 static char *test_port_only_classifies() {
     flow_table_t ft;
-    memset(&ft, 0, sizeof(ft));
+    flow_table_init(&ft);
     /* UDP to port 27020 — Valve game traffic */
-    seed_flow(&ft, 0, 0x0a0a0a01u, 0x08080808u, 40000, 27020, 17,
+    seed_flow(&ft, 0x0a0a0a01u, 0x08080808u, 40000, 27020, 17,
               0, 0, 0, 0, 1.0);
 
     flow_service_table_t *tab = classifier_create();
@@ -63,14 +61,15 @@ static char *test_port_only_classifies() {
 
     mark_engine_close(eng);
     classifier_destroy(tab);
+    flow_table_free(&ft);
     return 0;
 }
 
 /* ── Stability gate: no ct mark push on first tick ───────────── */
 static char *test_stability_gate_requires_two_ticks() {
     flow_table_t ft;
-    memset(&ft, 0, sizeof(ft));
-    seed_flow(&ft, 0, 0x0a0a0a01u, 0x08080808u, 40000, 27020, 17,
+    flow_table_init(&ft);
+    seed_flow(&ft, 0x0a0a0a01u, 0x08080808u, 40000, 27020, 17,
               100, 10000, 5000, 5000, 1.0);
 
     flow_service_table_t *tab = classifier_create();
@@ -87,15 +86,16 @@ static char *test_stability_gate_requires_two_ticks() {
 
     mark_engine_close(eng);
     classifier_destroy(tab);
+    flow_table_free(&ft);
     return 0;
 }
 
 /* ── Verdict flip resets stability ────────────────────────────── */
 static char *test_verdict_flip_resets_stability() {
     flow_table_t ft;
-    memset(&ft, 0, sizeof(ft));
+    flow_table_init(&ft);
     /* First: UDP 27020 → GAME_RT via port */
-    seed_flow(&ft, 0, 0x0a0a0a01u, 0x08080808u, 40000, 27020, 17,
+    seed_flow(&ft, 0x0a0a0a01u, 0x08080808u, 40000, 27020, 17,
               100, 10000, 5000, 5000, 1.0);
 
     flow_service_table_t *tab = classifier_create();
@@ -104,10 +104,10 @@ static char *test_verdict_flip_resets_stability() {
 
     classifier_tick(tab, &ft, NULL, eng, NULL, 1.0, 1.0);  /* tentative */
     /* Flip to port 6881 → TORRENT */
-    ft.entries[0].key.dst_port = 6881;
-    /* Same flow index but different key — need a fresh slot; reset & reseed */
-    memset(&ft, 0, sizeof(ft));
-    seed_flow(&ft, 0, 0x0a0a0a01u, 0x08080808u, 40000, 6881, 17,
+    /* Same 5-tuple except the port is a different flow: reset & reseed */
+    flow_table_free(&ft);
+    flow_table_init(&ft);
+    seed_flow(&ft, 0x0a0a0a01u, 0x08080808u, 40000, 6881, 17,
               100, 10000, 5000, 5000, 2.0);
     classifier_tick(tab, &ft, NULL, eng, NULL, 2.0, 1.0);
     /* New flow, tentative only → no mark yet */
@@ -120,15 +120,16 @@ static char *test_verdict_flip_resets_stability() {
 
     mark_engine_close(eng);
     classifier_destroy(tab);
+    flow_table_free(&ft);
     return 0;
 }
 
 /* ── Unknown verdict doesn't create an entry ──────────────────── */
 static char *test_unknown_does_not_track() {
     flow_table_t ft;
-    memset(&ft, 0, sizeof(ft));
+    flow_table_init(&ft);
     /* Port 443 + no DNS + idle → all three signals UNKNOWN */
-    seed_flow(&ft, 0, 0x0a0a0a01u, 0x08080808u, 40000, 443, 6,
+    seed_flow(&ft, 0x0a0a0a01u, 0x08080808u, 40000, 443, 6,
               0, 0, 0, 0, 1.0);
 
     flow_service_table_t *tab = classifier_create();
@@ -137,15 +138,16 @@ static char *test_unknown_does_not_track() {
               classifier_active_count(tab) == 0);
 
     classifier_destroy(tab);
+    flow_table_free(&ft);
     return 0;
 }
 
 /* ── DNS hint dominates port hint (0.6 > 0.3) ─────────────────── */
 static char *test_dns_beats_port() {
     flow_table_t ft;
-    memset(&ft, 0, sizeof(ft));
+    flow_table_init(&ft);
     /* Port 5222 → GAME_RT via port, but DNS says googlevideo.com → VIDEO_VOD */
-    seed_flow(&ft, 0, 0x0a0a0a01u, 0xd83acf8eu, 40000, 5222, 17,
+    seed_flow(&ft, 0x0a0a0a01u, 0xd83acf8eu, 40000, 5222, 17,
               100, 10000, 5000, 5000, 1.0);
 
     dns_cache_t dns;
@@ -161,6 +163,7 @@ static char *test_dns_beats_port() {
 
     classifier_destroy(tab);
     dns_cache_destroy(&dns);
+    flow_table_free(&ft);
     return 0;
 }
 
@@ -177,16 +180,16 @@ static char *test_null_safe() {
 /* ── classifier_device_counts (Phase 4b) ─────────────────────── */
 static char *test_device_counts_aggregates_per_src_ip() {
     flow_table_t ft;
-    memset(&ft, 0, sizeof(ft));
+    flow_table_init(&ft);
 
     uint32_t a = 0x0a0a0a01u, b = 0x0a0a0a02u;
     /* A: two GAME_RT flows */
-    seed_flow(&ft, 0, a, 0x08080808u, 40000, 27020, 17, 100, 10000, 5000, 5000, 1.0);
-    seed_flow(&ft, 1, a, 0x08080809u, 40001, 27021, 17, 100, 10000, 5000, 5000, 1.0);
+    seed_flow(&ft, a, 0x08080808u, 40000, 27020, 17, 100, 10000, 5000, 5000, 1.0);
+    seed_flow(&ft, a, 0x08080809u, 40001, 27021, 17, 100, 10000, 5000, 5000, 1.0);
     /* A: one VIDEO_LIVE (RTMP) flow */
-    seed_flow(&ft, 2, a, 0x0101017fu, 40002, 1935,   6,  100, 10000, 5000, 5000, 1.0);
+    seed_flow(&ft, a, 0x0101017fu, 40002, 1935,   6,  100, 10000, 5000, 5000, 1.0);
     /* B: one TORRENT flow */
-    seed_flow(&ft, 3, b, 0x02020202u, 40003, 6881,   6,  100, 10000, 5000, 5000, 1.0);
+    seed_flow(&ft, b, 0x02020202u, 40003, 6881,   6,  100, 10000, 5000, 5000, 1.0);
 
     flow_service_table_t *tab = classifier_create();
     classifier_tick(tab, &ft, NULL, NULL, NULL, 1.0, 1.0);
@@ -203,6 +206,7 @@ static char *test_device_counts_aggregates_per_src_ip() {
     mu_assert("B has 0 GAME_RT",    counts[SVC_GAME_RT]    == 0);
 
     classifier_destroy(tab);
+    flow_table_free(&ft);
     return 0;
 }
 
@@ -218,9 +222,9 @@ static char *test_device_counts_aggregates_per_src_ip() {
 
 static char *test_rtt_demote_after_two_breaches() {
     flow_table_t ft;
-    memset(&ft, 0, sizeof(ft));
+    flow_table_init(&ft);
     /* TCP → RTT engine applies. Port 25565 classifies GAME_RT via port hint. */
-    seed_flow(&ft, 0, 0x0a0a0a01u, 0x08080808u, 40000, 25565, 6,
+    seed_flow(&ft, 0x0a0a0a01u, 0x08080808u, 40000, 25565, 6,
               100, 10000, 5000, 5000, 1.0);
 
     flow_service_table_t *tab = classifier_create();
@@ -250,13 +254,14 @@ static char *test_rtt_demote_after_two_breaches() {
     mark_engine_close(eng);
     rtt_engine_close(rtt);
     classifier_destroy(tab);
+    flow_table_free(&ft);
     return 0;
 }
 
 static char *test_rtt_repromote_after_recovery() {
     flow_table_t ft;
-    memset(&ft, 0, sizeof(ft));
-    seed_flow(&ft, 0, 0x0a0a0a01u, 0x08080808u, 40000, 25565, 6,
+    flow_table_init(&ft);
+    seed_flow(&ft, 0x0a0a0a01u, 0x08080808u, 40000, 25565, 6,
               100, 10000, 5000, 5000, 1.0);
 
     flow_service_table_t *tab = classifier_create();
@@ -285,13 +290,14 @@ static char *test_rtt_repromote_after_recovery() {
     mark_engine_close(eng);
     rtt_engine_close(rtt);
     classifier_destroy(tab);
+    flow_table_free(&ft);
     return 0;
 }
 
 static char *test_rtt_noop_when_under_target() {
     flow_table_t ft;
-    memset(&ft, 0, sizeof(ft));
-    seed_flow(&ft, 0, 0x0a0a0a01u, 0x08080808u, 40000, 25565, 6,
+    flow_table_init(&ft);
+    seed_flow(&ft, 0x0a0a0a01u, 0x08080808u, 40000, 25565, 6,
               100, 10000, 5000, 5000, 1.0);
 
     flow_service_table_t *tab = classifier_create();
@@ -314,13 +320,177 @@ static char *test_rtt_noop_when_under_target() {
     mark_engine_close(eng);
     rtt_engine_close(rtt);
     classifier_destroy(tab);
+    flow_table_free(&ft);
+    return 0;
+}
+
+/* Mean under target, p99 far over it: only the tail trigger demotes,
+ * and only with enough samples in the window. */
+static char *run_tail_case(double factor, uint32_t samples, uint64_t *pushes) {
+    flow_table_t ft;
+    flow_table_init(&ft);
+    seed_flow(&ft, 0x0a0a0a01u, 0x08080808u, 40000, 25565, 6,
+              100, 10000, 5000, 5000, 1.0);
+
+    flow_service_table_t *tab = classifier_create();
+    classifier_set_rtt_tail(tab, factor);
+    mark_engine_t *eng = mark_engine_open();
+    rtt_engine_t  *rtt = rtt_engine_open(NULL, NULL);
+    flow_key_t k = { 0x0a0a0a01u, 0x08080808u, 40000, 25565, 6 };
+
+    classifier_tick(tab, &ft, NULL, eng, rtt, 1.0, 1.0);
+    rtt_engine_inject_stub(rtt, &k, 30);
+    rtt_pct_t pct = { samples, 28, 90, 160 };
+    rtt_engine_inject_pct_stub(rtt, &k, &pct);
+
+    uint64_t ok_before = mark_engine_stat_ok(eng);
+    classifier_tick(tab, &ft, NULL, eng, rtt, 2.0, 1.0);
+    classifier_tick(tab, &ft, NULL, eng, rtt, 3.0, 1.0);
+    *pushes = mark_engine_stat_ok(eng) - ok_before;
+
+    mark_engine_close(eng);
+    rtt_engine_close(rtt);
+    classifier_destroy(tab);
+    flow_table_free(&ft);
+    return 0;
+}
+
+static char *test_rtt_tail_trigger() {
+    uint64_t pushes = 0;
+    run_tail_case(0.0, 40, &pushes);
+    mu_assert("tail trigger off: srtt alone, no demote", pushes == 1);
+    run_tail_case(2.0, 40, &pushes);
+    mu_assert("p99 160ms > 50ms × 2 → demote on 2nd breach", pushes == 2);
+    run_tail_case(2.0, RTT_TAIL_MIN_SAMPLES - 1, &pushes);
+    mu_assert("too few samples → p99 ignored", pushes == 1);
+    run_tail_case(4.0, 40, &pushes);
+    mu_assert("p99 under target × factor → no demote", pushes == 1);
+    return 0;
+}
+
+typedef struct {
+    flow_service_table_t *tab;
+    flow_table_t         *ft;
+    mark_engine_t        *eng;
+    int                   demoted;
+} event_ctx_t;
+
+static void on_event(const rtt_event_t *ev, void *arg) {
+    event_ctx_t *c = arg;
+    if (classifier_rtt_event(c->tab, c->ft, c->eng, ev, 2.5) == 1) c->demoted++;
+}
+
+static char *test_rtt_event_demotes_between_ticks() {
+    flow_table_t ft;
+    flow_table_init(&ft);
+    seed_flow(&ft, 0x0a0a0a01u, 0x08080808u, 40000, 25565, 6,
+              100, 10000, 5000, 5000, 1.0);
+
+    flow_service_table_t *tab = classifier_create();
+    classifier_set_rtt_events(tab, 1);
+    mark_engine_t *eng = mark_engine_open();
+    rtt_engine_t  *rtt = rtt_engine_open(NULL, NULL);
+    flow_key_t k = { 0x0a0a0a01u, 0x08080808u, 40000, 25565, 6 };
+    event_ctx_t ctx = { tab, &ft, eng, 0 };
+
+    /* Healthy until stable: the tick sets the 75 ms (50 × 1.5) threshold. */
+    rtt_engine_inject_stub(rtt, &k, 30);
+    classifier_tick(tab, &ft, NULL, eng, rtt, 1.0, 1.0);
+    classifier_tick(tab, &ft, NULL, eng, rtt, 2.0, 1.0);
+    uint64_t ok_before = mark_engine_stat_ok(eng);
+
+    /* srtt crosses mid-tick: demoted on the event, no tick needed. */
+    rtt_engine_inject_stub(rtt, &k, 200);
+    mu_assert("one breach event", rtt_engine_poll_events(rtt, 0, on_event, &ctx) == 1);
+    mu_assert("event demoted the flow", ctx.demoted == 1);
+    mu_assert("demoted mark pushed", mark_engine_stat_ok(eng) == ok_before + 1);
+    classifier_stats_t st;
+    classifier_get_stats(tab, &st);
+    mu_assert("event demote counted", st.rtt_event_demotes == 1);
+
+    /* Still over: no second event, and the next tick keeps the demotion. */
+    rtt_engine_inject_stub(rtt, &k, 220);
+    mu_assert("no repeat while over", rtt_engine_poll_events(rtt, 0, on_event, &ctx) == 0);
+    classifier_tick(tab, &ft, NULL, eng, rtt, 3.0, 1.0);
+    mu_assert("tick does not demote twice", mark_engine_stat_ok(eng) == ok_before + 1);
+
+    /* Demoted flows are unwatched, so a fresh crossing is ignored. */
+    rtt_engine_inject_stub(rtt, &k, 30);
+    rtt_engine_inject_stub(rtt, &k, 200);
+    mu_assert("no event while demoted", rtt_engine_poll_events(rtt, 0, on_event, &ctx) == 0);
+
+    mark_engine_close(eng);
+    rtt_engine_close(rtt);
+    classifier_destroy(tab);
+    flow_table_free(&ft);
+    return 0;
+}
+
+static char *test_rtt_events_off_sets_no_threshold() {
+    flow_table_t ft;
+    flow_table_init(&ft);
+    seed_flow(&ft, 0x0a0a0a01u, 0x08080808u, 40000, 25565, 6,
+              100, 10000, 5000, 5000, 1.0);
+
+    flow_service_table_t *tab = classifier_create();
+    mark_engine_t *eng = mark_engine_open();
+    rtt_engine_t  *rtt = rtt_engine_open(NULL, NULL);
+    flow_key_t k = { 0x0a0a0a01u, 0x08080808u, 40000, 25565, 6 };
+    event_ctx_t ctx = { tab, &ft, eng, 0 };
+
+    rtt_engine_inject_stub(rtt, &k, 30);
+    classifier_tick(tab, &ft, NULL, eng, rtt, 1.0, 1.0);
+    classifier_tick(tab, &ft, NULL, eng, rtt, 2.0, 1.0);
+    rtt_engine_inject_stub(rtt, &k, 200);
+    mu_assert("events off: nothing queued", rtt_engine_poll_events(rtt, 0, on_event, &ctx) == 0);
+
+    mark_engine_close(eng);
+    rtt_engine_close(rtt);
+    classifier_destroy(tab);
+    flow_table_free(&ft);
+    return 0;
+}
+
+/* A watched flow recycled at the ceiling takes its threshold with it. */
+static char *test_rtt_threshold_cleared_on_recycle() {
+    static flow_table_t ft;
+    flow_table_init_sized(&ft, 1024);
+    seed_flow(&ft, 0x0a0a0a01u, 0x08080808u, 40000, 25565, 6,
+              100, 10000, 5000, 5000, 1.0);
+
+    flow_service_table_t *tab = classifier_create_sized(256);
+    classifier_set_rtt_events(tab, 1);
+    rtt_engine_t *rtt = rtt_engine_open(NULL, NULL);
+    flow_key_t k = { 0x0a0a0a01u, 0x08080808u, 40000, 25565, 6 };
+    event_ctx_t ctx = { tab, &ft, NULL, 0 };
+
+    rtt_engine_inject_stub(rtt, &k, 30);
+    classifier_tick(tab, &ft, NULL, NULL, rtt, 1.0, 1.0);
+    classifier_tick(tab, &ft, NULL, NULL, rtt, 2.0, 1.0);
+
+    /* 256 new flows: the watched one is the LRU entry that goes. */
+    flow_table_free(&ft);
+    flow_table_init_sized(&ft, 1024);
+    for (int i = 0; i < 256; i++) {
+        seed_flow(&ft, 0x0a0a0a02u, 0x08080808u, (uint16_t)(20000 + i), 27020, 17,
+                  0, 0, 0, 0, 3.0);
+    }
+    classifier_tick(tab, &ft, NULL, NULL, rtt, 3.0, 1.0);
+    mu_assert("watched flow recycled", classifier_get_service(tab, &k) == SVC_UNKNOWN);
+
+    rtt_engine_inject_stub(rtt, &k, 200);
+    mu_assert("threshold cleared with it", rtt_engine_poll_events(rtt, 0, on_event, &ctx) == 0);
+
+    rtt_engine_close(rtt);
+    classifier_destroy(tab);
+    flow_table_free(&ft);
     return 0;
 }
 
 static char *test_rtt_null_engine_skipped() {
     flow_table_t ft;
-    memset(&ft, 0, sizeof(ft));
-    seed_flow(&ft, 0, 0x0a0a0a01u, 0x08080808u, 40000, 25565, 6,
+    flow_table_init(&ft);
+    seed_flow(&ft, 0x0a0a0a01u, 0x08080808u, 40000, 25565, 6,
               100, 10000, 5000, 5000, 1.0);
 
     flow_service_table_t *tab = classifier_create();
@@ -333,6 +503,265 @@ static char *test_rtt_null_engine_skipped() {
 
     mark_engine_close(eng);
     classifier_destroy(tab);
+    flow_table_free(&ft);
+    return 0;
+}
+
+/* ── Conntrack marks are reconciled, not blindly rewritten ─── */
+
+/* Report `mark` as the flow's live conntrack mark, read at `when`. */
+static void kernel_mark(flow_table_t *ft, uint16_t sport, uint32_t mark, double when) {
+    flow_key_t k = { 0x0a0a0a01u, 0x08080808u, sport, 27020, 17 };
+    flow_entry_t *e = (flow_entry_t *)flow_table_lookup(ft, &k);
+    e->ct_mark = mark;
+    e->ct_mark_valid = 1;
+    e->ct_mark_at = when;
+    e->last_seen = when;
+}
+
+static int find_fs_cb(const flow_service_t *fs, void *user) {
+    *(const flow_service_t **)user = fs;
+    return 1;
+}
+
+static char *test_mark_reconciliation() {
+    static flow_table_t ft;
+    flow_table_init(&ft);
+    uint8_t game = service_to_ct_mark(SVC_GAME_RT);
+    uint8_t low  = service_to_ct_mark(service_demote(SVC_GAME_RT));
+    seed_flow(&ft, 0x0a0a0a01u, 0x08080808u, 40001, 27020, 17,
+              100, 10000, 5000, 5000, 1.0);   /* kernel already has `game` */
+    seed_flow(&ft, 0x0a0a0a01u, 0x08080808u, 40002, 27020, 17,
+              100, 10000, 5000, 5000, 1.0);   /* kernel has the demoted tier */
+    seed_flow(&ft, 0x0a0a0a01u, 0x08080808u, 40003, 27020, 17,
+              100, 10000, 5000, 5000, 1.0);   /* kernel mark unset */
+    kernel_mark(&ft, 40001, game, 1.0);
+    kernel_mark(&ft, 40002, low, 1.0);
+    kernel_mark(&ft, 40003, 0, 1.0);
+
+    /* A fresh table is what a restarted daemon starts from. */
+    flow_service_table_t *tab = classifier_create();
+    mark_engine_t *eng = mark_engine_open();
+    uint64_t ok0 = mark_engine_stat_ok(eng);
+    classifier_tick(tab, &ft, NULL, eng, NULL, 1.0, 1.0);
+    kernel_mark(&ft, 40001, game, 2.0);
+    kernel_mark(&ft, 40002, low, 2.0);
+    kernel_mark(&ft, 40003, 0, 2.0);
+    classifier_tick(tab, &ft, NULL, eng, NULL, 2.0, 1.0);
+
+    mu_assert("only the unmarked flow is written", mark_engine_stat_ok(eng) == ok0 + 1);
+    classifier_stats_t st;
+    classifier_get_stats(tab, &st);
+    mu_assert("two marks adopted", st.marks_adopted == 2);
+
+    const flow_service_t *fs = NULL;
+    flow_service_table_t *one = classifier_create();
+    static flow_table_t single;
+    flow_table_init(&single);
+    seed_flow(&single, 0x0a0a0a01u, 0x08080808u, 40002, 27020, 17,
+              100, 10000, 5000, 5000, 1.0);
+    kernel_mark(&single, 40002, low, 1.0);
+    classifier_tick(one, &single, NULL, NULL, NULL, 1.0, 1.0);
+    kernel_mark(&single, 40002, low, 2.0);
+    classifier_tick(one, &single, NULL, NULL, NULL, 2.0, 1.0);
+    classifier_for_each(one, find_fs_cb, &fs);
+    mu_assert("demoted tier re-adopted", fs && fs->demoted == 1 && fs->ct_mark == low);
+    classifier_destroy(one);
+    flow_table_free(&single);
+
+    /* Our write is not trusted back until conntrack is read again — an
+     * idle refresh that only bumps last_seen does not count... */
+    flow_key_t k3 = { 0x0a0a0a01u, 0x08080808u, 40003, 27020, 17 };
+    flow_table_touch(&ft, &k3, 2.5);
+    classifier_tick(tab, &ft, NULL, eng, NULL, 2.5, 1.0);
+    mu_assert("no rewrite off a stale reading", mark_engine_stat_ok(eng) == ok0 + 1);
+
+    /* ...and a mark cleared behind our back is put back. */
+    kernel_mark(&ft, 40001, 0, 3.0);
+    classifier_tick(tab, &ft, NULL, eng, NULL, 3.0, 1.0);
+    mu_assert("drifted mark rewritten", mark_engine_stat_ok(eng) == ok0 + 2);
+    classifier_get_stats(tab, &st);
+    mu_assert("repair counted", st.marks_repaired == 1);
+
+    classifier_get_stats(NULL, &st);
+    mu_assert("NULL tab zeroes stats", st.marks_adopted == 0 && st.marks_repaired == 0);
+
+    mark_engine_close(eng);
+    classifier_destroy(tab);
+    flow_table_free(&ft);
+    return 0;
+}
+
+/* ── A tick's mark pushes go out as batches, not one by one ─── */
+static char *test_mark_pushes_batched_per_tick() {
+    static flow_table_t ft;
+    flow_table_init_sized(&ft, 2048);
+    const int n = 600;
+    for (int i = 0; i < n; i++) {
+        seed_flow(&ft, 0x0a0a0a01u, 0x08080808u, (uint16_t)(20000 + i), 27020, 17,
+                  100, 10000, 5000, 5000, 1.0);
+    }
+    flow_service_table_t *tab = classifier_create_sized(2048);
+    mark_engine_t *eng = mark_engine_open();
+    uint64_t ok0 = mark_engine_stat_ok(eng);
+    uint64_t b0  = mark_engine_stat_batches(eng);
+
+    classifier_tick(tab, &ft, NULL, eng, NULL, 1.0, 1.0);
+    mu_assert("tentative tick sends no batch", mark_engine_stat_batches(eng) == b0);
+
+    classifier_tick(tab, &ft, NULL, eng, NULL, 2.0, 1.0);
+    mu_assert("every stable flow pushed", mark_engine_stat_ok(eng) == ok0 + (uint64_t)n);
+    mu_assert("pushes grouped into ceil(n / MARK_BATCH_MAX) batches",
+              mark_engine_stat_batches(eng) ==
+              b0 + (uint64_t)((n + MARK_BATCH_MAX - 1) / MARK_BATCH_MAX));
+    mu_assert("no batch failed", mark_engine_stat_batch_err(eng) == 0);
+    mu_assert("batch latency recorded",
+              mark_engine_stat_batch_max_us(eng) >= mark_engine_stat_batch_last_us(eng));
+
+    classifier_tick(tab, &ft, NULL, eng, NULL, 3.0, 1.0);
+    mu_assert("steady tick sends nothing",
+              mark_engine_stat_batches(eng) ==
+              b0 + (uint64_t)((n + MARK_BATCH_MAX - 1) / MARK_BATCH_MAX));
+    mu_assert("flush on NULL is safe", mark_engine_flush(NULL) == 0);
+
+    mark_engine_close(eng);
+    classifier_destroy(tab);
+    flow_table_free(&ft);
+    return 0;
+}
+
+/* ── Hashed index: thousands of flows, grow, sweep, shrink ──── */
+static char *test_index_scales_and_sweeps() {
+    static flow_table_t ft;
+    flow_table_init_sized(&ft, 8192);
+    const int n = 4000;
+    for (int i = 0; i < n; i++) {
+        seed_flow(&ft, 0x0a0a0000u | (uint32_t)(i >> 8), 0x08080808u,
+                  (uint16_t)(20000 + i), 27020, 17, 0, 0, 0, 0, 1.0);
+    }
+
+    flow_service_table_t *tab = classifier_create_sized(8192);
+    classifier_tick(tab, &ft, NULL, NULL, NULL, 1.0, 1.0);
+    mu_assert("every flow tracked", classifier_active_count(tab) == n);
+    for (int i = 0; i < n; i++) {
+        flow_key_t k = { 0x0a0a0000u | (uint32_t)(i >> 8), 0x08080808u,
+                         (uint16_t)(20000 + i), 27020, 17 };
+        mu_assert("flow reachable through the index",
+                  classifier_get_service(tab, &k) == SVC_GAME_RT);
+    }
+    flow_key_t miss = { 0x0b0b0b0bu, 0x08080808u, 1, 27020, 17 };
+    mu_assert("untracked key misses", classifier_get_service(tab, &miss) == SVC_UNKNOWN);
+
+    /* Every flow goes quiet: one sweep drops them all. */
+    flow_table_free(&ft);
+    flow_table_init(&ft);
+    classifier_tick(tab, &ft, NULL, NULL, NULL, 40.0, 1.0);
+    mu_assert("stale entries swept", classifier_active_count(tab) == 0);
+    for (int t = 0; t < 8; t++) {
+        classifier_tick(tab, &ft, NULL, NULL, NULL, 41.0 + t, 1.0);
+    }
+    flow_key_t k0 = { 0x0a0a0000u, 0x08080808u, 20000, 27020, 17 };
+    mu_assert("swept flow no longer reported",
+              classifier_get_service(tab, &k0) == SVC_UNKNOWN);
+
+    classifier_destroy(tab);
+    flow_table_free(&ft);
+    return 0;
+}
+
+/* ── At the ceiling the least recently confirmed entry goes ─── */
+static char *test_ceiling_recycles_lru() {
+    static flow_table_t ft;
+    flow_table_init_sized(&ft, 1024);
+    for (int i = 0; i < 256; i++) {
+        seed_flow(&ft, 0x0a0a0a01u, 0x08080808u, (uint16_t)(20000 + i), 27020, 17,
+                  0, 0, 0, 0, 1.0);
+    }
+    flow_service_table_t *tab = classifier_create_sized(256);
+    classifier_tick(tab, &ft, NULL, NULL, NULL, 1.0, 1.0);
+    mu_assert("table full", classifier_active_count(tab) == 256);
+
+    /* Next tick: half of the old flows plus 64 new ones. */
+    flow_table_free(&ft);
+    flow_table_init_sized(&ft, 1024);
+    for (int i = 0; i < 128; i++) {
+        seed_flow(&ft, 0x0a0a0a01u, 0x08080808u, (uint16_t)(20000 + i), 27020, 17,
+                  0, 0, 0, 0, 2.0);
+    }
+    for (int i = 0; i < 64; i++) {
+        seed_flow(&ft, 0x0a0a0a02u, 0x08080808u, (uint16_t)(30000 + i), 27020, 17,
+                  0, 0, 0, 0, 2.0);
+    }
+    classifier_tick(tab, &ft, NULL, NULL, NULL, 2.0, 1.0);
+    mu_assert("count stays at the ceiling", classifier_active_count(tab) == 256);
+    for (int i = 0; i < 128; i++) {
+        flow_key_t k = { 0x0a0a0a01u, 0x08080808u, (uint16_t)(20000 + i), 27020, 17 };
+        mu_assert("reconfirmed flow kept", classifier_get_service(tab, &k) == SVC_GAME_RT);
+    }
+    for (int i = 0; i < 64; i++) {
+        flow_key_t k = { 0x0a0a0a02u, 0x08080808u, (uint16_t)(30000 + i), 27020, 17 };
+        mu_assert("new flow admitted", classifier_get_service(tab, &k) == SVC_GAME_RT);
+    }
+
+    classifier_destroy(tab);
+    flow_table_free(&ft);
+    return 0;
+}
+
+/* ── Incremental ticks: only dirty / due flows are re-voted ──── */
+static char *test_incremental_revote() {
+    flow_table_t ft;
+    flow_table_init(&ft);
+    seed_flow(&ft, 0x0a0a0a01u, 0x08080808u, 40000, 27020, 17, 0, 0, 0, 0, 1.0);
+    seed_flow(&ft, 0x0a0a0a01u, 0xd83acf8eu, 40001, 5222, 17, 0, 0, 0, 0, 1.0);
+    seed_flow(&ft, 0x0a0a0a01u, 0x09090909u, 40002, 9, 6, 0, 0, 0, 0, 1.0);
+
+    dns_cache_t dns;
+    dns_cache_init(&dns);
+    flow_service_table_t *tab = classifier_create();
+    classifier_stats_t st;
+
+    classifier_tick(tab, &ft, &dns, NULL, NULL, 1.0, 1.0);
+    classifier_get_stats(tab, &st);
+    mu_assert("first tick votes every new flow",
+              st.last_tick_revoted == 3 && st.last_tick_skipped == 0);
+    classifier_tick(tab, &ft, &dns, NULL, NULL, 2.0, 1.0);
+    classifier_get_stats(tab, &st);
+    mu_assert("unstable flows vote, idle unknown is skipped",
+              st.last_tick_revoted == 2 && st.last_tick_skipped == 1);
+    classifier_tick(tab, &ft, &dns, NULL, NULL, 3.0, 1.0);
+    classifier_get_stats(tab, &st);
+    mu_assert("stable quiet flows are skipped",
+              st.last_tick_revoted == 0 && st.last_tick_skipped == 3);
+
+    /* A new DNS answer for one flow's destination re-votes just it. */
+    dns_cache_insert(&dns, 0xd83acf8eu, "r1.googlevideo.com", 300);
+    classifier_tick(tab, &ft, &dns, NULL, NULL, 4.0, 1.0);
+    classifier_get_stats(tab, &st);
+    flow_key_t k = { 0x0a0a0a01u, 0xd83acf8eu, 40001, 5222, 17 };
+    mu_assert("dns change re-votes its flow", st.last_tick_revoted == 1);
+    mu_assert("dns change applied", classifier_get_service(tab, &k) == SVC_VIDEO_VOD);
+
+    classifier_tick(tab, &ft, &dns, NULL, NULL, 5.0, 1.0);   /* re-stabilise */
+    classifier_tick(tab, &ft, &dns, NULL, NULL, 12.5, 1.0);
+    classifier_get_stats(tab, &st);
+    mu_assert("recheck interval re-votes the stable game flow",
+              st.last_tick_revoted == 1 && st.last_tick_skipped == 2);
+    mu_assert("cumulative counters add up",
+              st.flows_revoted + st.flows_skipped == 18);
+
+    classifier_revote_all(tab);
+    classifier_tick(tab, &ft, &dns, NULL, NULL, 13.0, 1.0);
+    classifier_get_stats(tab, &st);
+    mu_assert("revote_all re-votes every flow once",
+              st.last_tick_revoted == 3 && st.last_tick_skipped == 0);
+    classifier_tick(tab, &ft, &dns, NULL, NULL, 14.0, 1.0);
+    classifier_get_stats(tab, &st);
+    mu_assert("then back to incremental", st.last_tick_revoted == 0);
+
+    classifier_destroy(tab);
+    dns_cache_destroy(&dns);
+    flow_table_free(&ft);
     return 0;
 }
 
@@ -347,7 +776,16 @@ static char *all_tests() {
     mu_run_test(test_rtt_demote_after_two_breaches);
     mu_run_test(test_rtt_repromote_after_recovery);
     mu_run_test(test_rtt_noop_when_under_target);
+    mu_run_test(test_rtt_tail_trigger);
+    mu_run_test(test_rtt_event_demotes_between_ticks);
+    mu_run_test(test_rtt_events_off_sets_no_threshold);
+    mu_run_test(test_rtt_threshold_cleared_on_recycle);
     mu_run_test(test_rtt_null_engine_skipped);
+    mu_run_test(test_mark_pushes_batched_per_tick);
+    mu_run_test(test_mark_reconciliation);
+    mu_run_test(test_index_scales_and_sweeps);
+    mu_run_test(test_ceiling_recycles_lru);
+    mu_run_test(test_incremental_revote);
     return 0;
 }
 
@@ -83,11 +83,65 @@ static char *test_config_ingress_env() {
     return 0;
 }
 
+static char *test_config_service_weights() {
+    myco_config_t cfg;
+    memset(&cfg, 0, sizeof(cfg));
+    config_load(&cfg);
+    mu_assert("error, default voter weights 0.6/0.3/0.1",
+              cfg.svc_weight_dns == 0.6 && cfg.svc_weight_port == 0.3 &&
+              cfg.svc_weight_behavior == 0.1);
+    mu_assert("error, default svc_min_score should be 0.3", cfg.svc_min_score == 0.3);
+
+    setenv("MYCOFLOW_SVC_WEIGHT_PORT", "0.7", 1);
+    setenv("MYCOFLOW_SVC_MIN_SCORE", "-1", 1);
+    config_load(&cfg);
+    mu_assert("error, svc_weight_port env override", cfg.svc_weight_port == 0.7);
+    mu_assert("error, svc_min_score clamped to 0", cfg.svc_min_score == 0.0);
+    unsetenv("MYCOFLOW_SVC_WEIGHT_PORT");
+    unsetenv("MYCOFLOW_SVC_MIN_SCORE");
+
+    mu_assert("error, rtt_tail_factor should default to 0 (off)", cfg.rtt_tail_factor == 0.0);
+    setenv("MYCOFLOW_RTT_TAIL_FACTOR", "1.1", 1);
+    config_load(&cfg);
+    mu_assert("error, rtt_tail_factor clamped up to 1.5", cfg.rtt_tail_factor == 1.5);
+    setenv("MYCOFLOW_RTT_TAIL_FACTOR", "3", 1);
+    config_load(&cfg);
+    mu_assert("error, rtt_tail_factor env override", cfg.rtt_tail_factor == 3.0);
+    unsetenv("MYCOFLOW_RTT_TAIL_FACTOR");
+
+    mu_assert("error, rtt_events should default to off", cfg.rtt_events == 0);
+    setenv("MYCOFLOW_RTT_EVENTS", "1", 1);
+    config_load(&cfg);
+    mu_assert("error, rtt_events env override", cfg.rtt_events == 1);
+    unsetenv("MYCOFLOW_RTT_EVENTS");
+    return 0;
+}
+
+static char *test_config_trace() {
+    myco_config_t cfg;
+    memset(&cfg, 0, sizeof(cfg));
+    config_load(&cfg);
+    mu_assert("error, trace_file should default to empty", cfg.trace_file[0] == '\0');
+    mu_assert("error, trace_max_mb should default to 16", cfg.trace_max_mb == 16);
+
+    setenv("MYCOFLOW_TRACE_FILE", "/tmp/myco.trace", 1);
+    setenv("MYCOFLOW_TRACE_MAX_MB", "0", 1);
+    config_load(&cfg);
+    mu_assert("error, trace_file env override",
+              strcmp(cfg.trace_file, "/tmp/myco.trace") == 0);
+    mu_assert("error, trace_max_mb clamped to 1", cfg.trace_max_mb == 1);
+    unsetenv("MYCOFLOW_TRACE_FILE");
+    unsetenv("MYCOFLOW_TRACE_MAX_MB");
+    return 0;
+}
+
 static char *all_tests() {
     mu_run_test(test_config_defaults);
     mu_run_test(test_config_validation);
     mu_run_test(test_config_ingress_defaults);
     mu_run_test(test_config_ingress_env);
+    mu_run_test(test_config_service_weights);
+    mu_run_test(test_config_trace);
     return 0;
 }
 
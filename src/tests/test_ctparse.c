@@ -0,0 +1,195 @@
+/*
+ * test_ctparse.c - Unit tests for the streaming nf_conntrack tokenizer
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include "../minunit.h"
+#include "../myco_ctparse.h"
+
+int tests_run = 0;
+
+static const char *TCP_LINE =
+    "ipv4     2 tcp      6 431999 ESTABLISHED src=192.168.1.10 dst=142.250.1.2 "
+    "sport=51234 dport=443 packets=120 bytes=9000 src=142.250.1.2 "
+    "dst=192.168.1.10 sport=443 dport=51234 packets=300 bytes=400000 "
+    "[ASSURED] mark=0 zone=0 use=2\n";
+
+static const char *UDP_LINE =
+    "ipv4     2 udp      17 29 src=192.168.1.20 dst=8.8.8.8 sport=40000 "
+    "dport=53 [UNREPLIED] src=8.8.8.8 dst=192.168.1.20 sport=53 dport=40000 "
+    "mark=0 zone=0 use=2\n";
+
+static const char *V6_LINE =
+    "ipv6     10 tcp      6 300 ESTABLISHED src=fe80::1 dst=fe80::2 sport=1 "
+    "dport=2 packets=1 bytes=60 src=fe80::2 dst=fe80::1 sport=2 dport=1 "
+    "packets=1 bytes=60 mark=0 zone=0 use=2\n";
+
+static const char *ICMP_LINE =
+    "ipv4     2 icmp     1 29 src=192.168.1.5 dst=1.1.1.1 type=8 code=0 id=7 "
+    "src=1.1.1.1 dst=192.168.1.5 type=0 code=0 id=7 mark=0 zone=0 use=2\n";
+
+static int count_cb(const ct_record_t *rec, void *user) {
+    (void)rec;
+    (*(int *)user)++;
+    return 0;
+}
+
+/* ── Single-line decoding ──────────────────────────────────── */
+static char *test_ctparse_tcp_line() {
+    ct_record_t r;
+    mu_assert("error, tcp line should parse",
+              ct_parse_line(TCP_LINE, strlen(TCP_LINE), &r) == 0);
+
+    uint32_t src, dst;
+    inet_pton(AF_INET, "192.168.1.10", &src);
+    inet_pton(AF_INET, "142.250.1.2", &dst);
+    mu_assert("error, src ip (original tuple)", r.key.src_ip == src);
+    mu_assert("error, dst ip (original tuple)", r.key.dst_ip == dst);
+    mu_assert("error, sport", r.key.src_port == 51234);
+    mu_assert("error, dport", r.key.dst_port == 443);
+    mu_assert("error, proto", r.key.protocol == 6);
+    mu_assert("error, tx packets", r.tx_packets == 120);
+    mu_assert("error, rx packets", r.rx_packets == 300);
+    mu_assert("error, tx bytes", r.tx_bytes == 9000);
+    mu_assert("error, rx bytes", r.rx_bytes == 400000);
+    mu_assert("error, mark=0 is still reported", r.has_mark == 1 && r.mark == 0);
+    return 0;
+}
+
+/* ── Live ct mark ──────────────────────────────────────────── */
+static char *test_ctparse_mark() {
+    static const char *marked =
+        "ipv4     2 udp      17 170 src=192.168.1.30 dst=162.159.1.1 sport=50000 "
+        "dport=50001 packets=900 bytes=90000 src=162.159.1.1 dst=192.168.1.30 "
+        "sport=50001 dport=50000 packets=800 bytes=80000 [ASSURED] mark=4294967295 "
+        "zone=0 use=2\n";
+    static const char *unmarked =
+        "ipv4     2 tcp      6 60 SYN_SENT src=10.0.0.2 dst=10.0.0.3 sport=1 "
+        "dport=2 packets=1 bytes=60 src=10.0.0.3 dst=10.0.0.2 sport=2 dport=1 "
+        "packets=0 bytes=0 zone=0 use=2\n";
+    ct_record_t r;
+    mu_assert("error, marked line should parse",
+              ct_parse_line(marked, strlen(marked), &r) == 0);
+    mu_assert("error, full 32-bit mark", r.has_mark == 1 && r.mark == 0xFFFFFFFFu);
+    mu_assert("error, counters survive mark parse", r.rx_bytes == 80000);
+    mu_assert("error, kernel without marks",
+              ct_parse_line(unmarked, strlen(unmarked), &r) == 0 && r.has_mark == 0);
+    return 0;
+}
+
+static char *test_ctparse_udp_no_counters() {
+    ct_record_t r;
+    mu_assert("error, udp line should parse",
+              ct_parse_line(UDP_LINE, strlen(UDP_LINE), &r) == 0);
+    mu_assert("error, proto udp", r.key.protocol == 17);
+    mu_assert("error, dport 53", r.key.dst_port == 53);
+    mu_assert("error, no accounting → zero bytes", r.tx_bytes == 0 && r.rx_bytes == 0);
+    return 0;
+}
+
+static char *test_ctparse_rejects() {
+    ct_record_t r;
+    mu_assert("error, ipv6 must be skipped",
+              ct_parse_line(V6_LINE, strlen(V6_LINE), &r) == -1);
+    mu_assert("error, icmp must be skipped",
+              ct_parse_line(ICMP_LINE, strlen(ICMP_LINE), &r) == -1);
+    const char *bad = "ipv4 2 tcp 6 10 src=300.1.1.1 dst=1.1.1.1 sport=1 dport=2\n";
+    mu_assert("error, bad octet must be rejected",
+              ct_parse_line(bad, strlen(bad), &r) == -1);
+    return 0;
+}
+
+static char *test_ctparse_buf_mixed() {
+    char buf[2048];
+    snprintf(buf, sizeof(buf), "%s%s%s%s", TCP_LINE, V6_LINE, UDP_LINE, ICMP_LINE);
+    int n = 0;
+    mu_assert("error, buf should yield 2 records",
+              ct_parse_buf(buf, strlen(buf), count_cb, &n) == 2);
+    mu_assert("error, cb called twice", n == 2);
+    return 0;
+}
+
+/* ── Streaming across block boundaries ─────────────────────── */
+static char *test_ctparse_fd_small_blocks() {
+    char path[] = "/tmp/test_ctparse_XXXXXX";
+    int fd = mkstemp(path);
+    mu_assert("error, mkstemp", fd >= 0);
+    const int lines = 500;
+    for (int i = 0; i < lines; i++) {
+        const char *l = (i % 3 == 2) ? V6_LINE : (i % 2 ? UDP_LINE : TCP_LINE);
+        if (write(fd, l, strlen(l)) < 0) break;
+    }
+    /* Final line without trailing newline. */
+    if (write(fd, TCP_LINE, strlen(TCP_LINE) - 1) < 0) { close(fd); return "error, write"; }
+
+    int expected = 0;
+    for (int i = 0; i < lines; i++) if (i % 3 != 2) expected++;
+    expected++;
+
+    /* 300 B is just over one line: nearly every line straddles a block. */
+    size_t caps[] = { 300, 1000, 4096, CT_PARSE_BLOCK };
+    for (size_t c = 0; c < sizeof(caps) / sizeof(caps[0]); c++) {
+        char *buf = malloc(caps[c]);
+        int n = 0;
+        lseek(fd, 0, SEEK_SET);
+        int got = ct_parse_fd(fd, buf, caps[c], count_cb, &n);
+        free(buf);
+        if (got != expected || n != expected) {
+            close(fd);
+            unlink(path);
+            return "error, record count differs with block size";
+        }
+    }
+    close(fd);
+    unlink(path);
+    return 0;
+}
+
+static char *test_ctparse_fd_long_line_skipped() {
+    char path[] = "/tmp/test_ctparse_XXXXXX";
+    int fd = mkstemp(path);
+    mu_assert("error, mkstemp", fd >= 0);
+    char junk[700];
+    memset(junk, 'x', sizeof(junk) - 1);
+    junk[sizeof(junk) - 1] = '\n';
+    if (write(fd, TCP_LINE, strlen(TCP_LINE)) < 0 ||
+        write(fd, junk, sizeof(junk)) < 0 ||
+        write(fd, UDP_LINE, strlen(UDP_LINE)) < 0) {
+        close(fd);
+        return "error, write";
+    }
+    char buf[256 + 64];
+    int n = 0;
+    lseek(fd, 0, SEEK_SET);
+    int got = ct_parse_fd(fd, buf, sizeof(buf), count_cb, &n);
+    close(fd);
+    unlink(path);
+    mu_assert("error, over-long line should be skipped, neighbours kept", got == 2);
+    return 0;
+}
+
+static char *all_tests() {
+    mu_run_test(test_ctparse_tcp_line);
+    mu_run_test(test_ctparse_mark);
+    mu_run_test(test_ctparse_udp_no_counters);
+    mu_run_test(test_ctparse_rejects);
+    mu_run_test(test_ctparse_buf_mixed);
+    mu_run_test(test_ctparse_fd_small_blocks);
+    mu_run_test(test_ctparse_fd_long_line_skipped);
+    return 0;
+}
+
+int main(int argc, char **argv) {
+    (void)argc; (void)argv;
+    char *result = all_tests();
+    if (result != 0) {
+        printf("FAILED: %s\n", result);
+    } else {
+        printf("ALL TESTS PASSED\n");
+    }
+    printf("Tests run: %d\n", tests_run);
+    return result != 0;
+}
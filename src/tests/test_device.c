@@ -4,10 +4,12 @@
 #include <stdio.h>
 #include <string.h>
 #include <arpa/inet.h>
+#include <time.h>
 #include "../minunit.h"
 #include "../myco_types.h"
 #include "../myco_device.h"
 #include "../myco_flow.h"
+#include "../myco_dns.h"
 
 int tests_run = 0;
 
@@ -72,6 +74,7 @@ static char *test_device_aggregation() {
     mu_assert("error, device B avg_pkt_size should be ~1500", dev_b->avg_pkt_size > 1000.0);
     mu_assert("error, device B should have elephant flow", dev_b->elephant_flow == 1);
 
+    flow_table_free(&ft);
     return 0;
 }
 
@@ -95,6 +98,7 @@ static char *test_device_tx_rx_aggregation() {
     mu_assert("error, device C rx_bytes should be 5000000", dev_c->rx_bytes == 5000000);
     mu_assert("error, device C tx_rx_ratio should be < 0.25", dev_c->tx_rx_ratio < 0.25);
 
+    flow_table_free(&ft);
     return 0;
 }
 
@@ -129,6 +133,7 @@ static char *test_device_avg_pkt_bidir() {
     /* Sanity: should be roughly 1350B */
     mu_assert("error, download avg_pkt should be < 2000B", dev->avg_pkt_size < 2000.0);
 
+    flow_table_free(&ft);
     return 0;
 }
 
@@ -162,6 +167,7 @@ static char *test_device_persona_inference() {
     mu_assert("error, device A should be GAMING", dev_a->persona == PERSONA_GAMING);
     mu_assert("error, device B should be BULK",   dev_b->persona == PERSONA_BULK);
 
+    flow_table_free(&ft);
     return 0;
 }
 
@@ -180,6 +186,7 @@ static char *test_device_eviction() {
     device_table_evict_stale(&dt, 1200.0, 120.0);
     mu_assert("error, device should be evicted", dt.count == 0);
 
+    flow_table_free(&ft);
     return 0;
 }
 
@@ -213,6 +220,7 @@ static char *test_hint_gaming_riot_ports() {
     mu_assert("hint_riot: GAMING votes should be 3",
               dev->hint_votes[PERSONA_GAMING] == 3);
 
+    flow_table_free(&ft);
     return 0;
 }
 
@@ -239,6 +247,7 @@ static char *test_hint_priority_tiebreak() {
     mu_assert("hint_tie: dominant_hint should be VOIP (priority tiebreak)",
               dev->dominant_hint == PERSONA_VOIP);
 
+    flow_table_free(&ft);
     return 0;
 }
 
@@ -262,6 +271,50 @@ static char *test_hint_no_hint_port443() {
               dev->dominant_hint == PERSONA_UNKNOWN);
     mu_assert("hint_443: has_hint should be 0", dev->has_hint == 0);
 
+    flow_table_free(&ft);
+    return 0;
+}
+
+/* ── DNS resolves 443, across more flows than one batch read ── */
+static char *test_hint_dns_batch_port443() {
+    device_table_t dt;
+    static flow_table_t ft;
+    device_table_init(&dt);
+    flow_table_init(&ft);
+    dns_cache_t dns;
+    dns_cache_init(&dns);
+
+    /* Cache expiry runs on CLOCK_MONOTONIC, like the main loop's `now`. */
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    double now = (double)ts.tv_sec;
+
+    uint32_t zoom_ip;
+    inet_pton(AF_INET, "170.114.0.1", &zoom_ip);
+    dns_cache_insert(&dns, zoom_ip, "zoom.us", 300);
+    persona_t want = dns_cache_lookup(&dns, zoom_ip);
+    mu_assert("hint_dns: zoom.us carries a hint", want != PERSONA_UNKNOWN);
+
+    /* 70 zoom flows on 443 interleaved with 70 uncached 443 flows from
+     * a second device: the queue flushes mid-scan and at the end. */
+    for (int i = 0; i < 70; i++) {
+        add_flow(&ft, "192.168.1.90", "170.114.0.1", (uint16_t)(41000 + i), 443, 17,
+                 50, 5000, 5000, now);
+        add_flow(&ft, "192.168.1.91", "1.2.3.4", (uint16_t)(42000 + i), 443, 6,
+                 50, 5000, 5000, now);
+    }
+
+    device_table_aggregate(&dt, &ft, now, &dns);
+
+    device_entry_t *a = find_dev(&dt, "192.168.1.90");
+    device_entry_t *b = find_dev(&dt, "192.168.1.91");
+    mu_assert("hint_dns: devices found", a != NULL && b != NULL);
+    mu_assert("hint_dns: every zoom flow voted", a->hint_votes[(int)want] == 70);
+    mu_assert("hint_dns: dominant_hint from DNS", a->dominant_hint == want && a->has_hint);
+    mu_assert("hint_dns: uncached 443 stays UNKNOWN", b->dominant_hint == PERSONA_UNKNOWN);
+
+    dns_cache_destroy(&dns);
+    flow_table_free(&ft);
     return 0;
 }
 
@@ -299,6 +352,7 @@ static char *test_hint_lol_persona_integration() {
     mu_assert("lol_fix: persona should be GAMING (not BULK!)",
               dev->persona == PERSONA_GAMING);
 
+    flow_table_free(&ft);
     return 0;
 }
 
@@ -314,6 +368,7 @@ static char *all_tests() {
     mu_run_test(test_hint_gaming_riot_ports);
     mu_run_test(test_hint_priority_tiebreak);
     mu_run_test(test_hint_no_hint_port443);
+    mu_run_test(test_hint_dns_batch_port443);
     mu_run_test(test_hint_lol_persona_integration);
     return 0;
 }
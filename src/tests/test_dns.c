@@ -6,6 +6,9 @@
 #include <signal.h>
 #include <arpa/inet.h>
 #include <time.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/socket.h>
 #include "../minunit.h"
 #include "../myco_types.h"
 #include "../myco_dns.h"
@@ -142,6 +145,31 @@ static char *test_domain_no_partial_match() {
     return 0;
 }
 
+static char *test_domain_longest_suffix_wins() {
+    /* "ubuntu.com" is listed before "connectivity-check.ubuntu.com";
+     * the more specific suffix must still win. */
+    mu_assert("connectivity-check.ubuntu.com → SYSTEM",
+              dns_domain_to_service("connectivity-check.ubuntu.com") == SVC_SYSTEM);
+    mu_assert("x.connectivity-check.ubuntu.com → SYSTEM",
+              dns_domain_to_service("x.connectivity-check.ubuntu.com") == SVC_SYSTEM);
+    mu_assert("releases.ubuntu.com → BULK_DL",
+              dns_domain_to_service("releases.ubuntu.com") == SVC_BULK_DL);
+    mu_assert("bare TLD → UNKNOWN", dns_domain_to_service("com") == SVC_UNKNOWN);
+    return 0;
+}
+
+static char *test_domain_case_and_trailing_dot() {
+    mu_assert("mixed case → VOD",
+              dns_domain_to_service("RR1---SN-ABC.GoogleVideo.COM") == SVC_VIDEO_VOD);
+    mu_assert("fully qualified → STREAMING",
+              dns_domain_to_hint("rr1.googlevideo.com.") == PERSONA_STREAMING);
+    mu_assert("table entry with capitals (miHoYo.com) → GAME_RT",
+              dns_domain_to_service("sdk.mihoyo.com") == SVC_GAME_RT);
+    mu_assert("empty label → UNKNOWN",
+              dns_domain_to_service("googlevideo..com") == SVC_UNKNOWN);
+    return 0;
+}
+
 /* ══════════════════════════════════════════════════════════════
  * DNS CACHE TESTS
  * ══════════════════════════════════════════════════════════════ */
@@ -201,23 +229,187 @@ static char *test_cache_fill_eviction() {
     dns_cache_t cache;
     dns_cache_init(&cache);
 
-    /* Fill all 64 slots */
+    /* Fill every entry */
     for (int i = 0; i < DNS_CACHE_SIZE; i++) {
-        uint32_t ip = htonl(0x0A000001 + (uint32_t)i);  /* 10.0.0.1 .. 10.0.0.64 */
+        uint32_t ip = htonl(0x0A000001 + (uint32_t)i);  /* 10.0.0.1 .. */
         dns_cache_insert(&cache, ip, "example.com", 300);
     }
+    mu_assert("cache: filled to capacity", cache.count == DNS_CACHE_SIZE);
 
-    /* Insert one more — should evict LRU */
-    uint32_t new_ip = htonl(0x0A000100);  /* 10.0.1.0 */
+    /* Insert one more — should evict the entry closest to expiry */
+    uint32_t new_ip = htonl(0x0B000100);
     dns_cache_insert(&cache, new_ip, "rr1.googlevideo.com", 300);
 
     mu_assert("cache: new entry after eviction → STREAMING",
               dns_cache_lookup(&cache, new_ip) == PERSONA_STREAMING);
+    mu_assert("cache: count stays at capacity", cache.count == DNS_CACHE_SIZE);
+
+    dns_cache_destroy(&cache);
+    return 0;
+}
+
+static char *test_cache_evicts_earliest_expiry() {
+    dns_cache_t cache;
+    dns_cache_init_sized(&cache, DNS_CACHE_MIN_SIZE);
+
+    /* Long TTLs everywhere except one IP in the middle. */
+    uint32_t short_ip = htonl(0x0A000020);
+    for (int i = 0; i < DNS_CACHE_MIN_SIZE; i++) {
+        uint32_t ip = htonl(0x0A000001 + (uint32_t)i);
+        dns_cache_insert(&cache, ip, "rr1.googlevideo.com", ip == short_ip ? 60 : 3000);
+    }
+    uint32_t new_ip = htonl(0x0B000001);
+    dns_cache_insert(&cache, new_ip, "zoom.us", 3000);
+
+    mu_assert("cache: short-TTL entry evicted",
+              dns_cache_lookup(&cache, short_ip) == PERSONA_UNKNOWN);
+    mu_assert("cache: newcomer present",
+              dns_cache_lookup_service(&cache, new_ip) == SVC_VIDEO_CONF);
+    int survivors = 0;
+    for (int i = 0; i < DNS_CACHE_MIN_SIZE; i++) {
+        uint32_t ip = htonl(0x0A000001 + (uint32_t)i);
+        if (dns_cache_lookup(&cache, ip) == PERSONA_STREAMING) survivors++;
+    }
+    mu_assert("cache: every long-TTL entry survives", survivors == DNS_CACHE_MIN_SIZE - 1);
 
     dns_cache_destroy(&cache);
     return 0;
 }
 
+static char *test_cache_large_capacity() {
+    dns_cache_t cache;
+    mu_assert("cache: 10k init", dns_cache_init_sized(&cache, 10000) == 0);
+    for (uint32_t i = 0; i < 10000; i++) {
+        dns_cache_insert(&cache, htonl(0x0A000000u + i), "rr1.googlevideo.com", 300);
+    }
+    int hits = 0;
+    for (uint32_t i = 0; i < 10000; i++) {
+        if (dns_cache_lookup_service(&cache, htonl(0x0A000000u + i)) == SVC_VIDEO_VOD) hits++;
+    }
+    mu_assert("cache: all 10k IPs resident", hits == 10000);
+    mu_assert("cache: 3/4 load bound", cache.count * 4 <= cache.slots * 3);
+    dns_cache_destroy(&cache);
+    return 0;
+}
+
+/* The batch read agrees with single lookups across chunk boundaries,
+ * honours the caller's clock for expiry and tolerates NULL outputs. */
+static char *test_cache_lookup_batch() {
+    dns_cache_t cache;
+    dns_cache_init_sized(&cache, 256);
+    uint32_t ips[100];
+    for (uint32_t i = 0; i < 100; i++) {
+        ips[i] = htonl(0x0A000000u + i);
+        if (i % 3 != 2) {   /* every third IP stays a miss */
+            dns_cache_insert(&cache, ips[i], (i & 1) ? "zoom.us" : "rr1.googlevideo.com", 300);
+        }
+    }
+
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    double now = (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+
+    persona_t hints[100];
+    service_t services[100];
+    dns_cache_lookup_batch(&cache, ips, 100, now, hints, services);
+    for (uint32_t i = 0; i < 100; i++) {
+        mu_assert("batch: service matches single lookup",
+                  services[i] == dns_cache_lookup_service(&cache, ips[i]));
+        mu_assert("batch: hint matches single lookup",
+                  hints[i] == dns_cache_lookup(&cache, ips[i]));
+    }
+    mu_assert("batch: hit resolved", services[0] == SVC_VIDEO_VOD && services[1] == SVC_VIDEO_CONF);
+    mu_assert("batch: miss is unknown", services[2] == SVC_UNKNOWN && hints[2] == PERSONA_UNKNOWN);
+
+    dns_cache_lookup_batch(&cache, ips, 100, now + 301.0, NULL, services);
+    int live = 0;
+    for (uint32_t i = 0; i < 100; i++) live += services[i] != SVC_UNKNOWN;
+    mu_assert("batch: entries past the caller's now are expired", live == 0);
+
+    dns_cache_lookup_batch(NULL, ips, 3, now, hints, NULL);
+    mu_assert("batch: NULL cache yields unknown", hints[0] == PERSONA_UNKNOWN);
+    dns_cache_lookup_batch(&cache, ips, 0, now, NULL, NULL);
+    dns_cache_destroy(&cache);
+    return 0;
+}
+
+static char *test_cache_change_log() {
+    dns_cache_t cache;
+    dns_cache_init_sized(&cache, 1024);
+    uint64_t cursor = 0;
+    uint32_t ips[DNS_CHANGE_LOG];
+    uint32_t a = htonl(0x0A000001u), b = htonl(0x0A000002u);
+
+    dns_cache_insert(&cache, a, "rr1.googlevideo.com", 300);
+    dns_cache_insert(&cache, b, "example.com", 300);   /* no hint: not logged */
+    int n = dns_cache_changes_since(&cache, &cursor, ips, DNS_CHANGE_LOG);
+    mu_assert("changes: new hinted IP logged", n == 1 && ips[0] == a);
+    mu_assert("changes: drained", dns_cache_changes_since(&cache, &cursor, ips, DNS_CHANGE_LOG) == 0);
+
+    dns_cache_insert(&cache, a, "r2.googlevideo.com", 300);  /* same service */
+    mu_assert("changes: refresh not logged",
+              dns_cache_changes_since(&cache, &cursor, ips, DNS_CHANGE_LOG) == 0);
+    dns_cache_insert(&cache, a, "zoom.us", 300);
+    n = dns_cache_changes_since(&cache, &cursor, ips, DNS_CHANGE_LOG);
+    mu_assert("changes: service flip logged", n == 1 && ips[0] == a);
+
+    for (uint32_t i = 0; i < DNS_CHANGE_LOG + 1; i++) {
+        dns_cache_insert(&cache, htonl(0x0B000000u + i), "zoom.us", 300);
+    }
+    mu_assert("changes: overrun reported",
+              dns_cache_changes_since(&cache, &cursor, ips, DNS_CHANGE_LOG) == -1);
+    mu_assert("changes: cursor caught up",
+              dns_cache_changes_since(&cache, &cursor, ips, DNS_CHANGE_LOG) == 0);
+    dns_cache_destroy(&cache);
+    return 0;
+}
+
+/* Reader runs lock-free against a writer churning the table. Every IP
+ * is always inserted with the same domain, so a reader may see a miss
+ * but must never see the wrong service. */
+typedef struct {
+    dns_cache_t *cache;
+    volatile int done;
+    int bad;
+    long reads;
+} seqlock_ctx_t;
+
+static void *seqlock_reader(void *arg) {
+    seqlock_ctx_t *ctx = arg;
+    uint32_t i = 0;
+    while (!ctx->done) {
+        uint32_t n = i++ % 4096;
+        service_t want = (n & 1) ? SVC_VIDEO_CONF : SVC_VIDEO_VOD;
+        service_t got = dns_cache_lookup_service(ctx->cache, htonl(0x0A000000u + n));
+        if (got != SVC_UNKNOWN && got != want) ctx->bad++;
+        ctx->reads++;
+    }
+    return NULL;
+}
+
+static char *test_cache_concurrent_readers() {
+    dns_cache_t cache;
+    dns_cache_init_sized(&cache, 1024);
+    seqlock_ctx_t ctx = { &cache, 0, 0, 0 };
+    pthread_t rd;
+    mu_assert("cache: reader thread", pthread_create(&rd, NULL, seqlock_reader, &ctx) == 0);
+
+    for (int round = 0; round < 50; round++) {
+        for (uint32_t n = 0; n < 4096; n++) {
+            dns_cache_insert(&cache, htonl(0x0A000000u + n),
+                             (n & 1) ? "zoom.us" : "rr1.googlevideo.com",
+                             (uint32_t)(30 + (n * 7 + (uint32_t)round) % 600));
+        }
+    }
+    ctx.done = 1;
+    pthread_join(rd, NULL);
+
+    mu_assert("cache: reader never saw a torn entry", ctx.bad == 0);
+    mu_assert("cache: reader made progress", ctx.reads > 0);
+    dns_cache_destroy(&cache);
+    return 0;
+}
+
 /* ══════════════════════════════════════════════════════════════
  * DNS PARSER TESTS
  * ══════════════════════════════════════════════════════════════ */
@@ -506,6 +698,84 @@ static char *test_svc_cache_lookup() {
     return 0;
 }
 
+/* ══════════════════════════════════════════════════════════════
+ * SOCKET FILTER TESTS
+ * The classic BPF program runs the same on any socket type; an
+ * AF_UNIX datagram pair delivers our buffer verbatim at offset 0, just
+ * like cooked AF_PACKET delivers the IP header. No privileges needed.
+ * ══════════════════════════════════════════════════════════════ */
+
+/* IPv4 (IHL 5) + UDP header, zero payload padding up to `len`. */
+static size_t build_ip_udp(uint8_t *buf, size_t len, uint8_t proto,
+                           uint16_t frag_off, uint16_t sport) {
+    memset(buf, 0, len);
+    buf[0] = 0x45;
+    buf[6] = (uint8_t)(frag_off >> 8);
+    buf[7] = (uint8_t)(frag_off & 0xFF);
+    buf[9] = proto;
+    buf[20] = (uint8_t)(sport >> 8);
+    buf[21] = (uint8_t)(sport & 0xFF);
+    buf[22] = 0x9C;   /* dport 40000 */
+    buf[23] = 0x40;
+    return len;
+}
+
+/* Send one packet through the filtered pair; returns bytes received,
+ * 0 when the filter dropped it. */
+static ssize_t filter_roundtrip(int sv[2], const uint8_t *pkt, size_t len) {
+    static uint8_t rx[4096];
+    if (send(sv[0], pkt, len, 0) < 0) return -1;
+    ssize_t n = recv(sv[1], rx, sizeof(rx), MSG_DONTWAIT);
+    return n < 0 ? 0 : n;
+}
+
+static char *test_filter_accepts_dns_only() {
+    int sv[2];
+    mu_assert("socketpair", socketpair(AF_UNIX, SOCK_DGRAM, 0, sv) == 0);
+    dns_sniff_set_mdns(0);
+    mu_assert("filter attaches", dns_sniff_attach_filter(sv[1]) == 0);
+
+    uint8_t pkt[200];
+    mu_assert("UDP sport 53 accepted",
+              filter_roundtrip(sv, pkt, build_ip_udp(pkt, 100, 17, 0, 53)) == 100);
+    mu_assert("first fragment (MF set) accepted",
+              filter_roundtrip(sv, pkt, build_ip_udp(pkt, 100, 17, 0x2000, 53)) == 100);
+    mu_assert("UDP sport 443 dropped",
+              filter_roundtrip(sv, pkt, build_ip_udp(pkt, 100, 17, 0, 443)) == 0);
+    mu_assert("TCP sport 53 dropped",
+              filter_roundtrip(sv, pkt, build_ip_udp(pkt, 100, 6, 0, 53)) == 0);
+    mu_assert("non-first fragment dropped",
+              filter_roundtrip(sv, pkt, build_ip_udp(pkt, 100, 17, 0x00B9, 53)) == 0);
+    mu_assert("mDNS dropped when off",
+              filter_roundtrip(sv, pkt, build_ip_udp(pkt, 100, 17, 0, 5353)) == 0);
+    mu_assert("truncated header dropped",
+              filter_roundtrip(sv, pkt, build_ip_udp(pkt, 21, 17, 0, 53)) == 0);
+
+    close(sv[0]);
+    close(sv[1]);
+    return 0;
+}
+
+static char *test_filter_mdns_and_snaplen() {
+    int sv[2];
+    mu_assert("socketpair", socketpair(AF_UNIX, SOCK_DGRAM, 0, sv) == 0);
+    dns_sniff_set_mdns(1);
+    mu_assert("filter attaches", dns_sniff_attach_filter(sv[1]) == 0);
+    dns_sniff_set_mdns(0);
+
+    static uint8_t big[3000];
+    mu_assert("mDNS accepted when on",
+              filter_roundtrip(sv, big, build_ip_udp(big, 100, 17, 0, 5353)) == 100);
+    mu_assert("DNS still accepted",
+              filter_roundtrip(sv, big, build_ip_udp(big, 100, 17, 0, 53)) == 100);
+    mu_assert("oversized answer truncated to snaplen",
+              filter_roundtrip(sv, big, build_ip_udp(big, sizeof(big), 17, 0, 53)) == DNS_SNAPLEN);
+
+    close(sv[0]);
+    close(sv[1]);
+    return 0;
+}
+
 /* ══════════════════════════════════════════════════════════════ */
 
 static char *all_tests() {
@@ -530,12 +800,19 @@ static char *all_tests() {
     mu_run_test(test_domain_unknown_empty);
     mu_run_test(test_domain_exact_match);
     mu_run_test(test_domain_no_partial_match);
+    mu_run_test(test_domain_longest_suffix_wins);
+    mu_run_test(test_domain_case_and_trailing_dot);
 
     /* Cache tests */
     mu_run_test(test_cache_insert_lookup);
     mu_run_test(test_cache_miss);
     mu_run_test(test_cache_update);
     mu_run_test(test_cache_fill_eviction);
+    mu_run_test(test_cache_evicts_earliest_expiry);
+    mu_run_test(test_cache_large_capacity);
+    mu_run_test(test_cache_lookup_batch);
+    mu_run_test(test_cache_change_log);
+    mu_run_test(test_cache_concurrent_readers);
 
     /* Service (v3 finer-grained) tests */
     mu_run_test(test_svc_vod_googlevideo);
@@ -564,6 +841,10 @@ static char *all_tests() {
     mu_run_test(test_parser_zoom_response);
     mu_run_test(test_parser_riot_response);
 
+    /* Socket filter tests */
+    mu_run_test(test_filter_accepts_dns_only);
+    mu_run_test(test_filter_mdns_and_snaplen);
+
     return 0;
 }
 
@@ -0,0 +1,315 @@
+/*
+ * test_flow.c - Unit tests for the flow table and conntrack ingestion source
+ */
+#include <stdio.h>
+#include <string.h>
+#include <arpa/inet.h>
+#include "../minunit.h"
+#include "../myco_flow.h"
+
+int tests_run = 0;
+
+static flow_key_t make_key(uint32_t n) {
+    flow_key_t key;
+    memset(&key, 0, sizeof(key));
+    key.src_ip   = htonl(0xC0A80100u | (n & 0xFFu));   /* 192.168.1.x */
+    key.dst_ip   = htonl(0x0A000000u | (n >> 8));      /* 10.0.0.x    */
+    key.src_port = (uint16_t)(30000 + n);
+    key.dst_port = 443;
+    key.protocol = 6;
+    return key;
+}
+
+/* ── Insert / update ───────────────────────────────────────── */
+static char *test_flow_update_delta() {
+    static flow_table_t ft;
+    flow_table_init(&ft);
+    flow_key_t k = make_key(1);
+
+    flow_table_update(&ft, &k, 10, 5, 1000, 500, 1.0);
+    const flow_entry_t *e = flow_table_lookup(&ft, &k);
+    mu_assert("error, inserted flow not found", e != NULL);
+    mu_assert("error, new flow should be hot", e->hot == 1);
+    mu_assert("error, first tx_delta is the full counter", e->tx_delta == 1000);
+
+    flow_table_update(&ft, &k, 12, 6, 1400, 500, 2.0);
+    mu_assert("error, tx_delta should be 400", e->tx_delta == 400);
+    mu_assert("error, rx_delta should be 0", e->rx_delta == 0);
+    mu_assert("error, moving flow stays hot", e->hot == 1);
+
+    flow_table_update(&ft, &k, 12, 6, 1400, 500, 3.0);
+    mu_assert("error, idle flow should go cold", e->hot == 0);
+    mu_assert("error, count should be 1", flow_table_active_count(&ft) == 1);
+    flow_table_free(&ft);
+    return 0;
+}
+
+/* ── Touch ─────────────────────────────────────────────────── */
+static char *test_flow_touch() {
+    static flow_table_t ft;
+    flow_table_init(&ft);
+    flow_key_t k = make_key(2);
+
+    flow_table_touch(&ft, &k, 5.0);
+    const flow_entry_t *e = flow_table_lookup(&ft, &k);
+    mu_assert("error, touch should insert unknown flow", e != NULL);
+    mu_assert("error, touched flow has zero counters", e->bytes == 0);
+
+    flow_table_update(&ft, &k, 1, 1, 100, 100, 6.0);
+    flow_table_update(&ft, &k, 1, 1, 100, 100, 7.0);
+    mu_assert("error, flow should be cold", e->hot == 0);
+    flow_table_touch(&ft, &k, 8.0);
+    mu_assert("error, touch should re-heat", e->hot == 1);
+    mu_assert("error, touch should refresh last_seen", e->last_seen == 8.0);
+    mu_assert("error, touch must not reset counters", e->bytes == 100);
+    mu_assert("error, touch must not duplicate", flow_table_active_count(&ft) == 1);
+    flow_table_free(&ft);
+    return 0;
+}
+
+/* ── Remove keeps probe chains intact ──────────────────────── */
+static char *test_flow_remove_chains() {
+    static flow_table_t ft;
+    flow_table_init(&ft);
+    const int n = 880;   /* ~86% load — long clusters */
+
+    for (int i = 0; i < n; i++) {
+        flow_key_t k = make_key((uint32_t)i);
+        flow_table_update(&ft, &k, 1, 1, 100, 100, 1.0);
+    }
+    mu_assert("error, all flows inserted", flow_table_active_count(&ft) == n);
+
+    for (int i = 0; i < n; i += 2) {
+        flow_key_t k = make_key((uint32_t)i);
+        mu_assert("error, remove of present key failed", flow_table_remove(&ft, &k) == 0);
+    }
+    mu_assert("error, half should remain", flow_table_active_count(&ft) == n / 2);
+
+    for (int i = 0; i < n; i++) {
+        flow_key_t k = make_key((uint32_t)i);
+        const flow_entry_t *e = flow_table_lookup(&ft, &k);
+        if (i % 2 == 0) {
+            mu_assert("error, removed key still found", e == NULL);
+        } else {
+            mu_assert("error, surviving key lost after removals", e != NULL);
+        }
+    }
+
+    flow_key_t gone = make_key(0);
+    mu_assert("error, double remove should fail", flow_table_remove(&ft, &gone) == -1);
+    flow_table_free(&ft);
+    return 0;
+}
+
+/* ── Stale eviction must not orphan later entries ─────────── */
+static char *test_flow_evict_stale_chains() {
+    static flow_table_t ft;
+    flow_table_init(&ft);
+    const int n = 800;
+
+    /* Interleave old and fresh flows so clusters mix both. */
+    for (int i = 0; i < n; i++) {
+        flow_key_t k = make_key((uint32_t)i);
+        flow_table_update(&ft, &k, 1, 1, 100, 100, (i % 3 == 0) ? 1.0 : 100.0);
+    }
+    flow_table_evict_stale(&ft, 100.0, 60.0);
+
+    int expected = 0;
+    for (int i = 0; i < n; i++) {
+        flow_key_t k = make_key((uint32_t)i);
+        const flow_entry_t *e = flow_table_lookup(&ft, &k);
+        if (i % 3 == 0) {
+            mu_assert("error, stale flow survived eviction", e == NULL);
+        } else {
+            mu_assert("error, fresh flow unreachable after eviction", e != NULL);
+            expected++;
+        }
+    }
+    mu_assert("error, count mismatch after eviction", flow_table_active_count(&ft) == expected);
+
+    /* Re-updating a survivor must not create a duplicate. */
+    flow_key_t k = make_key(1);
+    flow_table_update(&ft, &k, 2, 2, 200, 200, 101.0);
+    mu_assert("error, duplicate inserted", flow_table_active_count(&ft) == expected);
+    flow_table_free(&ft);
+    return 0;
+}
+
+/* ── At the ceiling: bounded eviction, flat probe lengths ──── */
+static char *test_flow_full_table_churn() {
+    static flow_table_t ft;
+    flow_table_init_sized(&ft, 1024);
+
+    /* Four budgets' worth of distinct flows, newest last. */
+    const int n = 1024 * 4;
+    for (int i = 0; i < n; i++) {
+        flow_key_t k = make_key((uint32_t)i);
+        flow_table_update(&ft, &k, 1, 1, 100, 100, (double)i);
+    }
+    mu_assert("error, table should have grown to its ceiling",
+              ft.capacity == ft.max_capacity);
+    mu_assert("error, count must stay at max load",
+              flow_table_active_count(&ft) <= (int)FLOW_TABLE_MAX_LOAD(ft.capacity));
+    mu_assert("error, evictions should have happened", ft.evictions > 0);
+
+    /* Every resident is reachable and unique. */
+    int reachable = 0;
+    uint32_t it = 0;
+    const flow_entry_t *fe;
+    while ((fe = flow_table_next(&ft, &it)) != NULL) {
+        mu_assert("error, resident unreachable", flow_table_lookup(&ft, &fe->key) == fe);
+        reachable++;
+    }
+    mu_assert("error, reachable != count", reachable == flow_table_active_count(&ft));
+
+    /* The newest flow must be tracked. */
+    flow_key_t newest = make_key((uint32_t)(n - 1));
+    mu_assert("error, newest flow evicted", flow_table_lookup(&ft, &newest) != NULL);
+
+    flow_probe_stats_t st;
+    flow_table_probe_stats(&ft, &st);
+    mu_assert("error, stats count", st.count == flow_table_active_count(&ft));
+    mu_assert("error, stats capacity", st.capacity == (int)ft.capacity);
+    mu_assert("error, max probe over bound", st.max_probe <= FLOW_MAX_PROBE);
+    mu_assert("error, mean probe should stay small", st.mean_probe < 4.0);
+    uint32_t hist_total = 0;
+    for (int b = 0; b < FLOW_PROBE_HIST; b++) hist_total += st.hist[b];
+    mu_assert("error, histogram total", (int)hist_total == st.count);
+    flow_table_free(&ft);
+    return 0;
+}
+
+/* ── Incremental grow and shrink keep every flow reachable ──── */
+static char *test_flow_grow_shrink() {
+    static flow_table_t ft;
+    flow_table_init_sized(&ft, 8192);
+    mu_assert("error, starts at min capacity", ft.capacity == FLOW_TABLE_MIN_CAPACITY);
+
+    const int n = 6000;
+    int saw_resizing = 0;
+    for (int i = 0; i < n; i++) {
+        flow_key_t k = make_key((uint32_t)i);
+        flow_table_update(&ft, &k, 1, 1, 100, 100, 1.0);
+        if (ft.old_entries) {
+            saw_resizing = 1;
+            /* Mid-migration: the oldest flow and this one both resolve. */
+            flow_key_t first = make_key(0);
+            mu_assert("error, lookup missed during migration",
+                      flow_table_lookup(&ft, &first) != NULL &&
+                      flow_table_lookup(&ft, &k) != NULL);
+        }
+    }
+    mu_assert("error, migration never observed", saw_resizing);
+    mu_assert("error, no flow may be evicted below the ceiling", ft.evictions == 0);
+    mu_assert("error, all flows tracked", flow_table_active_count(&ft) == n);
+    mu_assert("error, grew past 6000/0.875", ft.capacity >= 8192);
+    for (int i = 0; i < n; i++) {
+        flow_key_t k = make_key((uint32_t)i);
+        mu_assert("error, flow lost across grow", flow_table_lookup(&ft, &k) != NULL);
+    }
+
+    /* Keep 100 flows fresh, let the rest age out; each tick shrinks. */
+    for (int i = 0; i < 100; i++) {
+        flow_key_t k = make_key((uint32_t)i);
+        flow_table_update(&ft, &k, 2, 2, 200, 200, 100.0);
+    }
+    for (int tick = 0; tick < 64; tick++) {
+        flow_table_evict_stale(&ft, 100.0, 60.0);
+    }
+    mu_assert("error, count after ageing", flow_table_active_count(&ft) == 100);
+    mu_assert("error, table should shrink back", ft.capacity == FLOW_TABLE_MIN_CAPACITY);
+    mu_assert("error, migration should be done", ft.old_entries == NULL);
+    for (int i = 0; i < 100; i++) {
+        flow_key_t k = make_key((uint32_t)i);
+        mu_assert("error, survivor lost across shrink", flow_table_lookup(&ft, &k) != NULL);
+    }
+    flow_table_free(&ft);
+    return 0;
+}
+
+/* ── Budget derivation ─────────────────────────────────────── */
+static char *test_flow_budget() {
+    uint32_t auto_max = flow_table_auto_max_flows();
+    mu_assert("error, auto budget must be positive", auto_max > 0);
+    mu_assert("error, auto budget within ceiling",
+              auto_max <= FLOW_TABLE_MAX_LOAD(FLOW_TABLE_MAX_CAPACITY));
+
+    static flow_table_t ft;
+    flow_table_init_sized(&ft, 1000000);
+    mu_assert("error, ceiling clamp", ft.max_capacity == FLOW_TABLE_MAX_CAPACITY);
+    flow_table_set_max_flows(&ft, 100);
+    mu_assert("error, floor clamp", ft.max_capacity == FLOW_TABLE_MIN_CAPACITY);
+    flow_table_free(&ft);
+    return 0;
+}
+
+/* ── Behaviour signature / dirty bit ───────────────────────── */
+static char *test_flow_dirty_on_behavior_shift() {
+    static flow_table_t ft;
+    flow_table_init(&ft);
+    flow_key_t k = make_key(3);
+
+    flow_table_update(&ft, &k, 10, 10, 6000, 6000, 1.0);
+    flow_entry_t *e = (flow_entry_t *)flow_table_lookup(&ft, &k);
+    mu_assert("new flow is dirty", e->dirty == 1);
+    mu_assert("signature matches helper", e->behav_sig == flow_behavior_sig(e));
+    e->dirty = 0;
+
+    /* Same per-tick volume, mix and packet size: signature holds. */
+    flow_table_update(&ft, &k, 20, 20, 12000, 12000, 2.0);
+    flow_table_update(&ft, &k, 30, 30, 18000, 18000, 3.0);
+    e = (flow_entry_t *)flow_table_lookup(&ft, &k);
+    uint32_t sig = e->behav_sig;
+    e->dirty = 0;
+    flow_table_update(&ft, &k, 40, 40, 24000, 24000, 4.0);
+    e = (flow_entry_t *)flow_table_lookup(&ft, &k);
+    mu_assert("steady flow stays clean", e->dirty == 0 && e->behav_sig == sig);
+
+    /* Volume jumps ~100x: bucket moves, flow goes dirty. */
+    flow_table_update(&ft, &k, 440, 40, 624000, 24000, 5.0);
+    e = (flow_entry_t *)flow_table_lookup(&ft, &k);
+    mu_assert("volume shift marks dirty", e->dirty == 1 && e->behav_sig != sig);
+
+    flow_table_free(&ft);
+    return 0;
+}
+
+/* ── Ingestion source without libnetfilter_conntrack ───────── */
+static char *test_flow_ct_source_fallback() {
+    mu_assert("error, NULL source is not event mode", flow_ct_event_mode(NULL) == 0);
+    mu_assert("error, poll with NULL table should fail", flow_ct_poll(NULL, NULL, 0.0) == -1);
+
+    flow_ct_source_t *src = flow_ct_open(1, 30.0);
+    mu_assert("error, flow_ct_open returned NULL", src != NULL);
+#ifndef HAVE_LIBNFCT
+    mu_assert("error, stub build must degrade to dump mode", flow_ct_event_mode(src) == 0);
+#endif
+    flow_ct_close(src);
+    flow_ct_close(NULL);
+    return 0;
+}
+
+static char *all_tests() {
+    mu_run_test(test_flow_update_delta);
+    mu_run_test(test_flow_touch);
+    mu_run_test(test_flow_remove_chains);
+    mu_run_test(test_flow_evict_stale_chains);
+    mu_run_test(test_flow_full_table_churn);
+    mu_run_test(test_flow_grow_shrink);
+    mu_run_test(test_flow_budget);
+    mu_run_test(test_flow_dirty_on_behavior_shift);
+    mu_run_test(test_flow_ct_source_fallback);
+    return 0;
+}
+
+int main(int argc, char **argv) {
+    (void)argc; (void)argv;
+    char *result = all_tests();
+    if (result != 0) {
+        printf("FAILED: %s\n", result);
+    } else {
+        printf("ALL TESTS PASSED\n");
+    }
+    printf("Tests run: %d\n", tests_run);
+    return result != 0;
+}
@@ -193,6 +193,20 @@ static char *test_svc_unknown() {
     return 0;
 }
 
+/* ── Generated table: overlaps, edges, other protocols ─────── */
+static char *test_table_overlap_and_edges() {
+    mu_assert("TCP SIP inside Riot range",   service_from_port(6, 5060)  == SVC_VOIP_CALL);
+    mu_assert("TCP SIP persona",             hint_from_port(6, 5061)     == PERSONA_VOIP);
+    mu_assert("TCP Riot either side of SIP", service_from_port(6, 5059)  == SVC_GAME_RT &&
+                                             service_from_port(6, 5062)  == SVC_GAME_RT);
+    mu_assert("Valve lower edge",            service_from_port(17, 27014) == SVC_UNKNOWN);
+    mu_assert("Valve upper edge",            service_from_port(17, 27051) == SVC_UNKNOWN);
+    mu_assert("port 65535",                  service_from_port(17, 65535) == SVC_UNKNOWN);
+    mu_assert("SCTP on a game port",         hint_from_port(132, 27015)  == PERSONA_UNKNOWN);
+    mu_assert("system port has no persona",  hint_from_port(17, 53)      == PERSONA_UNKNOWN);
+    return 0;
+}
+
 static char *all_tests() {
     mu_run_test(test_valve_udp);
     mu_run_test(test_riot_tcp);
@@ -215,6 +229,7 @@ static char *all_tests() {
     mu_run_test(test_svc_system);
     mu_run_test(test_svc_web_interactive);
     mu_run_test(test_svc_unknown);
+    mu_run_test(test_table_overlap_and_edges);
     return 0;
 }
 
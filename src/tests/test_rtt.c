@@ -39,19 +39,38 @@ static char *test_inject_then_lookup() {
     mu_assert("lookup after inject → 42", rtt_engine_lookup_ms(eng, &k) == 42);
     rtt_engine_inject_stub(eng, &k, 130);
     mu_assert("update in place → 130", rtt_engine_lookup_ms(eng, &k) == 130);
+    mu_assert("stub snapshot reads nothing", rtt_engine_refresh_rtt(eng) == 0);
+    mu_assert("lookup after refresh → 130", rtt_engine_lookup_ms(eng, &k) == 130);
+    mu_assert("NULL snapshot refresh", rtt_engine_refresh_rtt(NULL) == -1);
     rtt_engine_close(eng);
     return 0;
 }
 
 static char *test_udp_flow_always_zero() {
     rtt_engine_t *eng = rtt_engine_open(NULL, NULL);
-    flow_key_t k = { 0x0a0a0a01u, 0x08080808u, 40000, 443, 17 };  /* UDP */
+    flow_key_t k = { 0x0a0a0a01u, 0x08080808u, 40000, 3478, 17 };  /* UDP */
     rtt_engine_inject_stub(eng, &k, 25);   /* injection succeeds but... */
     mu_assert("UDP lookup skipped → 0", rtt_engine_lookup_ms(eng, &k) == 0);
     rtt_engine_close(eng);
     return 0;
 }
 
+static char *test_quic_flow_measured() {
+    rtt_engine_t *eng = rtt_engine_open(NULL, NULL);
+    flow_key_t k = { 0x0a0a0a01u, 0x08080808u, 40000, 443, 17 };   /* QUIC */
+    flow_key_t rev = { 0x0a0a0a01u, 0x08080808u, 443, 40000, 17 }; /* server side */
+    rtt_pct_t in = { 12, 30, 45, 60 }, out;
+    rtt_engine_inject_stub(eng, &k, 35);
+    rtt_engine_inject_stub(eng, &rev, 35);
+    mu_assert("UDP/443 timed by spin bit → 35", rtt_engine_lookup_ms(eng, &k) == 35);
+    mu_assert("only server port 443 counts", rtt_engine_lookup_ms(eng, &rev) == 0);
+    rtt_engine_inject_pct_stub(eng, &k, &in);
+    mu_assert("QUIC percentiles",
+              rtt_engine_flow_percentiles(eng, &k, &out) == 0 && out.p99_ms == 60);
+    rtt_engine_close(eng);
+    return 0;
+}
+
 static char *test_null_lookup_safe() {
     mu_assert("NULL engine → 0", rtt_engine_lookup_ms(NULL, NULL) == 0);
     rtt_engine_t *eng = rtt_engine_open(NULL, NULL);
@@ -61,12 +80,150 @@ static char *test_null_lookup_safe() {
     return 0;
 }
 
+static char *test_window_stub() {
+    rtt_engine_t *eng = rtt_engine_open(NULL, NULL);
+    flow_key_t udp = { 0x0a0a0a01u, 0x08080808u, 40000, 3478, 17 };
+    flow_key_t icmp = { 0x0a0a0a01u, 0x08080808u, 0, 0, 1 };
+    flow_pkt_window_t w, got;
+    memset(&w, 0, sizeof(w));
+
+    mu_assert("stub refresh reads nothing", rtt_engine_refresh_features(eng, 1.0) == 0);
+    mu_assert("no window before injection", rtt_engine_flow_window(eng, &udp, &got) == -1);
+
+    w.dir[RTT_FEAT_UP].packets      = 50;
+    w.dir[RTT_FEAT_UP].bytes        = 8000;
+    w.dir[RTT_FEAT_UP].size_hist[2] = 50;
+    w.dir[RTT_FEAT_UP].iat_hist[12] = 49;
+    w.window_s = 1.0;
+    rtt_engine_inject_window_stub(eng, &udp, &w);
+    mu_assert("UDP window after injection", rtt_engine_flow_window(eng, &udp, &got) == 0);
+    mu_assert("window round-trips",
+              got.dir[RTT_FEAT_UP].packets == 50 && got.dir[RTT_FEAT_UP].bytes == 8000 &&
+              got.dir[RTT_FEAT_UP].iat_hist[12] == 49 && got.dir[RTT_FEAT_DOWN].packets == 0 &&
+              got.window_s == 1.0);
+    mu_assert("window stub leaves RTT unknown", rtt_engine_lookup_ms(eng, &udp) == 0);
+
+    rtt_engine_inject_window_stub(eng, &icmp, &w);
+    mu_assert("non TCP/UDP has no window", rtt_engine_flow_window(eng, &icmp, &got) == -1);
+    mu_assert("NULL safe", rtt_engine_flow_window(NULL, &udp, &got) == -1);
+    mu_assert("NULL refresh", rtt_engine_refresh_features(NULL, 1.0) == -1);
+    rtt_engine_close(eng);
+    return 0;
+}
+
+static char *test_hist_buckets() {
+    mu_assert("0..3 ms exact", rtt_hist_bucket(0) == 0 && rtt_hist_bucket(3) == 3);
+    mu_assert("4..7 ms one bucket per ms",
+              rtt_hist_bucket(4) == 4 && rtt_hist_bucket(7) == 7);
+    mu_assert("8..15 ms in 2 ms steps",
+              rtt_hist_bucket(8) == 8 && rtt_hist_bucket(9) == 8 && rtt_hist_bucket(10) == 9);
+    mu_assert("64..79 ms share a bucket",
+              rtt_hist_bucket(64) == rtt_hist_bucket(79) &&
+              rtt_hist_bucket(80) == rtt_hist_bucket(64) + 1);
+    mu_assert("monotonic", rtt_hist_bucket(150) < rtt_hist_bucket(300));
+    mu_assert("clamped to last bucket",
+              rtt_hist_bucket(10000) == RTT_HIST_BUCKETS - 1 &&
+              rtt_hist_bucket(UINT32_MAX) == RTT_HIST_BUCKETS - 1);
+    return 0;
+}
+
+static char *test_hist_percentiles() {
+    uint32_t hist[RTT_HIST_BUCKETS];
+    rtt_pct_t p;
+    memset(hist, 0, sizeof(hist));
+    rtt_hist_percentiles(hist, &p);
+    mu_assert("empty → zeros", p.samples == 0 && p.p50_ms == 0 && p.p99_ms == 0);
+
+    /* 95 samples at 20 ms, 4 at 100 ms, 1 at 400 ms. */
+    hist[rtt_hist_bucket(20)]  = 95;
+    hist[rtt_hist_bucket(100)] = 4;
+    hist[rtt_hist_bucket(400)] = 1;
+    rtt_hist_percentiles(hist, &p);
+    mu_assert("sample count", p.samples == 100);
+    mu_assert("p50 within the 20 ms bucket", p.p50_ms >= 20 && p.p50_ms <= 24);
+    mu_assert("p95 still in the 20 ms bucket", p.p95_ms >= 20 && p.p95_ms <= 24);
+    mu_assert("p99 in the 100 ms bucket", p.p99_ms >= 96 && p.p99_ms <= 112);
+    mu_assert("ordered", p.p50_ms <= p.p95_ms && p.p95_ms <= p.p99_ms);
+
+    hist[rtt_hist_bucket(400)] = 10;
+    rtt_hist_percentiles(hist, &p);
+    mu_assert("heavier tail moves p99 to 400 ms", p.p99_ms >= 384 && p.p99_ms <= 448);
+    return 0;
+}
+
+static char *test_pct_stub() {
+    rtt_engine_t *eng = rtt_engine_open(NULL, NULL);
+    flow_key_t tcp = { 0x0a0a0a01u, 0x08080808u, 40000, 443, 6 };
+    flow_key_t udp = { 0x0a0a0a01u, 0x08080808u, 40000, 3478, 17 };
+    rtt_pct_t in = { 50, 20, 40, 90 }, out;
+    mu_assert("no percentiles before injection",
+              rtt_engine_flow_percentiles(eng, &tcp, &out) == -1);
+    rtt_engine_inject_stub(eng, &tcp, 25);
+    rtt_engine_inject_pct_stub(eng, &tcp, &in);
+    mu_assert("percentiles after injection",
+              rtt_engine_flow_percentiles(eng, &tcp, &out) == 0 &&
+              out.samples == 50 && out.p99_ms == 90);
+    mu_assert("srtt kept alongside", rtt_engine_lookup_ms(eng, &tcp) == 25);
+    rtt_engine_inject_pct_stub(eng, &udp, &in);
+    mu_assert("UDP has no RTT percentiles",
+              rtt_engine_flow_percentiles(eng, &udp, &out) == -1);
+    rtt_engine_close(eng);
+    return 0;
+}
+
+typedef struct {
+    int         n;
+    rtt_event_t last;
+} ev_sink_t;
+
+static void sink(const rtt_event_t *ev, void *arg) {
+    ev_sink_t *s = arg;
+    s->n++;
+    s->last = *ev;
+}
+
+static char *test_breach_events_stub() {
+    rtt_engine_t *eng = rtt_engine_open(NULL, NULL);
+    flow_key_t k = { 0x0a0a0a01u, 0x08080808u, 40000, 443, 6 };
+    ev_sink_t s = { 0 };
+    mu_assert("stub has no kernel ring", rtt_engine_events_open(eng) == -1);
+
+    rtt_engine_inject_stub(eng, &k, 200);
+    mu_assert("unwatched flow: no event", rtt_engine_poll_events(eng, 0, sink, &s) == 0);
+
+    mu_assert("set threshold", rtt_engine_set_threshold(eng, &k, 75) == 0);
+    rtt_engine_inject_stub(eng, &k, 60);
+    mu_assert("under threshold: no event", rtt_engine_poll_events(eng, 0, sink, &s) == 0);
+    rtt_engine_inject_stub(eng, &k, 90);
+    rtt_engine_inject_stub(eng, &k, 120);
+    mu_assert("one event per crossing", rtt_engine_poll_events(eng, 0, sink, &s) == 1);
+    mu_assert("event fields", s.last.srtt_ms == 90 && s.last.thresh_ms == 75 &&
+              s.last.key.dst_port == 443 && s.last.key.src_ip == k.src_ip);
+
+    rtt_engine_inject_stub(eng, &k, 70);
+    rtt_engine_inject_stub(eng, &k, 100);
+    mu_assert("re-armed after recovery", rtt_engine_poll_events(eng, 0, sink, &s) == 1);
+
+    rtt_engine_set_threshold(eng, &k, 0);
+    rtt_engine_inject_stub(eng, &k, 50);
+    rtt_engine_inject_stub(eng, &k, 300);
+    mu_assert("cleared threshold: no event", rtt_engine_poll_events(eng, 0, sink, &s) == 0);
+    rtt_engine_close(eng);
+    return 0;
+}
+
 static char *all_tests() {
     mu_run_test(test_open_close_null_safe);
     mu_run_test(test_lookup_unknown_returns_zero);
     mu_run_test(test_inject_then_lookup);
     mu_run_test(test_udp_flow_always_zero);
+    mu_run_test(test_quic_flow_measured);
     mu_run_test(test_null_lookup_safe);
+    mu_run_test(test_window_stub);
+    mu_run_test(test_hist_buckets);
+    mu_run_test(test_hist_percentiles);
+    mu_run_test(test_pct_stub);
+    mu_run_test(test_breach_events_stub);
     return 0;
 }
 
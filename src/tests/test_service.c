@@ -244,6 +244,44 @@ static char *test_behavior_web_browsing_unknown() {
     return 0;
 }
 
+static char *test_behavior_windowed_vod_ignores_acks() {
+    /* MSS download with one 52B ACK per segment: the combined average
+     * (~750B) misses the VOD rule, the downstream window does not. */
+    flow_features_t f = {
+        .proto = 6, .avg_pkt_size = 750.0, .bw_bps = 8000000.0,
+        .rx_ratio = 0.96, .pkts_total = 5000,
+    };
+    mu_assert("combined average alone → UNKNOWN",
+              service_infer_behavior(&f) == SVC_UNKNOWN);
+    f.windowed        = 1;
+    f.win_pkts[0]     = 600;
+    f.win_pkts[1]     = 600;
+    f.win_avg_size[0] = 52.0;
+    f.win_avg_size[1] = 1448.0;
+    mu_assert("downstream window → VIDEO_VOD",
+              service_infer_behavior(&f) == SVC_VIDEO_VOD);
+    return 0;
+}
+
+static char *test_behavior_windowed_voip_needs_cadence() {
+    flow_features_t f = {
+        .proto = 17, .avg_pkt_size = 160.0, .bw_bps = 60000.0,
+        .rx_ratio = 0.5, .pkts_total = 500,
+        .windowed = 1, .win_pkts = { 50, 50 },
+        .win_avg_size = { 160.0, 160.0 },
+        .win_iat_p50_us = { 24576.0, 24576.0 },   /* 20 ms frames */
+    };
+    mu_assert("20 ms cadence → VOIP_CALL",
+              service_infer_behavior(&f) == SVC_VOIP_CALL);
+    f.win_iat_p50_us[0] = 1536.0;                /* bursty, ~1.5 ms gaps */
+    mu_assert("no codec cadence → GAME_RT",
+              service_infer_behavior(&f) == SVC_GAME_RT);
+    f.win_iat_p50_us[0] = 0.0;                   /* no gap samples */
+    mu_assert("unknown cadence keeps the size/rate verdict",
+              service_infer_behavior(&f) == SVC_VOIP_CALL);
+    return 0;
+}
+
 static char *test_behavior_null_safe() {
     mu_assert("NULL → UNKNOWN", service_infer_behavior(NULL) == SVC_UNKNOWN);
     return 0;
@@ -301,6 +339,45 @@ static char *test_behavior_composes_with_voter() {
     return 0;
 }
 
+/* Precomputed table: same verdicts as scoring, then new weights */
+static char *test_voter_table_and_weights() {
+    static service_t direct[SERVICE_COUNT][SERVICE_COUNT][SERVICE_COUNT];
+    service_signals_t s;
+    for (int d = 0; d < SERVICE_COUNT; d++)
+        for (int p = 0; p < SERVICE_COUNT; p++)
+            for (int b = 0; b < SERVICE_COUNT; b++) {
+                s = (service_signals_t){ (service_t)d, (service_t)p, (service_t)b };
+                direct[d][p][b] = service_classify(&s);
+            }
+
+    service_set_weights(NULL);
+    for (int d = 0; d < SERVICE_COUNT; d++)
+        for (int p = 0; p < SERVICE_COUNT; p++)
+            for (int b = 0; b < SERVICE_COUNT; b++) {
+                s = (service_signals_t){ (service_t)d, (service_t)p, (service_t)b };
+                mu_assert("table == scored verdict", service_classify(&s) == direct[d][p][b]);
+            }
+    s = (service_signals_t){ (service_t)99, SVC_GAME_RT, SVC_UNKNOWN };
+    mu_assert("out-of-range hint ignored", service_classify(&s) == SVC_GAME_RT);
+
+    service_weights_t w = { .dns = 0.6, .port = 0.7, .behavior = 0.1, .floor = 0.3 };
+    service_set_weights(&w);
+    s = (service_signals_t){ SVC_VIDEO_VOD, SVC_GAME_RT, SVC_UNKNOWN };
+    mu_assert("heavier port beats DNS", service_classify(&s) == SVC_GAME_RT);
+
+    w = (service_weights_t){ .dns = 0.6, .port = 0.3, .behavior = 0.1, .floor = 0.35 };
+    service_set_weights(&w);
+    s = (service_signals_t){ SVC_UNKNOWN, SVC_GAME_RT, SVC_UNKNOWN };
+    mu_assert("raised floor rejects lone port", service_classify(&s) == SVC_UNKNOWN);
+    s.behavior_hint = SVC_GAME_RT;
+    mu_assert("port+behavior clears it", service_classify(&s) != SVC_UNKNOWN);
+
+    service_set_weights(NULL);
+    s = (service_signals_t){ SVC_UNKNOWN, SVC_GAME_RT, SVC_UNKNOWN };
+    mu_assert("defaults restored", service_classify(&s) == SVC_GAME_RT);
+    return 0;
+}
+
 static char *all_tests() {
     mu_run_test(test_service_names_stable);
     mu_run_test(test_service_to_persona);
@@ -321,8 +398,11 @@ static char *all_tests() {
     mu_run_test(test_behavior_young_flow_unknown);
     mu_run_test(test_behavior_idle_flow_unknown);
     mu_run_test(test_behavior_web_browsing_unknown);
+    mu_run_test(test_behavior_windowed_vod_ignores_acks);
+    mu_run_test(test_behavior_windowed_voip_needs_cadence);
     mu_run_test(test_behavior_null_safe);
     mu_run_test(test_behavior_composes_with_voter);
+    mu_run_test(test_voter_table_and_weights);
     mu_run_test(test_rtt_target_nonzero_for_rt_classes);
     mu_run_test(test_rtt_target_zero_for_opt_out_classes);
     mu_run_test(test_demote_ladder);
@@ -0,0 +1,151 @@
+/*
+ * test_spsc.c - Unit tests for the pipeline SPSC queue
+ */
+#include <pthread.h>
+#include <sched.h>
+#include <stdint.h>
+#include <stdio.h>
+#include "../minunit.h"
+#include "../myco_spsc.h"
+
+int tests_run = 0;
+
+typedef struct {
+    uint32_t seq;
+    double   payload[3];
+} item_t;
+
+static char *test_push_pop_order() {
+    spsc_queue_t q;
+    mu_assert("init failed", spsc_init(&q, 4, sizeof(item_t)) == 0);
+
+    item_t in = {0}, out = {0};
+    mu_assert("new queue should be empty", spsc_pop(&q, &out) == -1);
+    for (uint32_t i = 0; i < 4; i++) {
+        in.seq = i;
+        mu_assert("push into free slot failed", spsc_push(&q, &in) == 0);
+    }
+    in.seq = 99;
+    mu_assert("push into full queue should fail", spsc_push(&q, &in) == -1);
+    mu_assert("refused push should count as a drop", spsc_drops(&q) == 1);
+    mu_assert("count should be 4", spsc_count(&q) == 4);
+
+    for (uint32_t i = 0; i < 4; i++) {
+        mu_assert("pop failed", spsc_pop(&q, &out) == 0);
+        mu_assert("items should come out in order", out.seq == i);
+    }
+    mu_assert("drained queue should be empty", spsc_pop(&q, &out) == -1);
+    spsc_destroy(&q);
+    return 0;
+}
+
+static char *test_capacity_rounding() {
+    spsc_queue_t q;
+    mu_assert("init failed", spsc_init(&q, 3, sizeof(uint32_t)) == 0);
+    uint32_t v = 0;
+    int pushed = 0;
+    while (spsc_push(&q, &v) == 0) pushed++;
+    mu_assert("capacity 3 should round up to 4", pushed == 4);
+    spsc_destroy(&q);
+
+    mu_assert("zero slot size should be rejected", spsc_init(&q, 4, 0) == -1);
+    spsc_destroy(&q);
+    spsc_destroy(NULL);
+    return 0;
+}
+
+static char *test_pop_latest() {
+    spsc_queue_t q;
+    mu_assert("init failed", spsc_init(&q, 8, sizeof(item_t)) == 0);
+
+    item_t in = {0}, out = {0};
+    out.seq = 1234;
+    mu_assert("empty pop_latest should consume nothing", spsc_pop_latest(&q, &out) == 0);
+    mu_assert("empty pop_latest should leave out untouched", out.seq == 1234);
+
+    for (uint32_t i = 0; i < 5; i++) {
+        in.seq = i;
+        spsc_push(&q, &in);
+    }
+    mu_assert("pop_latest should consume all 5", spsc_pop_latest(&q, &out) == 5);
+    mu_assert("pop_latest should keep the newest", out.seq == 4);
+    mu_assert("queue should be empty afterwards", spsc_count(&q) == 0);
+
+    /* Wraparound: indices keep running past the capacity. */
+    for (uint32_t i = 0; i < 20; i++) {
+        in.seq = 100 + i;
+        spsc_push(&q, &in);
+        mu_assert("pop after wrap failed", spsc_pop(&q, &out) == 0);
+        mu_assert("wrong item after wrap", out.seq == 100 + i);
+    }
+    spsc_destroy(&q);
+    return 0;
+}
+
+/* ── Cross-thread: one producer, one consumer ─────────────────── */
+
+#define XFER_ITEMS 200000u
+
+static void *producer(void *arg) {
+    spsc_queue_t *q = arg;
+    item_t it = {0};
+    for (uint32_t i = 0; i < XFER_ITEMS; i++) {
+        it.seq = i;
+        it.payload[0] = (double)i;
+        it.payload[2] = (double)i * 2.0;
+        while (spsc_push(q, &it) != 0) {
+            sched_yield();   /* full: let the consumer catch up */
+        }
+    }
+    return NULL;
+}
+
+static char *test_threaded_transfer() {
+    spsc_queue_t q;
+    mu_assert("init failed", spsc_init(&q, 16, sizeof(item_t)) == 0);
+
+    pthread_t tid;
+    mu_assert("thread create failed", pthread_create(&tid, NULL, producer, &q) == 0);
+
+    uint32_t expect = 0;
+    int torn = 0, gap = 0;
+    item_t out;
+    while (expect < XFER_ITEMS) {
+        if (spsc_pop(&q, &out) != 0) {
+            sched_yield();
+            continue;
+        }
+        if (out.seq != expect) gap = 1;
+        if (out.payload[0] != (double)out.seq || out.payload[2] != (double)out.seq * 2.0) {
+            torn = 1;
+        }
+        expect = out.seq + 1;
+    }
+    pthread_join(tid, NULL);
+
+    mu_assert("items lost or reordered across threads", !gap);
+    mu_assert("item copied while still being written", !torn);
+    mu_assert("queue should be empty after the transfer", spsc_count(&q) == 0);
+    spsc_destroy(&q);
+    return 0;
+}
+
+static char *all_tests() {
+    mu_run_test(test_push_pop_order);
+    mu_run_test(test_capacity_rounding);
+    mu_run_test(test_pop_latest);
+    mu_run_test(test_threaded_transfer);
+    return 0;
+}
+
+int main(int argc, char **argv) {
+    (void)argc; (void)argv;
+    char *result = all_tests();
+    if (result != 0) {
+        printf("FAILED: %s\n", result);
+    } else {
+        printf("ALL TESTS PASSED\n");
+    }
+    printf("Tests run: %d\n", tests_run);
+    return result != 0;
+}
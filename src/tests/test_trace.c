@@ -0,0 +1,197 @@
+/*
+ * test_trace.c - Unit tests for the record / replay trace
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "../minunit.h"
+#include "../myco_trace.h"
+
+int tests_run = 0;
+
+static flow_key_t mk_key(uint16_t sport) {
+    flow_key_t k;
+    memset(&k, 0, sizeof(k));
+    k.src_ip   = 0x0a00000au;
+    k.dst_ip   = 0x08080808u;
+    k.src_port = sport;
+    k.dst_port = 443;
+    k.protocol = 6;
+    return k;
+}
+
+static int tmp_path(char *buf, size_t len) {
+    snprintf(buf, len, "/tmp/test_trace_XXXXXX");
+    int fd = mkstemp(buf);
+    if (fd < 0) return -1;
+    close(fd);
+    return 0;
+}
+
+/* Decode a FLOWS payload into `out`; returns the entry count or -1. */
+static int decode_all(const trace_rec_t *rec, trace_flow_t *out, int max) {
+    size_t off = 0;
+    int n = 0;
+    while (off < rec->len && n < max) {
+        int used = trace_flow_decode(rec->data + off, rec->len - off, &out[n]);
+        if (used < 0) return -1;
+        off += (size_t)used;
+        n++;
+    }
+    return off == rec->len ? n : -1;
+}
+
+static char *test_trace_roundtrip() {
+    char path[64];
+    mu_assert("mkstemp failed", tmp_path(path, sizeof(path)) == 0);
+    mu_assert("open failed", trace_open(path, 1u << 20) == 0);
+    mu_assert("recorder should be active", trace_active() == 1);
+
+    flow_table_t ft;
+    mu_assert("flow table init failed", flow_table_init(&ft) == 0);
+    flow_key_t a = mk_key(1000), b = mk_key(1001);
+
+    /* Tick 1: two new flows, plus a DNS answer before it. */
+    static const uint8_t dns[] = { 0x12, 0x34, 0x81, 0x80, 0, 0, 0, 0, 0, 0, 0, 0 };
+    trace_record_dns(dns, sizeof(dns), 0.9);
+    flow_table_update(&ft, &a, 10, 10, 1000, 2000, 1.0);
+    flow_table_update(&ft, &b, 5, 5, 500, 600, 1.0);
+    trace_record_tick(&ft, 1.0, 0.5);
+
+    /* Tick 2: a refreshed unchanged, b grew. */
+    flow_table_update(&ft, &a, 10, 10, 1000, 2000, 2.0);
+    flow_table_update(&ft, &b, 9, 9, 900, 1000, 2.0);
+    trace_record_tick(&ft, 2.0, 0.5);
+
+    /* Tick 3: b destroyed, a idle (not refreshed, still in the table). */
+    flow_table_remove(&ft, &b);
+    trace_record_tick(&ft, 3.0, 0.5);
+    trace_close();
+    mu_assert("recorder should be inactive after close", trace_active() == 0);
+    flow_table_free(&ft);
+
+    trace_reader_t r;
+    trace_rec_t rec;
+    trace_flow_t f[4];
+    mu_assert("reader open failed", trace_reader_open(&r, path) == 0);
+
+    mu_assert("expected DNS record", trace_reader_next(&r, &rec) == 1 &&
+              rec.type == TRACE_REC_DNS && rec.ts == 0.9 && rec.len == sizeof(dns) &&
+              memcmp(rec.data, dns, sizeof(dns)) == 0);
+
+    mu_assert("expected tick 1 flows", trace_reader_next(&r, &rec) == 1 &&
+              rec.type == TRACE_REC_FLOWS && rec.ts == 1.0);
+    mu_assert("tick 1 should hold 2 entries", decode_all(&rec, f, 4) == 2);
+    mu_assert("new flows are FULL", f[0].kind == TRACE_FLOW_FULL && f[1].kind == TRACE_FLOW_FULL);
+    const trace_flow_t *fb = f[0].key.src_port == 1001 ? &f[0] : &f[1];
+    mu_assert("counters should round-trip", fb->tx_packets == 5 && fb->rx_packets == 5 &&
+              fb->tx_bytes == 500 && fb->rx_bytes == 600 && fb->key.dst_port == 443 &&
+              fb->key.protocol == 6 && fb->has_mark == 0);
+
+    double window_s = 0.0;
+    mu_assert("expected tick 1 boundary", trace_reader_next(&r, &rec) == 1 &&
+              rec.type == TRACE_REC_TICK && rec.len == sizeof(window_s));
+    memcpy(&window_s, rec.data, sizeof(window_s));
+    mu_assert("tick should carry window_s", window_s == 0.5);
+
+    mu_assert("expected tick 2 flows", trace_reader_next(&r, &rec) == 1 &&
+              rec.type == TRACE_REC_FLOWS && rec.ts == 2.0);
+    mu_assert("tick 2 should hold 2 entries", decode_all(&rec, f, 4) == 2);
+    const trace_flow_t *fa = f[0].key.src_port == 1000 ? &f[0] : &f[1];
+    fb = fa == &f[0] ? &f[1] : &f[0];
+    mu_assert("unchanged flow should be SAME", fa->kind == TRACE_FLOW_SAME);
+    mu_assert("grown flow should be FULL", fb->kind == TRACE_FLOW_FULL && fb->tx_bytes == 900);
+    mu_assert("expected tick 2 boundary", trace_reader_next(&r, &rec) == 1 &&
+              rec.type == TRACE_REC_TICK);
+
+    mu_assert("expected tick 3 flows", trace_reader_next(&r, &rec) == 1 &&
+              rec.type == TRACE_REC_FLOWS && rec.ts == 3.0);
+    mu_assert("tick 3 should hold only the destroyed flow", decode_all(&rec, f, 4) == 1);
+    mu_assert("destroyed flow should be GONE",
+              f[0].kind == TRACE_FLOW_GONE && f[0].key.src_port == 1001);
+    mu_assert("expected tick 3 boundary", trace_reader_next(&r, &rec) == 1 &&
+              rec.type == TRACE_REC_TICK);
+    mu_assert("expected end of trace", trace_reader_next(&r, &rec) == 0);
+
+    trace_reader_rewind(&r);
+    mu_assert("rewind should return to the first record",
+              trace_reader_next(&r, &rec) == 1 && rec.type == TRACE_REC_DNS);
+    trace_reader_close(&r);
+    unlink(path);
+    return 0;
+}
+
+static char *test_trace_size_limit() {
+    char path[64];
+    mu_assert("mkstemp failed", tmp_path(path, sizeof(path)) == 0);
+    /* Header (16) + one TICK record (16 + 8) fits; the second does not. */
+    mu_assert("open failed", trace_open(path, 16 + 24 + 10) == 0);
+
+    flow_table_t ft;
+    mu_assert("flow table init failed", flow_table_init(&ft) == 0);
+    trace_record_tick(&ft, 1.0, 0.5);
+    mu_assert("first tick fits", trace_active() == 1);
+    trace_record_tick(&ft, 2.0, 0.5);
+    mu_assert("recording should stop at the limit", trace_active() == 0);
+    trace_record_tick(&ft, 3.0, 0.5);
+    trace_close();
+    flow_table_free(&ft);
+
+    trace_reader_t r;
+    trace_rec_t rec;
+    mu_assert("reader open failed", trace_reader_open(&r, path) == 0);
+    mu_assert("first tick kept", trace_reader_next(&r, &rec) == 1 && rec.ts == 1.0);
+    mu_assert("nothing after the limit", trace_reader_next(&r, &rec) == 0);
+    trace_reader_close(&r);
+    unlink(path);
+    return 0;
+}
+
+static char *test_trace_reader_rejects() {
+    char path[64];
+    mu_assert("mkstemp failed", tmp_path(path, sizeof(path)) == 0);
+    trace_reader_t r;
+
+    FILE *f = fopen(path, "wb");
+    fputs("not a trace at all", f);
+    fclose(f);
+    mu_assert("foreign file should be rejected", trace_reader_open(&r, path) == -1);
+
+    mu_assert("open failed", trace_open(path, 1u << 20) == 0);
+    static const uint8_t dns[64] = { 0 };
+    trace_record_dns(dns, sizeof(dns), 1.0);
+    trace_close();
+    mu_assert("truncate failed", truncate(path, 16 + 16 + 10) == 0);
+
+    trace_rec_t rec;
+    mu_assert("reader open failed", trace_reader_open(&r, path) == 0);
+    mu_assert("truncated record should be an error", trace_reader_next(&r, &rec) == -1);
+    trace_reader_close(&r);
+
+    trace_flow_t fl;
+    uint8_t short_full[TRACE_FLOW_SIZE_SAME] = { TRACE_FLOW_FULL };
+    mu_assert("truncated FULL entry should be an error",
+              trace_flow_decode(short_full, sizeof(short_full), &fl) == -1);
+    unlink(path);
+    return 0;
+}
+
+static char *all_tests() {
+    mu_run_test(test_trace_roundtrip);
+    mu_run_test(test_trace_size_limit);
+    mu_run_test(test_trace_reader_rejects);
+    return 0;
+}
+
+int main(int argc, char **argv) {
+    (void)argc; (void)argv;
+    char *result = all_tests();
+    if (result != 0) {
+        printf("FAILED: %s\n", result);
+    } else {
+        printf("ALL TESTS PASSED\n");
+    }
+    printf("Tests run: %d\n", tests_run);
+    return result != 0;
+}
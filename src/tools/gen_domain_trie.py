@@ -0,0 +1,163 @@
+#!/usr/bin/env python3
+"""
+gen_domain_trie.py
+------------------
+Compiles myco_domains.def into myco_domain_trie.h, a label-reversed
+suffix trie used by dns_domain_to_hint() / dns_domain_to_service().
+
+  "rr1---sn-x.googlevideo.com"  is walked as  com → googlevideo → rr1---sn-x
+
+Each node carries the persona and service of the suffix that ends there
+(PERSONA_UNKNOWN / SVC_UNKNOWN when none does). Children of a node are
+stored contiguously and sorted by label bytes, so the C side binary-
+searches them; the deepest node with a value is the longest suffix match.
+
+Usage:
+  gen_domain_trie.py <myco_domains.def> <myco_domain_trie.h>
+"""
+
+import re
+import sys
+
+ENTRY_RE = re.compile(r'^\s*DOMAIN_(HINT|SERVICE)\(\s*"([^"]+)"\s*,\s*(\w+)\s*\)', re.M)
+LABEL_RE = re.compile(r'^[a-z0-9_-]{1,63}$')
+
+
+class Node:
+    def __init__(self, label):
+        self.label = label
+        self.children = {}
+        self.hint = None
+        self.service = None
+
+
+def strip_comments(text):
+    return re.sub(r'/\*.*?\*/', lambda m: '\n' * m.group(0).count('\n'), text, flags=re.S)
+
+
+def parse(path):
+    with open(path, encoding='utf-8') as fh:
+        text = strip_comments(fh.read())
+    entries = []
+    for m in ENTRY_RE.finditer(text):
+        line = text.count('\n', 0, m.start()) + 1
+        entries.append((m.group(1), m.group(2).lower().rstrip('.'), m.group(3), line))
+    return entries
+
+
+def build(entries, src):
+    root = Node('')
+    errors = []
+    for kind, suffix, value, line in entries:
+        labels = suffix.split('.')
+        bad = [lab for lab in labels if not LABEL_RE.match(lab)]
+        if bad:
+            errors.append('%s:%d: bad label %r in "%s"' % (src, line, bad[0], suffix))
+            continue
+        node = root
+        for lab in reversed(labels):
+            node = node.children.setdefault(lab, Node(lab))
+        attr = 'hint' if kind == 'HINT' else 'service'
+        prev = getattr(node, attr)
+        if prev is not None and prev[0] != value:
+            errors.append('%s:%d: "%s" already mapped to %s (line %d), now %s'
+                          % (src, line, suffix, prev[0], prev[1], value))
+            continue
+        if prev is None:
+            setattr(node, attr, (value, line))
+    if errors:
+        sys.stderr.write('\n'.join(errors) + '\n')
+        sys.exit(1)
+    return root
+
+
+def flatten(root):
+    """Breadth-first layout: every node's children are contiguous."""
+    order = [root]
+    first_child = {}
+    i = 0
+    while i < len(order):
+        node = order[i]
+        kids = sorted(node.children.values(), key=lambda n: n.label.encode())
+        first_child[id(node)] = len(order)
+        order.extend(kids)
+        i += 1
+    return order, first_child
+
+
+def emit(order, first_child, out_path, n_entries):
+    pool = []
+    offsets = {}
+    size = 0
+    for node in order[1:]:
+        if node.label not in offsets:
+            offsets[node.label] = size
+            pool.append(node.label)
+            size += len(node.label)
+    if len(order) > 0xFFFF or size > 0xFFFF:
+        sys.stderr.write('domain trie too large for 16-bit indices\n')
+        sys.exit(1)
+
+    lines = []
+    w = lines.append
+    w('/*')
+    w(' * myco_domain_trie.h — GENERATED by tools/gen_domain_trie.py from')
+    w(' * myco_domains.def. Do not edit; edit the .def file instead.')
+    w(' *')
+    w(' * %d suffixes, %d trie nodes, %d label bytes.' % (n_entries, len(order), size))
+    w(' */')
+    w('#ifndef MYCO_DOMAIN_TRIE_H')
+    w('#define MYCO_DOMAIN_TRIE_H')
+    w('')
+    w('/* Included by myco_dns.c after myco_dns.h (persona_t, service_t). */')
+    w('#include <stdint.h>')
+    w('')
+    w('typedef struct {')
+    w('    uint16_t first_child;  /* index into dom_trie_nodes */')
+    w('    uint16_t n_children;')
+    w('    uint16_t label_off;    /* into dom_trie_labels */')
+    w('    uint8_t  label_len;')
+    w('    uint8_t  hint;         /* persona_t ending here, PERSONA_UNKNOWN = none */')
+    w('    uint8_t  service;      /* service_t ending here, SVC_UNKNOWN = none */')
+    w('} dom_trie_node_t;')
+    w('')
+    w('#define DOM_TRIE_NODE_COUNT %d' % len(order))
+    w('')
+    w('static const char dom_trie_labels[] =')
+    chunk = ''
+    for lab in pool:
+        if len(chunk) + len(lab) > 64:
+            w('    "%s"' % chunk)
+            chunk = ''
+        chunk += lab
+    w('    "%s";' % chunk)
+    w('')
+    w('static const dom_trie_node_t dom_trie_nodes[DOM_TRIE_NODE_COUNT] = {')
+    for node in order:
+        kids = len(node.children)
+        fc = first_child[id(node)] if kids else 0
+        off = offsets.get(node.label, 0)
+        hint = node.hint[0] if node.hint else 'PERSONA_UNKNOWN'
+        svc = node.service[0] if node.service else 'SVC_UNKNOWN'
+        w('    { %5d, %3d, %5d, %2d, %s, %s },  /* %s */'
+          % (fc, kids, off, len(node.label), hint, svc, node.label or '(root)'))
+    w('};')
+    w('')
+    w('#endif /* MYCO_DOMAIN_TRIE_H */')
+    with open(out_path, 'w', encoding='utf-8') as fh:
+        fh.write('\n'.join(lines) + '\n')
+
+
+def main():
+    if len(sys.argv) != 3:
+        sys.stderr.write(__doc__)
+        return 2
+    entries = parse(sys.argv[1])
+    root = build(entries, sys.argv[1])
+    order, first_child = flatten(root)
+    emit(order, first_child, sys.argv[2], len(entries))
+    return 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())
@@ -0,0 +1,153 @@
+#!/usr/bin/env python3
+"""
+gen_port_table.py
+-----------------
+Compiles myco_ports.def into myco_port_table.h, the lookup tables behind
+service_from_port() / hint_from_port().
+
+Every (protocol, port) gets one byte: the service_t in the low nibble and
+the persona_t in the high nibble. The 2 x 65536 bytes are split into
+256-port blocks; identical blocks are stored once and a per-protocol
+page map picks the block, so a lookup is two indexed loads from a few KB
+that stay in L1:
+
+  cell = port_blocks[port_pages[proto][port >> 8]][port & 0xFF]
+
+Block 0 is all-unknown. Where ranges overlap the narrower one wins.
+
+Usage:
+  gen_port_table.py <myco_ports.def> <myco_port_table.h>
+"""
+
+import re
+import sys
+
+ENTRY_RE = re.compile(
+    r'^\s*PORT_RANGE\(\s*(TCP|UDP)\s*,\s*(\d+)\s*,\s*(\d+)\s*,\s*(\w+)\s*,\s*(\w+)\s*\)', re.M)
+PROTOS = ('TCP', 'UDP')   # page map row order: 0 = TCP, 1 = UDP
+
+
+def strip_comments(text):
+    return re.sub(r'/\*.*?\*/', lambda m: '\n' * m.group(0).count('\n'), text, flags=re.S)
+
+
+def parse(path):
+    with open(path, encoding='utf-8') as fh:
+        text = strip_comments(fh.read())
+    entries = []
+    for m in ENTRY_RE.finditer(text):
+        line = text.count('\n', 0, m.start()) + 1
+        proto, lo, hi, svc, persona = m.groups()
+        entries.append((proto, int(lo), int(hi), svc, persona, line))
+    return entries
+
+
+def build(entries, src):
+    """Per protocol: port -> (width, cell, line) of the narrowest range."""
+    owner = {p: {} for p in PROTOS}
+    errors = []
+    for proto, lo, hi, svc, persona, line in entries:
+        if not 0 <= lo <= hi <= 0xFFFF:
+            errors.append('%s:%d: bad range %d-%d' % (src, line, lo, hi))
+            continue
+        width = hi - lo
+        cell = (svc, persona)
+        for port in range(lo, hi + 1):
+            prev = owner[proto].get(port)
+            if prev is None or width < prev[0]:
+                owner[proto][port] = (width, cell, line)
+            elif width == prev[0] and cell != prev[1]:
+                errors.append('%s:%d: %s port %d already mapped to %s/%s (line %d)'
+                              % (src, line, proto, port, prev[1][0], prev[1][1], prev[2]))
+                break
+    if errors:
+        sys.stderr.write('\n'.join(errors) + '\n')
+        sys.exit(1)
+    return owner
+
+
+def emit(owner, out_path, n_entries):
+    cells = [None]            # index 0 = (SVC_UNKNOWN, PERSONA_UNKNOWN)
+    cell_idx = {}
+    for proto in PROTOS:
+        for port in sorted(owner[proto]):
+            cell = owner[proto][port][1]
+            if cell not in cell_idx:
+                cell_idx[cell] = len(cells)
+                cells.append(cell)
+
+    blocks = [tuple([0] * 256)]
+    block_idx = {blocks[0]: 0}
+    pages = []
+    for proto in PROTOS:
+        row = []
+        for page in range(256):
+            blk = tuple(cell_idx[owner[proto][p][1]] if p in owner[proto] else 0
+                        for p in range(page << 8, (page + 1) << 8))
+            if blk not in block_idx:
+                block_idx[blk] = len(blocks)
+                blocks.append(blk)
+            row.append(block_idx[blk])
+        pages.append(row)
+    if len(blocks) > 256:
+        sys.stderr.write('port table needs more than 256 distinct blocks\n')
+        sys.exit(1)
+
+    lines = []
+    w = lines.append
+    w('/*')
+    w(' * myco_port_table.h — GENERATED by tools/gen_port_table.py from')
+    w(' * myco_ports.def. Do not edit; edit the .def file instead.')
+    w(' *')
+    w(' * %d ranges, %d distinct cells, %d blocks (%d bytes).'
+      % (n_entries, len(cells), len(blocks), len(blocks) * 256 + 2 * 256))
+    w(' */')
+    w('#ifndef MYCO_PORT_TABLE_H')
+    w('#define MYCO_PORT_TABLE_H')
+    w('')
+    w('/* Included by myco_hint.c after myco_hint.h (persona_t, service_t). */')
+    w('#include <stdint.h>')
+    w('')
+    w('#define PORT_CELL(svc, persona) ((uint8_t)((unsigned)(persona) << 4 | (unsigned)(svc)))')
+    for i, cell in enumerate(cells[1:], 1):
+        w('#define PC%d PORT_CELL(%s, %s)' % (i, cell[0], cell[1]))
+    w('')
+    w('#define PORT_TABLE_TCP 0')
+    w('#define PORT_TABLE_UDP 1')
+    w('')
+    w('static const uint8_t port_pages[2][256] = {')
+    for proto, row in zip(PROTOS, pages):
+        w('    { /* %s */' % proto)
+        for i in range(0, 256, 32):
+            w('        ' + ','.join(str(b) for b in row[i:i + 32]) + ',')
+        w('    },')
+    w('};')
+    w('')
+    w('static const uint8_t port_blocks[%d][256] = {' % len(blocks))
+    for bi, blk in enumerate(blocks):
+        w('    { /* block %d */' % bi)
+        for i in range(0, 256, 16):
+            w('        ' + ','.join(('PC%d' % c) if c else '0' for c in blk[i:i + 16]) + ',')
+        w('    },')
+    w('};')
+    w('')
+    for i in range(1, len(cells)):
+        w('#undef PC%d' % i)
+    w('')
+    w('#endif /* MYCO_PORT_TABLE_H */')
+    with open(out_path, 'w', encoding='utf-8') as fh:
+        fh.write('\n'.join(lines) + '\n')
+
+
+def main():
+    if len(sys.argv) != 3:
+        sys.stderr.write(__doc__)
+        return 2
+    entries = parse(sys.argv[1])
+    owner = build(entries, sys.argv[1])
+    emit(owner, sys.argv[2], len(entries))
+    return 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())